@@ -8,6 +8,8 @@
 #ifndef APPMIXER_H
 #define	APPMIXER_H
 #include <string>
+#include <vector>
+#include <map>
 #include "config.h"
 #include "tools.h"
 #include "video.h"
@@ -99,6 +101,15 @@ public:
 	virtual void onKeyboardEvent(bool down, DWORD keySym);
 private:
 	int Display(const BYTE* frame,int x,int y,int width,int height,int lineSize);
+	int DisplayDamaged(const BYTE* frame,int width,int height,int lineSize);
+	int Convert(const BYTE* frame,int x,int y,int width,int height,int lineSize);
+	int Present(int width,int height);
+	void Damage(int x,int y,int width,int height);
+	SwsContext* GetConverter(int width,int height);
+private:
+	//Size of the regions converted on damage
+	static const int TileSize = 64;
+	typedef std::map<DWORD,SwsContext*> Converters;
 private:
 	Logo		logo;
 	VideoOutput*	output;
@@ -118,6 +129,11 @@ private:
 	DWORD		popUpY;
 	DWORD		popUpWidth;
 	DWORD		popUpHeight;
+	Converters	converters;
+	std::vector<bool> damaged;
+	int		tilesX;
+	int		tilesY;
+	bool		updated;
 	
 #ifdef CEF
 public:
@@ -13,6 +13,8 @@ public:
 	virtual DWORD TrySetRate(DWORD rate)=0;
 	virtual DWORD GetRate()=0;
 	virtual DWORD GetClockRate()=0;
+	//Clear prediction state in place, false if not supported
+	virtual bool  Reset()			{ return false;	}
 	AudioCodec::Type	type;
 	int			numFrameSamples;
 	int			frameLength;
@@ -75,6 +77,11 @@ public:
 	virtual void  CancelRecBuffer()=0;
 	virtual int StartRecording(DWORD samplerate)=0;
 	virtual int StopRecording()=0;
+	//Ask for frames encoded once for all listeners of the same mix, not supported by default
+	virtual bool StartSharedEncoding(AudioCodec::Type codec,DWORD rate,DWORD numFrameSamples,const Properties &properties)	{ return false;	}
+	virtual void StopSharedEncoding()	{}
+	//Get samples or, if len is set, an already encoded frame
+	virtual int RecFrame(SWORD *buffer,DWORD size,BYTE *frame,DWORD frameSize,DWORD &len)	{ len = 0; return RecBuffer(buffer,size); }
 };
 
 class AudioOutput
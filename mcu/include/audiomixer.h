@@ -6,9 +6,14 @@
 #include "pipeaudioinput.h"
 #include "pipeaudiooutput.h"
 #include "sidebar.h"
+#include "mediaclock.h"
 #include <map>
+#include <list>
+#include <vector>
 
-class AudioMixer : public VADProxy
+class AudioMixer : 
+	public VADProxy,
+	public MediaClock::Listener
 {
 public:
 	AudioMixer();
@@ -33,8 +38,13 @@ public:
 
 	//VAD proxy interface
 	virtual DWORD GetVAD(int id);
+
+	//Media clock listener interface
+	virtual void onTick(QWORD deadline,DWORD ticks);
 	
 	int SetCalculateVAD(bool vad);
+	//Only mix the loudest ones, 0 for all
+	int SetMaxSpeakers(DWORD num);
 
 protected:
 	//Mix thread
@@ -47,6 +57,43 @@ private:
 private:
 
 	//Tipos
+	class SharedEncoder
+	{
+	public:
+		SharedEncoder(Sidebar* sidebar,AudioCodec::Type codec,DWORD rate,DWORD numFrameSamples,const Properties& properties);
+		~SharedEncoder();
+
+		bool Init(DWORD nativeRate);
+		bool IsFor(Sidebar* sidebar,AudioCodec::Type codec,DWORD rate,DWORD numFrameSamples,const Properties& properties);
+		//Encode the mix, returns number of frames ready
+		DWORD Encode(SWORD* samples,DWORD len);
+
+		BYTE*	 GetFrame(DWORD i)		{ return frames[i];	}
+		DWORD	 GetFrameLength(DWORD i)	{ return lengths[i];	}
+		DWORD	 GetNumFrames()			{ return numFrames;	}
+		//Samples pending before last Encode, they are not in any frame yet
+		SWORD*	 GetCarry()			{ return carry;		}
+		DWORD	 GetCarryLength()		{ return carryLen;	}
+		Sidebar* GetSidebar()			{ return sidebar;	}
+	public:
+		static const DWORD MaxFrames = 4;
+		DWORD			refs;
+	private:
+		Sidebar*		sidebar;
+		AudioCodec::Type	codec;
+		DWORD			rate;
+		DWORD			numFrameSamples;
+		Properties		properties;
+		AudioEncoder*		encoder;
+		AudioTransrater		transrater;
+		fifo<SWORD,4096>	pending;
+		SWORD			carry[4096];
+		DWORD			carryLen;
+		BYTE			frames[MaxFrames][MTU];
+		DWORD			lengths[MaxFrames];
+		DWORD			numFrames;
+	};
+
 	class AudioSource
 	{
 	public:
@@ -68,13 +115,32 @@ private:
 		PipeAudioOutput *output;
 		Sidebar*	sidebar;
 		DWORD		vad;
+		bool		mixed;
+		DWORD		hold;
+		SharedEncoder*	encoder;
+		bool		sharing;
+		DWORD		sharedVersion;
+		Sidebar*	sharedSidebar;
 	};
 
 	typedef std::map<int,AudioSource *>	Audios;
 	typedef std::map<int,Sidebar *>		Sidebars;
+	typedef std::pair<DWORD,AudioSource*>	Speaker;
+	typedef std::vector<Speaker>		Speakers;
+	typedef std::list<SharedEncoder*>	SharedEncoders;
+
+	//Time in ms a selected speaker is kept after it stops talking
+	static const DWORD SpeakerHold = 1000;
+
+private:
+	void UpdateSharedEncoder(AudioSource* audio);
+	void ReleaseSharedEncoder(AudioSource* audio);
 
 private:
 	pthread_t 	mixAudioThread;
+	pthread_mutex_t	tickMutex;
+	pthread_cond_t	tickCond;
+	DWORD		pendingTicks;
 	int		mixingAudio;
 	Use		lstAudiosUse;
 	
@@ -84,6 +150,9 @@ private:
 	int		numSidebars;
 	bool		vad;
 	DWORD		rate;
+	DWORD		maxSpeakers;
+	Speakers	speakers;
+	SharedEncoders	encoders;
 
 };
 
@@ -41,6 +41,12 @@ protected:
 private:
 	static void *startEncoding(void *par);
 
+private:
+	//Quantizer offsets for screen content
+	static const int ChangedQP = -2;
+	static const int StaticQP = 6;
+	static const int BurstQP = 6;
+
 private:
 	MediaFrame::Listener *mediaListener;
 	
@@ -56,6 +62,8 @@ private:
 	int bitrateLimit;
 	int bitrateLimitCount;
 	Properties properties;
+	bool screen;
+	DWORD keepAlive;
 
 	pthread_t	thread;
 	pthread_mutex_t mutex;
@@ -0,0 +1,63 @@
+/*
+ * File:   encoderthreads.h
+ * Author: Sergio
+ *
+ * Created on 23 de octubre de 2026, 11:20
+ */
+
+#ifndef ENCODERTHREADS_H
+#define	ENCODERTHREADS_H
+
+#include <pthread.h>
+#include "config.h"
+
+/*
+ * Process wide core budget for the video encoders.
+ *	Each encoder asks for a number of threads depending on its resolution
+ *	when it is opened and gives them back when it is deleted. Every encoder
+ *	gets at least one, so small encodes never get extra threads once the
+ *	budget is used and big ones are limited to the cores still free. It
+ *	also keeps the time spent encoding each frame.
+ */
+class EncoderThreads
+{
+public:
+	struct Stats
+	{
+		DWORD	cores;		//Core budget
+		DWORD	used;		//Threads granted to the open encoders
+		DWORD	encoders;	//Number of open encoders
+		QWORD	limited;	//Encoders that got less threads than wanted
+		QWORD	frames;		//Number of frames encoded
+		QWORD	encodeTime;	//Time spent encoding in us
+	};
+
+public:
+	static EncoderThreads& getInstance()
+	{
+		static EncoderThreads threads;
+		return threads;
+	}
+
+	//Threads an encoder of that size would use without budget
+	static DWORD GetWanted(DWORD width,DWORD height);
+
+public:
+	//0 uses the number of online cores
+	EncoderThreads(DWORD cores = 0);
+	~EncoderThreads();
+
+	//Wanted 0 uses the size policy, returns the threads granted, at least one
+	DWORD Acquire(DWORD width,DWORD height,DWORD wanted = 0);
+	void  Release(DWORD threads);
+	//Time in us of a frame encoding
+	void  OnEncoded(QWORD time);
+	void  SetCores(DWORD cores);
+	Stats GetStats();
+
+private:
+	Stats		stats;
+	pthread_mutex_t	mutex;
+};
+
+#endif	/* ENCODERTHREADS_H */
@@ -59,16 +59,25 @@ public:
 
 	int WriteEvent(const char* type,const char *msg)
 	{
-		char aux[1024];
+		char aux[4096];
+		int len;
 
 		if (type!=NULL)
 			//Serialize
-			sprintf(aux,"event:%s\ndata:%s\n\n",type,msg);
+			len = snprintf(aux,sizeof(aux),"event:%s\ndata:%s\n\n",type,msg);
 		else
 			//Serialize
-			sprintf(aux,"data:%s\n\n",msg);
+			len = snprintf(aux,sizeof(aux),"data:%s\n\n",msg);
+		//Check it fits
+		if (len<0 || len>=sizeof(aux))
+		{
+			//Log
+			Error("-StreamRequest::WriteEvent event too big [len:%d]\n",len);
+			//Skip it, but keep the request
+			return 1;
+		}
 		//Send it
-		if (!ResponseWriteBody(sess,aux,strlen(aux)))
+		if (!ResponseWriteBody(sess,aux,len))
 			//Error
 			return 0;
 		//Exit
@@ -6,14 +6,41 @@ extern "C" {
 }
 #include <config.h>
 
+/*
+ * Scales yuv 4:2:0 pictures.
+ *	Scaler contexts are kept on a process wide cache keyed by size, so
+ *	switching back to a previous resolution or moving a participant to
+ *	another slot reuses them. Exact 2:1, 3:1 and 4:1 downscales skip
+ *	libswscale and use a box filter.
+ */
 class FrameScaler
 {
+public:
+	struct Stats
+	{
+		QWORD	created;	//Number of scaler contexts created
+		QWORD	reused;		//Number of times a cached context was used
+		DWORD	cached;		//Number of contexts on the cache
+	};
+public:
+	static Stats GetStats();
+	static void  SetMaxCached(DWORD num);
+
 public:
 	FrameScaler();
 	~FrameScaler();
 	int SetResize(int srcWidth,int srcHeight,int srcLineWidth,int dstWidth,int dstHeight,int dstLineWidth,bool keepAspectRatio = true);
 	int Resize(BYTE *srcY,BYTE *srcU,BYTE *srcV,BYTE *dstY, BYTE *dstU, BYTE *dstV);
 	int Resize(BYTE *src,DWORD srcWidth,DWORD srcHeight,BYTE *dst,DWORD dstWidth,DWORD dstHeight,bool keepAspectRatio = true);
+	//Source planes with padded lines, chroma stride is half of the luma one
+	int Resize(BYTE *srcY,BYTE *srcU,BYTE *srcV,DWORD srcStride,DWORD srcWidth,DWORD srcHeight,BYTE *dst,DWORD dstWidth,DWORD dstHeight,bool keepAspectRatio = true);
+	//Enabled by default
+	void SetBoxFilter(bool enabled)	{ boxEnabled = enabled;	}
+	//Current downscale factor if using the box filter, 0 otherwise
+	int  GetBoxFactor()		{ return boxFactor;	}
+
+private:
+	void ReleaseContext();
 
 private:
 	struct SwsContext* resizeCtx;
@@ -34,6 +61,12 @@ private:
 	BYTE*	tmpY;
 	BYTE* 	tmpU;
 	BYTE* 	tmpV;
+	int	resizeSrcLineWidth;
+	bool	resizeKeepAspectRatio;
+	bool	boxEnabled;
+	int	boxFactor;
+	WORD*	boxRow;
+	int	boxRowSize;
 
 };
 
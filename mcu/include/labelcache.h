@@ -0,0 +1,83 @@
+/*
+ * File:   labelcache.h
+ * Author: Sergio
+ *
+ * Created on 21 de octubre de 2026, 10:15
+ */
+
+#ifndef LABELCACHE_H
+#define	LABELCACHE_H
+
+#include <pthread.h>
+#include <string>
+#include <list>
+#include "config.h"
+
+/*
+ * Process wide cache of rendered text labels.
+ *	Labels are rasterized once as yuva 4:2:0 tiles keyed by text, size and
+ *	style properties, and later draws of the same label just copy the tile
+ *	into the canvas, so participant names are not rendered again on each
+ *	frame. Least recently used tiles are dropped when the cache is full.
+ */
+class LabelCache
+{
+public:
+	struct Stats
+	{
+		QWORD	rendered;	//Number of labels rasterized
+		QWORD	reused;		//Number of times a cached tile was used
+		DWORD	cached;		//Number of tiles on the cache
+	};
+
+	struct Key
+	{
+		std::wstring	text;
+		DWORD		width;
+		DWORD		height;
+		std::string	style;
+
+		bool operator==(const Key& other) const;
+	};
+
+public:
+	static LabelCache& getInstance();
+	static Key   GetKey(const std::wstring& text,DWORD width,DWORD height,const Properties& properties);
+	//Size of a yuva 4:2:0 tile
+	static DWORD GetTileSize(DWORD width,DWORD height)	{ return width*height*2+(width/2)*(height/2)*2;	}
+
+public:
+	LabelCache(DWORD maxCached = 256);
+	virtual ~LabelCache();
+
+	//Copy the label at x,y of a yuva 4:2:0 canvas, rendering it only if not cached
+	int   Draw(const std::wstring& text,DWORD width,DWORD height,const Properties& properties,BYTE* canvas,DWORD canvasWidth,DWORD canvasHeight,DWORD x,DWORD y);
+	Stats GetStats();
+	void  SetMaxCached(DWORD num);
+	void  Clear();
+
+protected:
+	//Rasterize the label on a yuva 4:2:0 tile of the given size, called without the cache locked
+	virtual int Render(const std::wstring& text,DWORD width,DWORD height,const Properties& properties,BYTE* tile);
+
+private:
+	struct Label
+	{
+		Key	key;
+		BYTE*	tile;
+	};
+	typedef std::list<Label> Labels;
+
+private:
+	//Get cached tile and move it to front, must be called locked
+	BYTE* Find(const Key& key);
+	void Evict();
+
+private:
+	pthread_mutex_t	mutex;
+	Labels		labels;
+	Stats		stats;
+	DWORD		maxCached;
+};
+
+#endif	/* LABELCACHE_H */
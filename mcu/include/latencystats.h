@@ -0,0 +1,116 @@
+/*
+ * File:   latencystats.h
+ * Author: Sergio
+ *
+ * Created on 18 de octubre de 2026, 17:20
+ */
+
+#ifndef LATENCYSTATS_H
+#define	LATENCYSTATS_H
+
+#include "config.h"
+
+/*
+ * Log linear histogram of times in microseconds.
+ *	Values below 64us have their own bucket, above that each power of two
+ *	is split in 32 buckets, so any value is within a 3% of its bucket
+ *	bound, up to 2^32us. Recording is just incrementing a counter, so it
+ *	can be done on each frame, but only one thread must record on it.
+ */
+class LatencyHistogram
+{
+public:
+	static const DWORD NumBuckets = 896;
+
+public:
+	LatencyHistogram();
+
+	void  Record(QWORD value);
+	void  Reset();
+
+	QWORD GetCount() const		{ return count;					}
+	QWORD GetMean() const		{ return count ? sum/count : 0;			}
+	//Highest value equivalent to the bucket of the given percentile (0-100)
+	QWORD GetPercentile(double percentile) const;
+	QWORD GetMax() const		{ return GetPercentile(100);			}
+
+	//Remove previous counts, to get the histogram for an interval
+	LatencyHistogram& operator-=(const LatencyHistogram& other);
+
+	static DWORD GetBucket(QWORD value);
+	static QWORD GetBucketValue(DWORD bucket);
+
+private:
+	QWORD	count;
+	QWORD	sum;
+	DWORD	buckets[NumBuckets];
+};
+
+/*
+ * Per participant latency and CPU usage of each stage of the video path.
+ *	Frames carry the time their first RTP packet was received, and each
+ *	stage records the time elapsed since then, so the stage where time is
+ *	spent can be found by comparing consecutive ones. Durations of the
+ *	decoding, encoding and packetization calls and the CPU time of the
+ *	receiving and sending threads are recorded too.
+ */
+class LatencyStats
+{
+public:
+	enum Stage
+	{
+		//Receiving side, from the participant
+		Jitter = 0,	//Packet received to got from jitter buffer
+		Decode,		//Time spent depacketizing and decoding a frame
+		Decoded,	//Since origin, when handed to the mixer
+		//Sending side, to the participant
+		Mixed,		//Since origin, when the mosaic is published
+		Grabbed,	//Since origin, when the encoder takes it
+		Encode,		//Time spent encoding it
+		Encoded,	//Since origin, after encoding
+		Packetize,	//Time spent packetizing and queuing it
+		Sent,		//Since origin, when queued for pacing
+		NumStages
+	};
+
+	enum Thread
+	{
+		Receiving = 0,
+		Sending,
+		NumThreads
+	};
+
+	struct Snapshot
+	{
+		LatencyHistogram	stages[NumStages];
+		QWORD			cpu[NumThreads];
+		QWORD			time;
+
+		Snapshot& operator-=(const Snapshot& other);
+	};
+
+public:
+	static const char* GetNameFor(Stage stage);
+	static const char* GetNameFor(Thread thread);
+	//CPU time used by the calling thread in us
+	static QWORD GetThreadCPUTime();
+
+public:
+	LatencyStats();
+
+	void Record(Stage stage,QWORD elapsed)	{ stages[stage].Record(elapsed);	}
+	//Record time since origin, if known
+	void RecordSince(Stage stage,QWORD origin);
+	//Must be called from the thread when started, and then periodically
+	void StartCPU(Thread thread);
+	void UpdateCPU(Thread thread);
+
+	void GetSnapshot(Snapshot& snapshot) const;
+
+private:
+	LatencyHistogram stages[NumStages];
+	QWORD		 cpu[NumThreads];
+	QWORD		 last[NumThreads];
+};
+
+#endif	/* LATENCYSTATS_H */
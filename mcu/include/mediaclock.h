@@ -0,0 +1,110 @@
+/*
+ * File:   mediaclock.h
+ * Author: Sergio
+ *
+ * Created on 18 de octubre de 2026, 10:40
+ */
+
+#ifndef MEDIACLOCK_H
+#define	MEDIACLOCK_H
+
+#include <pthread.h>
+#include <map>
+#include <vector>
+#include "config.h"
+
+/*
+ * Shared periodic clock for the mixers.
+ *	A single thread waits on a CLOCK_MONOTONIC timerfd armed with absolute
+ *	deadlines, so ticks don't drift with processing time. Deadlines are
+ *	aligned to multiples of the period, so listeners with the same period
+ *	in different conferences are woken up together. Listeners are called
+ *	from the clock thread without the timers lock, so they can get the
+ *	stats, but they must only signal their own thread and must not add or
+ *	remove listeners. RemoveListener waits for an in progress dispatch, so
+ *	the listener can be deleted after it returns.
+ */
+class MediaClock
+{
+public:
+	class Listener
+	{
+	public:
+		virtual ~Listener() {}
+		//Deadline in us of the monotonic clock, ticks is greater than one if periods were missed
+		virtual void onTick(QWORD deadline,DWORD ticks) = 0;
+	};
+
+	static const DWORD NumBuckets = 8;
+
+	struct Stats
+	{
+		QWORD	wakeups;		//Number of timer expirations handled
+		QWORD	ticks;			//Number of ticks dispatched to listeners
+		QWORD	missed;			//Number of periods skipped because of lateness
+		DWORD	maxLateness;		//Max lateness in us
+		QWORD	lateness[NumBuckets];	//Lateness histogram, see GetBucketLimit
+	};
+
+public:
+	static MediaClock& getInstance()
+	{
+		static MediaClock clock;
+		return clock;
+	}
+
+	//Upper limit of the histogram bucket in us, 0 for the last one
+	static DWORD GetBucketLimit(DWORD bucket);
+	//Current time of the monotonic clock in us
+	static QWORD GetTime();
+
+public:
+	bool Start();
+	bool Stop();
+	bool IsRunning() const		{ return __atomic_load_n(&running,__ATOMIC_ACQUIRE);	}
+
+	//Period in ms
+	bool AddListener(Listener* listener,DWORD period);
+	bool RemoveListener(Listener* listener);
+
+	Stats GetStats();
+
+private:
+	MediaClock();
+	~MediaClock();
+	//Non copyable
+	MediaClock(MediaClock const&);
+	void operator=(MediaClock const&);
+
+private:
+	struct Timer
+	{
+		QWORD	period;
+		QWORD	next;
+	};
+	typedef std::map<Listener*,Timer> Timers;
+	struct Tick
+	{
+		Listener*	listener;
+		QWORD		deadline;
+		DWORD		ticks;
+	};
+	typedef std::vector<Tick> Ticks;
+
+private:
+	static void* run(void *par);
+	int Run();
+	void Arm();
+
+private:
+	bool		running;
+	int		fd;
+	pthread_t	thread;
+	pthread_mutex_t	mutex;
+	pthread_mutex_t	dispatch;
+	Timers		timers;
+	Ticks		due;
+	Stats		stats;
+};
+
+#endif	/* MEDIACLOCK_H */
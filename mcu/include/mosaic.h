@@ -2,12 +2,14 @@
 #define _MOSAIC_H_
 #include "config.h"
 #include "framescaler.h"
+#include "videobuffer.h"
 #include "overlay.h"
 #include "vad.h"
 #include "logo.h"
 #include "use.h"
 #include <map>
 #include <set>
+#include <vector>
 
 class Mosaic
 {
@@ -75,6 +77,21 @@ public:
 	typedef std::map<int,PartInfo*> Participants;
 	typedef std::set<PartInfo*,PartInfo::Short> ParticipantsOrder;
 
+	struct Label
+	{
+		std::wstring	text;
+		int		left;
+		int		top;
+		int		width;
+		int		height;
+
+		bool operator==(const Label& other) const
+		{
+			return left==other.left && top==other.top && width==other.width && height==other.height && text==other.text;
+		}
+	};
+	typedef std::vector<Label> Labels;
+
 public:
 	static int GetNumSlotsForType(Type type);
 	static Mosaic* CreateMosaic(Type type,DWORD size);
@@ -86,9 +103,29 @@ public:
 	int GetWidth()		{ return mosaicTotalWidth;}
 	int GetHeight()		{ return mosaicTotalHeight;}
 	int HasChanged()	{ return mosaicChanged; }
+	//Pixels written on the mosaic and overlay image for the previous frame
+	DWORD GetPixelsTouched(){ return lastPixelsTouched; }
+	//Origin time of the newest frame drawn on it
+	QWORD GetFrameTime()	{ return frameTime; }
+	void  UpdateFrameTime(QWORD time) { if (time>frameTime) frameTime = time; }
 
 	BYTE* GetFrame();
-	virtual int Update(int index,BYTE *frame,int width,int heigth, bool keepAspectRatio = true) = 0;
+	//Planes with padded lines, chroma stride is half of the luma one
+	virtual int Update(int index,BYTE *imageY,BYTE *imageU,BYTE *imageV,int stride,int width,int heigth, bool keepAspectRatio) = 0;
+	//Packed picture
+	int Update(int index,BYTE *frame,int width,int heigth, bool keepAspectRatio = true)
+	{
+		//Check picture
+		if (!frame)
+			return Update(index,NULL,NULL,NULL,0,width,heigth,keepAspectRatio);
+		//Get packed planes
+		return Update(index,frame,frame+width*heigth,frame+width*heigth*5/4,width,width,heigth,keepAspectRatio);
+	}
+	//Decoded picture, used directly without packing it
+	int Update(int index,const VideoBuffer* buffer, bool keepAspectRatio = true)
+	{
+		return Update(index,buffer->GetPlane(0),buffer->GetPlane(1),buffer->GetPlane(2),buffer->GetStride(),buffer->GetWidth(),buffer->GetHeight(),keepAspectRatio);
+	}
 	virtual int Clean(int index) = 0;
 	virtual int Clean(int index,const Logo& logo)
 	{
@@ -127,6 +164,8 @@ public:
 	int SetOverlaySVG(const char* svg);
 	int SetOverlayText();
 	int RenderOverlayText(const std::wstring& text,DWORD x,DWORD y,DWORD width,DWORD height, const Properties &properties);
+	//Only draws again the labels that have changed since last call
+	int SetOverlayLabels(const Labels& labels,const Properties& properties);
 	int ResetOverlay();
 	int DrawVUMeter(int pos,DWORD val,DWORD size);
 	
@@ -138,8 +177,24 @@ public:
 	const ParticipantsOrder& GetParticipantsOrder()	{ return order; }
 	Type  GetType() { return mosaicType;	}
 protected:
-	void SetChanged()	{ mosaicChanged = true; overlayNeedsUpdate = true; }
+	void SetChanged()	{ SetChanged(0,0,mosaicTotalWidth,mosaicTotalHeight);			}
+	void SetChanged(int pos){ SetChanged(GetLeft(pos),GetTop(pos),GetWidth(pos),GetHeight(pos));	}
+	void SetChanged(int left,int top,int width,int height);
 
+protected:
+	struct Rect
+	{
+		int left;
+		int top;
+		int width;
+		int height;
+
+		bool Contains(const Rect& rect) const
+		{
+			return left<=rect.left && top<=rect.top && left+width>=rect.left+rect.width && top+height>=rect.top+rect.height;
+		}
+	};
+	typedef std::vector<Rect> Rects;
 
 protected:
 	Mutex			mutex;
@@ -169,6 +224,17 @@ protected:
 
 	Overlay* overlay;
 	bool	 overlayNeedsUpdate;
+
+	//Labels currently drawn on the overlay
+	Labels		labels;
+	Properties	labelsProperties;
+	bool		labelsShown;
+
+	//Areas changed since last time overlay was blended
+	Rects	dirty;
+	DWORD	pixelsTouched;
+	DWORD	lastPixelsTouched;
+	QWORD	frameTime;
 };
 
 #endif
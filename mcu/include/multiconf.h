@@ -80,6 +80,7 @@ public:
 	int SendFPU(int partId);
 	int SetMute(int partId,MediaFrame::Type media,bool isMuted);
 	ParticipantStatistics* GetParticipantStatistic(int partId);
+	LatencyStats::Snapshot* GetParticipantLatencyStatistics(int partId);
 	int SetParticipantMosaic(int partId,int mosaicId);
 	int SetParticipantSidebar(int partId,int sidebarId);
 	int DeleteParticipant(int partId);
@@ -12,6 +12,19 @@
 
 class Canvas
 {
+public:
+	enum Blend
+	{
+		BlendScalar = 0,
+		BlendSSE2,
+		BlendAVX2
+	};
+public:
+	//Blend implementation used by all canvases, best one available is selected at startup
+	static Blend GetBlend();
+	static bool  SetBlend(Blend blend);
+	static bool  IsBlendSupported(Blend blend);
+	static const char* GetBlendName(Blend blend);
 public:
 	Canvas(DWORD width,DWORD height);
 	~Canvas();
@@ -20,14 +33,27 @@ public:
 	int RenderText(const std::wstring& text,DWORD x,DWORD y,DWORD width,DWORD height);
 	int RenderText(const std::wstring& text,DWORD x,DWORD y,DWORD width,DWORD height,const Properties& properties);
 	void Draw(BYTE*image, BYTE* frame);
+	//Only blend the given rectangle, rest of image is not touched
+	void Draw(BYTE*image, BYTE* frame,DWORD x,DWORD y,DWORD w,DWORD h);
 	void Reset();
+	//Make the given rectangle transparent
+	void Clear(DWORD x,DWORD y,DWORD w,DWORD h);
 	BYTE* GetCanvas()	{ return overlay;	}
+	bool  IsDisplayed()	{ return display;	}
+	//Must be called after writing directly on the canvas
+	void Invalidate()	{ dirty = true;		}
+protected:
+	void UpdateCoverage();
 protected:
 	DWORD overlaySize;
 	BYTE* overlay;
 	DWORD width;
 	DWORD height;
 	bool display;	
+	//Per block alpha coverage of each pair of rows, first byte is for the whole row
+	BYTE* coverage;
+	DWORD blocks;
+	bool dirty;
 };
 
 class Overlay : public Canvas
@@ -37,6 +63,8 @@ public:
 	~Overlay();
 
 	BYTE* Display(BYTE* frame);
+	BYTE* Display(BYTE* frame,DWORD x,DWORD y,DWORD w,DWORD h);
+	BYTE* GetImage() { return image; }
 	BYTE* GetOverlay() { return GetCanvas(); }
 private:
 	DWORD imageSize;
@@ -11,7 +11,7 @@ public:
 	PartedMosaic(Mosaic::Type type, DWORD size);
 	virtual ~PartedMosaic();
 
-	virtual int Update(int index,BYTE *frame,int width,int heigth, bool keepAspectRatio);
+	virtual int Update(int index,BYTE *imageY,BYTE *imageU,BYTE *imageV,int stride,int width,int heigth, bool keepAspectRatio);
 	virtual int Clean(int index);
 	virtual int GetWidth(int pos);
 	virtual int GetHeight(int pos);
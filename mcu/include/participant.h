@@ -12,6 +12,8 @@
 #include "audio.h"
 #include "text.h"
 #include "rtpsession.h"
+#include "latencystats.h"
+#include "videoencodergroup.h"
 
 class Participant
 {
@@ -70,8 +72,10 @@ public:
 	virtual int SetAudioOutput(AudioOutput *output) = 0;
 	virtual int SetTextInput(TextInput* input) = 0;
 	virtual int SetTextOutput(TextOutput* output) = 0;
+	virtual int SetSharedVideoEncoder(SharedVideoEncoder* encoder)	{ return 0;	}
 
 	virtual MediaStatistics GetStatistics(MediaFrame::Type media) = 0;
+	virtual LatencyStats* GetLatencyStats()	{ return NULL;	}
 	virtual int SetMute(MediaFrame::Type media, bool isMuted) = 0;
 	virtual int SendVideoFPU() = 0;
 
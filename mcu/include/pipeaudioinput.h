@@ -2,7 +2,7 @@
 #define _PIPEAUDIOINPUT_H_
 #include <pthread.h>
 #include <audio.h>
-#include <fifo.h>
+#include <spscring.h>
 #include "audiotransrater.h"
 
 
@@ -20,18 +20,49 @@ public:
 
 	virtual DWORD GetNativeRate()		{ return nativeRate;	}
 	virtual DWORD GetRecordingRate()	{ return recordRate;	}
+	virtual bool StartSharedEncoding(AudioCodec::Type codec,DWORD rate,DWORD numFrameSamples,const Properties &properties);
+	virtual void StopSharedEncoding();
+	virtual int RecFrame(SWORD *buffer,DWORD size,BYTE *frame,DWORD frameSize,DWORD &len);
 	
 	int Init(DWORD rate);
 	int PutSamples(SWORD *buffer,DWORD size);
+	//Samples already at the recording rate
+	int PutRecordedSamples(SWORD *buffer,DWORD size);
 	int End();
 
+	//Shared encoding, used by the mixer
+	DWORD GetSharedVersion()		{ return sharedVersion;	}
+	bool GetSharedEncoding(AudioCodec::Type &codec,DWORD &rate,DWORD &numFrameSamples,Properties &properties);
+	int PutFrame(BYTE *frame,DWORD len);
+
+private:
+	//Waits for samples or a signal with the mutex locked
+	bool WaitSamples(DWORD size);
+	//Queues samples at the recording rate and wakes up the encoder
+	int Push(SWORD *buffer,DWORD size);
+
+private:
+	static const DWORD MaxSharedFrames = 4;
+
+	struct SharedFrame
+	{
+		BYTE	data[MTU];
+		DWORD	len;
+		//Samples queued before it
+		DWORD	mark;
+	};
+
 private:
 	//Los mutex y condiciones
 	pthread_mutex_t mutex;
 	pthread_cond_t  cond; 
+	pthread_mutex_t transraterMutex;
 
-	//Members
-	fifo<SWORD,4096>	fifoBuffer;
+	//Members, samples are not passed under the mutex
+	spscring<SWORD,4096>	fifoBuffer;
+	DWORD		overrun;
+	DWORD		waiting;
+	DWORD		frameSamples;
 	int		recording;
 	int 		inited;
 	int		canceled;
@@ -40,6 +71,17 @@ private:
 	AudioTransrater		transrater;
 	DWORD			recordRate;
 	DWORD			nativeRate;
+
+	//Shared encoding
+	bool			sharing;
+	AudioCodec::Type	sharedCodec;
+	DWORD			sharedRate;
+	DWORD			sharedFrameSamples;
+	Properties		sharedProperties;
+	volatile DWORD		sharedVersion;
+	SharedFrame		frames[MaxSharedFrames];
+	DWORD			framesFirst;
+	DWORD			framesNum;
 };
 
 #endif
@@ -1,7 +1,7 @@
 #ifndef _AUDIOOUTPUT_H_
 #define _AUDIOOUTPUT_H_
 #include <pthread.h>
-#include <fifo.h>
+#include <spscring.h>
 #include <audio.h>
 #include "vad.h"
 #include "audiotransrater.h"
@@ -25,14 +25,15 @@ public:
 	int Init(DWORD samplerate);
 	int End();
 private:
-	//Mutex
+	//Mutex, not used for passing samples
 	pthread_mutex_t mutex;
 
 	//Members
-	fifo<SWORD,8192>	fifoBuffer;
+	spscring<SWORD,8192>	fifoBuffer;
 	int			inited;
 	VAD			vad;
 	DWORD			acu;
+	DWORD			overrun;
 	bool			calcVAD;
 	AudioTransrater 	transrater;
 
@@ -3,6 +3,7 @@
 
 #include <video.h>
 #include <framescaler.h>
+#include "videobuffer.h"
 #include "pthread.h"
 
 class PipeVideoInput
@@ -17,11 +18,16 @@ public:
 	virtual void  CancelGrabFrame();
 	virtual DWORD GetBufferSize();
 	virtual int   StopVideoCapture();
+	virtual bool  IsFrameChanged()	{ return changed;	}
+	virtual QWORD GetFrameTime()	{ return grabbed ? grabbed->GetTime() : 0;	}
 
 	int Init();
-	int SetFrame(BYTE * buffer, int height, int width);
+	int SetFrame(BYTE * buffer, int height, int width, QWORD time = 0);
 	int End();
 
+private:
+	int Publish(VideoBuffer* frame);
+
 private:
 
 	FrameScaler resizer;
@@ -29,12 +35,12 @@ private:
 	int videoHeight;
 	int videoSize;
 	int videoFPS;
-	int imgPos;
-	int imgNew;
 	int inited;
 	int capturing;
-	BYTE *imgBuffer[2];
-	BYTE *grabPic;
+	int canceled;
+	bool changed;
+	VideoBufferSlot	pending;
+	VideoBuffer*	grabbed;
 
 	pthread_mutex_t newPicMutex;
 	pthread_cond_t  newPicCond;
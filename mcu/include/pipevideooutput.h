@@ -2,36 +2,44 @@
 #define _PIPVIDEOOUTPUT_H_
 #include <pthread.h>
 #include <video.h>
+#include "videobuffer.h"
 
 class PipeVideoOutput :
 	public VideoOutput
 {
 public:
-	PipeVideoOutput(pthread_mutex_t* mutex, pthread_cond_t* cond);
+	PipeVideoOutput(pthread_mutex_t* mutex, pthread_cond_t* cond, DWORD* waiting);
 	~PipeVideoOutput();
 
 	virtual int NextFrame(BYTE *pic);
+	virtual int NextFrame(BYTE *pic,QWORD time);
+	virtual int NextFrame(VideoBuffer* frame);
 	virtual void ClearFrame();
 	virtual int SetVideoSize(int width,int height);
 
+	//Consumer side, must be called from a single thread
 	BYTE*	GetFrame();
+	VideoBuffer* GetBuffer();
 	int	IsChanged(DWORD version);
-	int 	GetWidth()	{ return videoWidth;		};
-	int 	GetHeight()	{ return videoHeight;		};
+	bool	HasPendingFrame()	{ return pending.IsPending();	};
+	int 	GetWidth()	{ return current ? current->GetWidth() : 0;	};
+	int 	GetHeight()	{ return current ? current->GetHeight() : 0;	};
 	int	Init();
 	int	End();
 private:
-	BYTE*	buffer;
-	int	bufferSize;
+	int	Publish(VideoBuffer* frame);
+private:
+	VideoBufferSlot	pending;
+	VideoBuffer*	current;
 	int 	videoWidth;
 	int	videoHeight;
-	bool	isChanged;
 	bool	versionChanged;
 	int 	inited;
 	DWORD	version;
 
 	pthread_mutex_t* videoMixerMutex;
 	pthread_cond_t*  videoMixerCond;
+	DWORD*		 videoMixerWaiting;
 };
 
 #endif
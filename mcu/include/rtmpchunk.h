@@ -3,6 +3,7 @@
 #include "config.h"
 #include "rtmp.h"
 #include "rtmpmessage.h"
+#include <sys/uio.h>
 #include <list>
 
 class RTMPChunkStreamInfo
@@ -29,6 +30,43 @@ protected:
 	DWORD			timestampDelta;
 };
 
+/*
+ * Chunks ready to be written with writev.
+ *	Headers are serialized into a small arena and payloads point to the
+ *	serialized message data, which is referenced until it has been written.
+ */
+class RTMPChunkOutput
+{
+public:
+	//Max chunks on each writev
+	static const DWORD MaxChunks = 256;
+	//Basic header, type 0 header and extended timestamp
+	static const DWORD MaxHeaderSize = 18;
+public:
+	RTMPChunkOutput();
+	~RTMPChunkOutput();
+
+	bool  IsEmpty()		{ return first==num;		}
+	bool  IsFull()		{ return chunks==MaxChunks;	}
+	DWORD GetLength()	{ return length;		}
+	iovec* GetIOVec()	{ return iov+first;		}
+	int   GetIOVecLength()	{ return num-first;		}
+
+	//Remove written data, releasing the payloads already sent
+	void Consume(DWORD len);
+	void Clear();
+
+private:
+	friend class RTMPChunkOutputStream;
+private:
+	iovec			iov[MaxChunks*2];
+	RTMPSerializedPayload*	payloads[MaxChunks*2];
+	BYTE			headers[MaxChunks*MaxHeaderSize];
+	DWORD			chunks;
+	int			first;
+	int			num;
+	DWORD			length;
+};
 
 class RTMPChunkOutputStream : public RTMPChunkStreamInfo
 {
@@ -39,7 +77,12 @@ public:
 	bool HasData();
 	bool ResetStream(DWORD id);
 	DWORD GetNextChunk(BYTE *data,DWORD size,DWORD maxChunkSize);
+	DWORD GetNextChunk(RTMPChunkOutput &output,DWORD maxChunkSize);
+	DWORD GetQueuedBytes();
 
+private:
+	DWORD PrepareChunk(BYTE *header,DWORD size,DWORD maxChunkSize,RTMPSerializedPayload** payload,DWORD *offset,DWORD *payloadLen);
+	void  ReleaseMessage();
 private:
 	typedef std::list<RTMPMessage*> RTMPMessages;
 private:
@@ -47,7 +90,8 @@ private:
 	DWORD chunkStreamId;
 	RTMPMessage* message;
 	DWORD pos;
-	BYTE* msgBuffer;
+	RTMPSerializedPayload* msgPayload;
+	DWORD queued;
 	pthread_mutex_t mutex;
 };
 
@@ -8,6 +8,7 @@
 #include "rtmpmessage.h"
 #include "rtmpstream.h"
 #include "rtmpapplication.h"
+#include "tcpreactor.h"
 #include <pthread.h>
 #include <map>
 
@@ -15,7 +16,8 @@
 class RTMPConnection :
 	public RTMPNetConnection::Listener,
 	public RTMPMediaStream::Listener,
-	public RTMPNetStream::Listener
+	public RTMPNetStream::Listener,
+	public TCPReactor::Connection
 {
 public:
 	class Listener
@@ -51,6 +53,10 @@ public:
 	//virtual void onStreamIsRecorded(DWORD id);
 	virtual void onStreamReset(DWORD id);
 	virtual void onDetached(RTMPMediaStream *stream);
+	//Events from the shared reactor
+	virtual bool onReadable();
+	virtual bool onWritable();
+	virtual void onClosed();
 	
 protected:
 	void Start();
@@ -60,7 +66,8 @@ protected:
 private:
 	static  void* run(void *par);
 	void ParseData(BYTE *data,const DWORD size);
-	DWORD SerializeChunkData(BYTE *data,const DWORD size);
+	DWORD SerializeChunkData(RTMPChunkOutput &output);
+	int WriteChunkData();
 	int WriteData(BYTE *data,const DWORD size);
 
 	void ProcessControlMessage(DWORD messageStremId,BYTE type,RTMPObject* msg);
@@ -81,11 +88,15 @@ private:
 	typedef std::map<DWORD,RTMPChunkInputStream*>  RTMPChunkInputStreams;
 	typedef std::map<DWORD,RTMPChunkOutputStream*> RTMPChunkOutputStreams;
 	typedef std::map<DWORD,RTMPNetStream*> RTMPNetStreams;
+private:
+	//Queued video after which non key frames are dropped
+	static const DWORD MaxQueuedVideo = 512*1024;
 private:
 	int socket;
 	pollfd ufds[1];
 	bool inited;
 	bool running;
+	bool reactor;
 	State state;
 
 	RTMPHandshake01 s01;
@@ -135,6 +146,11 @@ private:
 	QWORD bandIni;
 	DWORD bandSize;
 	DWORD bandCalc;
+
+	RTMPChunkOutput output;
+
+	bool  waitIntra;
+	DWORD droppedFrames;
 };
 
 #endif
@@ -8,6 +8,40 @@
 #include "aacconfig.h"
 #include <vector>
 
+/*
+ * Immutable refcounted serialized media frame.
+ *	Shared by all the connections watching a stream, so a frame is only
+ *	serialized once regardless of the number of viewers.
+ */
+class RTMPSerializedPayload
+{
+public:
+	static RTMPSerializedPayload* Create(DWORD size);
+
+	void AddRef()		{ __sync_add_and_fetch(&refs,1);	}
+	void Release();
+	//Number of messages created from it
+	void AddUse()		{ __sync_add_and_fetch(&uses,1);	}
+	DWORD GetUses()		{ return uses;				}
+
+	const BYTE* GetData()	{ return data;				}
+	DWORD GetSize()		{ return size;				}
+private:
+	RTMPSerializedPayload()	{}
+	~RTMPSerializedPayload(){}
+	//Non copyable
+	RTMPSerializedPayload(RTMPSerializedPayload const&);
+	void operator=(RTMPSerializedPayload const&);
+
+	friend class RTMPMediaFrame;
+	friend class RTMPChunkOutputStream;
+private:
+	volatile DWORD	refs;
+	volatile DWORD	uses;
+	BYTE*		data;
+	DWORD		size;
+};
+
 class RTMPMediaFrame 
 {
 public:
@@ -16,6 +50,11 @@ public:
 	virtual ~RTMPMediaFrame();
 	virtual RTMPMediaFrame* Clone() = 0;
 
+	//Serialize once for all the listeners, only while the frame is not modified
+	bool CacheSerialized();
+	void ClearSerialized();
+	RTMPSerializedPayload* GetSerialized()	{ return serialized;	}
+
 	Type  GetType()		{ return type;		}
 	QWORD GetTimestamp()	{ return timestamp;	}
 	void  SetTimestamp(QWORD timestamp) { this->timestamp = timestamp; }
@@ -53,6 +92,7 @@ protected:
 	DWORD mediaSize;
 	DWORD pos;
 	Type type;
+	RTMPSerializedPayload* serialized;
 };
 
 class RTMPVideoFrame : public RTMPMediaFrame
@@ -260,6 +300,7 @@ public:
 	RTMPMessage(DWORD streamId,QWORD timestamp,RTMPCommandMessage* cmd);
 	RTMPMessage(DWORD streamId,QWORD timestamp,RTMPMediaFrame* media);
 	RTMPMessage(DWORD streamId,QWORD timestamp,RTMPMetaData* meta);
+	RTMPMessage(DWORD streamId,QWORD timestamp,RTMPMediaFrame::Type type,RTMPSerializedPayload* payload);
 	~RTMPMessage();
 	
 	DWORD Parse(BYTE* buffer,DWORD size);
@@ -277,6 +318,7 @@ public:
 	RTMPCommandMessage* 	GetCommandMessage()		{ return cmd; 	}
 	RTMPMetaData* 		GetMetaData()			{ return meta;	}
 	RTMPMediaFrame*		GetMediaFrame()			{ return media;	}
+	RTMPSerializedPayload*	GetSerialized()			{ return payload;	}
 
 	DWORD	GetStreamId() 	{ return streamId; 	}
 	Type	GetType()	{ return type; 		}
@@ -288,6 +330,7 @@ private:
 	RTMPCommandMessage* 	cmd;
 	RTMPMetaData*		meta;
 	RTMPMediaFrame*		media;
+	RTMPSerializedPayload*	payload;
 
 	//Header values
 	DWORD 	streamId;
@@ -158,6 +158,16 @@ public:
 		virtual void onStreamReset(DWORD id) = 0;
 		virtual void onDetached(RTMPMediaStream *stream)  = 0;
 	};
+	struct Stats
+	{
+		QWORD	frames;		//Frames serialized once for all the listeners
+		QWORD	messages;	//Messages sent with those frames
+		QWORD	serializedBytes;//Bytes serialized
+		QWORD	savedBytes;	//Bytes that would have been serialized again without sharing
+	};
+public:
+	//Process wide serialization sharing stats
+	static Stats GetStats();
 public:
 	RTMPMediaStream();
 	RTMPMediaStream(DWORD id);
@@ -187,6 +197,9 @@ protected:
 	std::wstring	tag;
 	Listeners	listeners;
 	Use		lock;
+	//Serialization bytes saved by sharing frames between listeners
+	volatile QWORD	savedBytes;
+	timeval		lastStats;
 };
 
 class RTMPPipedMediaStream :
@@ -4,6 +4,7 @@
 #include "config.h"
 #include "log.h"
 #include "media.h"
+#include "rtppacketpool.h"
 #include <vector>
 #include <list>
 #include <math.h>
@@ -191,10 +192,16 @@ public:
 		}
 	}
 
+	//Packets created with new(media) are recycled on the media pool, plain new is not pooled
+	static void* operator new(size_t size)				{ return RTPPacketPool::Allocate(size,(MediaFrame::Type)-1);	}
+	static void* operator new(size_t size,MediaFrame::Type media)	{ return RTPPacketPool::Allocate(size,media);			}
+	static void  operator delete(void* ptr)				{ RTPPacketPool::Release(ptr);					}
+	static void  operator delete(void* ptr,MediaFrame::Type media)	{ RTPPacketPool::Release(ptr);					}
+
 	RTPPacket* Clone()
 	{
 		//New one
-		RTPPacket* cloned = new RTPPacket(GetMedia(),GetCodec(),GetType());
+		RTPPacket* cloned = new(GetMedia()) RTPPacket(GetMedia(),GetCodec(),GetType());
 		//Set attrributes
 		cloned->SetClockRate(GetClockRate());
 		cloned->SetMark(GetMark());
@@ -449,7 +456,7 @@ public:
 	RTPTimedPacket* Clone()
 	{
 		//New one
-		RTPTimedPacket* cloned = new RTPTimedPacket(GetMedia(),GetCodec(),GetType());
+		RTPTimedPacket* cloned = new(GetMedia()) RTPTimedPacket(GetMedia(),GetCodec(),GetType());
 		//Set attrributes
 		cloned->SetClockRate(GetClockRate());
 		cloned->SetMark(GetMark());
@@ -1,4 +1,4 @@
-/* 
+/*
  * File:   rtpbuffer.h
  * Author: Sergio
  *
@@ -9,11 +9,28 @@
 #define	RTPBUFFER_H
 #include <errno.h>
 #include <pthread.h>
+#include <vector>
 #include "rtp.h"
 #include "use.h"
 
-class RTPBuffer 
+/*
+ * Jitter buffer.
+ *	Packets are stored in a fixed ring of slots indexed by the extended
+ *	sequence number, so there is no allocation nor ordering on insertion.
+ *	There is a single producer (the rtp reading thread) and a single
+ *	consumer (the decoding thread), slots are handed off with atomic
+ *	operations and the mutex is only used for sleeping when there is
+ *	nothing to deliver and for serializing Reset/Clear with the producer.
+ *	Packets published on a slot are only freed by the consumer, the ones
+ *	removed by the producer are retired and deleted on next Wait, as the
+ *	consumer may still be reading them.
+ */
+class RTPBuffer
 {
+public:
+	//Number of slots, must be power of two
+	static const DWORD Capacity = 2048;
+
 public:
 	RTPBuffer()
 	{
@@ -23,10 +40,24 @@ public:
 		hurryUp = false;
 		//No canceled
 		cancel = false;
+		//Not waiting
+		waiting = false;
 		//No next
 		next = (DWORD)-1;
-		//Crete mutex
+		//Nothing added yet
+		low = (DWORD)-1;
+		head = 0;
+		//No packets
+		length = 0;
+		added = 0;
+		resyncs = 0;
+		numRetired = 0;
+		//Empty slots
+		memset(slots,0,sizeof(slots));
+		//Crete mutexes
 		pthread_mutex_init(&mutex,NULL);
+		pthread_mutex_init(&producer,NULL);
+		pthread_mutex_init(&retiredMutex,NULL);
 		//Create condition
 		pthread_cond_init(&cond,NULL);
 	}
@@ -35,163 +66,214 @@ public:
 	{
 		//Free packets
 		Clear();
-		//Destroy mutex
+		//No consumer anymore, free the retired ones
+		Collect();
+		//Destroy mutexes
 		pthread_mutex_destroy(&mutex);
+		pthread_mutex_destroy(&producer);
+		pthread_mutex_destroy(&retiredMutex);
+		//Destroy condition
+		pthread_cond_destroy(&cond);
 	}
 
 	bool Add(RTPTimedPacket *rtp)
 	{
 		//Get seq num
 		DWORD seq = rtp->GetExtSeqNum();
-		
-		//Lock
-		pthread_mutex_lock(&mutex);
+		//Get slot
+		RTPTimedPacket** slot = &slots[seq & (Capacity-1)];
+
+		//Lock against reset, never taken by the consumer
+		pthread_mutex_lock(&producer);
+
+		//Check what is on the slot before reading next, so if the consumer has just taken it we see the updated next
+		RTPTimedPacket* prev = __atomic_load_n(slot,__ATOMIC_ACQUIRE);
+		//Get next expected by consumer
+		DWORD next = __atomic_load_n(&this->next,__ATOMIC_ACQUIRE);
+
+		//Get top of the window
+		DWORD top = next!=(DWORD)-1 && next>head ? next : head;
+
+		//If it is too far from the window, sender has restarted the sequence or we have been out for too long
+		if (top && (seq>=top+Capacity || seq+Capacity<top))
+		{
+			//Start again from it
+			Resync(seq);
+			//Slot is free now
+			prev = NULL;
+			next = seq;
+		}
 
 		//If already past
 		if (next!=(DWORD)-1 && seq<next)
 		{
 			//Error
 			Debug("-Out of order non recoverable packet [next:%d,seq:%d,maxWaitTime=%d,%d,%d]\n",next,seq,maxWaitTime,rtp->GetSeqCycles(),rtp->GetSeqNum());
-			//Delete pacekt
-			delete(rtp);
-			//Unlock
-			pthread_mutex_unlock(&mutex);
 			//Skip it and lost forever
-			return 0;
+			return Drop(rtp);
 		}
-		
+
+		//Check if it is a packet left behind by the consumer
+		if (prev && next!=(DWORD)-1 && prev->GetExtSeqNum()<next)
+		{
+			//Try to get it, consumer could be taking it right now
+			if (__sync_bool_compare_and_swap(slot,prev,(RTPTimedPacket*)NULL))
+			{
+				//One less
+				__sync_sub_and_fetch(&length,1);
+				//Consumer may be reading it, it will delete it
+				Retire(prev);
+			}
+			//Free now
+			prev = NULL;
+		}
+
 		//Check if we already have it
-		if (packets.find(seq)!=packets.end())
+		if (prev && prev->GetExtSeqNum()==seq)
 		{
 			//Error
 			Debug("-Already have that packet [next:%d,seq:%d,maxWaitTime=%d,%d,%d]\n",next,seq,maxWaitTime,rtp->GetSeqCycles(),rtp->GetSeqNum());
-			//Delete pacekt
-			delete(rtp);
-			//Unlock
-			pthread_mutex_unlock(&mutex);
 			//Skip it and lost forever
-			return 0;
+			return Drop(rtp);
 		}
 
-		//Add packet, check if it was already there
-		if (!packets.insert(std::pair<DWORD,RTPTimedPacket*>(seq,rtp)).second)
+		//Calculate the window that would be in use after adding it
+		DWORD first = next!=(DWORD)-1 ? next : (low!=(DWORD)-1 && low<seq ? low : seq);
+		DWORD last = head>seq+1 ? head : seq+1;
+
+		//Check if it fits on the ring, consumer is late
+		if (prev || last-first>Capacity)
 		{
 			//Error
-			Debug("-Error inserting packet [next:%d,seq:%d,maxWaitTime=%d,%d,%d]\n",next,seq,maxWaitTime,rtp->GetSeqCycles(),rtp->GetSeqNum());
-			//Delete pacekt
-			delete(rtp);
-			//Unlock
-			pthread_mutex_unlock(&mutex);
+			Debug("-Jitter buffer overflow [next:%d,seq:%d,first:%d,last:%d,maxWaitTime=%d]\n",next,seq,first,last,maxWaitTime);
 			//Skip it and lost forever
-			return 0;
+			return Drop(rtp);
 		}
 
+		//Publish packet
+		__atomic_store_n(slot,rtp,__ATOMIC_RELEASE);
+
+		//Update window, consumer reads it after the slot
+		if (low==(DWORD)-1 || seq<low)
+			__atomic_store_n(&low,seq,__ATOMIC_RELEASE);
+		if (seq+1>head)
+			__atomic_store_n(&head,seq+1,__ATOMIC_RELEASE);
+
+		//One more
+		__sync_add_and_fetch(&length,1);
+		__sync_add_and_fetch(&added,1);
+
 		//Unlock
-		pthread_mutex_unlock(&mutex);
+		pthread_mutex_unlock(&producer);
 
-		//Signal
-		pthread_cond_signal(&cond);
+		//Wake up consumer if it is sleeping
+		Signal();
 
 		return true;
 	}
 
 	void Cancel()
 	{
-		//Lock
-		pthread_mutex_lock(&mutex);
-
 		//Canceled
 		cancel = true;
 
-		//Unlock
-		pthread_mutex_unlock(&mutex);
-
 		//Signal condition
-		pthread_cond_signal(&cond);
+		Signal(true);
 	}
 
 	RTPPacket* Wait()
 	{
-		//NO packet
-		RTPTimedPacket* rtp = NULL;
-
-		//Get default wait time
-		DWORD timeout = maxWaitTime;
-
-		//Lock
-		pthread_mutex_lock(&mutex);
-
 		//While we have to wait
 		while (!cancel)
 		{
-			//Check if we have somethin in queue
-			if (!packets.empty())
+			//Delete the packets removed by the producer, we hold no pointer to them now
+			Collect();
+			//Get current add count, to know if something has arrived before sleeping
+			DWORD count = __atomic_load_n(&added,__ATOMIC_ACQUIRE);
+			//Get window
+			DWORD next = __atomic_load_n(&this->next,__ATOMIC_ACQUIRE);
+			DWORD low = __atomic_load_n(&this->low,__ATOMIC_ACQUIRE);
+			DWORD head = __atomic_load_n(&this->head,__ATOMIC_ACQUIRE);
+			//Get first seq to check
+			DWORD first = next!=(DWORD)-1 ? next : low;
+
+			//NO packet
+			RTPTimedPacket* candidate = NULL;
+			DWORD seq = 0;
+
+			//Check if we have something on the ring
+			if (first!=(DWORD)-1)
 			{
+				//Find first packet in order
+				for (seq=first; seq<head && seq-first<Capacity; ++seq)
+				{
+					//Get packet on slot
+					RTPTimedPacket* rtp = __atomic_load_n(&slots[seq & (Capacity-1)],__ATOMIC_ACQUIRE);
+					//Check it is the one we are looking for and not a stale one
+					if (rtp && rtp->GetExtSeqNum()==seq)
+					{
+						//Found
+						candidate = rtp;
+						break;
+					}
+				}
+			}
 
-				//Get first
-				RTPOrderedPackets::iterator it = packets.begin();
-				//Get first seq num
-				DWORD seq = it->first;
-				//Get packet
-				RTPTimedPacket* candidate = it->second;
+			//Check if we have somethin in queue
+			if (candidate)
+			{
 				//Get time of the packet
 				QWORD time = candidate->GetTime();
 
 				//Check if first is the one expected or wait if not
 				if (next==(DWORD)-1 || seq==next || time+maxWaitTime<getTime()/1000 || hurryUp)
 				{
+					//Update next before releasing the slot, so the producer drops duplicates of it
+					__sync_bool_compare_and_swap(&this->next,next,seq+1);
+					//Take it from the slot
+					if (!__sync_bool_compare_and_swap(&slots[seq & (Capacity-1)],candidate,(RTPTimedPacket*)NULL))
+					{
+						//It has been cleared by a reset, restore next
+						__sync_bool_compare_and_swap(&this->next,seq+1,next);
+						//Try again
+						continue;
+					}
+					//One less
+					__sync_sub_and_fetch(&length,1);
 					//We have it!
-					rtp = candidate;
-					//Update next
-					next = seq+1;
-					//Remove it
-					packets.erase(it);
-					//Return it!
-					break;
+					return candidate;
 				}
 
 				//We have to wait
 				timespec ts;
 				//Calculate until when we have to sleep
 				ts.tv_sec  = (time+maxWaitTime) / 1000;
-				ts.tv_nsec = (time+maxWaitTime - ts.tv_sec*1000)*1000;
-				
-				//Wait with time out
-				int ret = pthread_cond_timedwait(&cond,&mutex,&ts);
-				//Check if there is an errot different than timeout
-				if (ret && ret!=ETIMEDOUT)
-					//Print error
-					Error("-WaitQueue cond timedwait error [%d,%d]\n",ret,errno);
-				
+				ts.tv_nsec = (time+maxWaitTime - ts.tv_sec*1000)*1000000;
+
+				//Sleep until timeout or new packet
+				Sleep(count,&ts);
 			} else {
 				//Not hurryUp more
 				hurryUp = false;
 				//Wait until we have a new rtp pacekt
-				int ret = pthread_cond_wait(&cond,&mutex);
-				//Check error
-				if (ret)
-					//Print error
-					Error("-WaitQueue cond timedwait error [%rd,%d]\n",ret,errno);
+				Sleep(count,NULL);
 			}
 		}
-		
-		//Unlock
-		pthread_mutex_unlock(&mutex);
 
 		//canceled
-		return rtp;
+		return NULL;
 	}
 
 	void Clear()
 	{
-		//Lock
-		pthread_mutex_lock(&mutex);
+		//Lock producer
+		pthread_mutex_lock(&producer);
 
 		//And remove all from queue
 		ClearPackets();
 
 		//UnLock
-		pthread_mutex_unlock(&mutex);
+		pthread_mutex_unlock(&producer);
 	}
 
 	void HurryUp()
@@ -199,13 +281,16 @@ public:
 		//Set flag
 		hurryUp = true;
 		//Signal condition and proccess rtp now
-		pthread_cond_signal(&cond);
+		Signal(true);
 	}
 
 	void Reset()
 	{
-		//Lock
-		pthread_mutex_lock(&mutex);
+		//Lock producer
+		pthread_mutex_lock(&producer);
+
+		//No next, set it before and after clearing so an in progress Wait can't leave it set
+		__atomic_store_n(&next,(DWORD)-1,__ATOMIC_RELEASE);
 
 		//And remove all from queue
 		ClearPackets();
@@ -214,46 +299,166 @@ public:
 		cancel = false;
 
 		//No next
-		next = (DWORD)-1;
+		__atomic_store_n(&next,(DWORD)-1,__ATOMIC_RELEASE);
 
-		//Signal condition
-		pthread_cond_signal(&cond);
-		
 		//UnLock
-		pthread_mutex_unlock(&mutex);
+		pthread_mutex_unlock(&producer);
+
+		//Signal condition
+		Signal(true);
 	}
 
 	DWORD Length()
 	{
 		//REturn objets in queu
-		return packets.size();
+		return __atomic_load_n(&length,__ATOMIC_ACQUIRE);
+	}
+	DWORD GetResyncs()
+	{
+		//Times the window has been moved to a far sequence number
+		return __atomic_load_n(&resyncs,__ATOMIC_ACQUIRE);
 	}
 	void SetMaxWaitTime(DWORD maxWaitTime)
 	{
 		this->maxWaitTime = maxWaitTime;
 	}
 private:
+	bool Drop(RTPTimedPacket *rtp)
+	{
+		//Unlock
+		pthread_mutex_unlock(&producer);
+		//Delete pacekt
+		delete(rtp);
+		//Not added
+		return 0;
+	}
+
+	void Signal(bool force = false)
+	{
+		//Make sure the consumer sees our changes before checking if it is sleeping
+		__sync_synchronize();
+		//If not sleeping there is no need to lock
+		if (!force && !waiting)
+			return;
+		//Lock
+		pthread_mutex_lock(&mutex);
+		//Signal
+		pthread_cond_signal(&cond);
+		//Unlock
+		pthread_mutex_unlock(&mutex);
+	}
+
+	void Sleep(DWORD count,timespec* ts)
+	{
+		//Lock
+		pthread_mutex_lock(&mutex);
+		//We are going to sleep
+		waiting = true;
+		//Make sure the producer sees it before checking for new packets
+		__sync_synchronize();
+		//If nothing has changed since we checked
+		if (!cancel && !hurryUp && __atomic_load_n(&added,__ATOMIC_ACQUIRE)==count)
+		{
+			//Wait with or without time out
+			int ret = ts ? pthread_cond_timedwait(&cond,&mutex,ts) : pthread_cond_wait(&cond,&mutex);
+			//Check if there is an errot different than timeout
+			if (ret && ret!=ETIMEDOUT)
+				//Print error
+				Error("-RTPBuffer cond wait error [%d,%d]\n",ret,errno);
+		}
+		//Not sleeping anymore
+		waiting = false;
+		//Unlock
+		pthread_mutex_unlock(&mutex);
+	}
+
+	void Resync(DWORD seq)
+	{
+		Log("-RTPBuffer resync [next:%d,head:%d,seq:%d]\n",next,head,seq);
+		//Remove stale packets, producer lock shall be taken before
+		ClearPackets();
+		//Deliver from the new one, consumer sees the gap and requests an FPU
+		__atomic_store_n(&next,seq,__ATOMIC_RELEASE);
+		//One more
+		__sync_add_and_fetch(&resyncs,1);
+	}
+
 	void ClearPackets()
 	{
-		//For each item, list shall be locked before
-		for (RTPOrderedPackets::iterator it=packets.begin(); it!=packets.end(); ++it)
-			//Delete rtp
-			delete(it->second);
-		//Clear all list
-		packets.clear();
+		//Lock retired list
+		pthread_mutex_lock(&retiredMutex);
+		//For each slot, producer lock shall be taken before
+		for (DWORD i=0;i<Capacity;++i)
+		{
+			//Get packet, consumer may be taking it concurrently
+			RTPTimedPacket* rtp = __sync_lock_test_and_set(&slots[i],(RTPTimedPacket*)NULL);
+			//If there was one
+			if (rtp)
+			{
+				//One less
+				__sync_sub_and_fetch(&length,1);
+				//Consumer may be reading it, it will delete it
+				retired.push_back(rtp);
+			}
+		}
+		//Update count
+		__atomic_store_n(&numRetired,retired.size(),__ATOMIC_RELEASE);
+		//Unlock
+		pthread_mutex_unlock(&retiredMutex);
+		//Reset window
+		__atomic_store_n(&low,(DWORD)-1,__ATOMIC_RELEASE);
+		__atomic_store_n(&head,0,__ATOMIC_RELEASE);
 	}
 
-private:
-	typedef std::map<DWORD,RTPTimedPacket*> RTPOrderedPackets;
+	void Retire(RTPTimedPacket* rtp)
+	{
+		//Lock
+		pthread_mutex_lock(&retiredMutex);
+		//Add it
+		retired.push_back(rtp);
+		//Update count
+		__atomic_store_n(&numRetired,retired.size(),__ATOMIC_RELEASE);
+		//Unlock
+		pthread_mutex_unlock(&retiredMutex);
+	}
+
+	void Collect()
+	{
+		//Check without locking first
+		if (!__atomic_load_n(&numRetired,__ATOMIC_ACQUIRE))
+			return;
+		//Get them all
+		Packets packets;
+		pthread_mutex_lock(&retiredMutex);
+		packets.swap(retired);
+		__atomic_store_n(&numRetired,0,__ATOMIC_RELEASE);
+		pthread_mutex_unlock(&retiredMutex);
+		//Delete them
+		for (Packets::iterator it=packets.begin();it!=packets.end();++it)
+			delete(*it);
+	}
 
 private:
-	//The event list
-	RTPOrderedPackets	packets;
-	bool			cancel;
-	bool			hurryUp;
+	typedef std::vector<RTPTimedPacket*> Packets;
+private:
+	//The packet ring
+	RTPTimedPacket*		slots[Capacity];
+	//Removed by the producer, to be deleted by the consumer
+	Packets			retired;
+	pthread_mutex_t		retiredMutex;
+	DWORD			numRetired;
+	volatile bool		cancel;
+	volatile bool		hurryUp;
+	volatile bool		waiting;
 	pthread_mutex_t		mutex;
+	pthread_mutex_t		producer;
 	pthread_cond_t		cond;
 	DWORD			next;
+	DWORD			low;
+	DWORD			head;
+	DWORD			length;
+	DWORD			added;
+	DWORD			resyncs;
 	DWORD			maxWaitTime;
 };
 
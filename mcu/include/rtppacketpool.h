@@ -0,0 +1,50 @@
+/*
+ * File:   rtppacketpool.h
+ * Author: Sergio
+ *
+ * Created on 16 de octubre de 2026, 17:40
+ */
+
+#ifndef RTPPACKETPOOL_H
+#define	RTPPACKETPOOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "config.h"
+#include "media.h"
+
+/*
+ * Memory pool for RTPPacket objects.
+ *	Each packet embeds a full MTU buffer, so they are recycled instead of
+ *	going back to malloc. There is one pool per media type, each thread
+ *	keeps a small free list per pool so most allocations don't lock, and
+ *	the thread caches overflow to (and refill from) a global free list.
+ *	Allocations without a valid media type go straight to malloc.
+ */
+class RTPPacketPool
+{
+public:
+	struct Stats
+	{
+		QWORD	allocs;		//Number of allocations
+		QWORD	hits;		//Number of allocations served from a free list
+		DWORD	resident;	//Number of blocks allocated from the system, in use or cached
+		DWORD	cached;		//Number of free blocks on the global list
+		DWORD	blockSize;	//Size of each block
+	};
+
+public:
+	static void* Allocate(size_t size,MediaFrame::Type media);
+	static void  Release(void* ptr);
+	static Stats GetStats(MediaFrame::Type media);
+	static void  SetMaxCached(DWORD num);
+
+private:
+	//Max number of blocks on each thread free list
+	static const DWORD MaxThreadCached = 64;
+	//Number of blocks moved between thread and global lists at once
+	static const DWORD BatchSize = 32;
+};
+
+#endif	/* RTPPACKETPOOL_H */
+
@@ -27,6 +27,7 @@ public:
 
 	virtual int SendVideoFPU();
 	virtual MediaStatistics GetStatistics(MediaFrame::Type type);
+	virtual LatencyStats* GetLatencyStats()		{ return video.GetLatencyStats();	}
 
 	virtual int SetVideoInput(VideoInput* input)	{ videoInput	= input;	}
 	virtual int SetVideoOutput(VideoOutput* output) { videoOutput	= output;	}
@@ -34,6 +35,7 @@ public:
 	virtual int SetAudioOutput(AudioOutput *output)	{ audioOutput	= output;	}
 	virtual int SetTextInput(TextInput* input)	{ textInput	= input;	}
 	virtual int SetTextOutput(TextOutput* output)	{ textOutput	= output;	}
+	virtual int SetSharedVideoEncoder(SharedVideoEncoder* encoder)	{ video.SetSharedEncoder(encoder); return 1;	}
 
 	virtual int SetMute(MediaFrame::Type media, bool isMuted);
 
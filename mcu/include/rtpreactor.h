@@ -0,0 +1,101 @@
+/*
+ * File:   rtpreactor.h
+ * Author: Sergio
+ *
+ * Created on 16 de octubre de 2026, 10:12
+ */
+
+#ifndef RTPREACTOR_H
+#define	RTPREACTOR_H
+
+#include <pthread.h>
+#include <vector>
+#include <map>
+#include "config.h"
+#include "use.h"
+
+class RTPSession;
+
+/*
+ * Shared RTP/RTCP socket reactor.
+ *	Instead of having one polling thread per RTPSession, a fixed set of
+ *	workers owns an epoll set each. Sessions are assigned to the least
+ *	loaded worker on registration and their ReadRTP/ReadRTCP methods are
+ *	dispatched from it, so each session is still served by only one thread.
+ */
+class RTPReactor
+{
+public:
+	struct Stats
+	{
+		DWORD	numWorkers;
+		DWORD	numSessions;
+		QWORD	numWakeUps;
+		QWORD	numEvents;
+	};
+public:
+	static RTPReactor& getInstance()
+	{
+		static RTPReactor reactor;
+		return reactor;
+	}
+
+public:
+	bool Start(int numWorkers = 0);
+	bool Stop();
+	bool IsRunning() const	{ return __atomic_load_n(&running,__ATOMIC_ACQUIRE);	}
+
+	bool AddSession(RTPSession* session,int rtp,int rtcp);
+	bool RemoveSession(RTPSession* session);
+
+	Stats GetStats();
+
+private:
+	RTPReactor();
+	~RTPReactor();
+	//Non copyable
+	RTPReactor(RTPReactor const&);
+	void operator=(RTPReactor const&);
+
+private:
+	typedef std::map<int,RTPSession*> Sockets;
+
+	struct Worker
+	{
+		RTPReactor*	reactor;
+		pthread_t	thread;
+		int		epfd;
+		int		efd;
+		Use		use;
+		Sockets		sockets;
+		DWORD		numSessions;
+		QWORD		numWakeUps;
+		QWORD		numEvents;
+	};
+
+	struct Registration
+	{
+		Worker*	worker;
+		int	rtp;
+		int	rtcp;
+	};
+
+	typedef std::vector<Worker*> Workers;
+	typedef std::map<RTPSession*,Registration> Sessions;
+
+private:
+	static void* run(void *par);
+	int Run(Worker* worker);
+
+private:
+	static const int MaxEvents = 64;
+
+private:
+	bool		running;
+	Workers		workers;
+	Sessions	sessions;
+	Mutex		mutex;
+};
+
+#endif	/* RTPREACTOR_H */
+
@@ -27,12 +27,21 @@ struct MediaStatistics
 	DWORD		numSendPackets;
 	DWORD		totalRecvBytes;
 	DWORD		totalSendBytes;
+	DWORD		recvBatches;
+	DWORD		recvBatchedPackets;
+	DWORD		maxRecvBatch;
+	DWORD		sendBatches;
+	DWORD		sendBatchedPackets;
+	DWORD		maxSendBatch;
+	DWORD		poolHitRate;
+	DWORD		poolResidentBytes;
 };
 
 class RTPSession :
 	public RemoteRateEstimator::Listener,
 	public DTLSConnection::Listener
 {
+	friend class RTPReactor;
 public:
 	class Listener
 	{
@@ -47,6 +56,20 @@ public:
 	};
 public:
 
+	struct BatchStats
+	{
+		DWORD	recvBatches;
+		DWORD	recvBatchedPackets;
+		DWORD	maxRecvBatch;
+		DWORD	sendBatches;
+		DWORD	sendBatchedPackets;
+		DWORD	maxSendBatch;
+	};
+public:
+	//Max number of datagrams read or written on a single syscall
+	static const DWORD MaxBatchSize = 16;
+	//Default number of sent packets kept for retransmission
+	static const DWORD DefaultRTXHistorySize = 512;
 public:
 	static bool SetPortRange(int minPort, int maxPort);
 	static DWORD GetMinPort() { return minLocalPort; }
@@ -76,6 +99,7 @@ public:
 	void SendEmptyPacket();
 	int SendPacket(RTPPacket &packet,DWORD timestamp);
 	int SendPacket(RTPPacket &packet);
+	int SendPackets(RTPPacket* packets[],DWORD num);
 
 	RTPPacket* GetPacket();
 	void CancelGetPacket();
@@ -84,6 +108,7 @@ public:
 	DWORD GetTotalRecvBytes()	const { return recv.totalBytes+recv.totalRTCPBytes;	}
 	DWORD GetTotalSendBytes()	const { return send.totalBytes+send.totalRTCPBytes;	}
 	DWORD GetLostRecvPackets()	const { return recv.lostPackets;	}
+	const BatchStats& GetBatchStats() const { return batch;			}
 
 
 	MediaFrame::Type GetMediaType()	const { return media;		}
@@ -110,6 +135,10 @@ private:
 	void Stop();
 	int  ReadRTP();
 	int  ReadRTCP();
+	int  ProcessRTP(BYTE* buffer,int size,sockaddr_in& from_addr);
+	bool PrepareSending();
+	int  PrepareRTPPacket(RTPPacket &packet,DWORD timestamp,BYTE* data);
+	void StoreRTXPacket(BYTE* data,DWORD headerLen,DWORD len);
 	void ProcessRTCPPacket(const RTCPCompoundPacket *packet);
 	int ReSendPacket(int seq);
 	int Run();
@@ -123,7 +152,15 @@ protected:
 	int SendFIR();
 	RTCPCompoundPacket* CreateSenderReport();
 private:
-	typedef std::map<DWORD,RTPTimedPacket*> RTPOrderedPackets;
+	//Sent packet before protecting it, as it is needed for retransmissions
+	struct RTXPacket
+	{
+		DWORD	extSeq;
+		QWORD	time;
+		WORD	headerLen;
+		WORD	len;
+		BYTE	data[MTU];
+	};
 protected:
 	RemoteRateEstimator*	remoteRateEstimator;
 private:
@@ -152,11 +189,13 @@ private:
 	char*	iceLocalUsername;
 	char*	iceLocalPwd;
 	pthread_t thread;
+	bool	reactor;
 
 	//Transmision
 	sockaddr_in sendAddr;
 	sockaddr_in sendRtcpAddr;
 	BYTE 	sendPacket[MTU+SRTP_MAX_TRAILER_LEN] ALIGNEDTO32;
+	BYTE	sendBatch[MaxBatchSize][MTU+SRTP_MAX_TRAILER_LEN] ALIGNEDTO32;
 	
 	RTPOutgoingSource send;
 	RTPIncomingSource recv;
@@ -170,6 +209,7 @@ private:
 
 	//Recepcion
 	BYTE	recBuffer[MTU+SRTP_MAX_TRAILER_LEN] ALIGNEDTO32;
+	BYTE	recvBatch[MaxBatchSize][MTU+SRTP_MAX_TRAILER_LEN] ALIGNEDTO32;
 	DWORD	recTimestamp;
 	timeval recTimeval;
 	DWORD	recSR;
@@ -203,8 +243,11 @@ private:
 
 	bool 			useRTCP;
 
-	RTPOrderedPackets	rtxs;
+	RTXPacket*		rtxs;
+	DWORD			rtxSize;
+	DWORD			rtxMaxHistory;
 	bool			usePLI;
+	BatchStats		batch;
 };
 
 #endif
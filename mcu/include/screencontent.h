@@ -0,0 +1,62 @@
+/*
+ * File:   screencontent.h
+ * Author: Sergio
+ *
+ * Created on 18 de octubre de 2026, 10:15
+ */
+
+#ifndef SCREENCONTENT_H
+#define	SCREENCONTENT_H
+
+#include "config.h"
+
+/*
+ * Macroblock change detector for screen content.
+ *	Compares each YUV 4:2:0 picture against the previous one and keeps a
+ *	map with one byte per 16x16 macroblock, non zero if it has changed. It
+ *	is used to skip encoding static screens, to give the encoder the
+ *	changed regions and to detect scrolling bursts, where most of the
+ *	picture changes on consecutive frames.
+ */
+class ScreenContent
+{
+public:
+	ScreenContent();
+	~ScreenContent();
+
+	//Compare with previous picture, returns number of changed macroblocks
+	DWORD Update(const BYTE* pic,DWORD width,DWORD height);
+	//Forget previous picture so everything is changed on next update
+	void  Reset();
+
+	const BYTE* GetMap() const		{ return map;			}
+	DWORD GetMacroblocksWidth() const	{ return cols;			}
+	DWORD GetMacroblocksHeight() const	{ return rows;			}
+	DWORD GetNumMacroblocks() const		{ return cols*rows;		}
+	DWORD GetChanged() const		{ return changed;		}
+	bool  IsBurst() const			{ return bursting>=BurstFrames;	}
+
+private:
+	//Non copyable
+	ScreenContent(ScreenContent const&);
+	void operator=(ScreenContent const&);
+
+	static bool HasChanged(const BYTE* a,const BYTE* b,DWORD stride,DWORD width,DWORD height);
+
+private:
+	//Consecutive frames with more than half the picture changed to be a burst
+	static const DWORD BurstFrames = 2;
+
+private:
+	BYTE*	prev;
+	BYTE*	map;
+	DWORD	width;
+	DWORD	height;
+	DWORD	cols;
+	DWORD	rows;
+	DWORD	changed;
+	DWORD	bursting;
+	bool	valid;
+};
+
+#endif	/* SCREENCONTENT_H */
@@ -11,6 +11,11 @@
 #include "tools.h"
 #include <set>
 
+/*
+ * Audio mix for a group of participants.
+ *	Samples are accumulated on 32 bits so the sum never wraps, and are
+ *	saturated back to 16 bits when the mix is read.
+ */
 class Sidebar
 {
 public:
@@ -18,6 +23,10 @@ public:
 	~Sidebar();
 
 	int  Update(int index,SWORD *samples,DWORD len);
+	//Saturate accumulated samples into the mix buffer
+	void Mix(DWORD len);
+	//Get the mix without the participant own samples, out may be the same as samples
+	void MixMinus(SWORD *samples,SWORD *out,DWORD len);
 	void Reset();
 
 	void AddParticipant(int id);
@@ -32,6 +41,8 @@ private:
 private:
 	//Audio mixing buffer
 	SWORD* mixer_buffer;
+	//Audio sum
+	int* mixer_acu;
 	Participants participants;
 };
 
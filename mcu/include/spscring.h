@@ -0,0 +1,145 @@
+/*
+ * File:   spscring.h
+ * Author: Sergio
+ *
+ * Created on 18 de octubre de 2026, 17:15
+ */
+
+#ifndef SPSCRING_H
+#define	SPSCRING_H
+
+#include <string.h>
+#include "config.h"
+
+/*
+ * Lock free single producer single consumer ring.
+ *	Only one thread may push and only one thread may pop, clear or
+ *	discard. Indexes grow forever and are published with release stores
+ *	and read with acquire loads, so data copied before moving an index is
+ *	visible to the other side. Each index is on its own cache line.
+ *	Size must be a power of two.
+ */
+template<typename T,DWORD S>
+class spscring
+{
+public:
+	spscring()
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	//Producer side, returns 0 if it does not fit
+	DWORD push(const T *in,DWORD l)
+	{
+		//Own index does not need to be synchronized
+		DWORD h = head;
+		//Get consumer index
+		DWORD t = __atomic_load_n(&tail,__ATOMIC_ACQUIRE);
+
+		//Check it fits
+		if (S-(h-t)<l)
+			return 0;
+
+		//Get position and what fits until the end
+		DWORD pos = h&(S-1);
+		DWORD first = S-pos<l ? S-pos : l;
+
+		//Copy
+		memcpy(data+pos,in,first*sizeof(T));
+		memcpy(data,in+first,(l-first)*sizeof(T));
+
+		//Publish
+		__atomic_store_n(&head,h+l,__ATOMIC_RELEASE);
+
+		return l;
+	}
+
+	//Producer side, index of next element to be pushed
+	DWORD written() const
+	{
+		return head;
+	}
+
+	//Consumer side, index of next element to be popped
+	DWORD read() const
+	{
+		return tail;
+	}
+
+	//Consumer side, returns 0 if there are not enough
+	DWORD pop(T *out,DWORD l)
+	{
+		//Own index does not need to be synchronized
+		DWORD t = tail;
+		//Get producer index
+		DWORD h = __atomic_load_n(&head,__ATOMIC_ACQUIRE);
+
+		//Check we have enough
+		if (h-t<l)
+			return 0;
+
+		//Get position and what is there until the end
+		DWORD pos = t&(S-1);
+		DWORD first = S-pos<l ? S-pos : l;
+
+		//Copy
+		memcpy(out,data+pos,first*sizeof(T));
+		memcpy(out+first,data,(l-first)*sizeof(T));
+
+		//Release space
+		__atomic_store_n(&tail,t+l,__ATOMIC_RELEASE);
+
+		return l;
+	}
+
+	//Consumer side, drop everything pushed before index
+	void discard(DWORD index)
+	{
+		//Get indexes
+		DWORD t = tail;
+		DWORD h = __atomic_load_n(&head,__ATOMIC_ACQUIRE);
+
+		//Check it is between them
+		if ((int)(index-t)>0 && (int)(h-index)>=0)
+			//Release space
+			__atomic_store_n(&tail,index,__ATOMIC_RELEASE);
+	}
+
+	//Consumer side, drop everything
+	void clear()
+	{
+		//Move to the end
+		__atomic_store_n(&tail,__atomic_load_n(&head,__ATOMIC_ACQUIRE),__ATOMIC_RELEASE);
+	}
+
+	//Snapshot, exact only from the consumer side
+	DWORD length() const
+	{
+		DWORD t = __atomic_load_n(&tail,__ATOMIC_ACQUIRE);
+		DWORD h = __atomic_load_n(&head,__ATOMIC_ACQUIRE);
+		return h-t;
+	}
+
+	DWORD size() const
+	{
+		return S;
+	}
+
+private:
+	//Non copyable
+	spscring(spscring const&);
+	void operator=(spscring const&);
+	//Size must be a power of two
+	typedef char SizeMustBePowerOfTwo[(S&(S-1))==0 ? 1 : -1];
+
+private:
+	char	pad0[64];
+	DWORD	head;
+	char	pad1[64-sizeof(DWORD)];
+	DWORD	tail;
+	char	pad2[64-sizeof(DWORD)];
+	T	data[S];
+};
+
+#endif	/* SPSCRING_H */
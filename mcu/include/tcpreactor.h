@@ -0,0 +1,126 @@
+/*
+ * File:   tcpreactor.h
+ * Author: Sergio
+ *
+ * Created on 17 de octubre de 2026, 11:40
+ */
+
+#ifndef TCPREACTOR_H
+#define	TCPREACTOR_H
+
+#include <pthread.h>
+#include <vector>
+#include <map>
+#include "config.h"
+#include "use.h"
+
+/*
+ * Shared TCP connection reactor.
+ *	Instead of having one polling thread per RTMP or WebSocket connection,
+ *	a fixed set of workers owns an edge triggered epoll set each. Each
+ *	connection is assigned to the least loaded worker and all its reads,
+ *	writes and timers are dispatched from it, so handlers are never run
+ *	concurrently for the same connection.
+ */
+class TCPReactor
+{
+public:
+	class Connection
+	{
+	public:
+		Connection()
+		{
+			epfd = FD_INVALID;
+			fd = FD_INVALID;
+		}
+		virtual ~Connection() {}
+	public:
+		//Read until it would block, return false to close the connection
+		virtual bool onReadable() = 0;
+		//Write until it would block or nothing is left, return false to close the connection
+		virtual bool onWritable() = 0;
+		//Called each second
+		virtual void onTick() {}
+		//Already removed from the reactor, socket must be closed here
+		virtual void onClosed() = 0;
+	private:
+		friend class TCPReactor;
+		volatile int epfd;
+		volatile int fd;
+	};
+
+	struct Stats
+	{
+		DWORD	numWorkers;
+		DWORD	numConnections;
+		QWORD	numWakeUps;
+		QWORD	numEvents;
+		QWORD	numSignals;
+	};
+public:
+	static TCPReactor& getInstance()
+	{
+		static TCPReactor reactor;
+		return reactor;
+	}
+
+public:
+	bool Start(int numWorkers = 0);
+	bool Stop();
+	bool IsRunning() const	{ return __atomic_load_n(&running,__ATOMIC_ACQUIRE);	}
+
+	//Socket must be non blocking
+	bool AddConnection(Connection* connection,int fd);
+	//Stop dispatching events, returns false if the worker had already closed it
+	bool RemoveConnection(Connection* connection);
+	//Must be called before deleting it, waits until no handler is running for it
+	void ReleaseConnection(Connection* connection);
+	//Thread safe, makes the worker call onWritable
+	bool SignalWrite(Connection* connection);
+
+	Stats GetStats();
+
+private:
+	TCPReactor();
+	~TCPReactor();
+	//Non copyable
+	TCPReactor(TCPReactor const&);
+	void operator=(TCPReactor const&);
+
+private:
+	typedef std::map<int,Connection*> Sockets;
+
+	struct Worker
+	{
+		TCPReactor*	reactor;
+		pthread_t	thread;
+		int		epfd;
+		int		efd;
+		Use		use;
+		Sockets		sockets;
+		DWORD		numConnections;
+		QWORD		numWakeUps;
+		QWORD		numEvents;
+	};
+
+	typedef std::vector<Worker*> Workers;
+	//Kept until released, so we know which worker to wait for
+	typedef std::map<Connection*,Worker*> Connections;
+
+private:
+	static void* run(void *par);
+	int Run(Worker* worker);
+	bool Remove(Worker* worker,Connection* connection);
+
+private:
+	static const int MaxEvents = 64;
+
+private:
+	bool		running;
+	Workers		workers;
+	Connections	connections;
+	Mutex		mutex;
+	volatile QWORD	numSignals;
+};
+
+#endif	/* TCPREACTOR_H */
@@ -3,6 +3,7 @@
 #include "config.h"
 #include "media.h"
 #include "codecs.h"
+#include "videobuffer.h"
 
 class VideoFrame : public MediaFrame
 {
@@ -72,6 +73,10 @@ public:
 	virtual void  CancelGrabFrame()=0;
 	virtual DWORD GetBufferSize()=0;
 	virtual int   StopVideoCapture()=0;
+	//False if the last grabbed picture is the same as the previous one
+	virtual bool  IsFrameChanged()	{ return true;	}
+	//Time the first packet of the newest frame on it was received, 0 if unknown
+	virtual QWORD GetFrameTime()	{ return 0;	}
 };
 
 class VideoOutput
@@ -79,6 +84,10 @@ class VideoOutput
 public:
 	virtual void ClearFrame() = 0;
 	virtual int NextFrame(BYTE *pic)=0;
+	//Same, with the time the first packet of the frame was received
+	virtual int NextFrame(BYTE *pic,QWORD time)	{ return NextFrame(pic);	}
+	//Decoded picture, planes may be padded, reference stays with the caller
+	virtual int NextFrame(VideoBuffer* frame);
 	virtual int SetVideoSize(int width,int height)=0;
 };
 
@@ -93,6 +102,8 @@ public:
 	virtual VideoFrame* EncodeFrame(BYTE *in,DWORD len)=0;
 	virtual int FastPictureUpdate()=0;
 	virtual int SetFrameRate(int fps,int kbits,int intraPeriod)=0;
+	//Quantizer offsets for next frame, map has one byte per macroblock, non zero if changed
+	virtual int SetRegionOfInterest(const BYTE* map,DWORD cols,DWORD rows,int changedQP,int staticQP) { return 0; }
 public:
 	VideoCodec::Type type;
 };
@@ -107,6 +118,8 @@ public:
 	virtual int Decode(BYTE *in,DWORD len) = 0;
 	virtual int DecodePacket(BYTE *in,DWORD len,int lost,int last)=0;
 	virtual BYTE* GetFrame()=0;
+	//Last decoded picture with a reference for the caller, planes may be padded
+	virtual VideoBuffer* GetBuffer();
 	virtual bool  IsKeyFrame()=0;
 public:
 	VideoCodec::Type type;
@@ -0,0 +1,151 @@
+/*
+ * File:   videobuffer.h
+ * Author: Sergio
+ *
+ * Created on 17 de octubre de 2026, 12:05
+ */
+
+#ifndef VIDEOBUFFER_H
+#define	VIDEOBUFFER_H
+
+#include <stddef.h>
+#include "config.h"
+
+/*
+ * Reference counted YUV 4:2:0 picture.
+ *	Buffers are recycled through a pool keyed by picture size, so handing
+ *	a frame from one thread to another is just passing a reference. The
+ *	content must not be modified once the buffer has been published.
+ *	Decoders write directly into buffers with padded lines, so planes may
+ *	have a stride bigger than the width, chroma one is always half of the
+ *	luma one. Buffers created with just the size are packed.
+ */
+class VideoBuffer
+{
+public:
+	struct Stats
+	{
+		QWORD	allocs;		//Number of buffers requested
+		QWORD	hits;		//Number of buffers served from the pool
+		DWORD	resident;	//Bytes allocated from the system, in use or cached
+		DWORD	cached;		//Bytes on the free lists
+	};
+
+public:
+	//Get a buffer with one reference for the caller
+	static VideoBuffer* Create(DWORD width,DWORD height);
+	//Same, with room for lines of stride bytes, stride must be even
+	static VideoBuffer* Create(DWORD width,DWORD height,DWORD stride,DWORD lines);
+	static Stats GetStats();
+	static void SetMaxCached(DWORD bytes);
+
+public:
+	void AddRef()			{ __sync_add_and_fetch(&refs,1);	}
+	void Release();
+
+	//Paint it in black
+	void Clear();
+	//Move the picture inside the allocated lines, left and top must be even
+	void Crop(DWORD left,DWORD top,DWORD width,DWORD height);
+	//Copy picture packed
+	void CopyTo(BYTE* dst) const;
+
+	//Packed picture for the ones with no padding
+	BYTE* GetData() const		{ return data;				}
+	BYTE* GetPlane(DWORD num) const	{ return planes[num];			}
+	//Luma stride, chroma ones are half of it
+	DWORD GetStride() const		{ return stride;			}
+	bool  IsPacked() const		{ return stride==width && planes[0]==data && lines==height;	}
+	DWORD GetWidth() const		{ return width;				}
+	DWORD GetHeight() const		{ return height;			}
+	DWORD GetSize() const		{ return size;				}
+	//Time the first packet of the frame it comes from was received, 0 if unknown
+	QWORD GetTime() const		{ return time;				}
+	void  SetTime(QWORD time)	{ this->time = time;			}
+
+private:
+	VideoBuffer(DWORD size);
+	~VideoBuffer();
+	//Non copyable
+	VideoBuffer(VideoBuffer const&);
+	void operator=(VideoBuffer const&);
+
+	static void Recycle(VideoBuffer* buffer);
+
+private:
+	BYTE*		data;
+	DWORD		size;
+	DWORD		width;
+	DWORD		height;
+	DWORD		stride;
+	DWORD		lines;
+	BYTE*		planes[3];
+	QWORD		time;
+	volatile DWORD	refs;
+	VideoBuffer*	next;
+};
+
+/*
+ * Single slot holding the latest published picture.
+ *	The producer swaps the new buffer in, dropping the previous one if
+ *	nobody took it, and the consumer swaps it out with NULL. Both sides
+ *	are wait free and the reference moves along with the pointer.
+ */
+class VideoBufferSlot
+{
+public:
+	VideoBufferSlot()
+	{
+		//Empty
+		buffer = NULL;
+	}
+
+	~VideoBufferSlot()
+	{
+		//Release pending one
+		Clear();
+	}
+
+	void Publish(VideoBuffer* frame)
+	{
+		//Swap it, we give our reference to the slot
+		VideoBuffer* old = __atomic_exchange_n(&buffer,frame,__ATOMIC_ACQ_REL);
+		//If the previous one was not consumed
+		if (old)
+			//Drop it
+			old->Release();
+	}
+
+	VideoBuffer* Take()
+	{
+		//Get it and leave the slot empty, reference goes to the caller
+		return __atomic_exchange_n(&buffer,(VideoBuffer*)NULL,__ATOMIC_ACQ_REL);
+	}
+
+	bool IsPending() const
+	{
+		//Check if there is a picture waiting
+		return __atomic_load_n(&buffer,__ATOMIC_ACQUIRE)!=NULL;
+	}
+
+	void Clear()
+	{
+		//Take pending one
+		VideoBuffer* old = Take();
+		//If any
+		if (old)
+			//Drop it
+			old->Release();
+	}
+
+private:
+	//Non copyable
+	VideoBufferSlot(VideoBufferSlot const&);
+	void operator=(VideoBufferSlot const&);
+
+private:
+	VideoBuffer* buffer;
+};
+
+#endif	/* VIDEOBUFFER_H */
+
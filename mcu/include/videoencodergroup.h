@@ -0,0 +1,125 @@
+/*
+ * File:   videoencodergroup.h
+ * Author: Sergio
+ *
+ * Created on 19 de octubre de 2026, 11:40
+ */
+
+#ifndef VIDEOENCODERGROUP_H
+#define	VIDEOENCODERGROUP_H
+
+#include <pthread.h>
+#include <set>
+#include "config.h"
+#include "codecs.h"
+#include "video.h"
+#include "pipevideoinput.h"
+
+class Mosaic;
+
+/*
+ * Encodes a mosaic once for all the participants watching it with the
+ *	same codec, size, frame rate and bitrate tier, and hands the encoded
+ *	frames to each of them to be packetized on their own RTP session.
+ */
+class VideoEncoderGroup
+{
+public:
+	class Listener
+	{
+	public:
+		//Virtual desctructor
+		virtual ~Listener(){};
+	public:
+		//Called from the group thread, frame is shared and only valid during the call
+		virtual void onEncodedFrame(VideoEncoderGroup* group,VideoFrame* frame,DWORD sendingTime) = 0;
+	};
+
+	struct Key
+	{
+		Mosaic*			mosaic;
+		VideoCodec::Type	codec;
+		DWORD			width;
+		DWORD			height;
+		DWORD			fps;
+		DWORD			tier;
+
+		bool operator<(const Key& other) const;
+	};
+
+	struct Stats
+	{
+		DWORD	frames;
+		DWORD	fpuRequested;
+		DWORD	fpuSent;
+	};
+
+public:
+	//Bitrate of the highest tier not over the given bitrate in kbps
+	static DWORD GetTier(DWORD bitrate);
+	//Tier for a member given its bitrate and estimation, only going down when clearly below current
+	static DWORD SelectTier(DWORD current,DWORD bitrate,DWORD estimation);
+
+public:
+	VideoEncoderGroup(const Key& key,int intraPeriod,const Properties& properties);
+	~VideoEncoderGroup();
+
+	int Start();
+	int Stop();
+
+	void  AddMember(Listener* listener);
+	DWORD RemoveMember(Listener* listener);
+	DWORD GetNumMembers();
+	//Intra requests are coalesced so at most one is sent each MinFPUPeriod
+	void  SendFPU();
+
+	const Key&	GetKey() const	{ return key;	}
+	PipeVideoInput*	GetInput()	{ return &input;}
+	Stats		GetStats();
+
+protected:
+	int Encode();
+
+private:
+	static void* startEncoding(void *par);
+
+private:
+	//Min time between intra frames in ms
+	static const DWORD MinFPUPeriod = 100;
+
+private:
+	typedef std::set<Listener*> Listeners;
+
+private:
+	Key		key;
+	int		intraPeriod;
+	Properties	properties;
+	PipeVideoInput	input;
+	Listeners	listeners;
+	Stats		stats;
+
+	pthread_t	thread;
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+	bool		encoding;
+	bool		sendFPU;
+};
+
+/*
+ * Given by the mixer to each participant so it can get the encoded
+ *	frames of its mosaic from a shared encoder instead of its own one.
+ */
+class SharedVideoEncoder
+{
+public:
+	//Virtual desctructor
+	virtual ~SharedVideoEncoder(){};
+public:
+	virtual int Join(VideoEncoderGroup::Listener* listener,VideoCodec::Type codec,int width,int height,int fps,int bitrate,int intraPeriod,const Properties& properties) = 0;
+	//Estimated bitrate in kbps from REMB or TMMBR
+	virtual int SetTargetBitrate(int bitrate) = 0;
+	virtual int SendFPU() = 0;
+	virtual int Leave() = 0;
+};
+
+#endif	/* VIDEOENCODERGROUP_H */
@@ -8,9 +8,17 @@
 #include "mosaic.h"
 #include "logo.h"
 #include "eventstreaminghandler.h"
+#include "workerpool.h"
+#include "mediaclock.h"
+#include "latencystats.h"
+#include "videoencodergroup.h"
+#include "labelcache.h"
+#include "encoderthreads.h"
 #include <map>
+#include <vector>
 
-class VideoMixer 
+class VideoMixer :
+	public MediaClock::Listener
 {
 public:
 	enum VADMode
@@ -33,10 +41,12 @@ public:
 	int CreateMixer(int id,const std::wstring &name);
 	int InitMixer(int id,int mosaicId);
 	int SetMixerMosaic(int id,int mosaicId);
+	int SetLatencyStats(int id,LatencyStats* latency);
 	int EndMixer(int id);
 	int DeleteMixer(int id);
 	VideoInput*  GetInput(int id);
 	VideoOutput* GetOutput(int id);
+	SharedVideoEncoder* GetSharedEncoder(int id);
 	int SetSlot(int num,int id);
 	int SetCompositionType(Mosaic::Type comp,int size);
 
@@ -51,6 +61,9 @@ public:
 	int DeleteMosaic(int mosaicId);
 
 	int End();
+
+	//Media clock listener interface
+	virtual void onTick(QWORD deadline,DWORD ticks);
 	
 public:
 	static void SetVADDefaultChangePeriod(DWORD ms);
@@ -62,16 +75,54 @@ protected:
 	
 private:
 	static void * startMixingVideo(void *par);
+	//Check refresh tick flag set by the media clock
+	bool IsRefreshTick(bool clear);
 
 private:
 
+	class SharedEncoder :
+		public SharedVideoEncoder,
+		public VideoEncoderGroup::Listener
+	{
+	public:
+		SharedEncoder(VideoMixer* mixer);
+		virtual ~SharedEncoder();
+
+		virtual int Join(VideoEncoderGroup::Listener* listener,VideoCodec::Type codec,int width,int height,int fps,int bitrate,int intraPeriod,const Properties& properties);
+		virtual int SetTargetBitrate(int bitrate);
+		virtual int SendFPU();
+		virtual int Leave();
+
+		//Forwards the frames of the current group and switches to the target one on its first intra
+		virtual void onEncodedFrame(VideoEncoderGroup* group,VideoFrame* frame,DWORD sendingTime);
+
+	public:
+		//All protected by the mixer encoder groups mutex
+		VideoMixer*			mixer;
+		//Also protected by the mutex as they are changed from the group threads
+		VideoEncoderGroup::Listener*	listener;
+		VideoEncoderGroup*		group;		//Group being delivered
+		VideoEncoderGroup*		target;		//Group to switch to on its next intra
+		VideoEncoderGroup*		previous;	//Group switched from, still to be left
+		pthread_mutex_t			mutex;
+		bool				joined;
+		VideoEncoderGroup::Key		key;
+		DWORD				bitrate;
+		DWORD				estimation;
+		int				intraPeriod;
+		Properties			properties;
+	};
+
 	struct VideoSource
 	{
 		PipeVideoInput  *input;
 		PipeVideoOutput *output;
+		SharedEncoder	*shared;
 		Mosaic *mosaic;
 		std::wstring name;
 		bool refresh;
+		LatencyStats* latency;
+		LatencyStats::Snapshot* lastLatency;
 		
 		VideoSource(const std::wstring &name)
 		{
@@ -80,14 +131,74 @@ private:
 			//NULL
 			input = NULL;
 			output = NULL;
+			shared = NULL;
 			mosaic = NULL;
 			refresh = true;
-			
+			latency = NULL;
+			lastLatency = NULL;
+		}
+
+		~VideoSource()
+		{
+			//Free last reported stats
+			if (lastLatency)
+				delete(lastLatency);
+		}
+	};
+
+	struct SourceFrame
+	{
+		VideoBuffer*	buffer;
+		bool		changed;
+	};
+
+	struct CompositionStats
+	{
+		DWORD	num;
+		QWORD	acu;
+		QWORD	max;
+		QWORD	pixels;
+
+		CompositionStats()
+		{
+			num = 0;
+			acu = 0;
+			max = 0;
+			pixels = 0;
 		}
 	};
 
 	typedef std::map<int,VideoSource *> Videos;
 	typedef std::map<int,Mosaic *> Mosaics;
+	typedef std::map<int,SourceFrame> Frames;
+	typedef std::map<int,CompositionStats> CompositionStatsMap;
+	typedef std::map<VideoEncoderGroup::Key,VideoEncoderGroup*> EncoderGroups;
+	typedef std::vector<VideoEncoderGroup*> EncoderGroupList;
+
+	class CompositionTask : public WorkerPool::Task
+	{
+	public:
+		virtual void Execute();
+	public:
+		VideoMixer*	mixer;
+		int		id;
+		Mosaic*		mosaic;
+		const Frames*	frames;
+		QWORD		elapsed;
+		DWORD		pixels;
+	};
+private:
+	int ComposeMosaic(Mosaic* mosaic,const Frames& frames);
+	void SendLatencyStats(int id,VideoSource* source);
+	void SetSharedEncoderMosaic(VideoSource* source,Mosaic* mosaic);
+	void UpdateEncoderGroup(SharedEncoder* shared,bool switching,EncoderGroupList& stopped);
+	void FinishEncoderGroupSwitch(SharedEncoder* shared,EncoderGroupList& stopped);
+	void LeaveEncoderGroup(SharedEncoder* shared,VideoEncoderGroup* group,EncoderGroupList& stopped);
+	static void DeleteEncoderGroups(EncoderGroupList& stopped);
+	int  GetMosaicId(Mosaic* mosaic);
+private:
+	//Period for reporting composition times in ms
+	static const DWORD CompositionStatsPeriod = 5000;
 private:
 	static DWORD vadDefaultChangePeriod;
 private:
@@ -107,7 +218,10 @@ private:
 	pthread_t 	mixVideoThread;
 	pthread_cond_t  mixVideoCond;
 	pthread_mutex_t mixVideoMutex;
+	DWORD		mixVideoWaiting;
 	int		mixingVideo;
+	pthread_mutex_t tickMutex;
+	bool		refreshTick;
 	QWORD		ini;
 	Use		lstVideosUse;
 	VADProxy*	proxy;
@@ -116,6 +230,16 @@ private:
 	bool		displayNames;
 	
 	Properties	overlay;
+
+	CompositionStatsMap	compositionStats;
+	timeval			lastStats;
+	FrameScaler::Stats	lastScalerStats;
+	LabelCache::Stats	lastLabelStats;
+	MediaClock::Stats	lastClockStats;
+	EncoderThreads::Stats	lastEncoderStats;
+
+	EncoderGroups		encoderGroups;
+	pthread_mutex_t		encoderGroupsMutex;
 };
 
 #endif
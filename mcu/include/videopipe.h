@@ -11,6 +11,7 @@
 #include <pthread.h>
 #include "video.h"
 #include "framescaler.h"
+#include "videobuffer.h"
 
 class VideoPipe :
 	public VideoOutput,
@@ -28,9 +29,16 @@ public:
 	virtual int   StopVideoCapture();
 	/** VideoOutput */
 	virtual int NextFrame(BYTE *pic);
+	virtual int NextFrame(VideoBuffer* frame);
 	virtual void ClearFrame();
 	virtual int SetVideoSize(int width,int height);
 	int End();
+	//Publish an already scaled picture of the capture size, takes the caller reference
+	int  NextScaledFrame(VideoBuffer* frame);
+	//False if not capturing
+	bool GetCaptureSize(int &width,int &height);
+private:
+	int Publish(VideoBuffer* frame);
 private:
 
 	FrameScaler resizer;
@@ -40,12 +48,11 @@ private:
 	int inputHeight;
 	int videoSize;
 	int videoFPS;
-	int imgPos;
-	int imgNew;
 	int inited;
 	int capturing;
-	BYTE *imgBuffer[2];
-	BYTE *grabPic;
+	int canceled;
+	VideoBufferSlot	pending;
+	VideoBuffer*	grabbed;
 
 	pthread_mutex_t newPicMutex;
 	pthread_cond_t  newPicCond;
@@ -0,0 +1,75 @@
+/*
+ * File:   videopyramid.h
+ * Author: Sergio
+ *
+ * Created on 22 de octubre de 2026, 16:50
+ */
+
+#ifndef VIDEOPYRAMID_H
+#define	VIDEOPYRAMID_H
+
+#include <pthread.h>
+#include <vector>
+#include "config.h"
+#include "video.h"
+#include "videopipe.h"
+
+/*
+ * Hands each decoded picture to several video pipes of different sizes.
+ *	Levels are scaled from biggest to smallest and each one is scaled from
+ *	the smallest level already done that is at least as big and has the
+ *	same aspect ratio, so exact downscales use the box filter on a small
+ *	picture instead of scaling the whole input again. Levels with the same
+ *	size share the same picture.
+ */
+class VideoPyramid :
+	public VideoOutput
+{
+public:
+	struct Stats
+	{
+		QWORD	frames;		//Number of input pictures
+		QWORD	scaled;		//Levels scaled from the input
+		QWORD	fromLevel;	//Levels scaled from a bigger level
+		QWORD	shared;		//Levels sharing the picture of another one
+	};
+
+public:
+	VideoPyramid();
+	~VideoPyramid();
+
+	//Keeps the existing levels, so encoders grabbing from them are not affected
+	int Init(DWORD num);
+	int End();
+
+	DWORD		GetNumLevels();
+	VideoPipe*	GetLevel(DWORD num);
+	Stats		GetStats();
+
+	/** VideoOutput */
+	virtual int NextFrame(BYTE *pic);
+	virtual int NextFrame(VideoBuffer* frame);
+	virtual void ClearFrame();
+	virtual int SetVideoSize(int width,int height);
+
+private:
+	//Either the decoded picture or a packed one of the input size
+	int NextPicture(VideoBuffer* input,BYTE* pic);
+
+private:
+	struct Level
+	{
+		VideoPipe*	pipe;
+		FrameScaler*	scaler;
+	};
+	typedef std::vector<Level> Levels;
+
+private:
+	Levels		levels;
+	Stats		stats;
+	int		inputWidth;
+	int		inputHeight;
+	pthread_mutex_t	mutex;
+};
+
+#endif	/* VIDEOPYRAMID_H */
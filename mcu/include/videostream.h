@@ -7,8 +7,11 @@
 #include "rtpsession.h"
 #include "RTPSmoother.h"
 #include "video.h"
+#include "latencystats.h"
+#include "videoencodergroup.h"
 
-class VideoStream 
+class VideoStream :
+	public VideoEncoderGroup::Listener
 {
 public:
 	class Listener : public RTPSession::Listener
@@ -26,6 +29,7 @@ public:
 
 	int Init(VideoInput *input, VideoOutput *output);
 	void SetRemoteRateEstimator(RemoteRateEstimator* estimator);
+	void SetSharedEncoder(SharedVideoEncoder* encoder);
 	int SetVideoCodec(VideoCodec::Type codec,int mode,int fps,int bitrate,int intraPeriod,const Properties& properties);
 	int SetTemporalBitrateLimit(int bitrate);
 	int StartSending(char *sendVideoIp,int sendVideoPort,RTPMap& rtpMap);
@@ -46,6 +50,10 @@ public:
 	int IsSending()	  { return sendingVideo;  }
 	int IsReceiving() { return receivingVideo;}
 	MediaStatistics GetStatistics();
+	LatencyStats* GetLatencyStats()	{ return &latency;	}
+
+	//VideoEncoderGroup listener interface
+	virtual void onEncodedFrame(VideoEncoderGroup* group,VideoFrame* frame,DWORD sendingTime);
 	
 protected:
 	int SendVideo();
@@ -62,8 +70,10 @@ private:
 	//Los objectos gordos
 	VideoInput     	*videoInput;
 	VideoOutput 	*videoOutput;
+	SharedVideoEncoder *sharedEncoder;
 	RTPSession      rtp;
 	RTPSmoother	smoother;
+	LatencyStats	latency;
 
 	//Parametros del video
 	VideoCodec::Type videoCodec;		//Codec de envio
@@ -85,6 +95,7 @@ private:
 
 	//Controlamos si estamos mandando o no
 	bool	sendingVideo;	
+	bool	sendingShared;
 	bool 	receivingVideo;
 	bool	inited;
 	bool	sendFPU;
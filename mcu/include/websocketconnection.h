@@ -12,6 +12,7 @@
 #include "websockets.h"
 #include "http.h"
 #include "httpparser.h"
+#include "tcpreactor.h"
 
 
 class WebSocketFrameHeader
@@ -232,7 +233,8 @@ private:
 
 class WebSocketConnection :
 	public WebSocket,
-	public HTTPParser::Listener
+	public HTTPParser::Listener,
+	public TCPReactor::Connection
 {
 private:
 	class Frame
@@ -332,6 +334,12 @@ public:
 	virtual int on_headers_complete (HTTPParser*);
 	virtual int on_message_complete (HTTPParser*);
 
+	//Events from the shared reactor
+	virtual bool onReadable();
+	virtual bool onWritable();
+	virtual void onTick();
+	virtual void onClosed();
+
 	HTTPRequest* GetRequest() { return request; }
 protected:
 	void Start();
@@ -349,6 +357,7 @@ private:
 	pollfd ufds[1];
 	bool inited;
 	bool running;
+	bool reactor;
 
 	pthread_t thread;
 	pthread_mutex_t mutex;
@@ -382,6 +391,12 @@ private:
 	std::list<Frame*>  frames;
 	DWORD		   outgoingFramesLength;
 	Frame*		   pong;
+
+	std::string	   outResponse;
+	bool		   outUpgrade;
+	Frame*		   outFrame;
+	DWORD		   outPos;
+	timeval		   lastActivity;
 };
 
 #endif
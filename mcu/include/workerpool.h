@@ -0,0 +1,81 @@
+/*
+ * File:   workerpool.h
+ * Author: Sergio
+ *
+ * Created on 17 de octubre de 2026, 9:20
+ */
+
+#ifndef WORKERPOOL_H
+#define	WORKERPOOL_H
+
+#include <pthread.h>
+#include <vector>
+#include <list>
+#include "config.h"
+
+/*
+ * Shared pool of worker threads for splitting cpu bound work.
+ *	Run() queues a set of tasks and returns when all of them have been
+ *	executed, the calling thread executes the first one itself. If the
+ *	pool is not started tasks are executed on the calling thread.
+ */
+class WorkerPool
+{
+public:
+	class Task
+	{
+	public:
+		virtual ~Task() {}
+		virtual void Execute() = 0;
+	};
+public:
+	static WorkerPool& getInstance()
+	{
+		static WorkerPool pool;
+		return pool;
+	}
+
+public:
+	bool Start(int numWorkers = 0);
+	bool Stop();
+	bool IsRunning() const		{ return running;		}
+	DWORD GetNumWorkers() const	{ return threads.size();	}
+
+	void Run(Task* tasks[],DWORD num);
+
+private:
+	WorkerPool();
+	~WorkerPool();
+	//Non copyable
+	WorkerPool(WorkerPool const&);
+	void operator=(WorkerPool const&);
+
+private:
+	struct Batch
+	{
+		DWORD		pending;
+		pthread_cond_t	cond;
+	};
+	struct Job
+	{
+		Task*	task;
+		Batch*	batch;
+	};
+	typedef std::list<Job> Jobs;
+	typedef std::vector<pthread_t> Threads;
+
+private:
+	static void* run(void *par);
+	int Run();
+	void Done(Batch* batch);
+
+private:
+	bool		running;
+	Threads		threads;
+	Jobs		jobs;
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+};
+
+#endif	/* WORKERPOOL_H */
+
@@ -125,7 +125,7 @@ int RTPSmoother::SendFrame(MediaFrame* frame,DWORD duration)
 		MediaFrame::RtpPacketization* rtp = info[i];
 
 		//Create rtp packet
-		RTPPacketSched *packet = new RTPPacketSched(frame->GetType(),codec);
+		RTPPacketSched *packet = new(frame->GetType()) RTPPacketSched(frame->GetType(),codec);
 
 		//Make sure it is enought length
 		if (rtp->GetTotalLength()>packet->GetMaxMediaLength())
@@ -232,8 +232,35 @@ int RTPSmoother::Run()
 			//Exit
 			continue;
 
-		//Send it
-		session->SendPacket(*sched,sched->GetTimestamp());
+		//Packets to send on this go
+		RTPPacket* batch[RTPSession::MaxBatchSize];
+		DWORD num = 0;
+
+		//Add first
+		batch[num++] = sched;
+
+		//Send together the rest of packets of the frame that are already due
+		while (!sched->GetMark() && num<RTPSession::MaxBatchSize)
+		{
+			//Check next one
+			RTPPacketSched *next = queue.Peek();
+			//If there is none or it has to be paced
+			if (!next || getDifTime(&prev)/1000<next->GetSendingTime())
+				//Stop
+				break;
+			//Get it
+			sched = queue.Pop();
+			//Add it
+			batch[num++] = sched;
+		}
+
+		//Check if we have more than one
+		if (num>1)
+			//Flush them with a single call
+			session->SendPackets(batch,num);
+		else
+			//Send it
+			session->SendPacket(*sched,sched->GetTimestamp());
 
 		//Update sending time
 		sendingTime = sched->GetSendingTime();
@@ -265,8 +292,9 @@ int RTPSmoother::Run()
 				Log("-RTPSmoother lagging behind [enqueued:%d,frameTime:%u,sendingTime:%u]\n",queue.Length(),frameTime,sendingTime);
 		}
 
-		//DElete it
-		delete(sched);
+		//DElete them
+		for (DWORD i=0;i<num;++i)
+			delete(batch[i]);
 	}
 
 	Log("<RTPSmoother run\n");
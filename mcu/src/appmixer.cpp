@@ -33,12 +33,17 @@ AppMixer::AppMixer()
 	lastMask = 0;
 	//No img
 	img = NULL;
+	//Nothing to display
+	updated = false;
 	//Clean popup
 	popUpShown = false;
 	popUpX = 0;
 	popUpY = 0;
 	popUpWidth = 0;
 	popUpHeight = 0;
+	//No damage tiles
+	tilesX = 0;
+	tilesY = 0;
 	
 	//No modifiers for key/mouse
 	modifiers = 0;
@@ -163,6 +168,16 @@ int AppMixer::Reset()
 		//null it
 		canvas = NULL;
 	}
+	//Free converters
+	for (Converters::iterator it=converters.begin();it!=converters.end();++it)
+		//Free it
+		sws_freeContext(it->second);
+	//Clear them
+	converters.clear();
+	//No damage
+	damaged.clear();
+	tilesX = 0;
+	tilesY = 0;
 }
 
 int AppMixer::WebsocketConnectRequest(int partId,const std::wstring &name,WebSocket *ws,bool isPresenter,const std::string &to)
@@ -554,6 +569,14 @@ int AppMixer::SetSize(int width,int height)
 		
 		//And create a new one
 		canvas = new Canvas(width,height);
+
+		//Create damage tiles
+		tilesX = (width+TileSize-1)/TileSize;
+		tilesY = (height+TileSize-1)/TileSize;
+		//All damaged, so first update is fully converted
+		damaged.assign(tilesX*tilesY,true);
+		//Display it on next update
+		updated = true;
 	}
 
 
@@ -567,6 +590,11 @@ int AppMixer::onFrameBufferUpdate(VNCViewer *viewer,int x, int y, int w, int h)
 	//UPdate vnc server frame buffer
 	server.FrameBufferUpdate(viewer->GetFrameBuffer(),x,y,server.GetWidth(),x,y,w,h);
 
+	//Convert it on finished update
+	Damage(x,y,w,h);
+	//Something has changed
+	updated = true;
+
 	return 1;
 }
 
@@ -575,6 +603,11 @@ int AppMixer::onGotCopyRectangle(VNCViewer *viewer, int src_x, int src_y, int w,
 	//Copy vnc server frame buffer rect to destination
 	server.CopyRect(viewer->GetFrameBuffer(),src_x, src_y, w, h, dest_x, dest_y);
 
+	//Convert it on finished update
+	Damage(dest_x,dest_y,w,h);
+	//Something has changed
+	updated = true;
+
 	return 1;
 }
 
@@ -582,8 +615,8 @@ int AppMixer::onFinishedFrameBufferUpdate(VNCViewer *viewer)
 {
 	//Signal server
 	server.FrameBufferUpdateDone();
-	//Display image
-	return Display(viewer->GetFrameBuffer(),0,0,viewer->GetWidth(),viewer->GetHeight(),viewer->GetWidth());
+	//Display only the regions updated since last time
+	return DisplayDamaged(viewer->GetFrameBuffer(),viewer->GetWidth(),viewer->GetHeight(),viewer->GetWidth());
 }
 
 
@@ -592,137 +625,248 @@ int AppMixer::Display(const BYTE* frame,int x, int y, int width,int height, int
 	if (output)
 	{
 		Debug("-Display [x:%d,y:%d,width:%d,height:%d,lineSize:%d]\n",x,y,width, height, lineSize);
-		//Get server size
-		DWORD w = server.GetWidth();
-		DWORD h = server.GetHeight();
-		//Calc num pixels
-		DWORD numpixels = w*h;
 
-		//Alloc data
-		AVFrame* in = av_frame_alloc();
-		AVFrame* out = av_frame_alloc();
+		//Convert whole rect
+		if (!Convert(frame,x,y,width,height,lineSize))
+			//Error
+			return 0;
 
-		//Set in frame
-		in->data[0] = (BYTE*)frame;
+		//Draw overlays and send it
+		return Present(width,height);
+	}
 
-		//Set size
-		in->linesize[0] = lineSize*4;
-
-		//Alloc data
-		out->data[0] = img + x + y*w;
-		out->data[1] = img + numpixels + x/2 + y*w/4;
-		out->data[2] = img + numpixels*5/4  + x/2 + y*w/4;
-
-		//Set size for planes
-		out->linesize[0] = w;
-		out->linesize[1] = w/2;
-		out->linesize[2] = w/2;
-
-		// Create YUV rescaller cotext
-		SwsContext* sws = sws_alloc_context();
-
-		// Set property's of YUV rescaller context
-		av_opt_set_defaults(sws);
-		av_opt_set_int(sws, "srcw",       width			,AV_OPT_SEARCH_CHILDREN);
-		av_opt_set_int(sws, "srch",       height		,AV_OPT_SEARCH_CHILDREN);
-		av_opt_set_int(sws, "src_format", AV_PIX_FMT_RGBA	,AV_OPT_SEARCH_CHILDREN);
-		av_opt_set_int(sws, "dstw",       width			,AV_OPT_SEARCH_CHILDREN);
-		av_opt_set_int(sws, "dsth",       height		,AV_OPT_SEARCH_CHILDREN);
-		av_opt_set_int(sws, "dst_format", AV_PIX_FMT_YUV420P	,AV_OPT_SEARCH_CHILDREN);
-		av_opt_set_int(sws, "sws_flags",  SWS_FAST_BILINEAR	,AV_OPT_SEARCH_CHILDREN);
-	
-		// Init YUV rescaller context
-		if (sws_init_context(sws, NULL, NULL) < 0)
+	return 1;
+}
+
+int AppMixer::DisplayDamaged(const BYTE* frame,int width,int height,int lineSize)
+{
+	//Check we have output and image
+	if (!output || !img)
+		//Nothing
+		return 1;
+
+	//If the frame buffer has not changed, don't send a new frame so the screen encoders can skip it
+	if (!updated)
+		//Nothing
+		return 1;
+
+	//Displayed
+	updated = false;
+
+	DWORD num = 0;
+
+	//For each tile row
+	for (int j=0;j<tilesY;++j)
+	{
+		//For each tile
+		for (int i=0;i<tilesX;++i)
 		{
-			//Clear context
-			sws_freeContext(sws);
-			//Set errror
-			return  Error("Couldn't init sws context\n");
+			//If it has not changed
+			if (!damaged[j*tilesX+i])
+				//Skip
+				continue;
+			//Get tile rect
+			int x = i*TileSize;
+			int y = j*TileSize;
+			int w = x+TileSize<width ? TileSize : width-x;
+			int h = y+TileSize<height ? TileSize : height-y;
+			//Check it is inside the frame buffer
+			if (w>0 && h>0)
+				//Convert only it
+				Convert(frame+(y*lineSize+x)*4,x,y,w,h,lineSize);
+			//Not damaged anymore
+			damaged[j*tilesX+i] = false;
+			//One more
+			num++;
 		}
+	}
+
+	Debug("-DisplayDamaged [tiles:%d,total:%d]\n",num,tilesX*tilesY);
+
+	//Draw overlays and send it
+	return Present(width,height);
+}
+
+void AppMixer::Damage(int x,int y,int width,int height)
+{
+	//Clip it
+	if (x<0) { width += x; x = 0; }
+	if (y<0) { height += y; y = 0; }
+
+	//Check size
+	if (width<=0 || height<=0 || !tilesX || !tilesY)
+		//Nothing
+		return;
+
+	//Get tiles covered
+	int i1 = x/TileSize;
+	int j1 = y/TileSize;
+	int i2 = (x+width-1)/TileSize;
+	int j2 = (y+height-1)/TileSize;
+
+	//Clip to image
+	if (i2>=tilesX) i2 = tilesX-1;
+	if (j2>=tilesY) j2 = tilesY-1;
+
+	//Mark them
+	for (int j=j1;j<=j2;++j)
+		for (int i=i1;i<=i2;++i)
+			damaged[j*tilesX+i] = true;
+}
+
+SwsContext* AppMixer::GetConverter(int width,int height)
+{
+	//Get key
+	DWORD key = width<<16 | height;
+
+	//Check if we already have one for that size
+	Converters::iterator it = converters.find(key);
 
-		//Convert
-		sws_scale(sws, in->data, in->linesize, 0, height, out->data, out->linesize);
+	//If found
+	if (it!=converters.end())
+		//Reuse it
+		return it->second;
 
-		//Clear context
-		sws_freeContext(sws);
+	// Create YUV rescaller cotext
+	SwsContext* sws = sws_getContext(width, height, AV_PIX_FMT_RGBA, width, height, AV_PIX_FMT_YUV420P, SWS_FAST_BILINEAR, 0, 0, 0);
 
-		//If we had canvas
-		if (canvas)
+	//Check
+	if (!sws)
+		//Error
+		return NULL;
+
+	//Store it
+	converters[key] = sws;
+
+	//Return it
+	return sws;
+}
+
+int AppMixer::Convert(const BYTE* frame,int x, int y, int width,int height, int lineSize)
+{
+	//Check we have image
+	if (!img)
+		//Nothing
+		return 0;
+
+	//Get server size
+	DWORD w = server.GetWidth();
+	DWORD h = server.GetHeight();
+	//Calc num pixels
+	DWORD numpixels = w*h;
+
+	//Get converter for this size
+	SwsContext* sws = GetConverter(width,height);
+
+	//Check
+	if (!sws)
+		//Set errror
+		return  Error("Couldn't init sws context\n");
+
+	//Set in frame
+	const BYTE* in[1] = { frame };
+	int inLineSize[1] = { lineSize*4 };
+
+	//Set out planes
+	BYTE* out[3] = {
+		img + x + y*w,
+		img + numpixels + x/2 + y*w/4,
+		img + numpixels*5/4  + x/2 + y*w/4
+	};
+	int outLineSize[3] = { (int)w, (int)w/2, (int)w/2 };
+
+	//Convert
+	sws_scale(sws, in, inLineSize, 0, height, out, outLineSize);
+
+	return 1;
+}
+
+int AppMixer::Present(int width,int height)
+{
+	//Get image size
+	DWORD iw = server.GetWidth();
+	DWORD numpixels = iw*server.GetHeight();
+
+	//If we had canvas
+	if (canvas)
+	{
+		//reset it
+		canvas->Reset();
+				
+		//Get editor name
+		std::wstring editor = server.GetEditorName();
+		
+		//If we got one
+		if (!editor.empty())
 		{
-			//reset it
-			canvas->Reset();
-					
-			//Get editor name
-			std::wstring editor = server.GetEditorName();
+			DWORD w = 180;
+			DWORD h = 36;
+			DWORD o = 16;		//Offset
+			DWORD m = 10;		//Margin
 			
-			//If we got one
-			if (!editor.empty())
+			//Ensure the window is big enought
+			if (width>w+m && height>h+m)
 			{
-				DWORD w = 180;
-				DWORD h = 36;
-				DWORD o = 16;		//Offset
-				DWORD m = 10;		//Margin
+				//Add offset
+				int x = lastX+o;
+				int y = lastY+o;
+				//Check overlay would be out of the image
+				if (x+w+m>=width)
+					//Move to the left of the pointer or width
+					x = fmin(lastX,width)-o-w;
+				//If we are not big enought
+				if (x<0)
+					//Reset to margin
+					x = m-1;
+				//Check overlay would be out of the image
+				if (y+h+m>=height)
+					//Move position to up the last pointer of height
+					y = fmin(lastY,height)-o-h;
+				//If we are not big enought
+				if (y<0)
+					//Reset to margin
+					y = m-1;
 				
-				//Ensure the window is big enought
-				if (width>w+m && height>h+m)
-				{
-					//Add offset
-					int x = lastX+o;
-					int y = lastY+o;
-					//Check overlay would be out of the image
-					if (x+w+m>=width)
-						//Move to the left of the pointer or width
-						x = fmin(lastX,width)-o-w;
-					//If we are not big enought
-					if (x<0)
-						//Reset to margin
-						x = m-1;
-					//Check overlay would be out of the image
-					if (y+h+m>=height)
-						//Move position to up the last pointer of height
-						y = fmin(lastY,height)-o-h;
-					//If we are not big enought
-					if (y<0)
-						//Reset to margin
-						y = m-1;
-					
-					//Set text properties
-					Properties properties;
-					properties.SetProperty("fillColor"	,"#11FF1140");
-					properties.SetProperty("strokeColor"	,"#40FF40A0");
-					properties.SetProperty("color"		,"black");
-					properties.SetProperty("font"		,"Verdana");
-					properties.SetProperty("fontSize"	,18);
-					
-					Debug("-RenderText [x:%d,y:%d,w:%d,h:%d,width:%d,height:%d,lastX:%d,lastY:%d]\n",x,y,w,h,width,height,lastX,lastY);
-					
-					//Draw editor name on canvas
-					canvas->RenderText(editor,x,y,w,h,properties);
-
-					//Draw it on top of the image
-					canvas->Draw(img,img);
-				}
+				//Set text properties
+				Properties properties;
+				properties.SetProperty("fillColor"	,"#11FF1140");
+				properties.SetProperty("strokeColor"	,"#40FF40A0");
+				properties.SetProperty("color"		,"black");
+				properties.SetProperty("font"		,"Verdana");
+				properties.SetProperty("fontSize"	,18);
 				
-				//Check coordinates
-				if (lastX<width-1 && lastY<height-1)
-				{
-					//Draw mouse pointer
-					out->data[0][lastY*out->linesize[0]+lastX] = 0;
-					out->data[0][(lastY+1)*out->linesize[0]+lastX] = 0;
-					out->data[0][lastY*out->linesize[0]+lastX+1] = 0;
-					out->data[0][(lastY+1)*out->linesize[0]+lastX+1] = 0;
-					out->data[1][lastY/2*out->linesize[1]+lastX/2] = 0;
-					out->data[2][lastY/2*out->linesize[2]+lastX/2] = 0;
-				}
+				Debug("-RenderText [x:%d,y:%d,w:%d,h:%d,width:%d,height:%d,lastX:%d,lastY:%d]\n",x,y,w,h,width,height,lastX,lastY);
+				
+				//Draw editor name on canvas
+				canvas->RenderText(editor,x,y,w,h,properties);
+
+				//Draw it on top of the image
+				canvas->Draw(img,img);
+				//Convert it again on next update to remove it
+				Damage(x,y,w,h);
+			}
+			
+			//Check coordinates
+			if (lastX<width-1 && lastY<height-1)
+			{
+				//Get planes
+				BYTE* py = img;
+				BYTE* pu = img+numpixels;
+				BYTE* pv = img+numpixels*5/4;
+				//Draw mouse pointer
+				py[lastY*iw+lastX] = 0;
+				py[(lastY+1)*iw+lastX] = 0;
+				py[lastY*iw+lastX+1] = 0;
+				py[(lastY+1)*iw+lastX+1] = 0;
+				pu[lastY/2*iw/2+lastX/2] = 0;
+				pv[lastY/2*iw/2+lastX/2] = 0;
+				//Convert it again on next update to remove it
+				Damage(lastX,lastY,2,2);
 			}
 		}
-		//Put new frame
-		output->NextFrame(img);
-
-		//Free frames
-		av_frame_free(&in);
-		av_frame_free(&out);
 	}
+	//Put new frame
+	output->NextFrame(img);
 
 	return 1;
 }
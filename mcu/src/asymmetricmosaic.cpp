@@ -24,14 +24,14 @@ AsymmetricMosaic::~AsymmetricMosaic()
 * Update
 * 	Update slot of mosaic with given image
 *****************************/
-int AsymmetricMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool keepAspectRatio)
+int AsymmetricMosaic::Update(int pos, BYTE *imageY, BYTE *imageU, BYTE *imageV, int imgStride, int imgWidth, int imgHeight,bool keepAspectRatio)
 {
 	//Check it's in the mosaic
 	if (pos<0 || pos >= numSlots)
 		return 0;
 	
 	//Check size
-	if (!image && !imgHeight && !imgHeight)
+	if (!imageY && !imgHeight && !imgHeight)
 		//Clean position
 		return Clean(pos);
 
@@ -41,11 +41,6 @@ int AsymmetricMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,b
 	BYTE *lineaY;
 	BYTE *lineaU;
 	BYTE *lineaV;
-	
-	DWORD imgNumPixels = imgHeight*imgWidth;
-	BYTE *imageY = image;
-	BYTE *imageU  = imageY  + imgNumPixels;
-	BYTE *imageV  = imageU + imgNumPixels/4;
 
 	//Get positions
 	int left = GetLeft(pos);
@@ -73,7 +68,7 @@ int AsymmetricMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,b
 
 			//Go to next
 			lineaY += mosaicTotalWidth;
-			imageY += imgWidth;
+			imageY += imgStride;
 		}
 
 		//Copy U and V planes
@@ -87,20 +82,20 @@ int AsymmetricMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,b
 			lineaU += mosaicTotalWidth/2;
 			lineaV += mosaicTotalWidth/2;
 
-			imageU += imgWidth/2;
-			imageV += imgWidth/2;
+			imageU += imgStride/2;
+			imageV += imgStride/2;
 		}
 	} else if ((imgWidth > 0) && (imgHeight > 0)) {
 		//Set resize
-		resizer[pos]->SetResize(imgWidth,imgHeight,imgWidth,mosaicWidth,mosaicHeight,mosaicTotalWidth,keepAspectRatio);
+		resizer[pos]->SetResize(imgWidth,imgHeight,imgStride,mosaicWidth,mosaicHeight,mosaicTotalWidth,keepAspectRatio);
 		//Resize and set to slot
 		resizer[pos]->Resize(imageY,imageU,imageV,lineaY,lineaU,lineaV);
 	} else {
 		return 0;
 	}
 
-	//We have changed
-	SetChanged();
+	//Only this slot has changed
+	SetChanged(pos);
 
 	return 1;
 }
@@ -158,8 +153,8 @@ int AsymmetricMosaic::Clean(int pos)
 		lineaV += mosaicTotalWidth/2;
 	}
 
-	//We have changed
-	SetChanged();
+	//Only this slot has changed
+	SetChanged(pos);
 
 	return 1;
 }
@@ -1,6 +1,8 @@
 #include <signal.h>
 #include <sys/time.h>
 #include <stdio.h>
+#include <algorithm>
+#include <functional>
 #include "log.h"
 #include "tools.h"
 #include "audiomixer.h"
@@ -20,6 +22,13 @@ AudioMixer::AudioMixer()
 	numSidebars = 0;
 	//NO vad by default
 	vad = false;
+	//Mix everyone
+	maxSpeakers = 0;
+	//No clock ticks yet
+	pendingTicks = 0;
+	//Create objects
+	pthread_mutex_init(&tickMutex,0);
+	pthread_cond_init(&tickCond,0);
 }
 
 /***********************
@@ -28,6 +37,25 @@ AudioMixer::AudioMixer()
 ************************/
 AudioMixer::~AudioMixer()
 {
+	//Clean objects
+	pthread_mutex_destroy(&tickMutex);
+	pthread_cond_destroy(&tickCond);
+}
+
+/***********************
+* onTick
+*	Called from the media clock thread
+************************/
+void AudioMixer::onTick(QWORD deadline,DWORD ticks)
+{
+	//Lock
+	pthread_mutex_lock(&tickMutex);
+	//Add them
+	pendingTicks += ticks;
+	//Wake up mixing thread
+	pthread_cond_signal(&tickCond);
+	//Unlock
+	pthread_mutex_unlock(&tickMutex);
 }
 
 /***********************************
@@ -56,38 +84,43 @@ void *AudioMixer::startMixingAudio(void *par)
 ************************************/
 int AudioMixer::MixAudio()
 {
-	timeval  tv;
 	DWORD step = 10;
-	QWORD prev = 0;
 
 	//Logeamos
 	Log(">MixAudio\n");
 
-	//Init ts
-	getUpdDifTime(&tv);
+	//Get ticks from the media clock
+	MediaClock::getInstance().AddListener(this,step);
 
 	//Mientras estemos mezclando
 	while(mixingAudio)
 	{
-		//Get processing time
-		DWORD proc = getDifTime(&tv)-prev;
+		//Lock
+		pthread_mutex_lock(&tickMutex);
 
-		//check we have not to hurry up
-		if (proc<step*1000)
-			//Wait until next to process again minus process time
-			msleep(step*1000-proc);
+		//Wait for next tick
+		while (mixingAudio && !pendingTicks)
+			//Wait
+			pthread_cond_wait(&tickCond,&tickMutex);
 
-		//Block list
-		lstAudiosUse.WaitUnusedAndLock();
+		//Get elapsed ticks, more than one if we are late
+		DWORD ticks = pendingTicks;
+		//Reset them
+		pendingTicks = 0;
+
+		//Unlock
+		pthread_mutex_unlock(&tickMutex);
 
-		//Get new time
-		QWORD curr = getDifTime(&tv);
+		//Check if we have been stopped
+		if (!mixingAudio)
+			//Exit
+			break;
 
-		//Get num samples at desired rate for the time difference
-		DWORD numSamples = (curr*rate)/1000000-(prev*rate)/1000000;
+		//Block list
+		lstAudiosUse.WaitUnusedAndLock();
 
-		//Update curr
-		prev = curr;
+		//Get num samples at desired rate for the elapsed ticks, exact so it does not drift
+		DWORD numSamples = ticks*step*rate/1000;
 
 		//At most the maximum
 		if (numSamples>Sidebar::MIXER_BUFFER_SIZE)
@@ -113,21 +146,84 @@ int AudioMixer::MixAudio()
 			//Get the samples from the fifo
 			audio->len = audio->output->GetSamples(audio->buffer,numSamples);
 			//Clean rest
-			memset(audio->buffer+audio->len,0,Sidebar::MIXER_BUFFER_SIZE-audio->len);
+			memset(audio->buffer+audio->len,0,(Sidebar::MIXER_BUFFER_SIZE-audio->len)*sizeof(SWORD));
 			//Get VAD value
 			audio->vad = audio->output->GetVAD(numSamples);
+			//Nothing to mix if it has no samples
+			audio->mixed = audio->len>0;
+			//If we have to select the speakers
+			if (maxSpeakers && vad)
+			{
+				//Talking ones and the ones held after talking are candidates
+				if (audio->vad || audio->hold)
+					//Favour the ones already selected so close ones do not keep swapping
+					speakers.push_back(Speaker(audio->hold ? audio->vad+audio->vad/2 : audio->vad,audio));
+				//Only selected ones are mixed
+				audio->mixed = false;
+			}
+		}
+
+		//If there are too many speakers
+		if (speakers.size()>maxSpeakers)
+			//Get the loudest ones first
+			std::nth_element(speakers.begin(),speakers.begin()+maxSpeakers,speakers.end(),std::greater<Speaker>());
+
+		//Update selection
+		for (DWORD i=0; i<speakers.size(); ++i)
+		{
+			//Get source
+			AudioSource *audio = speakers[i].second;
+			//If it is one of the loudest
+			if (i<maxSpeakers)
+			{
+				//Mix it
+				audio->mixed = true;
+				//Keep it while talking and for a while after, so it does not flap around the vad threshold
+				audio->hold = audio->vad ? SpeakerHold : (audio->hold>ticks*step ? audio->hold-ticks*step : 0);
+			} else {
+				//Replaced by a louder one
+				audio->hold = 0;
+			}
+		}
+		//Clean for next time
+		speakers.clear();
+
+		//Mix selected sources on each sidebar
+		for(Audios::iterator it = audios.begin(); it != audios.end(); ++it)
+		{
+			//Get the source
+			AudioSource *audio = it->second;
+			//Check it has to be mixed
+			if (!audio->mixed)
+				//Next
+				continue;
 			//For each sidepaf
 			for (Sidebars::iterator sit = sidebars.begin(); sit!=sidebars.end(); ++sit)
 			{
 				//Get sidebar
 				Sidebar * sidebar = sit->second;
 				//Check if participant is in the sidebar
-				if (sidebar->HasParticipant(id))
+				if (sidebar->HasParticipant(it->first))
 					//Mix it
-					sidebar->Update(id,audio->buffer,audio->len);
+					sidebar->Update(it->first,audio->buffer,audio->len);
 			}
 		}
 
+		//For each sidebar
+		for (Sidebars::iterator sit=sidebars.begin(); sit!=sidebars.end(); ++sit)
+			//Saturate the sum
+			sit->second->Mix(numSamples);
+
+		//Check which listeners want shared frames
+		for(Audios::iterator it = audios.begin(); it != audios.end(); ++it)
+			//Update it
+			UpdateSharedEncoder(it->second);
+
+		//Encode each sidebar mix once for all its listeners
+		for (SharedEncoders::iterator it = encoders.begin(); it!=encoders.end(); ++it)
+			//Encode
+			(*it)->Encode((*it)->GetSidebar()->GetBuffer(),numSamples);
+
 		// Second pass: Calculate this stream's output
 		for(Audios::iterator it = audios.begin(); it != audios.end(); it++)
 		{
@@ -148,31 +244,33 @@ int AudioMixer::MixAudio()
 			//And the audio buffer for participant
 			SWORD *buffer = audio->buffer;
 
-			//Check if we are also an input to the sidebar to remove ound sound
-			if (audio->sidebar->HasParticipant(id))
+			//Check if we are also mixed in the sidebar to remove ound sound
+			if (audio->mixed && audio->sidebar->HasParticipant(id))
 			{
-				//Get pointers to buffer
-				__m128i* b = (__m128i*) buffer;
-				__m128i* m = (__m128i*) mixed;
-
-				//Sum 8 each time
-				for(DWORD n = (audio->len + 7) >> 3; n != 0; --n,++b,++m)
-				{
-					//Load data in SSE registers
-					__m128i xmm1 = _mm_load_si128(m);
-					__m128i xmm2 = _mm_load_si128(b);
-					//SSE2 sum
-					_mm_store_si128(b,  _mm_sub_epi16(xmm1,xmm2));
-				}
-				//Check length
-				if (audio->len<numSamples)
-					//Copy the rest
-					memcpy(buffer+audio->len,mixed+audio->len,(numSamples-audio->len)*sizeof(SWORD));
+				//If it was getting shared frames, give it the mix not encoded in them yet, so it goes on from the last frame boundary
+				if (audio->sharing && audio->encoder)
+					//Put them
+					audio->input->PutRecordedSamples(audio->encoder->GetCarry(),audio->encoder->GetCarryLength());
+				//Not sharing
+				audio->sharing = false;
+				//Remove our samples from the sum, rest of buffer is zero
+				audio->sidebar->MixMinus(buffer,buffer,numSamples);
 				//Put the output
 				audio->input->PutSamples(buffer,numSamples);
+			} else if (audio->encoder) {
+				//Get encoder
+				SharedEncoder* encoder = audio->encoder;
+				//Send it the already encoded frames, input encodes the samples queued before them first
+				for (DWORD i=0; i<encoder->GetNumFrames(); ++i)
+					//Put it
+					audio->input->PutFrame(encoder->GetFrame(i),encoder->GetFrameLength(i));
+				//Sharing
+				audio->sharing = true;
 			} else {
 				//Copy everything as it is
 				audio->input->PutSamples((SWORD*)mixed,numSamples);
+				//Not sharing
+				audio->sharing = false;
 			}
 		}
 
@@ -180,6 +278,9 @@ int AudioMixer::MixAudio()
 		lstAudiosUse.Unlock();
 	}
 
+	//No more ticks
+	MediaClock::getInstance().RemoveListener(this);
+
 	//Logeamos
 	Log("<MixAudio\n");
 
@@ -193,6 +294,20 @@ int AudioMixer::SetCalculateVAD(bool vad)
 	this->vad = vad;	
 }
 
+int AudioMixer::SetMaxSpeakers(DWORD num)
+{
+	Log("-AudioMixer::SetMaxSpeakers() | [num:%d]\n",num);
+	//Speaker selection needs vad
+	if (num && !vad)
+		Log("-AudioMixer::SetMaxSpeakers() | vad not enabled, mixing everyone\n");
+	//Store
+	maxSpeakers = num;
+	//Avoid allocating while mixing
+	speakers.reserve(256);
+	//OK
+	return 1;
+}
+
 
 /***********************
 * Init
@@ -204,7 +319,10 @@ int AudioMixer::Init(const Properties &properties)
 	this->rate = properties.GetProperty("rate",8000);
 
 	//Log
-	Log("-Init audio mixer [rate: %d]\n",vad,rate);
+	Log("-Init audio mixer [rate: %d]\n",rate);
+
+	//Set max number of speakers mixed
+	SetMaxSpeakers(properties.GetProperty("maxSpeakers",0));
 
 	// Estamos mzclando
 	mixingAudio = true;
@@ -236,6 +354,13 @@ int AudioMixer::End()
 		//Terminamos la mezcla
 		mixingAudio = 0;
 
+		//Lock
+		pthread_mutex_lock(&tickMutex);
+		//Wake up mixing thread
+		pthread_cond_signal(&tickCond);
+		//Unlock
+		pthread_mutex_unlock(&tickMutex);
+
 		//Y esperamos
 		pthread_join(mixAudioThread,NULL);
 	}
@@ -252,6 +377,9 @@ int AudioMixer::End()
 		//Terminamos
 		audio->input->End();
 		audio->output->End();
+
+		//Release shared encoder
+		ReleaseSharedEncoder(audio);
 		
 		//SI esta borramos los objetos
 		delete audio->input;
@@ -314,6 +442,13 @@ int AudioMixer::CreateMixer(int id)
 	memset(audio->buffer, 0, Sidebar::MIXER_BUFFER_SIZE*sizeof(SWORD));
 	audio->len = 0;
 	audio->vad = 0;
+	audio->mixed = false;
+	audio->hold = 0;
+	//No shared encoding
+	audio->encoder = NULL;
+	audio->sharing = false;
+	audio->sharedVersion = 0;
+	audio->sharedSidebar = NULL;
 
 	//Y lo a�adimos a la lista
 	audios[id] = audio;
@@ -457,6 +592,9 @@ int AudioMixer::DeleteMixer(int id)
 	//Lo quitamos de la lista
 	audios.erase(it);
 
+	//Release shared encoder
+	ReleaseSharedEncoder(audio);
+
 	//Desprotegemos la lista
 	lstAudiosUse.Unlock();
 
@@ -679,6 +817,10 @@ int AudioMixer::DeleteSidebar(int sidebarId)
 		if (ita->second->sidebar == sidebar)
 			//Set to null
 			ita->second->sidebar = NULL;
+		//If it was sharing its encoded mix
+		if (ita->second->encoder && ita->second->encoder->GetSidebar()==sidebar)
+			//Release it
+			ReleaseSharedEncoder(ita->second);
 	}
 
 	//Remove sidebar
@@ -715,3 +857,201 @@ DWORD AudioMixer::GetVAD(int id)
 	//Return VAD acumulated
 	return acuVAD;
 }
+
+void AudioMixer::UpdateSharedEncoder(AudioSource* audio)
+{
+	AudioCodec::Type codec;
+	DWORD rate;
+	DWORD numFrameSamples;
+	Properties properties;
+
+	//Get shared encoding request version
+	DWORD version = audio->input->GetSharedVersion();
+
+	//If neither the request or the sidebar have changed
+	if (version==audio->sharedVersion && audio->sidebar==audio->sharedSidebar)
+		//Nothing to do
+		return;
+
+	//Store them
+	audio->sharedVersion = version;
+	audio->sharedSidebar = audio->sidebar;
+
+	//Release previous one
+	ReleaseSharedEncoder(audio);
+
+	//Check if participant has a mix and wants shared frames
+	if (!audio->sidebar || !audio->input->GetSharedEncoding(codec,rate,numFrameSamples,properties))
+		//Done
+		return;
+
+	//Find an encoder for the same mix
+	for (SharedEncoders::iterator it = encoders.begin(); it!=encoders.end(); ++it)
+	{
+		//If it is the same
+		if ((*it)->IsFor(audio->sidebar,codec,rate,numFrameSamples,properties))
+		{
+			//Use it
+			audio->encoder = *it;
+			//One more
+			audio->encoder->refs++;
+			//Done
+			return;
+		}
+	}
+
+	//Create new one
+	SharedEncoder* encoder = new SharedEncoder(audio->sidebar,codec,rate,numFrameSamples,properties);
+
+	//Init it from the mixer rate
+	if (!encoder->Init(this->rate))
+	{
+		//Delete it
+		delete(encoder);
+		//Participant will encode by itself
+		Error("-AudioMixer::UpdateSharedEncoder() | could not create shared encoder [codec:%s,rate:%d]\n",AudioCodec::GetNameFor(codec),rate);
+		//Done
+		return;
+	}
+
+	Log("-AudioMixer::UpdateSharedEncoder() | new shared encoder [codec:%s,rate:%d,samples:%d]\n",AudioCodec::GetNameFor(codec),rate,numFrameSamples);
+
+	//One reference
+	encoder->refs = 1;
+	//Add it
+	encoders.push_back(encoder);
+	//Set it
+	audio->encoder = encoder;
+}
+
+void AudioMixer::ReleaseSharedEncoder(AudioSource* audio)
+{
+	//Get encoder
+	SharedEncoder* encoder = audio->encoder;
+
+	//Check it
+	if (!encoder)
+		//Nothing to do
+		return;
+
+	//Not used anymore
+	audio->encoder = NULL;
+	//Its pending samples are not for us anymore
+	audio->sharing = false;
+
+	//If still used by other listeners
+	if (--encoder->refs)
+		//Done
+		return;
+
+	Log("-AudioMixer::ReleaseSharedEncoder() | deleting shared encoder\n");
+
+	//Remove from list
+	encoders.remove(encoder);
+	//Delete it
+	delete(encoder);
+}
+
+/***********************
+* SharedEncoder
+*	Encodes a sidebar mix once for all its listeners
+************************/
+AudioMixer::SharedEncoder::SharedEncoder(Sidebar* sidebar,AudioCodec::Type codec,DWORD rate,DWORD numFrameSamples,const Properties& properties)
+{
+	//Store parameters
+	this->sidebar = sidebar;
+	this->codec = codec;
+	this->rate = rate;
+	this->numFrameSamples = numFrameSamples;
+	this->properties = properties;
+	//No encoder yet
+	encoder = NULL;
+	numFrames = 0;
+	carryLen = 0;
+	refs = 0;
+}
+
+AudioMixer::SharedEncoder::~SharedEncoder()
+{
+	//Check encoder
+	if (encoder)
+		//Delete it
+		delete(encoder);
+}
+
+bool AudioMixer::SharedEncoder::Init(DWORD nativeRate)
+{
+	//Create encoder
+	encoder = AudioCodecFactory::CreateEncoder(codec,properties);
+
+	//Check it
+	if (!encoder)
+		//Error
+		return Error("-SharedEncoder::Init() | could not create audio codec [codec:%d]\n",codec);
+
+	//Must produce the same frames than the listeners ones
+	if (encoder->TrySetRate(rate)!=rate || encoder->numFrameSamples!=numFrameSamples || numFrameSamples>4096)
+		//Error
+		return Error("-SharedEncoder::Init() | encoder does not match listener [rate:%d,samples:%d]\n",rate,numFrameSamples);
+
+	//Open transrater from the mixer rate
+	transrater.Open(nativeRate,rate);
+
+	//OK
+	return true;
+}
+
+bool AudioMixer::SharedEncoder::IsFor(Sidebar* sidebar,AudioCodec::Type codec,DWORD rate,DWORD numFrameSamples,const Properties& properties)
+{
+	//Same mix, codec, rate, ptime and configuration
+	return this->sidebar==sidebar && this->codec==codec && this->rate==rate && this->numFrameSamples==numFrameSamples && this->properties==properties;
+}
+
+DWORD AudioMixer::SharedEncoder::Encode(SWORD* samples,DWORD len)
+{
+	SWORD resampled[4096];
+	DWORD resampledSize = 4096;
+	SWORD frame[4096];
+
+	//No frames yet
+	numFrames = 0;
+
+	//If we need to transrate
+	if (transrater.IsOpen())
+	{
+		//Transrate
+		if (!transrater.ProcessBuffer(samples, len, resampled, &resampledSize))
+			//Error
+			return Error("-SharedEncoder::Encode() | could not transrate\n");
+		//Swith input parameters to resample ones
+		samples = resampled;
+		len = resampledSize;
+	}
+
+	//Keep what was not encoded before, for listeners that stop getting our frames
+	carryLen = pending.peek(carry,pending.length());
+
+	//If it does not fit
+	if (pending.length()+len>pending.size())
+		//Clean
+		pending.clear();
+
+	//Enqueue
+	pending.push(samples,len);
+
+	//Encode all complete frames
+	while (numFrames<MaxFrames && pending.length()>=numFrameSamples)
+	{
+		//Get samples
+		pending.pop(frame,numFrameSamples);
+		//Encode them
+		int res = encoder->Encode(frame,numFrameSamples,frames[numFrames],MTU);
+		//If ok
+		if (res>0)
+			//Store length
+			lengths[numFrames++] = res;
+	}
+
+	//Return number of frames
+	return numFrames;
+}
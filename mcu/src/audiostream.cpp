@@ -428,21 +428,40 @@ int AudioStream::SendAudio()
 	//Get ts multiplier
 	float multiplier = clock/rate;
 
+	//Try to get frames encoded once for all the listeners with same codec
+	audioInput->StartSharedEncoding(audioCodec,rate,codec->numFrameSamples,audioProperties);
+
+	//Not getting shared frames yet
+	bool sharing = false;
+
 	//Mientras tengamos que capturar
 	while(sendingAudio)
 	{
+		DWORD shared = 0;
+
 		//Incrementamos el tiempo de envio
 		frameTime += codec->numFrameSamples*multiplier;
 
-		//Capturamos 
-		if (audioInput->RecBuffer(recBuffer,codec->numFrameSamples)==0)
+		//Capturamos, we may get an already encoded frame
+		if (audioInput->RecFrame(recBuffer,codec->numFrameSamples,packet.GetMediaData(),packet.GetMaxMediaLength(),shared)==0)
 		{
 			Log("-sendingAudio cont\n");
 			continue;
 		}
 
-		//Lo codificamos
-		int len = codec->Encode(recBuffer,codec->numFrameSamples,packet.GetMediaData(),packet.GetMaxMediaLength());
+		//If we have stopped getting shared frames
+		if (sharing && !shared)
+		{
+			//Reset it in place, so it does not predict from the audio it encoded before sharing
+			if (!codec->Reset())
+				Debug("-SendAudio back to private encoder, could not reset it [codec:%d]\n",audioCodec);
+		}
+
+		//Store state
+		sharing = shared>0;
+
+		//Lo codificamos si no lo esta ya
+		int len = shared ? shared : codec->Encode(recBuffer,codec->numFrameSamples,packet.GetMediaData(),packet.GetMaxMediaLength());
 
 		//Comprobamos que ha sido correcto
 		if(len<=0)
@@ -460,6 +479,9 @@ int AudioStream::SendAudio()
 
 	Log("-SendAudio cleanup[%d]\n",sendingAudio);
 
+	//Stop getting shared frames
+	audioInput->StopSharedEncoding();
+
 	//Paramos de grabar por si acaso
 	audioInput->StopRecording();
 
@@ -485,6 +507,18 @@ MediaStatistics AudioStream::GetStatistics()
 	stats.numSendPackets	= rtp.GetNumSendPackets();
 	stats.totalRecvBytes	= rtp.GetTotalRecvBytes();
 	stats.totalSendBytes	= rtp.GetTotalSendBytes();
+	//Fill batching stats
+	const RTPSession::BatchStats& batch = rtp.GetBatchStats();
+	stats.recvBatches	= batch.recvBatches;
+	stats.recvBatchedPackets= batch.recvBatchedPackets;
+	stats.maxRecvBatch	= batch.maxRecvBatch;
+	stats.sendBatches	= batch.sendBatches;
+	stats.sendBatchedPackets= batch.sendBatchedPackets;
+	stats.maxSendBatch	= batch.maxSendBatch;
+	//Fill packet pool stats
+	RTPPacketPool::Stats pool = RTPPacketPool::GetStats(MediaFrame::Audio);
+	stats.poolHitRate	= pool.allocs ? pool.hits*100/pool.allocs : 0;
+	stats.poolResidentBytes	= pool.resident*pool.blockSize;
 
 	//Return it
 	return stats;
@@ -9,6 +9,7 @@
 #include "log.h"
 #include "tools.h"
 #include "acumulator.h"
+#include "screencontent.h"
 
 VideoEncoderWorker::VideoEncoderWorker() 
 {
@@ -16,6 +17,8 @@ VideoEncoderWorker::VideoEncoderWorker()
 	input = NULL;
 	encoding = false;
 	sendFPU = false;
+	screen = false;
+	keepAlive = 0;
 	codec = (VideoCodec::Type)-1;
 	//Create objects
 	pthread_mutex_init(&mutex,NULL);
@@ -51,6 +54,10 @@ int VideoEncoderWorker::SetCodec(VideoCodec::Type codec,int mode,int fps,int bit
 	this->bitrateLimitCount	= fps;
         //Store properties
         this->properties  = properties;
+	//Check if encoding screen content, so static frames are not sent
+	this->screen	  = properties.GetProperty("screen",false);
+	//Max time without sending a frame when nothing changes
+	this->keepAlive	  = properties.GetProperty("screen.keepalive",1000);
 
 	//Get width and height
 	width = GetWidth(mode);
@@ -139,14 +146,17 @@ int VideoEncoderWorker::Encode()
 	timeval first;
 	timeval prev;
 	timeval lastFPU;
+	timeval lastEncoded;
 	
 	DWORD num = 0;
+	DWORD skipped = 0;
 	QWORD overslept = 0;
 
 	Acumulator bitrateAcu(1000);
 	Acumulator fpsAcu(1000);
+	ScreenContent content;
 
-	Log(">SendVideo [width:%d,size:%d,bitrate:%d,fps:%d,intra:%d]\n",width,height,bitrate,fps,intraPeriod);
+	Log(">SendVideo [width:%d,size:%d,bitrate:%d,fps:%d,intra:%d,screen:%d]\n",width,height,bitrate,fps,intraPeriod,screen);
 
 	//Creamos el encoder
 	VideoEncoder* videoEncoder = VideoCodecFactory::CreateEncoder(codec,properties);
@@ -185,6 +195,9 @@ int VideoEncoderWorker::Encode()
 	//Fist FPU
 	gettimeofday(&lastFPU,NULL);
 
+	//No frame encoded yet
+	gettimeofday(&lastEncoded,NULL);
+
 	//Started
 	Log("-Sending video\n");
 
@@ -199,6 +212,35 @@ int VideoEncoderWorker::Encode()
 			//Exit
 			continue;
 
+		//If encoding screen content
+		if (screen)
+		{
+			//We must send it if an intra is requested or nothing has been sent for a while
+			bool forced = sendFPU || getDifTime(&lastEncoded)/1000>=keepAlive;
+			//If the input has not got a new picture
+			if (!forced && !input->IsFrameChanged())
+			{
+				//Nothing has changed on screen
+				skipped++;
+				//Wait for next
+				continue;
+			}
+			//Intra must not have coarser static blocks
+			if (sendFPU)
+				//All will be changed
+				content.Reset();
+			//Check which macroblocks have changed, as mixer may send same picture again
+			if (!content.Update(pic,width,height) && !forced)
+			{
+				//Same picture
+				skipped++;
+				//Wait for next
+				continue;
+			}
+			//Don't spend bits on static blocks and be coarser while scrolling
+			videoEncoder->SetRegionOfInterest(content.GetMap(),content.GetMacroblocksWidth(),content.GetMacroblocksHeight(),content.IsBurst() ? BurstQP : ChangedQP,StaticQP);
+		}
+
 		//Check if we need to send intra
 		if (sendFPU)
 		{
@@ -258,6 +300,9 @@ int VideoEncoderWorker::Encode()
 			//Next
 			continue;
 
+		//Update last encoded time
+		getUpdDifTime(&lastEncoded);
+
 		//Increase frame counter
 		fpsAcu.Update(getTime()/1000,1);
 
@@ -360,7 +405,7 @@ int VideoEncoderWorker::Encode()
 		delete videoEncoder;
 
 	//Salimos
-	Log("<SendVideo [%d]\n",encoding);
+	Log("<SendVideo [%d,sent:%d,skipped:%d]\n",encoding,num,skipped);
 }
 
 int VideoEncoderWorker::SetMediaListener(MediaFrame::Listener *listener)
@@ -0,0 +1,139 @@
+/*
+ * File:   encoderthreads.cpp
+ * Author: Sergio
+ *
+ * Created on 23 de octubre de 2026, 11:20
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include "log.h"
+#include "encoderthreads.h"
+
+DWORD EncoderThreads::GetWanted(DWORD width,DWORD height)
+{
+	//Get number of pixels
+	DWORD pixels = width*height;
+
+	//Up to vga a single core is enough
+	if (pixels<=640*480)
+		return 1;
+	//720p
+	if (pixels<=1280*720)
+		return 2;
+	//1080p, with padding
+	if (pixels<=1920*1088)
+		return 4;
+	//Bigger ones
+	return 8;
+}
+
+EncoderThreads::EncoderThreads(DWORD cores)
+{
+	//No stats
+	memset(&stats,0,sizeof(stats));
+	//If not set
+	if (!cores)
+		//One per core
+		cores = sysconf(_SC_NPROCESSORS_ONLN);
+	//Store budget, at least one
+	stats.cores = cores ? cores : 1;
+	//Create mutex
+	pthread_mutex_init(&mutex,NULL);
+}
+
+EncoderThreads::~EncoderThreads()
+{
+	//Destroy mutex
+	pthread_mutex_destroy(&mutex);
+}
+
+DWORD EncoderThreads::Acquire(DWORD width,DWORD height,DWORD wanted)
+{
+	//If not set
+	if (!wanted)
+		//Get it from size
+		wanted = GetWanted(width,height);
+
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Always the encoding thread itself
+	DWORD granted = 1;
+
+	//If there are free cores
+	if (stats.used<stats.cores)
+		//Get as much as available
+		granted = wanted<stats.cores-stats.used ? wanted : stats.cores-stats.used;
+
+	//Check
+	if (!granted)
+		//At least one
+		granted = 1;
+
+	//If limited by budget
+	if (granted<wanted)
+		//One more
+		stats.limited++;
+
+	//Reserve them
+	stats.used += granted;
+	stats.encoders++;
+
+	Debug("-EncoderThreads::Acquire() [%dx%d,wanted:%d,granted:%d,used:%d,cores:%d]\n",width,height,wanted,granted,stats.used,stats.cores);
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	return granted;
+}
+
+void EncoderThreads::Release(DWORD threads)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Give them back
+	stats.used = stats.used>threads ? stats.used-threads : 0;
+	//One less
+	if (stats.encoders)
+		stats.encoders--;
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
+
+void EncoderThreads::OnEncoded(QWORD time)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//One more
+	stats.frames++;
+	stats.encodeTime += time;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
+
+void EncoderThreads::SetCores(DWORD cores)
+{
+	Log("-EncoderThreads::SetCores() [cores:%d]\n",cores);
+
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Set new budget, only applied to the encoders opened from now on
+	stats.cores = cores ? cores : 1;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
+
+EncoderThreads::Stats EncoderThreads::GetStats()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Copy
+	Stats copy = stats;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	return copy;
+}
@@ -71,9 +71,9 @@ int EventStreamingHandler::CreateEvenSource(const char* source)
 }
 int EventStreamingHandler::WriteEvent(const char* source,const char* type,const char* msg,va_list params)
 {
-	char aux[1024];
+	char aux[3072];
 	//print
-	vsprintf(aux, msg, params);
+	vsnprintf(aux, sizeof(aux), msg, params);
 	//Write msg
 	return WriteEvent(source,type,aux);
 }
@@ -249,7 +249,7 @@ RTPTimedPacket* FECDecoder::Recover()
 					}
 				}
 				//Create new video packet
-				RTPTimedPacket* packet = new RTPTimedPacket(MediaFrame::Video,pt);
+				RTPTimedPacket* packet = new(MediaFrame::Video) RTPTimedPacket(MediaFrame::Video,pt);
 				//Set values
 				packet->SetP(p);
 				packet->SetX(x);
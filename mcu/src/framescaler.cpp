@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <list>
 #include "log.h"
 extern "C" {
 #include <libswscale/swscale.h>
@@ -10,6 +12,295 @@ extern "C" {
 #include <libavutil/opt.h>
 #include <libavutil/common.h>
 }
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Scaler context cache
+ *	Contexts are not reentrant, so scalers take them out of the cache
+ *	while in use and give them back when their size changes.
+ */
+struct ScalerKey
+{
+	int srcWidth;
+	int srcHeight;
+	int dstWidth;
+	int dstHeight;
+	int flags;
+
+	bool operator==(const ScalerKey& other) const
+	{
+		return srcWidth==other.srcWidth && srcHeight==other.srcHeight && dstWidth==other.dstWidth && dstHeight==other.dstHeight && flags==other.flags;
+	}
+};
+
+struct CachedScaler
+{
+	ScalerKey		key;
+	struct SwsContext*	ctx;
+};
+
+typedef std::list<CachedScaler> CachedScalers;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+//Most recently used first
+static CachedScalers cache;
+static FrameScaler::Stats stats = {0};
+static DWORD maxCached = 64;
+
+static struct SwsContext* GetCachedContext(const ScalerKey& key)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Find a free one for that size
+	for (CachedScalers::iterator it=cache.begin();it!=cache.end();++it)
+	{
+		//If found
+		if (it->key==key)
+		{
+			//Get it
+			struct SwsContext* ctx = it->ctx;
+			//It is ours now
+			cache.erase(it);
+			//Reused
+			stats.reused++;
+			stats.cached = cache.size();
+			//Unlock
+			pthread_mutex_unlock(&mutex);
+			//Done
+			return ctx;
+		}
+	}
+
+	//We will create a new one
+	stats.created++;
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//Create new context
+	struct SwsContext* ctx = sws_alloc_context();
+
+	//Check
+	if (!ctx)
+		//Exit
+		return NULL;
+
+	// Set property's of context
+	av_opt_set_defaults(ctx);
+	av_opt_set_int(ctx, "srcw",       key.srcWidth		,AV_OPT_SEARCH_CHILDREN);
+	av_opt_set_int(ctx, "srch",       key.srcHeight		,AV_OPT_SEARCH_CHILDREN);
+	av_opt_set_int(ctx, "src_format", AV_PIX_FMT_YUV420P	,AV_OPT_SEARCH_CHILDREN);
+	av_opt_set_int(ctx, "dstw",       key.dstWidth		,AV_OPT_SEARCH_CHILDREN);
+	av_opt_set_int(ctx, "dsth",       key.dstHeight		,AV_OPT_SEARCH_CHILDREN);
+	av_opt_set_int(ctx, "dst_format", AV_PIX_FMT_YUV420P	,AV_OPT_SEARCH_CHILDREN);
+	av_opt_set_int(ctx, "sws_flags",  key.flags		,AV_OPT_SEARCH_CHILDREN);
+
+	// Init context
+	if (sws_init_context(ctx, NULL, NULL) < 0)
+	{
+		//Free context
+		sws_freeContext(ctx);
+		// Exit
+		return NULL;
+	}
+
+	//Done
+	return ctx;
+}
+
+static void PutCachedContext(const ScalerKey& key,struct SwsContext* ctx)
+{
+	CachedScaler cached;
+	//Set it
+	cached.key = key;
+	cached.ctx = ctx;
+
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Add it first
+	cache.push_front(cached);
+
+	//If we have too much
+	while (cache.size()>maxCached)
+	{
+		//Free least recently used one
+		sws_freeContext(cache.back().ctx);
+		//Remove it
+		cache.pop_back();
+	}
+
+	//Update
+	stats.cached = cache.size();
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
+
+FrameScaler::Stats FrameScaler::GetStats()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Copy them
+	Stats copy = stats;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+	//Return them
+	return copy;
+}
+
+void FrameScaler::SetMaxCached(DWORD num)
+{
+	Log("-FrameScaler::SetMaxCached() | [num:%d]\n",num);
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Set it
+	maxCached = num;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
+
+/*
+ * Box filter downscales
+ *	Each output pixel is the rounded average of a factor x factor block.
+ */
+static void Box2(const BYTE* src,int srcStride,BYTE* dst,int dstStride,int width,int height)
+{
+	for (int j=0; j<height; ++j)
+	{
+		//Get rows
+		const BYTE* r0 = src+j*2*srcStride;
+		const BYTE* r1 = r0+srcStride;
+		BYTE* out = dst+j*dstStride;
+		int i = 0;
+#ifdef __SSE2__
+		const __m128i mask = _mm_set1_epi16(0x00FF);
+		const __m128i two = _mm_set1_epi16(2);
+		//8 pixels each time
+		for (; i+8<=width; i+=8)
+		{
+			//Load 16 pixels from each row
+			__m128i a = _mm_loadu_si128((const __m128i*)(r0+i*2));
+			__m128i b = _mm_loadu_si128((const __m128i*)(r1+i*2));
+			//Sum each pair on both rows
+			__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a,mask),_mm_srli_epi16(a,8)),_mm_add_epi16(_mm_and_si128(b,mask),_mm_srli_epi16(b,8)));
+			//Round and divide
+			sum = _mm_srli_epi16(_mm_add_epi16(sum,two),2);
+			//Store
+			_mm_storel_epi64((__m128i*)(out+i),_mm_packus_epi16(sum,sum));
+		}
+#endif
+		//Rest of pixels
+		for (; i<width; ++i)
+			out[i] = (r0[i*2]+r0[i*2+1]+r1[i*2]+r1[i*2+1]+2)>>2;
+	}
+}
+
+static void Box3(const BYTE* src,int srcStride,BYTE* dst,int dstStride,int width,int height,WORD* row)
+{
+	for (int j=0; j<height; ++j)
+	{
+		//Get rows
+		const BYTE* r0 = src+j*3*srcStride;
+		const BYTE* r1 = r0+srcStride;
+		const BYTE* r2 = r1+srcStride;
+		BYTE* out = dst+j*dstStride;
+		int i = 0;
+#ifdef __SSE2__
+		const __m128i zero = _mm_setzero_si128();
+		//Sum the three rows, 16 pixels each time
+		for (; i+16<=width*3; i+=16)
+		{
+			//Load
+			__m128i a = _mm_loadu_si128((const __m128i*)(r0+i));
+			__m128i b = _mm_loadu_si128((const __m128i*)(r1+i));
+			__m128i c = _mm_loadu_si128((const __m128i*)(r2+i));
+			//Sum low and high halves
+			__m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a,zero),_mm_unpacklo_epi8(b,zero)),_mm_unpacklo_epi8(c,zero));
+			__m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a,zero),_mm_unpackhi_epi8(b,zero)),_mm_unpackhi_epi8(c,zero));
+			//Store
+			_mm_storeu_si128((__m128i*)(row+i),lo);
+			_mm_storeu_si128((__m128i*)(row+i+8),hi);
+		}
+#endif
+		//Rest of columns
+		for (; i<width*3; ++i)
+			row[i] = r0[i]+r1[i]+r2[i];
+		//Sum each three columns, divide by 9 rounding
+		for (i=0; i<width; ++i)
+			out[i] = (row[i*3]+row[i*3+1]+row[i*3+2]+4)/9;
+	}
+}
+
+static void Box4(const BYTE* src,int srcStride,BYTE* dst,int dstStride,int width,int height)
+{
+	for (int j=0; j<height; ++j)
+	{
+		//Get rows
+		const BYTE* r0 = src+j*4*srcStride;
+		const BYTE* r1 = r0+srcStride;
+		const BYTE* r2 = r1+srcStride;
+		const BYTE* r3 = r2+srcStride;
+		BYTE* out = dst+j*dstStride;
+		int i = 0;
+#ifdef __SSE2__
+		const __m128i mask = _mm_set1_epi16(0x00FF);
+		const __m128i ones = _mm_set1_epi16(1);
+		const __m128i eight = _mm_set1_epi32(8);
+		//8 pixels each time
+		for (; i+8<=width; i+=8)
+		{
+			__m128i sum[2];
+			//For each 16 input columns
+			for (int k=0; k<2; ++k)
+			{
+				//Load
+				__m128i a = _mm_loadu_si128((const __m128i*)(r0+i*4+k*16));
+				__m128i b = _mm_loadu_si128((const __m128i*)(r1+i*4+k*16));
+				__m128i c = _mm_loadu_si128((const __m128i*)(r2+i*4+k*16));
+				__m128i d = _mm_loadu_si128((const __m128i*)(r3+i*4+k*16));
+				//Sum each pair on the four rows
+				__m128i ab = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a,mask),_mm_srli_epi16(a,8)),_mm_add_epi16(_mm_and_si128(b,mask),_mm_srli_epi16(b,8)));
+				__m128i cd = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(c,mask),_mm_srli_epi16(c,8)),_mm_add_epi16(_mm_and_si128(d,mask),_mm_srli_epi16(d,8)));
+				//Sum adjacent pairs on 32 bits, round and divide
+				sum[k] = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_add_epi16(ab,cd),ones),eight),4);
+			}
+			//Pack and store
+			__m128i res = _mm_packs_epi32(sum[0],sum[1]);
+			_mm_storel_epi64((__m128i*)(out+i),_mm_packus_epi16(res,res));
+		}
+#endif
+		//Rest of pixels
+		for (; i<width; ++i)
+		{
+			DWORD acu = 8;
+			//Sum block
+			for (int k=0; k<4; ++k)
+				acu += r0[i*4+k]+r1[i*4+k]+r2[i*4+k]+r3[i*4+k];
+			//Divide
+			out[i] = acu>>4;
+		}
+	}
+}
+
+static void Box(int factor,const BYTE* src,int srcStride,BYTE* dst,int dstStride,int width,int height,WORD* row)
+{
+	switch (factor)
+	{
+		case 2:
+			Box2(src,srcStride,dst,dstStride,width,height);
+			break;
+		case 3:
+			Box3(src,srcStride,dst,dstStride,width,height,row);
+			break;
+		case 4:
+			Box4(src,srcStride,dst,dstStride,width,height);
+			break;
+	}
+}
 
 FrameScaler::FrameScaler()
 {
@@ -22,6 +313,8 @@ FrameScaler::FrameScaler()
 	resizeDstAdjustedHeight = 0;
 	resizeDstAdjustedWidth  = 0;
 	resizeDstLineWidth = 0;
+	resizeSrcLineWidth = 0;
+	resizeKeepAspectRatio = true;
 
 	//tmp buffer
 	tmpWidth  	= 0;
@@ -32,6 +325,12 @@ FrameScaler::FrameScaler()
 	tmpU		= NULL;
 	tmpV		= NULL;
 
+	//Box filter
+	boxEnabled	= true;
+	boxFactor	= 0;
+	boxRow		= NULL;
+	boxRowSize	= 0;
+
 	// Bicubic by default 
 	resizeFlags	= SWS_BICUBIC;
 }
@@ -41,10 +340,29 @@ FrameScaler::~FrameScaler()
 	if (tmpBuffer)
 		//free
 		free(tmpBuffer);
-	//If we got a context
-	if (resizeCtx)
-		//Closse context
-		sws_freeContext(resizeCtx);
+	//Free box row
+	if (boxRow)
+		//free
+		free(boxRow);
+	//Give back context
+	ReleaseContext();
+}
+
+void FrameScaler::ReleaseContext()
+{
+	//Check we have one
+	if (!resizeCtx)
+		//Nothing to do
+		return;
+
+	//Get key for it
+	ScalerKey key = {resizeWidth,resizeHeight,resizeDstAdjustedWidth,resizeDstAdjustedHeight,resizeFlags};
+
+	//Give it back to the cache
+	PutCachedContext(key,resizeCtx);
+
+	//Not ours anymore
+	resizeCtx = NULL;
 }
 
 int FrameScaler::SetResize(int srcWidth,int srcHeight,int srcLineWidth,int dstWidth,int dstHeight,int dstLineWidth,bool keepAspectRatio)
@@ -52,39 +370,22 @@ int FrameScaler::SetResize(int srcWidth,int srcHeight,int srcLineWidth,int dstWi
 	// Check Size
 	if (!srcWidth || !srcHeight || !srcLineWidth || !dstWidth || !dstHeight || !dstLineWidth)
 	{
-		//If we got a context
-		if (resizeCtx)
-			//Closse context
-			sws_freeContext(resizeCtx);
-		// No valid context
-		resizeCtx = NULL;
+		//Give back the context
+		ReleaseContext();
+		//No box filter either
+		boxFactor = 0;
 		//Exit
 		return 0;
 	}
 
 	// Check if we already have a scaler for this
-	if (resizeCtx && (resizeWidth==srcWidth) && (srcHeight==resizeHeight) && (dstWidth==resizeDstWidth) && (dstHeight==resizeDstHeight))
+	if ((resizeCtx || boxFactor) && (resizeWidth==srcWidth) && (srcHeight==resizeHeight) && (dstWidth==resizeDstWidth) && (dstHeight==resizeDstHeight)
+		&& (srcLineWidth==resizeSrcLineWidth) && (dstLineWidth==resizeDstLineWidth) && (keepAspectRatio==resizeKeepAspectRatio))
 		//Done
 		return 1;
 
-	//If we already got a context
-	if (resizeCtx)
-		//Closse context
-		sws_freeContext(resizeCtx);
-
-	// Create new context
-	if (!(resizeCtx = sws_alloc_context()))
-		// Exit 
-		return 0;
-
-	// Set values
-	resizeWidth		= srcWidth;
-	resizeHeight		= srcHeight;
-	resizeDstWidth		= dstWidth;
-	resizeDstHeight		= dstHeight;
-	resizeDstLineWidth	= dstLineWidth;
-	resizeDstAdjustedWidth  = dstWidth;
-	resizeDstAdjustedHeight = dstHeight;
+	int adjustedWidth  = dstWidth;
+	int adjustedHeight = dstHeight;
 
 	//Check aspect ratio flag
 	if (keepAspectRatio)
@@ -104,8 +405,8 @@ int FrameScaler::SetResize(int srcWidth,int srcHeight,int srcLineWidth,int dstWi
 			// |       |                   |       |
 			// ------------------------------------
 			//Recaultulate weight
-			resizeDstAdjustedWidth  = dstHeight*srcRatio;
-			resizeDstAdjustedHeight = dstHeight;
+			adjustedWidth  = dstHeight*srcRatio;
+			adjustedHeight = dstHeight;
 		} else if (srcRatio>dstRatio) {
 			//Put horizontal scroll bars
 			// -------------------------------------
@@ -119,30 +420,66 @@ int FrameScaler::SetResize(int srcWidth,int srcHeight,int srcLineWidth,int dstWi
 			// |                                   |
 			// -------------------------------------
 			//Recaultulate weight
-			resizeDstAdjustedWidth  = dstWidth;
-			resizeDstAdjustedHeight = dstWidth/srcRatio;
+			adjustedWidth  = dstWidth;
+			adjustedHeight = dstWidth/srcRatio;
 		}
 	}
-	
-	// Set property's of context
-	av_opt_set_defaults(resizeCtx);
-	av_opt_set_int(resizeCtx, "srcw",       srcWidth		,AV_OPT_SEARCH_CHILDREN);
-	av_opt_set_int(resizeCtx, "srch",       srcHeight		,AV_OPT_SEARCH_CHILDREN);
-	av_opt_set_int(resizeCtx, "src_format", AV_PIX_FMT_YUV420P	,AV_OPT_SEARCH_CHILDREN);
-	av_opt_set_int(resizeCtx, "dstw",       resizeDstAdjustedWidth	,AV_OPT_SEARCH_CHILDREN);
-	av_opt_set_int(resizeCtx, "dsth",       resizeDstAdjustedHeight	,AV_OPT_SEARCH_CHILDREN);
-	av_opt_set_int(resizeCtx, "dst_format", AV_PIX_FMT_YUV420P	,AV_OPT_SEARCH_CHILDREN);
-	av_opt_set_int(resizeCtx, "sws_flags",  resizeFlags		,AV_OPT_SEARCH_CHILDREN);
-	
-	// Init context
-	if (sws_init_context(resizeCtx, NULL, NULL) < 0)
+
+	//Check if it is an exact downscale we can do with the box filter, chroma must be exact too
+	int factor = 0;
+	for (int n=2; boxEnabled && n<=4 && !factor; ++n)
+		if (srcWidth==adjustedWidth*n && srcHeight==adjustedHeight*n && !(adjustedWidth&1) && !(adjustedHeight&1))
+			factor = n;
+
+	//If we don't need a scaler or it is for a different size
+	if (resizeCtx && (factor || resizeWidth!=srcWidth || resizeHeight!=srcHeight || resizeDstAdjustedWidth!=adjustedWidth || resizeDstAdjustedHeight!=adjustedHeight))
+		//Give it back to the cache
+		ReleaseContext();
+
+	// Set values
+	resizeWidth		= srcWidth;
+	resizeHeight		= srcHeight;
+	resizeDstWidth		= dstWidth;
+	resizeDstHeight		= dstHeight;
+	resizeDstLineWidth	= dstLineWidth;
+	resizeSrcLineWidth	= srcLineWidth;
+	resizeKeepAspectRatio	= keepAspectRatio;
+	resizeDstAdjustedWidth  = adjustedWidth;
+	resizeDstAdjustedHeight = adjustedHeight;
+	boxFactor		= factor;
+
+	// Set values for line sizes
+	resizeSrc[0] = srcLineWidth;
+	resizeSrc[1] = srcLineWidth/2;
+	resizeSrc[2] = srcLineWidth/2;
+
+	//If using the box filter
+	if (boxFactor)
 	{
-		//Free context
-		sws_freeContext(resizeCtx);
-		//Nullify it
-		resizeCtx = NULL;
-		// Exit 
-		return Error("Couldn't init sws context");
+		//Check if we need a bigger row for the 3:1 one
+		if (boxFactor==3 && boxRowSize<srcWidth)
+		{
+			//Free old one
+			if (boxRow)
+				free(boxRow);
+			//Allocate it
+			boxRow = (WORD*)malloc32(srcWidth*sizeof(WORD));
+			//Store size
+			boxRowSize = srcWidth;
+		}
+		//Done, no scaler or tmp buffer needed
+		return 1;
+	}
+
+	//If we don't have a scaler yet
+	if (!resizeCtx)
+	{
+		//Get key
+		ScalerKey key = {resizeWidth,resizeHeight,resizeDstAdjustedWidth,resizeDstAdjustedHeight,resizeFlags};
+		//Get one from the cache or create it
+		if (!(resizeCtx = GetCachedContext(key)))
+			// Exit
+			return Error("Couldn't init sws context");
 	}
 
 	//to use MM2 we need the width and heinght to be multiple of 32
@@ -150,20 +487,22 @@ int FrameScaler::SetResize(int srcWidth,int srcHeight,int srcLineWidth,int dstWi
 	tmpHeight = (resizeDstAdjustedHeight/32 +1)*32;
 
 	//Get tmp buffer size
-	tmpBufferSize = tmpWidth*tmpHeight*3/2+FF_INPUT_BUFFER_PADDING_SIZE+32;
+	int size = tmpWidth*tmpHeight*3/2+FF_INPUT_BUFFER_PADDING_SIZE+32;
 
-	//Check if we had it already
-	if (tmpBuffer)
-		//Free it
-		free(tmpBuffer);
+	//Check if we have to allocate it
+	if (size>tmpBufferSize)
+	{
+		//Check if we had it already
+		if (tmpBuffer)
+			//Free it
+			free(tmpBuffer);
 
-	//Allocate it
-	tmpBuffer = (BYTE*)malloc32(tmpBufferSize);
+		//Allocate it
+		tmpBuffer = (BYTE*)malloc32(size);
+		//Store size
+		tmpBufferSize = size;
+	}
 
-	// Set values for line sizes
-	resizeSrc[0] = srcLineWidth;
-	resizeSrc[1] = srcLineWidth/2;
-	resizeSrc[2] = srcLineWidth/2;
 	/*resizeDst[0] = dstLineWidth;
 	resizeDst[1] = dstLineWidth/2;
 	resizeDst[2] = dstLineWidth/2;*/
@@ -176,7 +515,7 @@ int FrameScaler::SetResize(int srcWidth,int srcHeight,int srcLineWidth,int dstWi
 	tmpU = tmpY+tmpWidth*tmpHeight;
 	tmpV = tmpU+tmpWidth*tmpHeight/4;
 
-	// exit 
+	// exit
 	return 1;
 }
 
@@ -187,28 +526,34 @@ int FrameScaler::Resize(BYTE *srcY,BYTE *srcU,BYTE *srcV,BYTE *dstY, BYTE *dstU,
 	BYTE* dst[3];
 
 	// Check 
-	if (!resizeCtx)
+	if (!resizeCtx && !boxFactor)
 		//Error
 		return 0;
 
-	// Set pointers 
-	src[0] = srcY;
-	src[1] = srcU;
-	src[2] = srcV;
-	/*dst[0] = dstY;
-	dst[1] = dstU;
-	dst[2] = dstV;*/
-	dst[0] = tmpY;
-	dst[1] = tmpU;
-	dst[2] = tmpV;
-
-	// Resize frame 
-	sws_scale(resizeCtx, src, resizeSrc, 0, resizeHeight, dst, resizeDst);
-
 	//Get offsets due to vertical lines (mast be even)
 	DWORD x = (resizeDstWidth-resizeDstAdjustedWidth)/2 & ~1;
 	DWORD y = (resizeDstHeight-resizeDstAdjustedHeight)/2 & ~1;
 
+	//If it is an exact downscale
+	if (boxFactor)
+	{
+		//Scale directly into the destination
+		Box(boxFactor,srcY,resizeSrc[0],dstY+resizeDstLineWidth*y+x,resizeDstLineWidth,resizeDstAdjustedWidth,resizeDstAdjustedHeight,boxRow);
+		Box(boxFactor,srcU,resizeSrc[1],dstU+resizeDstLineWidth/2*y/2+x/2,resizeDstLineWidth/2,resizeDstAdjustedWidth/2,resizeDstAdjustedHeight/2,boxRow);
+		Box(boxFactor,srcV,resizeSrc[2],dstV+resizeDstLineWidth/2*y/2+x/2,resizeDstLineWidth/2,resizeDstAdjustedWidth/2,resizeDstAdjustedHeight/2,boxRow);
+	} else {
+		// Set pointers 
+		src[0] = srcY;
+		src[1] = srcU;
+		src[2] = srcV;
+		dst[0] = tmpY;
+		dst[1] = tmpU;
+		dst[2] = tmpV;
+
+		// Resize frame 
+		sws_scale(resizeCtx, src, resizeSrc, 0, resizeHeight, dst, resizeDst);
+	}
+
 	//Copy to destination
 	for (int i=0;i<resizeDstHeight;++i)
 	{
@@ -225,8 +570,9 @@ int FrameScaler::Resize(BYTE *srcY,BYTE *srcU,BYTE *srcV,BYTE *dstY, BYTE *dstU,
 				memset(dstY+resizeDstLineWidth*i,0,x);
 				memset(dstY+resizeDstLineWidth*i+x+resizeDstAdjustedWidth,0,resizeDstWidth-resizeDstAdjustedWidth-x);
 			}
-			//Copy image in the middle
-			memcpy(dstY+resizeDstLineWidth*i+x,tmpY+tmpWidth*(i-y),resizeDstAdjustedWidth);
+			//Copy image in the middle if not already there
+			if (!boxFactor)
+				memcpy(dstY+resizeDstLineWidth*i+x,tmpY+tmpWidth*(i-y),resizeDstAdjustedWidth);
 		}
 	}
 
@@ -253,9 +599,12 @@ int FrameScaler::Resize(BYTE *srcY,BYTE *srcU,BYTE *srcV,BYTE *dstY, BYTE *dstU,
 				memset(dstU+resizeDstLineWidth*i/2+x+resizeDstAdjustedWidth/2,(BYTE)-128,resizeDstWidth/2-resizeDstAdjustedWidth/2-x);
 				memset(dstV+resizeDstLineWidth*i/2+x+resizeDstAdjustedWidth/2,(BYTE)-128,resizeDstWidth/2-resizeDstAdjustedWidth/2-x);
 			}
-			//Copy
-			memcpy(dstU+resizeDstLineWidth*i/2+x,tmpU+tmpWidth*(i-y)/2,resizeDstAdjustedWidth/2);
-			memcpy(dstV+resizeDstLineWidth*i/2+x,tmpV+tmpWidth*(i-y)/2,resizeDstAdjustedWidth/2);
+			//Copy if not already there
+			if (!boxFactor)
+			{
+				memcpy(dstU+resizeDstLineWidth*i/2+x,tmpU+tmpWidth*(i-y)/2,resizeDstAdjustedWidth/2);
+				memcpy(dstV+resizeDstLineWidth*i/2+x,tmpV+tmpWidth*(i-y)/2,resizeDstAdjustedWidth/2);
+			}
 		}
 	}
 
@@ -264,17 +613,31 @@ int FrameScaler::Resize(BYTE *srcY,BYTE *srcU,BYTE *srcV,BYTE *dstY, BYTE *dstU,
 } 
 
 int FrameScaler::Resize(BYTE *src,DWORD srcWidth,DWORD srcHeight,BYTE *dst,DWORD dstWidth,DWORD dstHeight, bool keepAspectRatio)
+{
+	//If sizes are the same
+	if (srcWidth==dstWidth && srcHeight==dstHeight)
+	{
+		//Just copy
+		memcpy(dst,src,srcWidth*srcHeight*3/2);
+		//Done
+		return 1;
+	}
+
+	//Calc pointers
+	DWORD srcPixels = srcWidth*srcHeight;
+
+	//Resize packed planes
+	return Resize(src,src+srcPixels,src+srcPixels*5/4,srcWidth,srcWidth,srcHeight,dst,dstWidth,dstHeight,keepAspectRatio);
+}
+
+int FrameScaler::Resize(BYTE *srcY,BYTE *srcU,BYTE *srcV,DWORD srcStride,DWORD srcWidth,DWORD srcHeight,BYTE *dst,DWORD dstWidth,DWORD dstHeight,bool keepAspectRatio)
 {
 	//If sizes are the inot same
 	if (srcWidth!=dstWidth ||srcHeight!=dstHeight)
 	{
 		//Set resize with full image
-		SetResize(srcWidth,srcHeight,srcWidth,dstWidth,dstHeight,dstWidth,keepAspectRatio);
+		SetResize(srcWidth,srcHeight,srcStride,dstWidth,dstHeight,dstWidth,keepAspectRatio);
 		//Calc pointers
-		DWORD srcPixels = srcWidth*srcHeight;
-		BYTE *srcY = src;
-		BYTE *srcU = src+srcPixels;
-		BYTE *srcV = src+srcPixels*5/4;
 		DWORD dstPixels = dstWidth*dstHeight;
 		BYTE *dstY = dst;
 		BYTE *dstU = dst+dstPixels;
@@ -283,8 +646,18 @@ int FrameScaler::Resize(BYTE *src,DWORD srcWidth,DWORD srcHeight,BYTE *dst,DWORD
 		//Resize imgae
 		Resize(srcY,srcU,srcV,dstY,dstU,dstV);
 	} else {
-		//Just copy
-		memcpy(dst,src,srcWidth*srcHeight*3/2);
+		//Get packed chroma planes
+		BYTE *dstU = dst+dstWidth*dstHeight;
+		BYTE *dstV = dst+dstWidth*dstHeight*5/4;
+		//Copy each luma line
+		for (DWORD i=0;i<srcHeight;++i)
+			memcpy(dst+i*dstWidth,srcY+i*srcStride,dstWidth);
+		//And chroma ones
+		for (DWORD i=0;i<srcHeight/2;++i)
+		{
+			memcpy(dstU+i*dstWidth/2,srcU+i*srcStride/2,dstWidth/2);
+			memcpy(dstV+i*dstWidth/2,srcV+i*srcStride/2,dstWidth/2);
+		}
 	}
 
 	return 1;
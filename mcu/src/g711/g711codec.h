@@ -12,7 +12,7 @@ public:
 	virtual DWORD TrySetRate(DWORD rate)	{ return 8000;	}
 	virtual DWORD GetRate()			{ return 8000;	}
 	virtual DWORD GetClockRate()		{ return 8000;	}
-
+	virtual bool  Reset()			{ return true;	}
 };
 
 class PCMADecoder : public AudioDecoder
@@ -34,6 +34,7 @@ public:
 	virtual DWORD TrySetRate(DWORD rate)	{ return 8000;	}
 	virtual DWORD GetRate()			{ return 8000;	}
 	virtual DWORD GetClockRate()		{ return 8000;	}
+	virtual bool  Reset()			{ return true;	}
 };
 
 class PCMUDecoder : public AudioDecoder
@@ -5,6 +5,65 @@
 #include "log.h"
 #include "h264decoder.h"
 
+static void ReleasePictureBuffer(void *opaque, uint8_t *data)
+{
+	//Give back the decoder reference
+	((VideoBuffer*)opaque)->Release();
+}
+
+static int GetPictureBuffer(struct AVCodecContext *ctx, AVFrame *frame, int flags)
+{
+	//Only planar 4:2:0 pictures can be handed on
+	if (frame->format!=AV_PIX_FMT_YUV420P && frame->format!=AV_PIX_FMT_YUVJ420P)
+		//Use default ones
+		return avcodec_default_get_buffer2(ctx,frame,flags);
+
+	int width = frame->width;
+	int height = frame->height;
+	int align[AV_NUM_DATA_POINTERS];
+
+	//Get size with the padding needed by the decoder
+	avcodec_align_dimensions2(ctx,&width,&height,align);
+
+	//Luma stride aligned so the half chroma ones are aligned too
+	int stride = width;
+	for (int i=0;i<3;++i)
+	{
+		//Chroma alignment is for half the stride
+		int a = i ? align[i]*2 : align[i];
+		//Align
+		if (a>0)
+			stride = ((stride+a-1)/a)*a;
+	}
+
+	//Get a picture from the pool, the decoder keeps this reference until it is done with it
+	VideoBuffer* buffer = VideoBuffer::Create(frame->width,frame->height,stride,height);
+
+	//Wrap it
+	frame->buf[0] = av_buffer_create(buffer->GetData(),buffer->GetSize(),ReleasePictureBuffer,buffer,0);
+
+	//Check
+	if (!frame->buf[0])
+	{
+		//Give it back
+		buffer->Release();
+		//Error
+		return AVERROR(ENOMEM);
+	}
+
+	//Set planes
+	for (int i=0;i<3;++i)
+	{
+		frame->data[i] = buffer->GetPlane(i);
+		frame->linesize[i] = i ? stride/2 : stride;
+	}
+	frame->extended_data = frame->data;
+	//So we can find it back on the decoded picture
+	frame->opaque = buffer;
+
+	return 0;
+}
+
 //H264Decoder
 // 	Decodificador H264
 //
@@ -37,14 +96,21 @@ H264Decoder::H264Decoder()
 
 	//Alocamos el contxto y el picture
 	ctx = avcodec_alloc_context3(codec);
-	ctx->flags != CODEC_FLAG_EMU_EDGE;
+	//No edges around the pictures, so they can be used directly
+	ctx->flags |= CODEC_FLAG_EMU_EDGE;
 	picture = av_frame_alloc();
 
+	//Decode directly into pooled pictures if supported
+	if (codec->capabilities & CODEC_CAP_DR1)
+		ctx->get_buffer2 = GetPictureBuffer;
+
 	//Alocamos el buffer
 	bufSize = 1024*756*3/2;
 	buffer = (BYTE *)malloc(bufSize);
 	frame = NULL;
 	frameSize = 0;
+	framePacked = false;
+	current = NULL;
 	src = 0;
 	
 	//Lo abrimos
@@ -61,6 +127,8 @@ H264Decoder::~H264Decoder()
 		free(buffer);
 	if (frame)
 		free(frame);
+	if (current)
+		current->Release();
 	if (ctx)
 	{
 		avcodec_close(ctx);
@@ -356,14 +424,68 @@ int H264Decoder::Decode(BYTE *buffer,DWORD size)
 
 		int w = ctx->width;
 		int h = ctx->height;
-		int u = w*h;
-		int v = w*h*5/4;
-		int size = w*h*3/2;
+
+		//Release previous picture
+		if (current)
+			current->Release();
+		//Not packed yet
+		framePacked = false;
+
+		//Get pooled picture it was decoded into
+		VideoBuffer* buffer = (VideoBuffer*)picture->opaque;
+
+		//If it is ours and has the expected layout
+		if (buffer && picture->data[0]>=buffer->GetData() && picture->data[0]<buffer->GetData()+buffer->GetSize()
+			&& picture->linesize[0]==(int)buffer->GetStride() && picture->linesize[1]*2==picture->linesize[0])
+		{
+			//Get offset of the visible picture
+			DWORD offset = picture->data[0]-buffer->GetData();
+			//Set it
+			buffer->Crop(offset%buffer->GetStride(),offset/buffer->GetStride(),w,h);
+			//Hand it on without copying, the decoder will not write it anymore
+			buffer->AddRef();
+			current = buffer;
+			//Done
+			return 1;
+		}
+
+		//Get a packed one from the pool
+		current = VideoBuffer::Create(w,h);
+
+		//Copaamos  el Cy
+		for(int i=0;i<h;i++)
+			memcpy(current->GetPlane(0)+i*w,&picture->data[0][i*picture->linesize[0]],w);
+
+		//Y el Cr y Cb
+		for(int i=0;i<h/2;i++)
+		{
+			memcpy(current->GetPlane(1)+i*w/2,&picture->data[1][i*picture->linesize[1]],w/2);
+			memcpy(current->GetPlane(2)+i*w/2,&picture->data[2][i*picture->linesize[2]],w/2);
+		}
+	}
+	return 1;
+}
+
+BYTE* H264Decoder::GetFrame()
+{
+	//Check we have a picture
+	if (!current)
+		return NULL;
+
+	//If it is already packed
+	if (current->IsPacked())
+		//Use it
+		return current->GetData();
+
+	//Only pack it once for the callers that need it
+	if (!framePacked)
+	{
+		int size = current->GetWidth()*current->GetHeight()*3/2;
 
 		//Comprobamos el tama�o
 		if (size>frameSize)
 		{
-			Log("-Frame size %dx%d\n",w,h);
+			Log("-Frame size %dx%d\n",current->GetWidth(),current->GetHeight());
 			//Liberamos si habia
 			if(frame!=NULL)
 				free(frame);
@@ -371,19 +493,24 @@ int H264Decoder::Decode(BYTE *buffer,DWORD size)
 			frame = (BYTE*) malloc(size);
 			frameSize = size;
 		}
-		
 
-		//Copaamos  el Cy
-		for(int i=0;i<ctx->height;i++)
-			memcpy(&frame[i*w],&picture->data[0][i*picture->linesize[0]],w);
-
-		//Y el Cr y Cb
-		for(int i=0;i<ctx->height/2;i++)
-		{
-			memcpy(&frame[i*w/2+u],&picture->data[1][i*picture->linesize[1]],w/2);
-			memcpy(&frame[i*w/2+v],&picture->data[2][i*picture->linesize[2]],w/2);
-		}
+		//Copy it
+		current->CopyTo(frame);
+		//Packed
+		framePacked = true;
 	}
-	return 1;
+
+	return frame;
+}
+
+VideoBuffer* H264Decoder::GetBuffer()
+{
+	//Check we have a picture
+	if (!current)
+		return NULL;
+	//One reference more for the caller
+	current->AddRef();
+	//Return it
+	return current;
 }
 
@@ -15,7 +15,8 @@ public:
 	virtual int Decode(BYTE *in,DWORD len);
 	virtual int GetWidth()		{ return ctx->width;		};
 	virtual int GetHeight()		{ return ctx->height;		};
-	virtual BYTE* GetFrame()	{ return (BYTE *)frame;		};
+	virtual BYTE* GetFrame();
+	virtual VideoBuffer* GetBuffer();
 	virtual bool  IsKeyFrame()	{ return picture->key_frame;	};
 private:
 	AVCodec 	*codec;
@@ -26,6 +27,8 @@ private:
 	DWORD 		bufSize;
 	BYTE*		frame;
 	DWORD		frameSize;
+	bool		framePacked;
+	VideoBuffer*	current;
 	BYTE		src;
 };
 #endif
@@ -4,6 +4,8 @@
 #include <inttypes.h>
 #include "log.h"
 #include "h264encoder.h"
+#include "encoderthreads.h"
+#include "tools.h"
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -36,6 +38,8 @@ H264Encoder::H264Encoder(const Properties& properties)
 	format  = 0;
 	frame	= NULL;
 	pts	= 0;
+	offsets = NULL;
+	numOffsets = 0;
 
 	//No estamos abiertos
 	opened = false;
@@ -51,6 +55,16 @@ H264Encoder::H264Encoder(const Properties& properties)
 	//Check mode
 	streaming = properties.HasProperty("streaming");
 
+	//Fixed number of threads, 0 for automatic depending on size and core budget
+	wantedThreads = properties.GetProperty("h264.threads",0);
+	//Not got yet
+	threads = 0;
+
+	//No frames encoded
+	frames = 0;
+	encodeTime = 0;
+	maxEncodeTime = 0;
+
 	//Reste values
 	enc = NULL;
 }
@@ -65,10 +79,20 @@ H264Encoder::~H264Encoder()
 	if (enc)
 		//Close it
 		x264_encoder_close(enc);
+	//If we had threads
+	if (threads)
+	{
+		Log("-~H264Encoder [%dx%d,threads:%d,frames:%llu,avg:%llums,max:%llums]\n",width,height,threads,frames,frames ? encodeTime/frames/1000 : 0,maxEncodeTime/1000);
+		//Give them back
+		EncoderThreads::getInstance().Release(threads);
+	}
 	//If we have created a frame
 	if (frame)
 		//Delete it
 		delete(frame);
+	//Free quantizer offsets
+	if (offsets)
+		free(offsets);
 }
 
 /**********************
@@ -180,8 +204,11 @@ int H264Encoder::OpenCodec()
 		params.rc.i_vbv_buffer_size = bitrate;
 	}
 	params.rc.f_vbv_buffer_init = 0;
-	params.i_threads	    = 1; //0 is auto!!
-	params.b_sliced_threads	    = 0;
+	//Get threads from the core budget, 0 is auto on x264 and would use all cores!!
+	threads = EncoderThreads::getInstance().Acquire(width,height,wantedThreads);
+	params.i_threads	    = threads;
+	//Slice threads don't add frame delay, so keep low latency
+	params.b_sliced_threads	    = threads>1;
 	params.rc.i_lookahead       = 0;
 	params.i_sync_lookahead	    = 0;
 	params.i_bframe             = 0;
@@ -223,7 +250,12 @@ int H264Encoder::OpenCodec()
 
 	//Check it is correct
 	if (!enc)
+	{
+		//Give threads back
+		EncoderThreads::getInstance().Release(threads);
+		threads = 0;
 		return Error("Could not open h264 codec\n");
+	}
 
 	// Clean pictures
 	memset(&pic,0,sizeof(x264_picture_t));
@@ -270,9 +302,21 @@ VideoFrame* H264Encoder::EncodeFrame(BYTE *buffer,DWORD bufferSize)
 	pic.img.i_plane = 3;
 	pic.i_pts  = pts++;
 
+	//Get encoding start time
+	QWORD ini = getTime();
+
 	// Encode frame and get length
 	int len = x264_encoder_encode(enc, &nals, &numNals, &pic, &pic_out);
 
+	//Get encoding time
+	QWORD time = getTime()-ini;
+	//Update stats
+	frames++;
+	encodeTime += time;
+	if (time>maxEncodeTime)
+		maxEncodeTime = time;
+	EncoderThreads::getInstance().OnEncoded(time);
+
 	//Check it
 	if (len<=0)
 	{
@@ -298,6 +342,9 @@ VideoFrame* H264Encoder::EncodeFrame(BYTE *buffer,DWORD bufferSize)
 	//Unset type
 	pic.i_type = X264_TYPE_AUTO;
 
+	//Offsets are only for this one
+	pic.prop.quant_offsets = NULL;
+
 	//Emtpy rtp info
 	frame->ClearRTPPacketizationInfo();
 
@@ -342,3 +389,38 @@ int H264Encoder::FastPictureUpdate()
 	return 1;
 }
 
+
+/**********************
+* SetRegionOfInterest
+*	Ajusta el cuantificador de cada macrobloque en el siguiente frame
+***********************/
+int H264Encoder::SetRegionOfInterest(const BYTE* map,DWORD cols,DWORD rows,int changedQP,int staticQP)
+{
+	//Check
+	if (!opened)
+		return 0;
+
+	//Check it matches the encoding size
+	if (cols!=(width+15)/16 || rows!=(height+15)/16)
+		return Error("-SetRegionOfInterest wrong size [%dx%d]\n",cols,rows);
+
+	//Check if we need to allocate offsets
+	if (numOffsets!=cols*rows)
+	{
+		//Free previous
+		if (offsets)
+			free(offsets);
+		//Allocate new ones
+		offsets = (float*)malloc(cols*rows*sizeof(float));
+		numOffsets = cols*rows;
+	}
+
+	//Set offset for each macroblock
+	for (DWORD i=0;i<numOffsets;++i)
+		offsets[i] = map[i] ? changedQP : staticQP;
+
+	//Added by x264 on top of adaptive quantization, which is enabled by the preset
+	pic.prop.quant_offsets = offsets;
+
+	return 1;
+}
@@ -15,6 +15,7 @@ public:
 	virtual int FastPictureUpdate();
 	virtual int SetSize(int width,int height);
 	virtual int SetFrameRate(int fps,int kbits,int intraPeriod);
+	virtual int SetRegionOfInterest(const BYTE* map,DWORD cols,DWORD rows,int changedQP,int staticQP);
 
 private:
 	int OpenCodec();
@@ -25,6 +26,8 @@ private:
 	x264_picture_t  pic;
 	x264_picture_t 	pic_out;
 	VideoFrame*	frame;
+	float*		offsets;
+	DWORD		numOffsets;
 	int curNal;
 	int numNals;
 	int width;
@@ -36,6 +39,11 @@ private:
 	int opened;
 	int intraPeriod;
 	int pts;
+	int wantedThreads;
+	DWORD threads;
+	QWORD frames;
+	QWORD encodeTime;
+	QWORD maxEncodeTime;
 	std::string h264ProfileLevelId;
 };
 
@@ -27,6 +27,9 @@ public:
 	virtual void AddListener(Listener *listener) = 0;
 	virtual void Update() = 0;
 	virtual void SetREMB(DWORD estimation) = 0;
+	//Same, coming from the given listener, so joinables sending several streams can choose one for it
+	virtual void Update(Listener *listener)			{ Update();		}
+	virtual void SetREMB(Listener *listener,DWORD estimation)	{ SetREMB(estimation);	}
 
 	virtual void RemoveListener(Listener *listener) = 0;
 };
@@ -164,7 +164,7 @@ int RTPEndpoint::StartSending()
 	//Check if wer are joined
 	if (joined)
 		//Rquest a FPU
-		joined->Update();
+		joined->Update(this);
         //Send
 	sending = true;
 
@@ -331,7 +331,7 @@ void RTPEndpoint::onFPURequested(RTPSession *session)
 	//Check if joined
 	if (joined)
 		//Request update
-		joined->Update();
+		joined->Update(this);
 }
 
 void RTPEndpoint::onReceiverEstimatedMaxBitrate(RTPSession *session,DWORD estimation)
@@ -339,7 +339,7 @@ void RTPEndpoint::onReceiverEstimatedMaxBitrate(RTPSession *session,DWORD estima
 	//Check if joined
        if (joined)
                //Request update
-               joined->SetREMB(estimation);
+               joined->SetREMB(this,estimation);
 }
 
 void RTPEndpoint::onTempMaxMediaStreamBitrateRequest(RTPSession *session,DWORD estimation,DWORD overhead)
@@ -347,7 +347,7 @@ void RTPEndpoint::onTempMaxMediaStreamBitrateRequest(RTPSession *session,DWORD e
 	//Check if joined
        if (joined)
                //Request update
-               joined->SetREMB(estimation);
+               joined->SetREMB(this,estimation);
 }
 
 void RTPEndpoint::Update()
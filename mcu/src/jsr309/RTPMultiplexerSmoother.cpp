@@ -117,7 +117,7 @@ int RTPMultiplexerSmoother::SmoothFrame(const MediaFrame* frame,DWORD duration)
 		MediaFrame::RtpPacketization* rtp = info[i];
 
 		//Create rtp packet
-		RTPPacketSched *packet = new RTPPacketSched(frame->GetType(),codec);
+		RTPPacketSched *packet = new(frame->GetType()) RTPPacketSched(frame->GetType(),codec);
 
 		//Make sure it is enought length
 		if (rtp->GetPrefixLen()+rtp->GetSize()>packet->GetMaxMediaLength())
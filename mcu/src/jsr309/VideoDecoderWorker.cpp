@@ -217,8 +217,8 @@ int VideoDecoderJoinableWorker::Decode()
 		{
 			//Try to decode what is in the buffer
 			videoDecoder->DecodePacket(NULL,0,1,1);
-			//Get picture
-			BYTE *frame = videoDecoder->GetFrame();
+			//Get picture, as decoded
+			VideoBuffer *frame = videoDecoder->GetBuffer();
 			DWORD width = videoDecoder->GetWidth();
 			DWORD height = videoDecoder->GetHeight();
 			//Check values
@@ -229,6 +229,9 @@ int VideoDecoderJoinableWorker::Decode()
 				//Send it
 				output->NextFrame(frame);
 			}
+			//Release it
+			if (frame)
+				frame->Release();
 		}
 
 
@@ -264,8 +267,8 @@ int VideoDecoderJoinableWorker::Decode()
 			//No seq number for frame
 			frameSeqNum = RTPPacket::MaxExtSeqNum;
 
-			//Get picture
-			BYTE *frame = videoDecoder->GetFrame();
+			//Get picture, as decoded
+			VideoBuffer *frame = videoDecoder->GetBuffer();
 			DWORD width = videoDecoder->GetWidth();
 			DWORD height = videoDecoder->GetHeight();
 			//Check values
@@ -277,6 +280,9 @@ int VideoDecoderJoinableWorker::Decode()
 				//Send it
 				output->NextFrame(frame);
 			}
+			//Release it
+			if (frame)
+				frame->Release();
 			//Check if we got the waiting refresh
 			if (waitIntra && videoDecoder->IsKeyFrame())
 				//Do not wait anymore
@@ -33,11 +33,11 @@ public:
 	virtual void Update();
 	virtual void SetREMB(int bitrate);
 	virtual void RemoveListener(Listener *listener);
-	
-private:
+
 	int Start();
 	int Stop();
 	
+private:
 	virtual void FlushRTXPackets();
 	virtual void SmoothFrame(const VideoFrame *videoFrame,DWORD sendingTime);
 };
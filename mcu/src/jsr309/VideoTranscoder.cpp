@@ -1,12 +1,42 @@
-/* 
+/*
  * File:   VideoTranscoder.cpp
  * Author: Sergio
- * 
+ *
  * Created on 19 de marzo de 2013, 12:32
  */
 
+#include <stdio.h>
 #include "VideoTranscoder.h"
-#include "videopipe.h"
+#include "log.h"
+
+DWORD VideoTranscoder::SelectRung(const Rungs& rungs,DWORD current,DWORD estimation)
+{
+	int selected = -1;
+	int lowest = -1;
+
+	//Find the highest bitrate not over the estimation
+	for (DWORD i=0;i<rungs.size();++i)
+	{
+		//Get lowest one just in case
+		if (lowest==-1 || rungs[i].bitrate<rungs[lowest].bitrate)
+			lowest = i;
+		//If it fits and it is higher
+		if (rungs[i].bitrate<=estimation && (selected==-1 || rungs[i].bitrate>rungs[selected].bitrate))
+			selected = i;
+	}
+
+	//If none fits
+	if (selected==-1)
+		//Get lowest
+		selected = lowest;
+
+	//If going down, wait until 10% below current to avoid flapping
+	if (current<rungs.size() && rungs[selected].bitrate<rungs[current].bitrate && estimation*10>=rungs[current].bitrate*9)
+		//Keep current
+		return current;
+
+	return selected;
+}
 
 VideoTranscoder::VideoTranscoder(std::wstring &name)
 {
@@ -15,6 +45,9 @@ VideoTranscoder::VideoTranscoder(std::wstring &name)
 
 	//Not inited
 	inited = false;
+
+	//Create mutex
+	pthread_mutex_init(&mutex,NULL);
 }
 
 VideoTranscoder::~VideoTranscoder()
@@ -23,59 +56,347 @@ VideoTranscoder::~VideoTranscoder()
 	if (inited)
 		//End!!
 		End();
+
+	//Delete encoders
+	for (RungEncoders::iterator it=encoders.begin();it!=encoders.end();++it)
+		delete(*it);
+
+	//Destroy mutex
+	pthread_mutex_destroy(&mutex);
 }
 
 int VideoTranscoder::Init()
 {
-	Log("-Init VideoTranscoder [%ls,encoder:%p,decoder:%p]\n",tag.c_str(),&encoder,&decoder);
-	
-	//Init pipe
-	pipe.Init();
-	//Start encoder
-	encoder.Init(&pipe);
-	//Star decoder
-	decoder.Init(&pipe);
+	Log("-Init VideoTranscoder [%ls,decoder:%p]\n",tag.c_str(),&decoder);
+
+	//Star decoder, encoders are created when codec is set
+	decoder.Init(&pyramid);
 	//Inited
 	inited = true;
 	//OK
 	return 1;
 }
+
 int VideoTranscoder::SetCodec(VideoCodec::Type codec,int mode,int fps,int bitrate,int intraPeriod,const Properties& properties)
 {
-	return encoder.SetCodec(codec,mode,fps,bitrate,intraPeriod,properties);
+	Rungs ladder;
+	char name[64];
+
+	//First rung is the main one
+	Rung first = {mode,bitrate};
+	ladder.push_back(first);
+
+	//Get the rest
+	for (int i=1;;++i)
+	{
+		Rung rung;
+		//Check size
+		snprintf(name,sizeof(name),"ladder.%d.size",i);
+		//If not found
+		if (!properties.HasProperty(name))
+			//No more
+			break;
+		//Get it
+		rung.mode = properties.GetProperty(name,mode);
+		//Get bitrate
+		snprintf(name,sizeof(name),"ladder.%d.bitrate",i);
+		rung.bitrate = properties.GetProperty(name,bitrate);
+		//Add it
+		ladder.push_back(rung);
+	}
+
+	Log("-VideoTranscoder::SetCodec() [%ls,codec:%s,rungs:%d]\n",tag.c_str(),VideoCodec::GetNameFor(codec),ladder.size());
+
+	//Stop current encoders, outside the lock as they may be waiting for it
+	StopEncoders();
+
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Remove members from their rungs
+	for (Members::iterator it=members.begin();it!=members.end();++it)
+		//Remove it
+		encoders[it->second.rung]->RTPMultiplexer::RemoveListener(it->first);
+
+	//Delete the encoders not needed anymore
+	while (encoders.size()>ladder.size())
+	{
+		//Delete last one
+		delete(encoders.back());
+		encoders.pop_back();
+	}
+
+	//One pyramid level for each rung
+	pyramid.Init(ladder.size());
+
+	//Create new ones
+	while (encoders.size()<ladder.size())
+	{
+		//Create encoder for rung
+		RungEncoder* encoder = new RungEncoder(this,encoders.size());
+		//Grab from its level
+		encoder->Init(pyramid.GetLevel(encoders.size()));
+		//Add it
+		encoders.push_back(encoder);
+	}
+
+	int res = 1;
+
+	//Set codec for each one
+	for (DWORD i=0;i<ladder.size();++i)
+		//Set it
+		res &= encoders[i]->SetCodec(codec,ladder[i].mode,fps,ladder[i].bitrate,intraPeriod,properties);
+
+	//Store ladder
+	rungs = ladder;
+
+	//Put members back
+	for (Members::iterator it=members.begin();it!=members.end();++it)
+	{
+		//If rung does not exist anymore
+		if (it->second.rung>=encoders.size())
+			//Move to the last one
+			it->second.rung = encoders.size()-1;
+		//No pending move
+		it->second.target = it->second.rung;
+		//Add it
+		encoders[it->second.rung]->RTPMultiplexer::AddListener(it->first);
+	}
+
+	//Check if we have to encode
+	bool start = !members.empty();
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//If we have listeners
+	if (start)
+		//Start encoding again
+		StartEncoders();
+
+	return res;
 }
+
 int VideoTranscoder::End()
 {
 	Log("-End VideoTranscoder [%ls]\n",tag.c_str());
-	//End encoder and decoder
-	encoder.End();
+	//End encoders and decoder
+	StopEncoders();
 	decoder.End();
-	//End pipe
-	pipe.End();
+	//End pyramid
+	pyramid.End();
 	//Not inited
 	inited = false;
 	//OK
 	return 1;
 }
 
+void VideoTranscoder::StartEncoders()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Get them
+	RungEncoders started = encoders;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//Start all rungs, so listeners can be moved to any of them
+	for (RungEncoders::iterator it=started.begin();it!=started.end();++it)
+		(*it)->Start();
+}
+
+void VideoTranscoder::StopEncoders()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Get them
+	RungEncoders stopped = encoders;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//Stop them, without the lock as the encoding threads may be waiting for it
+	for (RungEncoders::iterator it=stopped.begin();it!=stopped.end();++it)
+		(*it)->Stop();
+}
+
 void VideoTranscoder::AddListener(Joinable::Listener *listener)
 {
-	encoder.AddListener(listener);
+	//Check
+	if (!listener)
+		//Nothing
+		return;
+
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//If already added
+	if (members.find(listener)!=members.end())
+	{
+		//Unlock
+		pthread_mutex_unlock(&mutex);
+		//Done
+		return;
+	}
+
+	//Start on the main rung
+	Member member = {0,0};
+	members[listener] = member;
+
+	//If codec is already set
+	if (!encoders.empty())
+		//Send it
+		encoders[0]->RTPMultiplexer::AddListener(listener);
+
+	//Check if it is the first one
+	bool first = members.size()==1;
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//If it is the first one
+	if (first)
+		//Start encoding
+		StartEncoders();
+}
+
+void VideoTranscoder::RemoveListener(Joinable::Listener *listener)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Find it
+	Members::iterator it = members.find(listener);
+
+	//If not found
+	if (it==members.end())
+	{
+		//Unlock
+		pthread_mutex_unlock(&mutex);
+		//Done
+		return;
+	}
+
+	//Remove it from its rung
+	if (it->second.rung<encoders.size())
+		encoders[it->second.rung]->RTPMultiplexer::RemoveListener(listener);
+
+	//Remove it
+	members.erase(it);
+
+	//Check if there are no more
+	bool empty = members.empty();
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//If it was the last one
+	if (empty)
+		//Stop encoding
+		StopEncoders();
 }
 
 void VideoTranscoder::Update()
 {
-	encoder.Update();
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Request an intra on all rungs
+	for (RungEncoders::iterator it=encoders.begin();it!=encoders.end();++it)
+		(*it)->Update();
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
+
+void VideoTranscoder::Update(Joinable::Listener *listener)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Find it
+	Members::iterator it = members.find(listener);
+
+	//If found
+	if (it!=members.end() && it->second.target<encoders.size())
+		//Request an intra only on the rung it is going to get
+		encoders[it->second.target]->Update();
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
 }
 
 void VideoTranscoder::SetREMB(DWORD estimation)
 {
-	encoder.SetREMB(estimation);
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Limit main rung, as before having a ladder
+	if (!encoders.empty())
+		encoders[0]->SetREMB(estimation);
+	//Unlock
+	pthread_mutex_unlock(&mutex);
 }
 
-void VideoTranscoder::RemoveListener(Joinable::Listener *listener)
+void VideoTranscoder::SetREMB(Joinable::Listener *listener,DWORD estimation)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Find it
+	Members::iterator it = members.find(listener);
+
+	//If not found or no codec set
+	if (it==members.end() || encoders.empty())
+	{
+		//Unlock
+		pthread_mutex_unlock(&mutex);
+		//Done
+		return;
+	}
+
+	//If there is only one rung
+	if (encoders.size()==1)
+	{
+		//Limit its bitrate
+		encoders[0]->SetREMB(estimation);
+	} else {
+		//Get rung for the estimation in kbps
+		DWORD target = SelectRung(rungs,it->second.rung,estimation/1000);
+		//If it has changed
+		if (target!=it->second.target)
+		{
+			Debug("-VideoTranscoder::SetREMB() | moving listener [%ls,listener:%p,from:%d,to:%d,estimation:%d]\n",tag.c_str(),listener,it->second.rung,target,estimation);
+			//Set new target
+			it->second.target = target;
+			//If it is a different one
+			if (target!=it->second.rung)
+				//It will be moved on next intra
+				encoders[target]->Update();
+		}
+	}
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
+
+void VideoTranscoder::onIntraFrame(DWORD num)
 {
-	encoder.RemoveListener(listener);
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Move members waiting for this rung
+	for (Members::iterator it=members.begin();it!=members.end();++it)
+	{
+		//Skip if not waiting for it
+		if (it->second.target!=num || it->second.rung==num)
+			continue;
+		//Remove from old one
+		encoders[it->second.rung]->RTPMultiplexer::RemoveListener(it->first);
+		//Add to new one, stream is reset so timestamps are continous
+		encoders[num]->RTPMultiplexer::AddListener(it->first);
+		//Moved
+		it->second.rung = num;
+	}
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
 }
 
 void VideoTranscoder::onRTPPacket(RTPPacket &packet)
@@ -99,4 +420,4 @@ int VideoTranscoder::Attach(Joinable *join)
 int VideoTranscoder::Dettach()
 {
 	decoder.Dettach();
-}
\ No newline at end of file
+}
@@ -9,13 +9,35 @@
 #define	VIDEOTRANSCODER_H
 #include "VideoEncoderWorkerMultiplexer.h"
 #include "VideoDecoderWorker.h"
-#include "videopipe.h"
+#include "videopyramid.h"
 #include <string>
+#include <vector>
+#include <map>
 
+/*
+ * Decodes the joined stream once and encodes it in one or more renditions.
+ *	Additional rungs of the ladder are set with the ladder.N.size and
+ *	ladder.N.bitrate properties, N starting at 1, and each one has its own
+ *	encoder fed from a shared scaling pyramid. Listeners start on the first
+ *	rung and are moved to the one matching their REMB estimation when that
+ *	rung sends a key frame.
+ */
 class VideoTranscoder :
 	public Joinable,
 	public Joinable::Listener
 {
+public:
+	struct Rung
+	{
+		int mode;
+		int bitrate;
+	};
+	typedef std::vector<Rung> Rungs;
+
+public:
+	//Rung for a listener given its estimation in kbps, only going down when clearly below current
+	static DWORD SelectRung(const Rungs& rungs,DWORD current,DWORD estimation);
+
 public:
 	VideoTranscoder(std::wstring &name);
 	virtual ~VideoTranscoder();
@@ -27,7 +49,9 @@ public:
 	//Joinable interface
 	virtual void AddListener(Joinable::Listener *listener);
 	virtual void Update();
+	virtual void Update(Joinable::Listener *listener);
 	virtual void SetREMB(DWORD estimation);
+	virtual void SetREMB(Joinable::Listener *listener,DWORD estimation);
 	virtual void RemoveListener(Joinable::Listener *listener);
 
 	//Virtuals from Joinable::Listener
@@ -42,11 +66,46 @@ public:
 	const std::wstring& GetName() { return tag;	}
 
 private:
-	VideoEncoderMultiplexerWorker	encoder;
+	class RungEncoder :
+		public VideoEncoderMultiplexerWorker
+	{
+	public:
+		RungEncoder(VideoTranscoder* transcoder,DWORD num)
+		{
+			this->transcoder = transcoder;
+			this->num = num;
+		}
+	private:
+		//Called by the encoder just before sending an intra
+		virtual void FlushRTXPackets()	{ transcoder->onIntraFrame(num);	}
+	private:
+		VideoTranscoder* transcoder;
+		DWORD num;
+	};
+
+	struct Member
+	{
+		DWORD rung;	//Rung sending to it
+		DWORD target;	//Rung to move to on its next intra
+	};
+
+	typedef std::vector<RungEncoder*> RungEncoders;
+	typedef std::map<Joinable::Listener*,Member> Members;
+
+private:
+	void onIntraFrame(DWORD num);
+	void StartEncoders();
+	void StopEncoders();
+
+private:
+	RungEncoders	encoders;
+	Rungs		rungs;
+	Members		members;
 	VideoDecoderJoinableWorker	decoder;
-	VideoPipe	pipe;
+	VideoPyramid	pyramid;
 	std::wstring	tag;
 	bool		inited;
+	pthread_mutex_t	mutex;
 };
 
 #endif	/* VIDEOTRANSCODER_H */
@@ -0,0 +1,364 @@
+/*
+ * File:   labelcache.cpp
+ * Author: Sergio
+ *
+ * Created on 21 de octubre de 2026, 10:15
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "log.h"
+#include "amf.h"
+#include "labelcache.h"
+extern "C" {
+#include <libswscale/swscale.h>
+#include <libavcodec/avcodec.h>
+}
+
+#ifdef HAVE_IMAGEMAGICK
+#include <Magick++.h>
+#endif
+
+bool LabelCache::Key::operator==(const Key& other) const
+{
+	//Cheap ones first
+	return width==other.width && height==other.height && text==other.text && style==other.style;
+}
+
+LabelCache& LabelCache::getInstance()
+{
+	static LabelCache cache;
+	return cache;
+}
+
+LabelCache::Key LabelCache::GetKey(const std::wstring& text,DWORD width,DWORD height,const Properties& properties)
+{
+	Key key;
+
+	//Set values
+	key.text = text;
+	key.width = width;
+	key.height = height;
+
+	//Serialize all properties, map is ordered so same ones give same style
+	for (Properties::const_iterator it=properties.begin();it!=properties.end();++it)
+	{
+		key.style += it->first;
+		key.style += "=";
+		key.style += it->second;
+		key.style += ";";
+	}
+
+	return key;
+}
+
+LabelCache::LabelCache(DWORD maxCached)
+{
+	//Store max
+	this->maxCached = maxCached;
+	//No stats
+	memset(&stats,0,sizeof(stats));
+	//Create mutex
+	pthread_mutex_init(&mutex,NULL);
+}
+
+LabelCache::~LabelCache()
+{
+	//Free tiles
+	Clear();
+	//Destroy mutex
+	pthread_mutex_destroy(&mutex);
+}
+
+void LabelCache::Clear()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Free all tiles
+	for (Labels::iterator it=labels.begin();it!=labels.end();++it)
+		free(it->tile);
+	//Empty
+	labels.clear();
+	stats.cached = 0;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
+
+void LabelCache::Evict()
+{
+	//Remove least recently used ones, but never the one just used
+	while (labels.size()>maxCached && labels.size()>1)
+	{
+		//Free tile
+		free(labels.back().tile);
+		//Remove it
+		labels.pop_back();
+	}
+	//Update number
+	stats.cached = labels.size();
+}
+
+LabelCache::Stats LabelCache::GetStats()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Copy
+	Stats copy = stats;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	return copy;
+}
+
+void LabelCache::SetMaxCached(DWORD num)
+{
+	Log("-LabelCache::SetMaxCached() | [num:%d]\n",num);
+
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Set new max
+	maxCached = num;
+	//Drop the ones over it
+	Evict();
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
+
+BYTE* LabelCache::Find(const Key& key)
+{
+	//Search it, most recently used are first
+	for (Labels::iterator it=labels.begin();it!=labels.end();++it)
+	{
+		//If found
+		if (it->key==key)
+		{
+			//Move to front
+			labels.splice(labels.begin(),labels,it);
+			//Got it
+			return labels.front().tile;
+		}
+	}
+	//Not found
+	return NULL;
+}
+
+int LabelCache::Draw(const std::wstring& text,DWORD width,DWORD height,const Properties& properties,BYTE* canvas,DWORD canvasWidth,DWORD canvasHeight,DWORD x,DWORD y)
+{
+	//Check it is inside
+	if (!width || !height || x>=canvasWidth || y>=canvasHeight)
+		//Error
+		return Error("-LabelCache::Draw() | label out of canvas [x:%d,y:%d,w:%d,h:%d,canvas:%dx%d]\n",x,y,width,height,canvasWidth,canvasHeight);
+
+	//Get key
+	Key key = GetKey(text,width,height,properties);
+
+	//Lock, tile is copied while holding it so it can't be evicted meanwhile
+	pthread_mutex_lock(&mutex);
+
+	//Search it
+	BYTE* tile = Find(key);
+
+	//If found
+	if (tile)
+	{
+		//Reused
+		stats.reused++;
+	} else {
+		//Unlock, so other mixers are not blocked while rasterizing
+		pthread_mutex_unlock(&mutex);
+
+		//Create new tile
+		BYTE* rendered = (BYTE*)malloc(GetTileSize(width,height));
+		//Render it
+		if (!Render(text,width,height,properties,rendered))
+		{
+			//Free it
+			free(rendered);
+			//Error
+			return Error("-LabelCache::Draw() | could not render label [text:%ls]\n",text.c_str());
+		}
+
+		//Lock again
+		pthread_mutex_lock(&mutex);
+
+		//Rendered
+		stats.rendered++;
+
+		//Check if it has been added while rendering
+		tile = Find(key);
+
+		//If so
+		if (tile)
+		{
+			//Use that one
+			free(rendered);
+		} else {
+			//Add it to the cache
+			Label label;
+			label.key = key;
+			label.tile = rendered;
+			labels.push_front(label);
+			//Drop old ones
+			Evict();
+			//Use it
+			tile = rendered;
+		}
+	}
+
+	//Get tile planes
+	BYTE* tileY = tile;
+	BYTE* tileU = tileY+width*height;
+	BYTE* tileV = tileU+(width/2)*(height/2);
+	BYTE* tileA = tileV+(width/2)*(height/2);
+
+	//Get canvas planes
+	DWORD numpixels = canvasWidth*canvasHeight;
+	BYTE* canvasY = canvas;
+	BYTE* canvasU = canvasY+numpixels;
+	BYTE* canvasV = canvasU+numpixels/4;
+	BYTE* canvasA = canvasV+numpixels/4;
+
+	//Clip to canvas
+	DWORD w = x+width<canvasWidth ? width : canvasWidth-x;
+	DWORD h = y+height<canvasHeight ? height : canvasHeight-y;
+
+	//Copy luma and alpha rows
+	for (DWORD j=0;j<h;++j)
+	{
+		memcpy(canvasY+(y+j)*canvasWidth+x,tileY+j*width,w);
+		memcpy(canvasA+(y+j)*canvasWidth+x,tileA+j*width,w);
+	}
+
+	//Copy chroma rows
+	for (DWORD j=0;j<h/2;++j)
+	{
+		memcpy(canvasU+(y/2+j)*(canvasWidth/2)+x/2,tileU+j*(width/2),w/2);
+		memcpy(canvasV+(y/2+j)*(canvasWidth/2)+x/2,tileV+j*(width/2),w/2);
+	}
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//Done
+	return 1;
+}
+
+int LabelCache::Render(const std::wstring& text,DWORD width,DWORD height,const Properties& properties,BYTE* tile)
+{
+#ifdef HAVE_IMAGEMAGICK
+	//Colors in RGBA
+	const char *strokeColor	= properties.GetProperty("strokeColor"		,"#40404040"	);
+	const char *fillColor	= properties.GetProperty("fillColor"		,"#11FF1140"	);
+	const char *color	= properties.GetProperty("color"		,"white"	);
+	bool drawBackground	= properties.GetProperty("drawBackground"	,true		);
+	BYTE strokeWidth	= properties.GetProperty("strokeWidth"		,2		);
+	const char *font	= properties.GetProperty("font"			,"Verdana"	);
+	BYTE fontSize		= properties.GetProperty("fontSize"		,14		);
+	BYTE padding		= properties.GetProperty("padding"		,2		);
+	BYTE margin		= properties.GetProperty("margin"		,2		);
+	BYTE cornerWidth	= properties.GetProperty("cornerWidth"		,2		);
+	BYTE cornerHeight	= properties.GetProperty("cornerHeight"		,2		);
+	char str[1024];
+
+	try
+	{
+		Magick::Blob rgbablob;
+		//Create rendered
+		Magick::Image render( Magick::Geometry(width,height),Magick::Color("#00000000"));
+		render.depth(8);
+		render.interlaceType(Magick::NoInterlace);
+		//Check if we need to draw background
+		if (drawBackground)
+		{
+			//background color
+			render.fillColor(Magick::Color(fillColor));
+			//If got border
+			if (strokeWidth)
+			{
+				render.strokeColor(Magick::Color(strokeColor));
+				//Set stroke widht
+				render.strokeWidth(strokeWidth);
+			}
+			// Check if it can be printed witthout be truncated
+			render.draw(Magick::DrawableRoundRectangle(margin, margin, width-margin*2, height-margin, cornerWidth, cornerHeight) );
+		}
+
+		//Set font
+		render.font(font);
+		render.fontPointsize(fontSize);
+
+		//Convert text to tuf8
+		UTF8Parser utf8(text);
+		//Get mas length
+		DWORD len = utf8.GetUTF8Size();
+		//Check size
+		if (len+1>1024)
+			//reduce
+			len = 1024-1;
+		//Serialize it
+		utf8.Serialize((BYTE*)str,len);
+		str[len] = 0;
+
+		render.fillColor(Magick::Color(color));
+		render.strokeWidth(0);
+		render.draw( Magick::DrawableText(margin+padding+strokeWidth, height-padding-strokeWidth-fontSize/2, str, "UTF-8"));
+		render.magick("RGBA");
+		render.write(&rgbablob);
+
+		//First from to RGBA to YUVB
+		SwsContext *sws = sws_getContext(
+						width,
+						height,
+						AV_PIX_FMT_RGBA,
+						width,
+						height,
+						AV_PIX_FMT_YUVA420P,
+						SWS_FAST_BILINEAR,
+						0,
+						0,
+						0
+					);
+
+		//Check
+		if (!sws)
+			//Set errror
+			return  Error("Couldn't alloc sws context\n");
+
+		//Create new frames for converting  RGBA->YUVA
+		AVFrame* rgba = av_frame_alloc();
+		AVFrame* yuva = av_frame_alloc();
+
+		//Set data origin data
+		rgba->data[0] = (BYTE *) rgbablob.data();
+		//Set origin planes
+		rgba->linesize[0] = 4*width;
+
+		//Set size for planes dest
+		yuva->linesize[0] = width;
+		yuva->linesize[1] = width/2;
+		yuva->linesize[2] = width/2;
+		yuva->linesize[3] = width;
+
+		//Set destination data on the tile
+		yuva->data[0] = tile;
+		yuva->data[1] = yuva->data[0] + width*height;
+		yuva->data[2] = yuva->data[1] + (width/2)*(height/2);
+		yuva->data[3] = yuva->data[2] + (width/2)*(height/2);
+
+		//Convert
+		sws_scale(sws, rgba->data, rgba->linesize, 0, height, yuva->data, yuva->linesize);
+
+		//Free memory
+		av_free(rgba);
+		av_free(yuva);
+		sws_freeContext(sws);
+	} catch ( Magick::Exception &error ) {
+		return Error("-LabelCache: failed to render text %ls: %s.\n", text.c_str(), error.what() );
+	}
+	//OK
+	return 1;
+#else
+	//Not supported
+	return Error("-LabelCache: text rendering not supported\n");
+#endif
+}
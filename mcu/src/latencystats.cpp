@@ -0,0 +1,219 @@
+/*
+ * File:   latencystats.cpp
+ * Author: Sergio
+ *
+ * Created on 18 de octubre de 2026, 17:20
+ */
+
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "tools.h"
+#include "latencystats.h"
+
+//Values below 2*SubBuckets have their own bucket
+static const DWORD SubBucketBits = 5;
+static const DWORD SubBuckets = 1<<SubBucketBits;
+
+LatencyHistogram::LatencyHistogram()
+{
+	//Empty
+	Reset();
+}
+
+void LatencyHistogram::Reset()
+{
+	//Clean all
+	count = 0;
+	sum = 0;
+	memset(buckets,0,sizeof(buckets));
+}
+
+DWORD LatencyHistogram::GetBucket(QWORD value)
+{
+	//Clamp to max
+	if (value>0xFFFFFFFF)
+		value = 0xFFFFFFFF;
+
+	//Small values are exact
+	if (value<2*SubBuckets)
+		return value;
+
+	//Get highest bit
+	DWORD msb = 31-__builtin_clz((DWORD)value);
+	//Get how much we need to shift it to get the sub bucket
+	DWORD shift = msb-SubBucketBits;
+
+	//Each power of two has SubBuckets buckets after the exact ones
+	return 2*SubBuckets + (shift-1)*SubBuckets + ((value>>shift)-SubBuckets);
+}
+
+QWORD LatencyHistogram::GetBucketValue(DWORD bucket)
+{
+	//Exact ones
+	if (bucket<2*SubBuckets)
+		return bucket;
+
+	//Get shift and sub bucket
+	DWORD shift = (bucket-2*SubBuckets)/SubBuckets+1;
+	DWORD sub = (bucket-2*SubBuckets)%SubBuckets+SubBuckets;
+
+	//Return highest value on it
+	return (((QWORD)sub)<<shift) + (((QWORD)1)<<shift) - 1;
+}
+
+void LatencyHistogram::Record(QWORD value)
+{
+	//Single writer, readers may get an slightly inconsistent view while copying
+	buckets[GetBucket(value)]++;
+	sum += value;
+	count++;
+}
+
+QWORD LatencyHistogram::GetPercentile(double percentile) const
+{
+	//Check
+	if (!count)
+		return 0;
+
+	//Get number of values that must be below or equal
+	QWORD target = (QWORD)ceil(count*percentile/100);
+
+	//At least one
+	if (!target)
+		target = 1;
+
+	QWORD acu = 0;
+	QWORD value = 0;
+
+	//Find the bucket
+	for (DWORD i=0;i<NumBuckets;++i)
+	{
+		//Skip empty
+		if (!buckets[i])
+			continue;
+		//Get value
+		value = GetBucketValue(i);
+		//Accumulate
+		acu += buckets[i];
+		//Check if reached
+		if (acu>=target)
+			break;
+	}
+
+	return value;
+}
+
+LatencyHistogram& LatencyHistogram::operator-=(const LatencyHistogram& other)
+{
+	//Remove counts
+	for (DWORD i=0;i<NumBuckets;++i)
+		buckets[i] -= other.buckets[i];
+	count -= other.count;
+	sum -= other.sum;
+
+	return *this;
+}
+
+LatencyStats::Snapshot& LatencyStats::Snapshot::operator-=(const Snapshot& other)
+{
+	//Each stage
+	for (DWORD i=0;i<NumStages;++i)
+		stages[i] -= other.stages[i];
+	//Each thread
+	for (DWORD i=0;i<NumThreads;++i)
+		cpu[i] -= other.cpu[i];
+	//Get interval
+	time -= other.time;
+
+	return *this;
+}
+
+const char* LatencyStats::GetNameFor(Stage stage)
+{
+	switch (stage)
+	{
+		case Jitter:	return "jitter";
+		case Decode:	return "decode";
+		case Decoded:	return "decoded";
+		case Mixed:	return "mixed";
+		case Grabbed:	return "grabbed";
+		case Encode:	return "encode";
+		case Encoded:	return "encoded";
+		case Packetize:	return "packetize";
+		case Sent:	return "sent";
+		default:	return "unknown";
+	}
+}
+
+const char* LatencyStats::GetNameFor(Thread thread)
+{
+	switch (thread)
+	{
+		case Receiving:	return "receiving";
+		case Sending:	return "sending";
+		default:	return "unknown";
+	}
+}
+
+QWORD LatencyStats::GetThreadCPUTime()
+{
+	timespec ts;
+	//Get cpu time of calling thread
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts))
+		return 0;
+	//In us
+	return ((QWORD)ts.tv_sec)*1000000 + ts.tv_nsec/1000;
+}
+
+LatencyStats::LatencyStats()
+{
+	//No cpu usage
+	memset(cpu,0,sizeof(cpu));
+	memset(last,0,sizeof(last));
+}
+
+void LatencyStats::RecordSince(Stage stage,QWORD origin)
+{
+	//If not known
+	if (!origin)
+		return;
+
+	//Get now
+	QWORD now = getTime();
+
+	//Clock may have moved backwards
+	if (now<origin)
+		return;
+
+	//Record it
+	Record(stage,now-origin);
+}
+
+void LatencyStats::StartCPU(Thread thread)
+{
+	//New thread, start counting from now
+	last[thread] = GetThreadCPUTime();
+}
+
+void LatencyStats::UpdateCPU(Thread thread)
+{
+	//Get current
+	QWORD now = GetThreadCPUTime();
+	//Accumulate since last one
+	if (now>last[thread])
+		cpu[thread] += now-last[thread];
+	//Store
+	last[thread] = now;
+}
+
+void LatencyStats::GetSnapshot(Snapshot& snapshot) const
+{
+	//Copy all
+	for (DWORD i=0;i<NumStages;++i)
+		snapshot.stages[i] = stages[i];
+	for (DWORD i=0;i<NumThreads;++i)
+		snapshot.cpu[i] = cpu[i];
+	//Set time
+	snapshot.time = getTime();
+}
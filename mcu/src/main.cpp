@@ -17,6 +17,13 @@
 #include "bfcp.h"
 #include "groupchat.h"
 #include "CPUMonitor.h"
+#include "rtpreactor.h"
+#include "tcpreactor.h"
+#include "rtppacketpool.h"
+#include "framescaler.h"
+#include "workerpool.h"
+#include "encoderthreads.h"
+#include "mediaclock.h"
 extern "C" {
 	#include "libavcodec/avcodec.h"
 }
@@ -193,6 +200,14 @@ int main(int argc,char **argv)
 	int minPort = RTPSession::GetMinPort();
 	int maxPort = RTPSession::GetMaxPort();
 	int vadPeriod = 2000;
+	bool rtpReactor = false;
+	int rtpWorkers = 0;
+	bool tcpReactor = false;
+	int tcpWorkers = 0;
+	int rtpPoolSize = 0;
+	int scalerCacheSize = 0;
+	int mixerWorkers = 0;
+	int encoderCores = 0;
 	const char *logfile = "mcu.log";
 	const char *pidfile = "mcu.pid";
 	const char *crtfile = "mcu.crt";
@@ -206,7 +221,7 @@ int main(int argc,char **argv)
 		{
 			//Show usage
 			printf("Medooze MCU media mixer version %s %s\r\n",MCUVERSION,MCUDATE);
-			printf("Usage: mcu [-h] [--help] [--mcu-log logfile] [--mcu-pid pidfile] [--http-port port] [--rtmp-port port] [--min-rtp-port port] [--max-rtp-port port] [--vad-period ms]\r\n\r\n"
+			printf("Usage: mcu [-h] [--help] [--mcu-log logfile] [--mcu-pid pidfile] [--http-port port] [--rtmp-port port] [--min-rtp-port port] [--max-rtp-port port] [--rtp-reactor] [--rtp-workers num] [--tcp-reactor] [--tcp-workers num] [--rtp-pool-size num] [--scaler-cache-size num] [--mixer-workers num] [--encoder-cores num] [--vad-period ms]\r\n\r\n"
 				"Options:\r\n"
 				" -h,--help        Print help\r\n"
 				" -f               Run as daemon in safe mode\r\n"
@@ -221,6 +236,14 @@ int main(int argc,char **argv)
 				" --http-ip        Set HTTP xmlrpc api listening interface ip\r\n"
 				" --min-rtp-port   Set min rtp port\r\n"
 				" --max-rtp-port   Set max rtp port\r\n"
+				" --rtp-reactor    Poll all RTP sessions from a shared pool of workers instead of one thread per session\r\n"
+				" --rtp-workers    Set the number of RTP reactor workers (default: number of cores)\r\n"
+				" --tcp-reactor    Serve all RTMP and WebSocket connections from a shared pool of workers instead of one thread per connection\r\n"
+				" --tcp-workers    Set the number of TCP reactor workers (default: number of cores)\r\n"
+				" --rtp-pool-size  Set the max number of free RTP packets kept for reuse per media type (default: 2048)\r\n"
+				" --scaler-cache-size Set the max number of free scaling contexts kept for reuse (default: 64)\r\n"
+				" --mixer-workers  Set the number of threads used for composing mosaics in parallel (default: number of cores minus one)\r\n"
+				" --encoder-cores  Set the number of cores shared by the video encoder threads (default: number of cores minus mixer workers)\r\n"
 				" --rtmp-port      Set RTMP port\r\n"
 				" --websocket-port Set WebSocket server port\r\n"
 				" --vad-period     Set the VAD based conference change period in milliseconds (default: 2000ms)\r\n");
@@ -256,6 +279,30 @@ int main(int argc,char **argv)
 		else if (strcmp(argv[i],"--max-rtp-port")==0 && (i+1<argc))
 			//Get rtmp port
 			maxPort = atoi(argv[++i]);
+		else if (strcmp(argv[i],"--rtp-reactor")==0)
+			//Enable reactor
+			rtpReactor = true;
+		else if (strcmp(argv[i],"--rtp-workers")==0 && (i+1<argc))
+			//Get number of workers
+			rtpWorkers = atoi(argv[++i]);
+		else if (strcmp(argv[i],"--tcp-reactor")==0)
+			//Enable reactor
+			tcpReactor = true;
+		else if (strcmp(argv[i],"--tcp-workers")==0 && (i+1<argc))
+			//Get number of workers
+			tcpWorkers = atoi(argv[++i]);
+		else if (strcmp(argv[i],"--rtp-pool-size")==0 && (i+1<argc))
+			//Get number of cached packets
+			rtpPoolSize = atoi(argv[++i]);
+		else if (strcmp(argv[i],"--scaler-cache-size")==0 && (i+1<argc))
+			//Get number of cached scalers
+			scalerCacheSize = atoi(argv[++i]);
+		else if (strcmp(argv[i],"--mixer-workers")==0 && (i+1<argc))
+			//Get number of workers
+			mixerWorkers = atoi(argv[++i]);
+		else if (strcmp(argv[i],"--encoder-cores")==0 && (i+1<argc))
+			//Get encoder core budget
+			encoderCores = atoi(argv[++i]);
 		else if (strcmp(argv[i],"--mcu-log")==0 && (i+1<argc))
 			//Get rtmp port
 			logfile = argv[++i];
@@ -415,6 +462,40 @@ int main(int argc,char **argv)
 		//Using default ones
 		Log("-RTPSession using default port range [%d,%d]\n",RTPSession::GetMinPort(),RTPSession::GetMaxPort());
 
+	//If set
+	if (rtpPoolSize>0)
+		//Set max free packets on each pool
+		RTPPacketPool::SetMaxCached(rtpPoolSize);
+
+	//If set
+	if (scalerCacheSize>0)
+		//Set max free scaling contexts
+		FrameScaler::SetMaxCached(scalerCacheSize);
+
+	//Start mosaic composition workers
+	WorkerPool::getInstance().Start(mixerWorkers);
+
+	//If not set
+	if (encoderCores<=0)
+		//Don't count the cores already taken by the composition workers
+		encoderCores = sysconf(_SC_NPROCESSORS_ONLN)-WorkerPool::getInstance().GetNumWorkers();
+
+	//Set encoder threads budget, at least one
+	EncoderThreads::getInstance().SetCores(encoderCores>0 ? encoderCores : 1);
+
+	//Start mixing clock
+	MediaClock::getInstance().Start();
+
+	//If using the shared rtp reactor
+	if (rtpReactor)
+		//Start it before any session is created
+		RTPReactor::getInstance().Start(rtpWorkers);
+
+	//If using the shared tcp reactor
+	if (tcpReactor)
+		//Start it before any connection is accepted
+		TCPReactor::getInstance().Start(tcpWorkers);
+
 	//Set DTLS certificate
 	DTLSConnection::SetCertificate(crtfile,keyfile);
 	//Log
@@ -553,6 +634,14 @@ int main(int argc,char **argv)
 	rtmpServer.End();
 	//ENd ws server
 	wsServer.End();
+	//Stop rtp reactor
+	RTPReactor::getInstance().Stop();
+	//Stop tcp reactor
+	TCPReactor::getInstance().Stop();
+	//Stop composition workers
+	WorkerPool::getInstance().Stop();
+	//Stop mixing clock
+	MediaClock::getInstance().Stop();
 #ifdef CEF
 	//CEF crashes on end so disabling signal/core
 	//Ignore SIGSEGV
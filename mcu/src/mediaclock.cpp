@@ -0,0 +1,339 @@
+/*
+ * File:   mediaclock.cpp
+ * Author: Sergio
+ *
+ * Created on 18 de octubre de 2026, 10:40
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include "log.h"
+#include "tools.h"
+#include "mediaclock.h"
+
+//Histogram bucket limits in us
+static const DWORD BucketLimits[MediaClock::NumBuckets] = {100,250,500,1000,2000,5000,10000,0};
+
+DWORD MediaClock::GetBucketLimit(DWORD bucket)
+{
+	//Check
+	if (bucket>=NumBuckets)
+		return 0;
+	//Return it
+	return BucketLimits[bucket];
+}
+
+QWORD MediaClock::GetTime()
+{
+	timespec ts;
+	//Get monotonic time
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	//Return in us
+	return ((QWORD)ts.tv_sec)*1000000+ts.tv_nsec/1000;
+}
+
+MediaClock::MediaClock()
+{
+	//Not running
+	__atomic_store_n(&running,false,__ATOMIC_RELEASE);
+	//No timer
+	fd = -1;
+	//No stats
+	memset(&stats,0,sizeof(stats));
+	//Create objects
+	pthread_mutex_init(&mutex,NULL);
+	pthread_mutex_init(&dispatch,NULL);
+}
+
+MediaClock::~MediaClock()
+{
+	//Stop just in case
+	Stop();
+	//Clean object
+	pthread_mutex_destroy(&mutex);
+	pthread_mutex_destroy(&dispatch);
+}
+
+bool MediaClock::Start()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Check if already running
+	if (__atomic_load_n(&running,__ATOMIC_ACQUIRE))
+	{
+		//Unlock
+		pthread_mutex_unlock(&mutex);
+		//Nothing to do
+		return true;
+	}
+
+	//Create timer
+	fd = timerfd_create(CLOCK_MONOTONIC,TFD_CLOEXEC);
+
+	//Check
+	if (fd==-1)
+	{
+		//Unlock
+		pthread_mutex_unlock(&mutex);
+		//Error
+		return Error("-MediaClock::Start() | could not create timer [errno:%d]\n",errno);
+	}
+
+	Log("-MediaClock::Start()\n");
+
+	//We are running
+	__atomic_store_n(&running,true,__ATOMIC_RELEASE);
+
+	//Arm it for current listeners
+	Arm();
+
+	//Start thread
+	createPriorityThread(&thread,run,this,0);
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//OK
+	return true;
+}
+
+bool MediaClock::Stop()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Check if running
+	if (!__atomic_load_n(&running,__ATOMIC_ACQUIRE))
+	{
+		//Unlock
+		pthread_mutex_unlock(&mutex);
+		//Nothing to do
+		return false;
+	}
+
+	Log(">MediaClock::Stop()\n");
+
+	//Not running anymore, clock thread checks it when woken up
+	__atomic_store_n(&running,false,__ATOMIC_RELEASE);
+
+	//Fire timer now to wake up the thread
+	itimerspec spec;
+	memset(&spec,0,sizeof(spec));
+	spec.it_value.tv_nsec = 1;
+	timerfd_settime(fd,0,&spec,NULL);
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//Wait for it
+	pthread_join(thread,NULL);
+
+	//Close timer
+	close(fd);
+	fd = -1;
+
+	Log("<MediaClock::Stop()\n");
+
+	//OK
+	return true;
+}
+
+bool MediaClock::AddListener(Listener* listener,DWORD period)
+{
+	//Check
+	if (!listener || !period)
+		//Error
+		return Error("-MediaClock::AddListener() | wrong listener or period [period:%d]\n",period);
+
+	Log("-MediaClock::AddListener() | [listener:%p,period:%dms]\n",listener,period);
+
+	//Start it if needed
+	if (!__atomic_load_n(&running,__ATOMIC_ACQUIRE))
+		Start();
+
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Create timer
+	Timer timer;
+	//Period in us
+	timer.period = period*1000;
+	//Align it to multiples of the period so listeners with same period are woken together
+	timer.next = (GetTime()/timer.period+1)*timer.period;
+
+	//Add or replace it
+	timers[listener] = timer;
+
+	//Rearm, it may be earlier than current deadline
+	Arm();
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//OK
+	return true;
+}
+
+bool MediaClock::RemoveListener(Listener* listener)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Remove it, no more ticks will be collected for it after this
+	bool found = timers.erase(listener);
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//Wait for the ticks already collected to be dispatched
+	pthread_mutex_lock(&dispatch);
+	pthread_mutex_unlock(&dispatch);
+
+	Log("-MediaClock::RemoveListener() | [listener:%p,found:%d]\n",listener,found);
+
+	//Done
+	return found;
+}
+
+MediaClock::Stats MediaClock::GetStats()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Copy them
+	Stats copy = stats;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+	//Return them
+	return copy;
+}
+
+void MediaClock::Arm()
+{
+	itimerspec spec;
+
+	//Nothing by default, which disarms it
+	memset(&spec,0,sizeof(spec));
+
+	//Check if running
+	if (!__atomic_load_n(&running,__ATOMIC_ACQUIRE))
+		//Don't touch it
+		return;
+
+	//Find earliest deadline, mutex must be locked
+	QWORD next = 0;
+	for (Timers::iterator it=timers.begin();it!=timers.end();++it)
+		//If earlier
+		if (!next || it->second.next<next)
+			//Store it
+			next = it->second.next;
+
+	//If there is any
+	if (next)
+	{
+		//Set absolute expiration
+		spec.it_value.tv_sec  = next/1000000;
+		spec.it_value.tv_nsec = (next%1000000)*1000;
+	}
+
+	//Set it
+	timerfd_settime(fd,TFD_TIMER_ABSTIME,&spec,NULL);
+}
+
+void* MediaClock::run(void *par)
+{
+	Log("-MediaClock::run() | clock thread [%d,0x%x]\n",getpid(),par);
+
+	//Block signals to avoid exiting on SIGUSR1
+	blocksignals();
+
+	//Run
+	((MediaClock*)par)->Run();
+
+	//Exit
+	return NULL;
+}
+
+int MediaClock::Run()
+{
+	QWORD expirations;
+
+	//Until stopped
+	while (__atomic_load_n(&running,__ATOMIC_ACQUIRE))
+	{
+		//Wait for timer
+		if (read(fd,&expirations,sizeof(expirations))!=sizeof(expirations) && errno!=EINTR)
+			//Error
+			return Error("-MediaClock::Run() | error reading timer [errno:%d]\n",errno);
+
+		//Lock dispatching, so listeners are not removed until we are done
+		pthread_mutex_lock(&dispatch);
+
+		//Lock timers
+		pthread_mutex_lock(&mutex);
+
+		//Get now
+		QWORD now = GetTime();
+
+		//Nothing due yet
+		due.clear();
+
+		//One more
+		stats.wakeups++;
+
+		//For each listener
+		for (Timers::iterator it=timers.begin();__atomic_load_n(&running,__ATOMIC_ACQUIRE) && it!=timers.end();++it)
+		{
+			//Get timer
+			Timer& timer = it->second;
+
+			//If it is not due yet
+			if (timer.next>now)
+				//Skip
+				continue;
+
+			//Get lateness
+			DWORD lateness = now-timer.next;
+			//Get elapsed periods
+			DWORD ticks = lateness/timer.period+1;
+
+			//Find bucket
+			DWORD bucket = 0;
+			while (BucketLimits[bucket] && lateness>=BucketLimits[bucket])
+				++bucket;
+
+			//Update stats
+			stats.ticks++;
+			stats.missed += ticks-1;
+			stats.lateness[bucket]++;
+			if (lateness>stats.maxLateness)
+				stats.maxLateness = lateness;
+
+			//Call listener later
+			Tick tick = {it->first,timer.next,ticks};
+			due.push_back(tick);
+
+			//Next deadline
+			timer.next += ticks*timer.period;
+		}
+
+		//Arm for next one
+		Arm();
+
+		//Unlock timers
+		pthread_mutex_unlock(&mutex);
+
+		//Call listeners without the timers lock, so they can't block the ones getting stats
+		for (Ticks::iterator it=due.begin();it!=due.end();++it)
+			it->listener->onTick(it->deadline,it->ticks);
+
+		//Unlock dispatching
+		pthread_mutex_unlock(&dispatch);
+	}
+
+	//Exit
+	return 0;
+}
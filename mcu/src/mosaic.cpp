@@ -129,8 +129,17 @@ Mosaic::Mosaic(Type type,DWORD size)
 	//NOt need to add overlay
 	overlayNeedsUpdate = false;
 
+	//Nothing written yet
+	pixelsTouched = 0;
+	lastPixelsTouched = 0;
+
+	//No frame origin yet
+	frameTime = 0;
+
 	//No overlay
 	overlay = NULL;;
+	//No labels on it
+	labelsShown = false;
 
 	//No vad particpant
 	vadParticipant = 0;
@@ -575,16 +584,44 @@ BYTE* Mosaic::GetFrame()
 	//Lock method
 	ScopedLock scoped(mutex); 
 	
-	//Check if there is a overlay
-	if (!overlay)
+	//Check if there is a overlay being displayed
+	if (!overlay || !overlay->IsDisplayed())
+	{
+		//Nothing to blend
+		dirty.clear();
+		//If it is shown later the image will have to be blended completely
+		overlayNeedsUpdate = true;
 		//Return mosaic without change
 		return mosaic;
-	//Check if we need to change
+	}
+
+	//If the overlay itself has changed
 	if (overlayNeedsUpdate)
-		//Calculate and return
-		return overlay->Display(mosaic);
-	//Return overlay
-	return overlay->GetOverlay();
+	{
+		//Blend it all
+		Rect all = {0,0,mosaicTotalWidth,mosaicTotalHeight};
+		dirty.clear();
+		dirty.push_back(all);
+		//Output has changed
+		mosaicChanged = true;
+		//Done
+		overlayNeedsUpdate = false;
+	}
+
+	//Blend only the areas that have changed, rest of the image is still valid
+	for (Rects::iterator it=dirty.begin();it!=dirty.end();++it)
+	{
+		//Blend
+		overlay->Display(mosaic,it->left,it->top,it->width,it->height);
+		//Count them
+		pixelsTouched += it->width*it->height;
+	}
+
+	//Clean
+	dirty.clear();
+
+	//Return overlay image
+	return overlay->GetImage();
 }
 
 void Mosaic::Reset()
@@ -592,6 +629,10 @@ void Mosaic::Reset()
 	//Not changed anymore
 	mosaicChanged = false;
 
+	//Store pixels written for the previous frame and start again
+	lastPixelsTouched = pixelsTouched;
+	pixelsTouched = 0;
+
 	//Move old position to new one
 	memcpy(oldPos,mosaicPos,numSlots*sizeof(int));
 }
@@ -610,6 +651,8 @@ int Mosaic::SetOverlayPNG(const char* filename)
 		delete(overlay);
 	//Create new one
 	overlay = new Overlay(mosaicTotalWidth,mosaicTotalHeight);
+	//Labels are not drawn on it
+	labelsShown = false;
 	//And load it
 	if(!overlay->LoadPNG(filename))
 		//Error
@@ -635,6 +678,8 @@ int Mosaic::SetOverlaySVG(const char* svg)
 		delete(overlay);
 	//Create new one
 	overlay = new Overlay(mosaicTotalWidth,mosaicTotalHeight);
+	//Labels are not drawn on it
+	labelsShown = false;
 	//And load it
 	if(!overlay->LoadSVG(svg))
 		//Error
@@ -656,6 +701,8 @@ int Mosaic::SetOverlayText()
 		delete(overlay);
 	//Create new one
 	overlay = new Overlay(mosaicTotalWidth,mosaicTotalHeight);
+	//Labels are not drawn on it
+	labelsShown = false;
 	
 	//Display it
 	overlayNeedsUpdate = true;
@@ -663,6 +710,60 @@ int Mosaic::SetOverlayText()
 	return 1;
 }
 
+int Mosaic::SetOverlayLabels(const Labels& labels,const Properties& properties)
+{
+	//Lock method
+	ScopedLock scoped(mutex);
+
+	//If labels are already drawn and the style is the same
+	if (overlay && labelsShown && properties==labelsProperties)
+	{
+		//If nothing has changed
+		if (labels==this->labels)
+			//Keep overlay as it is
+			return 1;
+
+		//Remove previous ones, labels may overlap so all are cleared and drawn again from the cached tiles
+		for (Labels::iterator it=this->labels.begin();it!=this->labels.end();++it)
+		{
+			//Clean it
+			overlay->Clear(it->left,it->top,it->width,it->height);
+			//Blend that part again
+			SetChanged(it->left,it->top,it->width,it->height);
+		}
+	} else {
+		//Reset any previous one
+		if (overlay)
+			//Delete it
+			delete(overlay);
+		//Create new one
+		overlay = new Overlay(mosaicTotalWidth,mosaicTotalHeight);
+		//Store style
+		labelsProperties = properties;
+		//We are drawing labels on it
+		labelsShown = true;
+		//Display it
+		overlayNeedsUpdate = true;
+	}
+
+	//Store new ones
+	this->labels = labels;
+
+	//Draw them
+	for (Labels::iterator it=this->labels.begin();it!=this->labels.end();++it)
+	{
+		//Render text, only rasterized if not cached already
+		if (!overlay->RenderText(it->text,it->left,it->top,it->width,it->height,properties))
+			//Next
+			continue;
+		//Only that part needs to be blended again
+		SetChanged(it->left,it->top,it->width,it->height);
+	}
+
+	//OK
+	return 1;
+}
+
 int Mosaic::RenderOverlayText(const std::wstring& text,DWORD x,DWORD y,DWORD width,DWORD height, const Properties& properties)
 {
 	//Lock method
@@ -673,7 +774,65 @@ int Mosaic::RenderOverlayText(const std::wstring& text,DWORD x,DWORD y,DWORD wid
 		//Error
 		return Error("-no overlay\n");
 	//Render text
-	return overlay->RenderText(text,x,y,width,height,properties);
+	if (!overlay->RenderText(text,x,y,width,height,properties))
+		//Error
+		return 0;
+	//Only that part needs to be blended again
+	SetChanged(x,y,width,height);
+	//OK
+	return 1;
+}
+
+void Mosaic::SetChanged(int left,int top,int width,int height)
+{
+	//Clip it
+	if (left<0)
+	{
+		width += left;
+		left = 0;
+	}
+	if (top<0)
+	{
+		height += top;
+		top = 0;
+	}
+	if (left+width>mosaicTotalWidth)
+		width = mosaicTotalWidth-left;
+	if (top+height>mosaicTotalHeight)
+		height = mosaicTotalHeight-top;
+
+	//Check
+	if (width<=0 || height<=0)
+		//Nothing changed
+		return;
+
+	//We have changed
+	mosaicChanged = true;
+
+	//Count pixels written
+	pixelsTouched += width*height;
+
+	//Create rect
+	Rect rect = {left,top,width,height};
+
+	//Check against the ones we have
+	for (Rects::iterator it=dirty.begin();it!=dirty.end();)
+	{
+		//If already covered
+		if (it->Contains(rect))
+			//Nothing more to do
+			return;
+		//If it covers it
+		if (rect.Contains(*it))
+			//Remove old one
+			it = dirty.erase(it);
+		else
+			//Next
+			++it;
+	}
+
+	//Add it
+	dirty.push_back(rect);
 }
 
 int Mosaic::ResetOverlay()
@@ -689,6 +848,8 @@ int Mosaic::ResetOverlay()
 		delete(overlay);
 	//remove it
 	overlay = NULL;
+	//No labels
+	labelsShown = false;
 	//OK
 	return 1;
 }
@@ -759,6 +920,9 @@ int Mosaic::DrawVUMeter(int pos,DWORD val,DWORD size)
 		memset(v+(j*totalWidth)/4+i/2		,-64,w/2);
 	}
 
+	//Only the meter has changed
+	SetChanged(i,j-8,w,8);
+
 	return 1;
 }
 
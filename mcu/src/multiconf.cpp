@@ -664,6 +664,7 @@ int MultiConf::CreateParticipant(int mosaicId,int sidebarId,const std::wstring &
 	part->SetAudioOutput(audioMixer.GetOutput(partId));
 	part->SetTextInput(textMixer.GetInput(partId));
 	part->SetTextOutput(textMixer.GetOutput(partId));
+	part->SetSharedVideoEncoder(videoMixer.GetSharedEncoder(partId));
 
 	//Init participant
 	part->Init();
@@ -673,6 +674,11 @@ int MultiConf::CreateParticipant(int mosaicId,int sidebarId,const std::wstring &
 	audioMixer.InitMixer(partId,sidebarId);
 	textMixer.InitMixer(partId);
 
+	//If the participant records the latency of its video
+	if (part->GetLatencyStats())
+		//Report it with the mixer stats
+		videoMixer.SetLatencyStats(partId,part->GetLatencyStats());
+
 	//Get lock
 	participantsLock.WaitUnusedAndLock();
 
@@ -1556,6 +1562,32 @@ MultiConf::ParticipantStatistics* MultiConf::GetParticipantStatistic(int partId)
 	return stats;
 }
 
+LatencyStats::Snapshot* MultiConf::GetParticipantLatencyStatistics(int partId)
+{
+	LatencyStats::Snapshot *snapshot = NULL;
+
+	//Lock
+	participantsLock.IncUse();
+
+	//Find participant
+	Participant* part = GetParticipant(partId);
+
+	//Check participant and if it records latency
+	if (part && part->GetLatencyStats())
+	{
+		//Create snapshot
+		snapshot = new LatencyStats::Snapshot();
+		//Get all since start
+		part->GetLatencyStats()->GetSnapshot(*snapshot);
+	}
+
+	//Unlock
+	participantsLock.DecUse();
+
+	//Return stats
+	return snapshot;
+}
+
 /********************************************************
  * SetMute
  *   Set participant mute
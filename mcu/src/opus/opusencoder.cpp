@@ -69,6 +69,12 @@ OpusEncoder::~OpusEncoder()
 		opus_encoder_destroy(enc);
 }
 
+bool OpusEncoder::Reset()
+{
+	//Drop prediction state but keep settings
+	return enc && opus_encoder_ctl(enc, OPUS_RESET_STATE)==OPUS_OK;
+}
+
 int OpusEncoder::Encode(SWORD *in,int inLen,BYTE* out,int outLen)
 {
 	return opus_encode(enc,in,inLen,out,outLen);
@@ -20,6 +20,7 @@ public:
 	virtual DWORD TrySetRate(DWORD rate);
 	virtual DWORD GetRate()			{ return rate;	}
 	virtual DWORD GetClockRate()		{ return 48000;	}
+	virtual bool  Reset();
 private:
 	OpusEncoder *enc;
 	DWORD rate;
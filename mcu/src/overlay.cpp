@@ -3,9 +3,15 @@
 #include "bitstream.h"
 
 
-#include "amf.h"
+#include "labelcache.h"
 #include <stdlib.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
 extern "C" {
 #include <libswscale/swscale.h>
 #include <libavcodec/avcodec.h>
@@ -18,6 +24,16 @@ extern "C" {
 #include <Magick++.h>
 #endif
 
+//Chroma pixels in each coverage block
+static const DWORD CoverageBlockSize = 16;
+
+enum Coverage
+{
+	Transparent = 0,
+	Opaque = 1,
+	Mixed = 2
+};
+
 
 Canvas::Canvas(DWORD width,DWORD height)
 {
@@ -32,6 +48,12 @@ Canvas::Canvas(DWORD width,DWORD height)
 	memset(overlay,0,overlaySize);
 	//Do not display
 	display = false;
+	//Coverage blocks for each pair of rows
+	blocks = (width/2+CoverageBlockSize-1)/CoverageBlockSize;
+	//Create coverage, one more for the whole row
+	coverage = (BYTE*)malloc((height/2)*(blocks+1));
+	//Calculate it on first draw
+	dirty = true;
 }
 
 Overlay::Overlay(DWORD width,DWORD height) : Canvas(width,height)
@@ -46,6 +68,7 @@ Canvas::~Canvas()
 {
 	//Free memor
 	free(overlay);
+	free(coverage);
 }
 
 Overlay::~Overlay()
@@ -206,6 +229,8 @@ int Canvas::LoadPNG(const char* filename)
 	
 	//Display it then
 	display = true;
+	//Coverage has changed
+	dirty = true;
 end:
 	if (logo)
 		av_free(logo);
@@ -283,6 +308,8 @@ int Canvas::LoadSVG(const char* svg)
 		
 		//Done
 		display = true;
+		//Coverage has changed
+		dirty = true;
 	} catch ( Magick::Exception &error ) {
 		display = false;
 		return Error("-Canvas: failed to load picture file %s: %s.\n", svg, error.what() );
@@ -302,147 +329,59 @@ int Canvas::RenderText(const std::wstring& text,DWORD x,DWORD y,DWORD width,DWOR
 int Canvas::RenderText(const std::wstring& text,DWORD x,DWORD y,DWORD width,DWORD height,const Properties& properties)
 {
 #ifdef HAVE_IMAGEMAGICK
-	//Colors in RGBA
-	const char *strokeColor	= properties.GetProperty("strokeColor"		,"#40404040"	);
-	const char *fillColor	= properties.GetProperty("fillColor"		,"#11FF1140"	);
-	const char *color	= properties.GetProperty("color"		,"white"	);
-	bool drawBackground	= properties.GetProperty("drawBackground"	,true		);
-	BYTE strokeWidth	= properties.GetProperty("strokeWidth"		,2		);
-	const char *font	= properties.GetProperty("font"			,"Verdana"	);
-	BYTE fontSize		= properties.GetProperty("fontSize"		,14		);
-	BYTE padding		= properties.GetProperty("padding"		,2		);
-	BYTE margin		= properties.GetProperty("margin"		,2		);
-	BYTE cornerWidth	= properties.GetProperty("cornerWidth"		,2		);
-	BYTE cornerHeight	= properties.GetProperty("cornerHeight"		,2		);
-	char str[1024];
-
-	try
+	//Copy the label tile, it is only rendered the first time it is used
+	if (!LabelCache::getInstance().Draw(text,width,height,properties,overlay,this->width,this->height,x,y))
 	{
-		Magick::Blob rgbablob;
-		//Create rendered
-		Magick::Image render( Magick::Geometry(width,height),Magick::Color("#00000000"));
-		render.depth(8);
-		render.interlaceType(Magick::NoInterlace);
-		//Check if we need to draw background
-		if (drawBackground)
-		{
-			//background color
-			render.fillColor(Magick::Color(fillColor));
-			//If got border
-			if (strokeWidth)
-			{
-				render.strokeColor(Magick::Color(strokeColor));
-				//Set stroke widht
-				render.strokeWidth(strokeWidth);
-			}
-			// Check if it can be printed witthout be truncated
-			render.draw(Magick::DrawableRoundRectangle(margin, margin, width-margin*2, height-margin, cornerWidth, cornerHeight) );
-		}
-
-		//Set font
-		render.font(font);
-		render.fontPointsize(fontSize);
-
-		//Convert text to tuf8
-		UTF8Parser utf8(text);
-		//Get mas length
-		DWORD len = utf8.GetUTF8Size();
-		//Check size
-		if (len+1>1024)
-			//reduce
-			len = 1024-1;
-		//Serialize it
-		utf8.Serialize((BYTE*)str,len);
-		str[len] = 0;
-/*
-		Magick::TypeMetric textSize;
-		render.fontTypeMetrics( txt, &textSize );
-		//Get width at this size
-		float curwidth = textSize.textWidth();
-		//Check it
-		while ( curwidth >= width )
-		{
-			// Text is too large to fit in, lower the font size, truncate it. Leave some space for the ...
-			render.fontPointsize(20);
-			if ( text.Truncate(1) == 0)
-			{
-				contentType = NONE;
-				Error("-Canvas: not enough width to render text in slot.\n");
-				return 0;
-			}
-
-			text.Serialize(text2);
-			text2 += " ...";
-			render.fontTypeMetrics( text2, &textSize );
-			curwidth = textSize.textWidth();
-		}
- */
-		render.fillColor(Magick::Color(color));
-		render.strokeWidth(0);
-		render.draw( Magick::DrawableText(margin+padding+strokeWidth, height-padding-strokeWidth-fontSize/2, str, "UTF-8"));
-		render.magick("RGBA");
-		render.write(&rgbablob);
-		
-
-		//First from to RGBA to YUVB
-		SwsContext *sws = sws_getContext(
-						width,
-						height,
-						AV_PIX_FMT_RGBA,
-						width,
-						height,
-						AV_PIX_FMT_YUVA420P,
-						SWS_FAST_BILINEAR,
-						0,
-						0,
-						0
-					);
-		
-		//Check
-		if (!sws)
-			//Set errror
-			return  Error("Couldn't alloc sws context\n");
-
-		//Create new frames for converting  RGBA->YUVA
-		AVFrame* rgba = av_frame_alloc();
-		AVFrame* yuva = av_frame_alloc();
-
-		//Set data origin data
-		rgba->data[0] = (BYTE *) rgbablob.data();
-		//Set origin planes
-		rgba->linesize[0] = 4*width;
-		
-		//Set size for planes dest
-		yuva->linesize[0] = this->width;
-		yuva->linesize[1] = this->width/2;
-		yuva->linesize[2] = this->width/2;
-		yuva->linesize[3] = this->width;
-
-		//Set destination data
-		int numpixels = this->width*this->height;
-		yuva->data[0] = overlay                 +x  +y*this->width;
-		yuva->data[1] = overlay + numpixels     +x/2+y/2*this->width/2;
-		yuva->data[2] = overlay + numpixels*5/4 +x/2+y/2*this->width/2;
-		yuva->data[3] = overlay + numpixels*3/2 +x  +y*this->width;
-
-		//Convert
-		sws_scale(sws, rgba->data, rgba->linesize, 0, this->height, yuva->data, yuva->linesize);
-
-		//Free memory
-		av_free(rgba);
-		av_free(yuva);
-		sws_freeContext(sws);
-		//OK
-		display = true;
-	} catch ( Magick::Exception &error ) {
 		display = false;
-		return Error("-Canvas: failed to render text %ls: %s.\n", text.c_str(), error.what() );
+		return Error("-Canvas: failed to render text %ls\n", text.c_str());
 	}
+	//OK
+	display = true;
+	//Coverage has changed
+	dirty = true;
 #endif
 	//OK
 	return 1;
 }
 
+void Canvas::Clear(DWORD x,DWORD y,DWORD w,DWORD h)
+{
+	//Check
+	if (x>=width || y>=height)
+		//Nothing to clear
+		return;
+
+	//Clip it
+	if (x+w>width)
+		w = width-x;
+	if (y+h>height)
+		h = height-y;
+
+	//Get planes
+	DWORD numpixels = width*height;
+	BYTE* py = overlay;
+	BYTE* pu = py+numpixels;
+	BYTE* pv = pu+numpixels/4;
+	BYTE* pa = pv+numpixels/4;
+
+	//Clean luma and alpha rows, so it gets transparent
+	for (DWORD j=y;j<y+h;++j)
+	{
+		memset(py+j*width+x,0,w);
+		memset(pa+j*width+x,0,w);
+	}
+
+	//Clean chroma rows
+	for (DWORD j=y/2;j<(y+h)/2;++j)
+	{
+		memset(pu+j*(width/2)+x/2,0,w/2);
+		memset(pv+j*(width/2)+x/2,0,w/2);
+	}
+
+	//Coverage has changed
+	dirty = true;
+}
+
 BYTE* Overlay::Display(uint8_t* frame)
 {
 	//check if we have overlay
@@ -456,161 +395,456 @@ BYTE* Overlay::Display(uint8_t* frame)
 	return image;
 }
 
+BYTE* Overlay::Display(BYTE* frame,DWORD x,DWORD y,DWORD w,DWORD h)
+{
+	//check if we have overlay
+	if (!display)
+		//Return the same frame
+		return frame;
+	//Draw only that part, the rest of the image must be already up to date
+	Draw(image,frame,x,y,w,h);
+
+	//Return internal image
+	return image;
+}
+
 void Canvas::Reset()
 {
 	//Clean overlay memory
 	memset(overlay,0,overlaySize);
+	//Coverage has changed
+	dirty = true;
 }
 
-void Canvas::Draw(BYTE*image,BYTE* frame)
+/*
+ * Alpha blending
+ *	dst = (ovr*a + src*(255-a))/255 for luma and
+ *	dst = (ovr*A + src*(1020-A))/1020 for chroma, where A is the sum of the
+ *	four luma alphas. The SIMD versions use exact shift based divisions so
+ *	they are bit exact with the scalar one.
+ */
+
+struct BlendPlanes
 {
-	//Get source
-	BYTE* srcY1 = frame;
-	BYTE* srcY2 = frame+width;
-	BYTE* srcU  = frame+width*height;
-	BYTE* srcV  = frame+width*height*5/4;
-	//Get overlay
-	BYTE* ovrY1 = overlay;
-	BYTE* ovrY2 = overlay+width;
-	BYTE* ovrU  = overlay+width*height;
-	BYTE* ovrV  = overlay+width*height*5/4;
-	BYTE* ovrA1 = overlay+width*height*3/2;
-	BYTE* ovrA2 = overlay+width*height*3/2+width;
-	//Get destingation
-	BYTE* dstY1 = image;
-	BYTE* dstY2 = image+width;
-	BYTE* dstU  = image+width*height;
-	BYTE* dstV  = image+width*height*5/4;
-
-	for (int j=0; j<height/2; ++j)
+	BYTE*		dstY[2];
+	BYTE*		dstU;
+	BYTE*		dstV;
+	const BYTE*	srcY[2];
+	const BYTE*	srcU;
+	const BYTE*	srcV;
+	const BYTE*	ovrY[2];
+	const BYTE*	ovrU;
+	const BYTE*	ovrV;
+	const BYTE*	ovrA[2];
+};
+
+//Blend chroma columns [from,to) of a pair of rows
+typedef void (*BlendFunc)(const BlendPlanes& p,DWORD from,DWORD to);
+
+static void BlendRowScalar(const BlendPlanes& p,DWORD from,DWORD to)
+{
+	for (DWORD i=from; i<to; ++i)
 	{
-		for (int i=0; i<width/2; ++i)
+		DWORD alpha = 0;
+		//For each luma row
+		for (DWORD k=0; k<2; ++k)
 		{
-			//Get alpha values
-			BYTE a11 = *(ovrA1++);
-			BYTE a12 = *(ovrA1++);
-			BYTE a21 = *(ovrA2++);
-			BYTE a22 = *(ovrA2++);
-			//Check
-			if (a11==0)
+			//For both pixels
+			for (DWORD x=i*2; x<i*2+2; ++x)
 			{
-				//Set alpha
-				*(dstY1++) = *(srcY1++);
-				//Increase pointer
-				++ovrY1;
-			} else if (a11==255) {
-				//Set original image
-				*(dstY1++) = *(ovrY1++);
-				//Increase pointer
-				++srcY1;
-			} else {
-				DWORD n = 255-a11;
-				DWORD oY = *(ovrY1++);
-				DWORD sY = *(srcY1++);
-				*(dstY1++) = (oY*a11+sY*n)/255;
-				//Calculate and move pointer
-				//*(dstY1++) = (((DWORD)(*(ovrY1++)))*a11 + (((DWORD)(*(srcY1++)))*(~a11)))/255;
+				//Get alpha
+				DWORD a = p.ovrA[k][x];
+				//Blend
+				p.dstY[k][x] = (p.ovrY[k][x]*a + p.srcY[k][x]*(255-a))/255;
+				//Sum it for chroma
+				alpha += a;
 			}
-			//Check
-			if (a12==0)
-			{
-				//Set alpha
-				*(dstY1++) = *(srcY1++);
-				//Increase pointer
-				++ovrY1;
-			} else if (a12==255) {
-				//Set original image
-				*(dstY1++) = *(ovrY1++);
-				//Increase pointer
-				++srcY1;
-			} else {
-				DWORD n = 255-a12;
-				DWORD oY = *(ovrY1++);
-				DWORD sY = *(srcY1++);
-				*(dstY1++) = (oY*a12+sY*n)/255;
-				//Calculate and move pointer
-				//*(dstY1++) = (((DWORD)(*(ovrY1++)))*a12 + (((DWORD)(*(srcY1++)))*(~a12)))/255;
-			}
-			//Check
-			if (a21==0)
-			{
-				//Set alpha
-				*(dstY2++) = *(srcY2++);
-				//Increase pointer
-				++ovrY2;
-			} else if (a21==255) {
-				//Set original image
-				*(dstY2++) = *(ovrY2++);
-				//Increase pointer
-				++srcY2;
-			} else {
-				DWORD n = 255-a21;
-				DWORD oY = *(ovrY2++);
-				DWORD sY = *(srcY2++);
-				*(dstY2++) = (oY*a21+sY*n)/255;
-				//Calculate and move pointer
-				//*(dstY2++) = (((DWORD)(*(ovrY2++)))*a21 + (((DWORD)(*(srcY2++)))*(~a21)))/255;
-			}
-			//Check
-			if (a22==0)
+		}
+		DWORD negalpha = 1020-alpha;
+		//Blend chroma
+		p.dstU[i] = (p.ovrU[i]*alpha + p.srcU[i]*negalpha)/1020;
+		p.dstV[i] = (p.ovrV[i]*alpha + p.srcV[i]*negalpha)/1020;
+	}
+}
+
+#ifdef __SSE2__
+static inline __m128i BlendLuma8SSE2(__m128i o,__m128i s,__m128i a)
+{
+	//x = o*a+s*(255-a), fits on 16 bits
+	__m128i x = _mm_add_epi16(_mm_mullo_epi16(o,a),_mm_mullo_epi16(s,_mm_sub_epi16(_mm_set1_epi16(255),a)));
+	//x/255 = (x+(x>>8)+1)>>8
+	return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x,_mm_srli_epi16(x,8)),_mm_set1_epi16(1)),8);
+}
+
+static inline __m128i BlendChroma4SSE2(__m128i os,__m128i an)
+{
+	//x = o*A+s*(1020-A) on 32 bits
+	__m128i x = _mm_madd_epi16(os,an);
+	//x/1020 = ((x>>2)/255)
+	__m128i y = _mm_srli_epi32(x,2);
+	return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(y,_mm_srli_epi32(y,8)),_mm_set1_epi32(1)),8);
+}
+
+static void BlendRowSSE2(const BlendPlanes& p,DWORD from,DWORD to)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	DWORD i = from;
+
+	//8 chroma pixels, 16 luma ones on each row, each time
+	for (; i+8<=to; i+=8)
+	{
+		__m128i alpha = zero;
+		//For each luma row
+		for (DWORD k=0; k<2; ++k)
+		{
+			//Load
+			__m128i o = _mm_loadu_si128((const __m128i*)(p.ovrY[k]+i*2));
+			__m128i s = _mm_loadu_si128((const __m128i*)(p.srcY[k]+i*2));
+			__m128i a = _mm_loadu_si128((const __m128i*)(p.ovrA[k]+i*2));
+			//Blend both halves
+			__m128i lo = BlendLuma8SSE2(_mm_unpacklo_epi8(o,zero),_mm_unpacklo_epi8(s,zero),_mm_unpacklo_epi8(a,zero));
+			__m128i hi = BlendLuma8SSE2(_mm_unpackhi_epi8(o,zero),_mm_unpackhi_epi8(s,zero),_mm_unpackhi_epi8(a,zero));
+			//Store
+			_mm_storeu_si128((__m128i*)(p.dstY[k]+i*2),_mm_packus_epi16(lo,hi));
+			//Sum each pair of alphas
+			alpha = _mm_add_epi16(alpha,_mm_add_epi16(_mm_and_si128(a,mask),_mm_srli_epi16(a,8)));
+		}
+		//Get inverse
+		__m128i negalpha = _mm_sub_epi16(_mm_set1_epi16(1020),alpha);
+		__m128i anlo = _mm_unpacklo_epi16(alpha,negalpha);
+		__m128i anhi = _mm_unpackhi_epi16(alpha,negalpha);
+		//Load U
+		__m128i o = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p.ovrU+i)),zero);
+		__m128i s = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p.srcU+i)),zero);
+		//Blend and store
+		__m128i u = _mm_packs_epi32(BlendChroma4SSE2(_mm_unpacklo_epi16(o,s),anlo),BlendChroma4SSE2(_mm_unpackhi_epi16(o,s),anhi));
+		_mm_storel_epi64((__m128i*)(p.dstU+i),_mm_packus_epi16(u,zero));
+		//Load V
+		o = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p.ovrV+i)),zero);
+		s = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p.srcV+i)),zero);
+		//Blend and store
+		__m128i v = _mm_packs_epi32(BlendChroma4SSE2(_mm_unpacklo_epi16(o,s),anlo),BlendChroma4SSE2(_mm_unpackhi_epi16(o,s),anhi));
+		_mm_storel_epi64((__m128i*)(p.dstV+i),_mm_packus_epi16(v,zero));
+	}
+
+	//Rest of pixels
+	BlendRowScalar(p,i,to);
+}
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_BLEND_AVX2
+
+__attribute__((target("avx2")))
+static inline __m256i BlendLuma16AVX2(__m256i o,__m256i s,__m256i a)
+{
+	//x = o*a+s*(255-a), fits on 16 bits
+	__m256i x = _mm256_add_epi16(_mm256_mullo_epi16(o,a),_mm256_mullo_epi16(s,_mm256_sub_epi16(_mm256_set1_epi16(255),a)));
+	//x/255 = (x+(x>>8)+1)>>8
+	return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(x,_mm256_srli_epi16(x,8)),_mm256_set1_epi16(1)),8);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i BlendChroma8AVX2(__m256i os,__m256i an)
+{
+	//x = o*A+s*(1020-A) on 32 bits
+	__m256i x = _mm256_madd_epi16(os,an);
+	//x/1020 = ((x>>2)/255)
+	__m256i y = _mm256_srli_epi32(x,2);
+	return _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(y,_mm256_srli_epi32(y,8)),_mm256_set1_epi32(1)),8);
+}
+
+__attribute__((target("avx2")))
+static inline __m128i BlendChroma16AVX2(const BYTE* ovr,const BYTE* src,__m256i anlo,__m256i anhi)
+{
+	//Load 16 pixels
+	__m256i o = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)ovr));
+	__m256i s = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)src));
+	//Blend, unpack and pack work on each lane so order is kept
+	__m256i r = _mm256_packs_epi32(BlendChroma8AVX2(_mm256_unpacklo_epi16(o,s),anlo),BlendChroma8AVX2(_mm256_unpackhi_epi16(o,s),anhi));
+	//Pack to bytes and join both lanes
+	r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r,r),0xD8);
+	//Return first 16 bytes
+	return _mm256_castsi256_si128(r);
+}
+
+__attribute__((target("avx2")))
+static void BlendRowAVX2(const BlendPlanes& p,DWORD from,DWORD to)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	DWORD i = from;
+
+	//16 chroma pixels, 32 luma ones on each row, each time
+	for (; i+16<=to; i+=16)
+	{
+		__m256i alpha = _mm256_setzero_si256();
+		//For each luma row
+		for (DWORD k=0; k<2; ++k)
+		{
+			//Load
+			__m256i o = _mm256_loadu_si256((const __m256i*)(p.ovrY[k]+i*2));
+			__m256i s = _mm256_loadu_si256((const __m256i*)(p.srcY[k]+i*2));
+			__m256i a = _mm256_loadu_si256((const __m256i*)(p.ovrA[k]+i*2));
+			//Blend both halves
+			__m256i lo = BlendLuma16AVX2(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(o)),_mm256_cvtepu8_epi16(_mm256_castsi256_si128(s)),_mm256_cvtepu8_epi16(_mm256_castsi256_si128(a)));
+			__m256i hi = BlendLuma16AVX2(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(o,1)),_mm256_cvtepu8_epi16(_mm256_extracti128_si256(s,1)),_mm256_cvtepu8_epi16(_mm256_extracti128_si256(a,1)));
+			//Pack works on each lane, so fix order and store
+			_mm256_storeu_si256((__m256i*)(p.dstY[k]+i*2),_mm256_permute4x64_epi64(_mm256_packus_epi16(lo,hi),0xD8));
+			//Sum each pair of alphas
+			alpha = _mm256_add_epi16(alpha,_mm256_add_epi16(_mm256_and_si256(a,mask),_mm256_srli_epi16(a,8)));
+		}
+		//Get inverse
+		__m256i negalpha = _mm256_sub_epi16(_mm256_set1_epi16(1020),alpha);
+		__m256i anlo = _mm256_unpacklo_epi16(alpha,negalpha);
+		__m256i anhi = _mm256_unpackhi_epi16(alpha,negalpha);
+		//Blend and store U and V
+		_mm_storeu_si128((__m128i*)(p.dstU+i),BlendChroma16AVX2(p.ovrU+i,p.srcU+i,anlo,anhi));
+		_mm_storeu_si128((__m128i*)(p.dstV+i),BlendChroma16AVX2(p.ovrV+i,p.srcV+i,anlo,anhi));
+	}
+
+	//Rest of pixels
+	BlendRowScalar(p,i,to);
+}
+#endif
+
+static Canvas::Blend DetectBlend()
+{
+#ifdef HAVE_BLEND_AVX2
+	//Needed as we may be called from static initialization
+	__builtin_cpu_init();
+	//Check avx2 support
+	if (__builtin_cpu_supports("avx2"))
+		return Canvas::BlendAVX2;
+#endif
+#ifdef __SSE2__
+	//Always available as we are compiled with it
+	return Canvas::BlendSSE2;
+#endif
+	//Plain C
+	return Canvas::BlendScalar;
+}
+
+//Selected blend
+static Canvas::Blend selected = DetectBlend();
+
+static BlendFunc GetBlendFunc(Canvas::Blend blend)
+{
+	switch (blend)
+	{
+#ifdef HAVE_BLEND_AVX2
+		case Canvas::BlendAVX2:
+			return BlendRowAVX2;
+#endif
+#ifdef __SSE2__
+		case Canvas::BlendSSE2:
+			return BlendRowSSE2;
+#endif
+		default:
+			return BlendRowScalar;
+	}
+}
+
+Canvas::Blend Canvas::GetBlend()
+{
+	return selected;
+}
+
+bool Canvas::IsBlendSupported(Blend blend)
+{
+	switch (blend)
+	{
+		case BlendScalar:
+			return true;
+		case BlendSSE2:
+#ifdef __SSE2__
+			return true;
+#else
+			return false;
+#endif
+		case BlendAVX2:
+			//Check cpu has it
+			return DetectBlend()==BlendAVX2;
+	}
+	return false;
+}
+
+bool Canvas::SetBlend(Blend blend)
+{
+	//Check it can be used
+	if (!IsBlendSupported(blend))
+		//Error
+		return Error("-Canvas::SetBlend() | blend not supported [%s]\n",GetBlendName(blend));
+	//Set it
+	selected = blend;
+	//Done
+	return true;
+}
+
+const char* Canvas::GetBlendName(Blend blend)
+{
+	switch (blend)
+	{
+		case BlendScalar:
+			return "scalar";
+		case BlendSSE2:
+			return "sse2";
+		case BlendAVX2:
+			return "avx2";
+	}
+	return "unknown";
+}
+
+static void CopyRow(const BlendPlanes& p,DWORD from,DWORD to,BYTE state)
+{
+	//Transparent takes the original image, opaque the overlay
+	const BYTE* Y0 = state==Opaque ? p.ovrY[0] : p.srcY[0];
+	const BYTE* Y1 = state==Opaque ? p.ovrY[1] : p.srcY[1];
+	const BYTE* U  = state==Opaque ? p.ovrU : p.srcU;
+	const BYTE* V  = state==Opaque ? p.ovrV : p.srcV;
+
+	//If drawing in place and transparent
+	if (Y0==p.dstY[0])
+		//Nothing to do
+		return;
+
+	//Copy them
+	memcpy(p.dstY[0]+from*2	,Y0+from*2	,(to-from)*2);
+	memcpy(p.dstY[1]+from*2	,Y1+from*2	,(to-from)*2);
+	memcpy(p.dstU+from	,U+from		,to-from);
+	memcpy(p.dstV+from	,V+from		,to-from);
+}
+
+void Canvas::UpdateCoverage()
+{
+	//Get alpha plane
+	const BYTE* alpha = overlay+width*height*3/2;
+
+	//For each pair of rows
+	for (DWORD j=0; j<height/2; ++j)
+	{
+		//Get row alphas
+		const BYTE* a1 = alpha+j*2*width;
+		const BYTE* a2 = a1+width;
+		//Get row coverage
+		BYTE* row = coverage+j*(blocks+1);
+		//Start with whole row as unknown
+		bool rowTransparent = true;
+		bool rowOpaque = true;
+		//For each block
+		for (DWORD b=0; b<blocks; ++b)
+		{
+			bool transparent = true;
+			bool opaque = true;
+			//Get luma columns
+			DWORD from = b*CoverageBlockSize*2;
+			DWORD to = (b+1)*CoverageBlockSize<width/2 ? (b+1)*CoverageBlockSize*2 : (width/2)*2;
+			//Check each alpha
+			for (DWORD x=from; x<to; ++x)
 			{
-				//Set alpha
-				*(dstY2++) = *(srcY2++);
-				//Increase pointer
-				++ovrY2;
-			} else if (a22==255) {
-				//Set original image
-				*(dstY2++) = *(ovrY2++);
-				//Increase pointer
-				++srcY2;
-			} else {
-				DWORD n = 255-a22;
-				DWORD oY = *(ovrY2++);
-				DWORD sY = *(srcY2++);
-				*(dstY2++) = (oY*a22+sY*n)/255;
-				//Calculate and move pointer
-				//*(dstY2++) = (((DWORD)(*(ovrY2++)))*a22 + (((DWORD)(*(srcY2++)))*(~a22)))/255;
+				//Update
+				transparent = transparent && !a1[x] && !a2[x];
+				opaque = opaque && a1[x]==255 && a2[x]==255;
 			}
-			//Summ all alphas
-			DWORD alpha = a11+a21+a21+a22;
-			//Check UV
-			if (alpha==0)
-			{
-				//Set UV
-				*(dstU++) = *(srcU++);
-				*(dstV++) = *(srcV++);
-				//Increase pointers
-				++ovrU;
-				++ovrV;
-			} else if (alpha == 1020) {
-				//Set UV
-				*(dstU++) = *(ovrU++);
-				*(dstV++) = *(ovrV++);
-				//Increase pointers
-				++srcU;
-				++srcV;
-			} else {
-				DWORD negalpha = 1020-alpha;
-				DWORD oU = *(ovrU++);
-				DWORD oV = *(ovrV++);
-				DWORD sU = *(srcU++);
-				DWORD sV = *(srcV++);
-				*(dstU++) = (oU*alpha+sU*negalpha)/1020;
-				*(dstV++) = (oV*alpha+sV*negalpha)/1020;
-				//Calculate and move pointer
-				//*(dstU++) = (((DWORD)(*(ovrU++)))*alpha + (((DWORD)(*(srcU++)))*negalpha))/1020;
-				//*(dstV++) = (((DWORD)(*(ovrV++)))*alpha + (((DWORD)(*(srcV++)))*negalpha))/1020;
+			//Set block coverage
+			row[b+1] = transparent ? Transparent : (opaque ? Opaque : Mixed);
+			//Update row
+			rowTransparent = rowTransparent && transparent;
+			rowOpaque = rowOpaque && opaque;
+		}
+		//Set whole row coverage
+		row[0] = rowTransparent ? Transparent : (rowOpaque ? Opaque : Mixed);
+	}
 
-			}
+	//Updated
+	dirty = false;
+}
+
+void Canvas::Draw(BYTE*image,BYTE* frame)
+{
+	//Draw all
+	Draw(image,frame,0,0,width,height);
+}
+
+void Canvas::Draw(BYTE*image,BYTE* frame,DWORD x,DWORD y,DWORD w,DWORD h)
+{
+	BlendPlanes p;
+
+	//If overlay has changed
+	if (dirty)
+		//Check which parts are not transparent
+		UpdateCoverage();
+
+	//Get blend function
+	BlendFunc func = GetBlendFunc(selected);
+
+	//Get number of pixels
+	DWORD num = width*height;
+	//Get chroma row size
+	DWORD cols = width/2;
+
+	//Get chroma rectangle containing the luma one
+	DWORD first = y/2;
+	DWORD last = (y+h+1)/2<height/2 ? (y+h+1)/2 : height/2;
+	DWORD left = x/2;
+	DWORD right = (x+w+1)/2<cols ? (x+w+1)/2 : cols;
+
+	//Check
+	if (left>=right)
+		//Nothing to draw
+		return;
+
+	for (DWORD j=first; j<last; ++j)
+	{
+		//Get source
+		p.srcY[0] = frame+j*2*width;
+		p.srcY[1] = p.srcY[0]+width;
+		p.srcU    = frame+num+j*cols;
+		p.srcV    = frame+num*5/4+j*cols;
+		//Get overlay
+		p.ovrY[0] = overlay+j*2*width;
+		p.ovrY[1] = p.ovrY[0]+width;
+		p.ovrU    = overlay+num+j*cols;
+		p.ovrV    = overlay+num*5/4+j*cols;
+		p.ovrA[0] = overlay+num*3/2+j*2*width;
+		p.ovrA[1] = p.ovrA[0]+width;
+		//Get destination
+		p.dstY[0] = image+j*2*width;
+		p.dstY[1] = p.dstY[0]+width;
+		p.dstU    = image+num+j*cols;
+		p.dstV    = image+num*5/4+j*cols;
+
+		//Get row coverage
+		const BYTE* row = coverage+j*(blocks+1);
+
+		//If the whole row is the same
+		if (row[0]!=Mixed)
+		{
+			//Copy it
+			CopyRow(p,left,right,row[0]);
+			//Next
+			continue;
+		}
+
+		//Process consecutive blocks with same coverage at once
+		for (DWORD b=left/CoverageBlockSize; b*CoverageBlockSize<right; )
+		{
+			//Get state
+			BYTE state = row[b+1];
+			//Find end of run
+			DWORD e = b+1;
+			while (e*CoverageBlockSize<right && row[e+1]==state)
+				++e;
+			//Get chroma columns inside the rectangle
+			DWORD from = b*CoverageBlockSize>left ? b*CoverageBlockSize : left;
+			DWORD to = e*CoverageBlockSize<right ? e*CoverageBlockSize : right;
+			//Blend or copy
+			if (state==Mixed)
+				func(p,from,to);
+			else
+				CopyRow(p,from,to,state);
+			//Next run
+			b = e;
 		}
-		//Skip Y line
-		srcY1 += width;
-		srcY2 += width;
-		dstY1 += width;
-		dstY2 += width;
-		ovrY1 += width;
-		ovrY2 += width;
-		ovrA1 += width;
-		ovrA2 += width;
 	}
 }
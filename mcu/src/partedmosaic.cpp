@@ -69,14 +69,14 @@ PartedMosaic::~PartedMosaic()
 * Update
 * 	Update slot of mosaic with given image
 *****************************/
-int PartedMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool keepAspectRatio)
+int PartedMosaic::Update(int pos, BYTE *imageY, BYTE *imageU, BYTE *imageV, int imgStride, int imgWidth, int imgHeight,bool keepAspectRatio)
 {
 	//Check it's in the mosaic
 	if (pos<0 || pos >= numSlots)
 		return 0;
 
 	//Check size
-	if (!image && !imgHeight && !imgHeight)
+	if (!imageY && !imgHeight && !imgHeight)
 	{
 		//Clean position
 		Clean(pos);
@@ -90,11 +90,6 @@ int PartedMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool
 	BYTE *lineaY;
 	BYTE *lineaU;
 	BYTE *lineaV;
-	
-	DWORD imgNumPixels = imgHeight*imgWidth;
-	BYTE *imageY = image;
-	BYTE *imageU  = image  + imgNumPixels;
-	BYTE *imageV  = imageU + imgNumPixels/4;
 
 	//Get slot position in mosaic
 	int i = pos / mosaicCols;
@@ -120,7 +115,7 @@ int PartedMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool
 
 			//Go to next
 			lineaY += mosaicTotalWidth;
-			imageY += imgWidth;
+			imageY += imgStride;
 		}
 
 		//Copy U and V planes
@@ -134,19 +129,19 @@ int PartedMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool
 			lineaU += mosaicTotalWidth/2;
 			lineaV += mosaicTotalWidth/2;
 
-			imageU += imgWidth/2;
-			imageV += imgWidth/2;
+			imageU += imgStride/2;
+			imageV += imgStride/2;
 		}
 	} else {
 		//Set resize
-		resizer[pos]->SetResize(imgWidth,imgHeight,imgWidth,mosaicWidth,mosaicHeight,mosaicTotalWidth,keepAspectRatio);
+		resizer[pos]->SetResize(imgWidth,imgHeight,imgStride,mosaicWidth,mosaicHeight,mosaicTotalWidth,keepAspectRatio);
 
 		//And resize
 		resizer[pos]->Resize(imageY,imageU,imageV,lineaY,lineaU,lineaV);
 	}
 
-	//We have changed
-	SetChanged();
+	//Only this slot has changed
+	SetChanged(pos);
 
 	return 1;
 }
@@ -201,8 +196,8 @@ int PartedMosaic::Clean(int pos)
 		lineaV += mosaicTotalWidth/2;
 	}
 
-	//We have changed
-	SetChanged();
+	//Only this slot has changed
+	SetChanged(pos);
 
 	return 1;
 }
@@ -5,6 +5,7 @@ PipeAudioInput::PipeAudioInput()
 {
 	//Creamos el mutex
 	pthread_mutex_init(&mutex,0);
+	pthread_mutex_init(&transraterMutex,0);
 
  	//Y la condicion
 	pthread_cond_init(&cond,0);
@@ -14,12 +15,25 @@ PipeAudioInput::PipeAudioInput()
 	recording = false;
 	canceled = false;
 	nativeRate = 8000;
+	//Nobody waiting for samples
+	overrun = 0;
+	waiting = false;
+	frameSamples = 0;
+	//Not sharing
+	sharing = false;
+	sharedCodec = AudioCodec::PCMU;
+	sharedRate = 0;
+	sharedFrameSamples = 0;
+	sharedVersion = 0;
+	framesFirst = 0;
+	framesNum = 0;
 }
 
 PipeAudioInput::~PipeAudioInput()
 {
 	//Creamos el mutex
 	pthread_mutex_destroy(&mutex);
+	pthread_mutex_destroy(&transraterMutex);
 
  	//Y la condicion
 	pthread_cond_destroy(&cond);
@@ -35,6 +49,35 @@ int PipeAudioInput::ClearBuffer()
 
 	//Desbloqueamos
 	pthread_mutex_unlock(&mutex);
+
+	return true;
+}
+
+bool PipeAudioInput::WaitSamples(DWORD size)
+{
+	//Check if the mixer has overflown the fifo
+	DWORD index = __atomic_exchange_n(&overrun,0,__ATOMIC_ACQ_REL);
+
+	//If so
+	if (index)
+		//Free space
+		fifoBuffer.discard(index);
+
+	//Let the mixer know before checking, so it signals us if it pushes after it
+	__atomic_store_n(&waiting,true,__ATOMIC_SEQ_CST);
+
+	//Check if we have enought samples
+	bool ready = fifoBuffer.length()>=size;
+
+	//If not
+	if (!ready)
+		//Esperamos la condicion
+		pthread_cond_wait(&cond,&mutex);
+
+	//Not waiting anymore
+	__atomic_store_n(&waiting,false,__ATOMIC_RELAXED);
+
+	return ready;
 }
 int PipeAudioInput::RecBuffer(SWORD *buffer,DWORD size)
 {
@@ -43,12 +86,12 @@ int PipeAudioInput::RecBuffer(SWORD *buffer,DWORD size)
 	//Bloqueamos
 	pthread_mutex_lock(&mutex);
 
+	//Let the mixer know our frame size
+	__atomic_store_n(&frameSamples,size,__ATOMIC_RELAXED);
+
 	//Mientras no tengamos suficientes muestras
-	while(recording && (fifoBuffer.length()<size))
+	while(recording && !WaitSamples(size))
 	{
-		//Esperamos la condicion
-		pthread_cond_wait(&cond,&mutex);
-
 		//If we have been canceled
 		if (canceled)
 		{
@@ -71,6 +114,161 @@ end:
 	return len;
 }
 
+int PipeAudioInput::RecFrame(SWORD *buffer,DWORD size,BYTE *frame,DWORD frameSize,DWORD &len)
+{
+	int num = 0;
+
+	//No frame yet
+	len = 0;
+
+	//Bloqueamos
+	pthread_mutex_lock(&mutex);
+
+	//Let the mixer know our frame size
+	__atomic_store_n(&frameSamples,size,__ATOMIC_RELAXED);
+
+	//Mientras no tengamos suficientes muestras ni frames
+	while(recording && !framesNum && !WaitSamples(size))
+	{
+		//If we have been canceled
+		if (canceled)
+		{
+			//Remove flag
+			canceled = false;
+			//Exit
+			Log("PipeAudioInput: RecFrame cancelled.\n");
+			//End
+			goto end;
+		}
+	}
+
+	//Samples queued before the first frame are older than it
+	if (framesNum && (int)(frames[framesFirst].mark-fifoBuffer.read())<(int)size)
+	{
+		//Get first one
+		SharedFrame& shared = frames[framesFirst];
+		//Drop the last partial frame before it, the shared frame starts on the same audio
+		fifoBuffer.discard(shared.mark);
+		//Check it fits
+		if (shared.len<=frameSize)
+		{
+			//Copy it
+			memcpy(frame,shared.data,shared.len);
+			//Set length
+			len = shared.len;
+			//It is a whole frame
+			num = size;
+		}
+		//Remove it
+		framesFirst = (framesFirst+1)%MaxSharedFrames;
+		framesNum--;
+	} else {
+		//Get samples from queue
+		num = fifoBuffer.pop(buffer,size);
+	}
+
+end:
+	//Desbloqueamos
+	pthread_mutex_unlock(&mutex);
+
+	return num;
+}
+
+bool PipeAudioInput::StartSharedEncoding(AudioCodec::Type codec,DWORD rate,DWORD numFrameSamples,const Properties &properties)
+{
+	Log("-PipeAudioInput start shared encoding [codec:%s,rate:%d,samples:%d]\n",AudioCodec::GetNameFor(codec),rate,numFrameSamples);
+
+	//Bloqueamos
+	pthread_mutex_lock(&mutex);
+	//Store encoding parameters
+	sharedCodec = codec;
+	sharedRate = rate;
+	sharedFrameSamples = numFrameSamples;
+	sharedProperties = properties;
+	//We are sharing
+	sharing = true;
+	//Let the mixer know
+	sharedVersion++;
+	//Desbloqueamos
+	pthread_mutex_unlock(&mutex);
+
+	return true;
+}
+
+void PipeAudioInput::StopSharedEncoding()
+{
+	Log("-PipeAudioInput stop shared encoding\n");
+
+	//Bloqueamos
+	pthread_mutex_lock(&mutex);
+	//Not sharing anymore
+	sharing = false;
+	//Drop pending frames
+	framesNum = 0;
+	//Let the mixer know
+	sharedVersion++;
+	//Desbloqueamos
+	pthread_mutex_unlock(&mutex);
+}
+
+bool PipeAudioInput::GetSharedEncoding(AudioCodec::Type &codec,DWORD &rate,DWORD &numFrameSamples,Properties &properties)
+{
+	//Bloqueamos
+	pthread_mutex_lock(&mutex);
+	//Get encoding parameters
+	codec = sharedCodec;
+	rate = sharedRate;
+	numFrameSamples = sharedFrameSamples;
+	properties = sharedProperties;
+	//Get state
+	bool res = sharing;
+	//Desbloqueamos
+	pthread_mutex_unlock(&mutex);
+
+	return res;
+}
+
+int PipeAudioInput::PutFrame(BYTE *frame,DWORD len)
+{
+	//Check size
+	if (len>MTU)
+		//Error
+		return Error("-PipeAudioInput shared frame too big [len:%d]\n",len);
+
+	//Block
+	pthread_mutex_lock(&mutex);
+
+	//Si estamos grabando y compartiendo
+	if (recording && sharing)
+	{
+		//If queue is full
+		if (framesNum==MaxSharedFrames)
+		{
+			//Drop oldest one
+			framesFirst = (framesFirst+1)%MaxSharedFrames;
+			framesNum--;
+		}
+		//Get next free one
+		SharedFrame& shared = frames[(framesFirst+framesNum)%MaxSharedFrames];
+		//Copy
+		memcpy(shared.data,frame,len);
+		shared.len = len;
+		//Samples queued before it are encoded privately first
+		shared.mark = fifoBuffer.written();
+		//One more
+		framesNum++;
+
+		//Se�alamos
+		pthread_cond_signal(&cond);
+	}
+
+	//Desbloqueamos
+	pthread_mutex_unlock(&mutex);
+
+	//Salimos
+	return true;
+}
+
 int PipeAudioInput::StartRecording(DWORD rate)
 {
 	Log("-PipeAudioInput start recording [rate:%d]\n",rate);
@@ -80,7 +278,9 @@ int PipeAudioInput::StartRecording(DWORD rate)
 	//Store recording rate
 	recordRate = rate;
 	//Open transrater
+	pthread_mutex_lock(&transraterMutex);
 	transrater.Open( nativeRate, recordRate );
+	pthread_mutex_unlock(&transraterMutex);
 	//Estamos grabando
 	recording = true;
 	//Desbloqueamos
@@ -100,7 +300,9 @@ int PipeAudioInput::StopRecording()
 	recording = false;
 
 	//Close transrater
+	pthread_mutex_lock(&transraterMutex);
 	transrater.Close();
+	pthread_mutex_unlock(&transraterMutex);
 	
 	//Se�alamos
 	pthread_cond_signal(&cond);
@@ -116,18 +318,22 @@ int PipeAudioInput::PutSamples(SWORD *buffer,DWORD size)
 	SWORD resampled[4096];
 	DWORD resampledSize = 4096;
 
-	
-	//Block
-	pthread_mutex_lock(&mutex);
-	
+	//Si no estamos grabando
+	if (!recording)
+		//Nothing to do
+		return true;
+
+	//Only contended when starting or stopping
+	pthread_mutex_lock(&transraterMutex);
+
 	//If we need to transrate
 	if (transrater.IsOpen())
 	{
 		//Transrate
 		if (!transrater.ProcessBuffer(buffer, size, resampled, &resampledSize))
 		{
-			//Desbloqueamos
-			pthread_mutex_unlock(&mutex);
+			//Unlock
+			pthread_mutex_unlock(&transraterMutex);
 			//Error
 			return Error("-PipeAudioInput could not transrate\n");
 		}
@@ -136,24 +342,54 @@ int PipeAudioInput::PutSamples(SWORD *buffer,DWORD size)
 		size = resampledSize;
 	}
 
-	//Si estamos reproduciendo
-	if (recording)
+	//Unlock
+	pthread_mutex_unlock(&transraterMutex);
+
+	//Queue them
+	return Push(buffer,size);
+}
+
+int PipeAudioInput::PutRecordedSamples(SWORD *buffer,DWORD size)
+{
+	//Si no estamos grabando
+	if (!recording)
+		//Nothing to do
+		return true;
+
+	//Queue them as they are
+	return Push(buffer,size);
+}
+
+int PipeAudioInput::Push(SWORD *buffer,DWORD size)
+{
+	//Encolamos
+	if (!fifoBuffer.push(buffer,size))
 	{
-		//Si no cabe
-		if (fifoBuffer.length()+size>fifoBuffer.size())
-			//Limpiamos
-			fifoBuffer.clear();
+		//Get encoder frame size, encoder only pops whole frames
+		DWORD frame = __atomic_load_n(&frameSamples,__ATOMIC_RELAXED);
+		//Get end of queue
+		DWORD index = fifoBuffer.written();
+		//Keep the last partial frame so the encoder stays on the same frame boundary
+		if (frame)
+			index -= fifoBuffer.length()%frame;
+		//Si no cabe, ask the encoder to drop what is queued as we can't free space from here
+		__atomic_store_n(&overrun,index,__ATOMIC_RELEASE);
+	}
 
-		//Encolamos
-		fifoBuffer.push(buffer,size);
+	//Make sure the push is visible before checking if the encoder is waiting
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
 
+	//If it is waiting for samples
+	if (__atomic_load_n(&waiting,__ATOMIC_SEQ_CST))
+	{
+		//Block
+		pthread_mutex_lock(&mutex);
 		//Se�alamos
 		pthread_cond_signal(&cond);
+		//Desbloqueamos
+		pthread_mutex_unlock(&mutex);
 	}
 
-	//Desbloqueamos
-	pthread_mutex_unlock(&mutex);
-
 	//Salimos
 	return true;
 
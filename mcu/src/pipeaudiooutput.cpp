@@ -9,6 +9,8 @@ PipeAudioOutput::PipeAudioOutput(bool calcVAD)
 	this->calcVAD = calcVAD;
 	//No vad score acumulated
 	acu = 0;
+	//No overrun
+	overrun = 0;
 	//No rates yet
 	nativeRate = 0;
 	playRate = 0;
@@ -51,22 +53,6 @@ int PipeAudioOutput::PlayBuffer(SWORD *buffer,DWORD size,DWORD frameTime, BYTE v
 		size = resampledSize;
 	}
 
-	//Bloqueamos
-	pthread_mutex_lock(&mutex);
-
-	//Get left space
-	int left = fifoBuffer.size()-fifoBuffer.length();
-
-	//if not enought
-	if(size>left)
-		//Free space
-		fifoBuffer.remove(size-left);
-
-	//Get initial bump
-	if (!acu && v>0)
-		//1 second minimum at 8khz
-		acu+=8000;
-
 	//Check if we have level info
 	if (v>0)
 	{
@@ -83,21 +69,32 @@ int PipeAudioOutput::PlayBuffer(SWORD *buffer,DWORD size,DWORD frameTime, BYTE v
 
 	//Check we have detected speech
 	if (v>0)
-		//Acumule VAD at 8Khz
-		acu += v*vadLevel*size*8000/playRate;
+	{
+		//Get current value, mixer may be decreasing it concurrently
+		DWORD old = __atomic_load_n(&acu,__ATOMIC_ACQUIRE);
+		DWORD val;
+		do {
+			//Get initial bump, 1 second minimum at 8khz
+			val = old ? old : 8000;
+			//Acumule VAD at 8Khz
+			val += v*vadLevel*size*8000/playRate;
+			//Check max
+			if (val>48000)
+				//Limit so it can timeout faster
+				val = 48000;
+		} while (!__atomic_compare_exchange_n(&acu,&old,val,false,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE));
+	}
 
 	//Debug("-%p acu:%.6d v:%.2d level:%.2d\n",this,acu,v,vadLevel);
-	
-	//Check max
-	if (acu>48000)
-		//Limit so it can timeout faster
-		acu = 48000;
 
 	//Metemos en la fifo
-	fifoBuffer.push(buffer,size);
-
-	//Desbloqueamos
-	pthread_mutex_unlock(&mutex);
+	if (!fifoBuffer.push(buffer,size))
+	{
+		//We can't free space from here, so ask the mixer to drop what is queued
+		__atomic_store_n(&overrun,fifoBuffer.written(),__ATOMIC_RELEASE);
+		//Nothing queued
+		return 0;
+	}
 
 	return size;
 }
@@ -146,11 +143,16 @@ int PipeAudioOutput::StopPlaying()
 
 int PipeAudioOutput::GetSamples(SWORD *buffer,DWORD num)
 {
-	//Bloqueamos
-	pthread_mutex_lock(&mutex);
+	//Check if the decoder has overflown the fifo
+	DWORD index = __atomic_exchange_n(&overrun,0,__ATOMIC_ACQ_REL);
 
-	//Obtenemos la longitud
-	int len = fifoBuffer.length();
+	//If so
+	if (index)
+		//Free space
+		fifoBuffer.discard(index);
+
+	//Obtenemos la longitud, no lock needed as we are the only consumer
+	DWORD len = fifoBuffer.length();
 
 	//Miramos si hay suficientes
 	if (len > num)
@@ -159,9 +161,6 @@ int PipeAudioOutput::GetSamples(SWORD *buffer,DWORD num)
 	//OBtenemos las muestras
 	fifoBuffer.pop(buffer,len);
 
-	//Desbloqueamos
-	pthread_mutex_unlock(&mutex);
-
 	//Salimos
 	return len;
 }
@@ -203,22 +202,22 @@ int PipeAudioOutput::End()
 
 DWORD PipeAudioOutput::GetVAD(DWORD numSamples)
 {
-	//Protegemos
-	pthread_mutex_lock(&mutex);
+	//Get value to remove
+	DWORD dec = nativeRate ? numSamples*8000/nativeRate : 0;
 	
-	//Get vad value
-	DWORD r = acu;
-
-	//Check
-	if (!nativeRate || acu<numSamples*8000/nativeRate)
-		//No vad
-		acu = 0;
-	else 
-		//Remove cumulative value
-		acu -= numSamples*8000/nativeRate;
-		
-	//Protegemos
-	pthread_mutex_unlock(&mutex);
+	//Get vad value, decoder may be increasing it concurrently
+	DWORD r = __atomic_load_n(&acu,__ATOMIC_ACQUIRE);
+	DWORD val;
+
+	do {
+		//Check
+		if (!nativeRate || r<dec)
+			//No vad
+			val = 0;
+		else 
+			//Remove cumulative value
+			val = r-dec;
+	} while (!__atomic_compare_exchange_n(&acu,&r,val,false,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE));
 	
 	//Return
 	return r;
@@ -13,13 +13,16 @@ PipeVideoInput::PipeVideoInput()
 	//No estamos iniciados
 	//inited = false;
 	capturing = false;
-	grabPic = 0;
-	imgBuffer[0] = NULL;
-	imgBuffer[1] = NULL;
+	canceled = false;
+	changed = false;
+	grabbed = NULL;
 }
 
 PipeVideoInput::~PipeVideoInput()
 {
+	//Release last grabbed picture
+	if (grabbed)
+		grabbed->Release();
 	//Liberamos los mutex
 	pthread_mutex_destroy(&newPicMutex);
 	pthread_cond_destroy(&newPicCond);
@@ -71,14 +74,8 @@ int PipeVideoInput::StartVideoCapture(int width,int height,int fps)
 	videoSize = (videoWidth*videoHeight*3)/2;
 	videoFPS = fps;
 
-	//Creamos el buffer
-	imgBuffer[0] = (BYTE *)malloc(videoSize);
-	imgBuffer[1] = (BYTE *)malloc(videoSize);
-
-	//El inicio
-	imgPos = false;
-	imgNew = false;
-	grabPic = 0;
+	//El inicio, pictures will be taken from the pool
+	canceled = false;
 
 	//Estamos capturando
 	capturing = true;
@@ -96,17 +93,18 @@ int PipeVideoInput::StopVideoCapture()
 	//Protegemos
 	pthread_mutex_lock(&newPicMutex);
 
-	//LIberamos los buffers
-	if (imgBuffer[0])
-		free(imgBuffer[0]);
-	if (imgBuffer[1])
-		free(imgBuffer[1]);
-
 	//Y no estamos capturando
 	capturing = false;
 
-	//Clear flags
-	grabPic = NULL;
+	//Drop pending picture
+	pending.Clear();
+
+	//Release last grabbed one
+	if (grabbed)
+		grabbed->Release();
+
+	//Clear it
+	grabbed = NULL;
 
 	//Desprotegemos
 	pthread_mutex_unlock(&newPicMutex);
@@ -133,7 +131,7 @@ BYTE* PipeVideoInput::GrabFrame(DWORD timeout)
 	}
 	
 	//Miramos a ver si hay un nuevo pict
-	if(imgNew==0)
+	if (!pending.IsPending() && !canceled)
 	{
 		//If timeout has been specified
 		if (timeout)
@@ -149,11 +147,36 @@ BYTE* PipeVideoInput::GrabFrame(DWORD timeout)
 		}
 	}
 
-	//Lo vamos a consumir
-	imgNew=0;
+	//Nothing new yet
+	changed = false;
 
-	//Nos quedamos con el puntero antes de que lo cambien
-	pic=grabPic;
+	//If we have been canceled
+	if (canceled)
+	{
+		//Not anymore
+		canceled = false;
+		//No picture
+		if (grabbed)
+			grabbed->Release();
+		grabbed = NULL;
+	} else {
+		//Take new picture if any
+		VideoBuffer* frame = pending.Take();
+		//If got it
+		if (frame)
+		{
+			//It is a new one
+			changed = true;
+			//Release previous one, the encoder is done with it
+			if (grabbed)
+				grabbed->Release();
+			//Keep it until next grab
+			grabbed = frame;
+		}
+	}
+
+	//Nos quedamos con el puntero, nobody will write on it
+	pic = grabbed ? grabbed->GetData() : NULL;
 
 	//Y liberamos el mutex
 	pthread_mutex_unlock(&newPicMutex);
@@ -167,8 +190,8 @@ void  PipeVideoInput::CancelGrabFrame()
 	pthread_mutex_lock(&newPicMutex);
 
 	//No image
-	imgNew = false;
-	grabPic = NULL;
+	canceled = true;
+	pending.Clear();
 
 	//Se�alamos
 	pthread_cond_signal(&newPicCond);
@@ -183,28 +206,47 @@ DWORD PipeVideoInput::GetBufferSize()
 	return (videoWidth*videoHeight*3)/2;
 }
 
-int PipeVideoInput::SetFrame(BYTE * buffer, int width, int height)
+int PipeVideoInput::SetFrame(BYTE * buffer, int width, int height, QWORD time)
 {
 	//Protegemos
 	pthread_mutex_lock(&newPicMutex);
 
-	//Si estamos capturamos
-	if (capturing)
-	{
-		//Actualizamos el grabPic
-		grabPic = imgBuffer[imgPos];
-
-		//Pasamos al siguiente
-		imgPos = !imgPos;
-
-		//Copy & Resize
-		resizer.Resize(buffer,width,height,grabPic,videoWidth,videoHeight,true);
-		
-		//Hay imagen
-		imgNew = true;
-		//Se�alamos
-		pthread_cond_signal(&newPicCond);
-	} 
+	//Get capture values
+	int capture = capturing;
+	int outWidth = videoWidth;
+	int outHeight = videoHeight;
+
+	//Y desbloqueamos
+	pthread_mutex_unlock(&newPicMutex);
+
+	//Si no estamos capturamos
+	if (!capture)
+		//Nothing to do
+		return 1;
+
+	//Get a free picture from the pool
+	VideoBuffer* frame = VideoBuffer::Create(outWidth,outHeight);
+
+	//Copy & Resize, outside the lock
+	resizer.Resize(buffer,width,height,frame->GetData(),outWidth,outHeight,true);
+
+	//Keep origin of the newest frame on it
+	frame->SetTime(time);
+
+	//Hay imagen
+	return Publish(frame);
+}
+
+int PipeVideoInput::Publish(VideoBuffer* frame)
+{
+	//Swap it with the pending one, if it was not grabbed it is dropped
+	pending.Publish(frame);
+
+	//Protegemos
+	pthread_mutex_lock(&newPicMutex);
+
+	//Señalamos
+	pthread_cond_signal(&newPicCond);
 
 	//Y desbloqueamos
 	pthread_mutex_unlock(&newPicMutex);
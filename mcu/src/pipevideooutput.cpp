@@ -3,19 +3,18 @@
 #include <string.h>
 #include <stdlib.h>
 
-PipeVideoOutput::PipeVideoOutput(pthread_mutex_t* mutex, pthread_cond_t* cond)
+PipeVideoOutput::PipeVideoOutput(pthread_mutex_t* mutex, pthread_cond_t* cond, DWORD* waiting)
 {
 	//Nos quedamos con los mutex
 	videoMixerMutex = mutex;
 	videoMixerCond  = cond;
+	videoMixerWaiting = waiting;
 
-	//E iniciamos el buffer
-	buffer		= NULL;
-	bufferSize	= 0;
+	//No frame yet
+	current		= NULL;
 
 	//Ponemos el cambio
 	inited		= false;
-	isChanged	= false;
 	versionChanged	= false;
 	version		= -1;
 	videoWidth	= 0;
@@ -24,65 +23,97 @@ PipeVideoOutput::PipeVideoOutput(pthread_mutex_t* mutex, pthread_cond_t* cond)
 
 PipeVideoOutput::~PipeVideoOutput()
 {
-	//Si estaba reservado
-	if (buffer!=NULL)
-		//Liberamos memoria
-		free(buffer);
+	//Si teniamos frame
+	if (current)
+		//Lo soltamos
+		current->Release();
 }
 
 int PipeVideoOutput::NextFrame(BYTE *pic)
+{
+	//Origin unknown
+	return NextFrame(pic,0);
+}
+
+int PipeVideoOutput::NextFrame(BYTE *pic,QWORD time)
 {
 	//Check pic
 	if (!pic)
 		return Error("-PipeVideoOuput called with null frame\n");
 
-	//Check pic
-	if (!buffer)
+	//Check size
+	if (!videoWidth || !videoHeight)
 		return Error("-Null buffer, size not set\n");
 
 	//Check if wer are inited
 	if (!inited)
 		//Exit
 		return Error("-PipeVideoOutput calling NextFrame without been inited\n");
-	
-	//Bloqueamos
-	pthread_mutex_lock(videoMixerMutex);
 
-	//Copiamos
-	memcpy(buffer,pic,bufferSize);
+	//Get a free buffer from the pool
+	VideoBuffer* frame = VideoBuffer::Create(videoWidth,videoHeight);
 
-	//Ponemos el cambio
-	isChanged = true;
+	//Copiamos, without holding any lock
+	memcpy(frame->GetData(),pic,frame->GetSize());
 
-	//Se�alizamos
-	pthread_cond_signal(videoMixerCond);
+	//Keep origin time along with it
+	frame->SetTime(time);
 
-	//Y desbloqueamos
-	pthread_mutex_unlock(videoMixerMutex);
+	//Publish it
+	return Publish(frame);
+}
 
-	return true;
+int PipeVideoOutput::NextFrame(VideoBuffer* frame)
+{
+	//Check if wer are inited
+	if (!inited)
+		//Exit
+		return Error("-PipeVideoOutput calling NextFrame without been inited\n");
+
+	//The mixer uses the decoded planes, so keep a reference instead of copying it
+	frame->AddRef();
+
+	//Publish it
+	return Publish(frame);
 }
 
 void PipeVideoOutput::ClearFrame()
 {
-	//Bloqueamos
-	pthread_mutex_lock(videoMixerMutex);
+	//Check size
+	if (!videoWidth || !videoHeight)
+		//Nothing to clear
+		return;
 
-	//Get number of pixels
-	DWORD num = videoWidth*videoHeight;
+	//Get a free buffer from the pool
+	VideoBuffer* frame = VideoBuffer::Create(videoWidth,videoHeight);
 
-	// paint the background in black for YUV
-	memset(buffer		, 0		, num);
-	memset(buffer+num	, (BYTE) -128	, num/2);
+	//Paint it in black
+	frame->Clear();
 
-	//Ponemos el cambio
-	isChanged = true;
+	//Publish it
+	Publish(frame);
+}
 
-	//Se�alizamos
-	pthread_cond_signal(videoMixerCond);
+int PipeVideoOutput::Publish(VideoBuffer* frame)
+{
+	//Swap it with the pending one, the mixer will take it without locking
+	pending.Publish(frame);
+
+	//Make sure the frame is visible before checking if the mixer is waiting
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	//If it is not waiting it will check the frame before it does, so we don't take its mutex while composing
+	if (__atomic_load_n(videoMixerWaiting,__ATOMIC_SEQ_CST))
+	{
+		//Lock, so the signal is not lost if it is about to wait
+		pthread_mutex_lock(videoMixerMutex);
+		//Wake up the mixer
+		pthread_cond_signal(videoMixerCond);
+		//Unlock
+		pthread_mutex_unlock(videoMixerMutex);
+	}
 
-	//Y desbloqueamos
-	pthread_mutex_unlock(videoMixerMutex);
+	return true;
 }
 
 int PipeVideoOutput::SetVideoSize(int width,int height)
@@ -91,37 +122,30 @@ int PipeVideoOutput::SetVideoSize(int width,int height)
 	if ((videoWidth==width) && (videoHeight==height))
 		//Not changed
 		return 0;
-	
-	//Lock
-	pthread_mutex_lock(videoMixerMutex);
-
-	//Freem memory
-	if (buffer)
-		free(buffer);
-	
-	//Store size
+
+	//Store size, next frames will be allocated with it
 	videoWidth = width;
 	videoHeight= height;
 
-	//Check frame size
-	bufferSize = (width*height*3)/2;
-	//Get memory
-	buffer = (BYTE*)malloc(bufferSize);
-
-	//Unlock
-	pthread_mutex_unlock(videoMixerMutex);
-	
 	//Changed
 	return 1;
 }
 
 BYTE* PipeVideoOutput::GetFrame()
 {
-	//QUitamos el cambio
-	isChanged = false;
+	//Y devolvemos el buffer, only if it is packed
+	return current && current->IsPacked() ? current->GetData() : NULL;
+}
 
-	//Y devolvemos el buffer
-	return buffer;
+VideoBuffer* PipeVideoOutput::GetBuffer()
+{
+	//Check
+	if (!current)
+		return NULL;
+	//One reference more for the caller
+	current->AddRef();
+	//Return it
+	return current;
 }
 
 int PipeVideoOutput::Init()
@@ -152,8 +176,19 @@ int PipeVideoOutput::IsChanged(DWORD version)
 		return versionChanged;
 	//Store version number
 	this->version = version;
+	//Take latest published frame
+	VideoBuffer* frame = pending.Take();
 	//Store value for change associated to that version
-	versionChanged = isChanged;
+	versionChanged = (frame!=NULL);
+	//If we have a new one
+	if (frame)
+	{
+		//Release previous
+		if (current)
+			current->Release();
+		//Keep reference to new one
+		current = frame;
+	}
 	//Have we changed?
-	return isChanged;
+	return versionChanged;
 };
\ No newline at end of file
@@ -43,10 +43,10 @@ PIPMosaic::~PIPMosaic()
 * Update
 * 	Update slot of mosaic with given image
 *****************************/
-int PIPMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool keepAspectRatio)
+int PIPMosaic::Update(int pos, BYTE *imageY, BYTE *imageU, BYTE *imageV, int imgStride, int imgWidth, int imgHeight,bool keepAspectRatio)
 {
 	//Check size
-	if (!image && !imgHeight && !imgHeight)
+	if (!imageY && !imgHeight && !imgHeight)
 	{
 		//Clean position
 		Clean(pos);
@@ -64,11 +64,6 @@ int PIPMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool kee
 	BYTE *lineaY = mosaic;
 	BYTE *lineaU = mosaic + numSlotsPixels;
 	BYTE *lineaV = lineaU + numSlotsPixels/4;
-	//Get plane pointers from incoming image
-	DWORD imgNumPixels = imgHeight*imgWidth;
-	BYTE *imageY = image;
-	BYTE *imageU = imageY + imgNumPixels;
-	BYTE *imageV = imageU + imgNumPixels/4;
 
 
 	/**********************************************
@@ -127,7 +122,7 @@ int PIPMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool kee
 			BYTE *underV = underU + numSlotsPixels/4;
 
 			//Set resize
-			resizer[pos]->SetResize(imgWidth,imgHeight,imgWidth,mosaicTotalWidth,mosaicTotalHeight,mosaicTotalWidth,keepAspectRatio);
+			resizer[pos]->SetResize(imgWidth,imgHeight,imgStride,mosaicTotalWidth,mosaicTotalHeight,mosaicTotalWidth,keepAspectRatio);
 			//Resize and set to slot
 			resizer[pos]->Resize(imageY,imageU,imageV,underY,underU,underV);
 
@@ -135,6 +130,7 @@ int PIPMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool kee
 			imageY = underY;
 			imageU = underU;
 			imageV = underV;
+			imgStride = mosaicTotalWidth;
 		}
 
 		//Copy to the begining of the pip zone
@@ -144,13 +140,13 @@ int PIPMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool kee
 			memcpy(lineaY, imageY, mosaicTotalWidth);
 			//Go to next
 			lineaY += mosaicTotalWidth;
-			imageY += mosaicTotalWidth;
+			imageY += imgStride;
 
 			//Copy Y line
 			memcpy(lineaY, imageY, mosaicTotalWidth);
 			//Go to next
 			lineaY += mosaicTotalWidth;
-			imageY += mosaicTotalWidth;
+			imageY += imgStride;
 
 			//Copy U and V lines
 			memcpy(lineaU, imageU, mosaicTotalWidthUV);
@@ -158,8 +154,8 @@ int PIPMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool kee
 			//Go to next
 			lineaU += mosaicTotalWidthUV;
 			lineaV += mosaicTotalWidthUV;
-			imageU += mosaicTotalWidthUV;
-			imageV += mosaicTotalWidthUV;
+			imageU += imgStride/2;
+			imageV += imgStride/2;
 		}
 
 		//Copy in the pip area
@@ -172,7 +168,7 @@ int PIPMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool kee
 			{
 				//Copy Y lines
 				memcpy(lineaY + pipY			, imageY + pipY				, intraWidth);
-				memcpy(lineaY + pipY + mosaicTotalWidth	, imageY + pipY + mosaicTotalWidth	, intraWidth);
+				memcpy(lineaY + pipY + mosaicTotalWidth	, imageY + pipY + imgStride	, intraWidth);
 				//skip next
 				pipY += intraWidth+mosaicWidth;
 				//Copy U and V lines
@@ -183,19 +179,19 @@ int PIPMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool kee
 			}
 			//Copy Y lines until the end
 			memcpy(lineaY + pipY				, imageY + pipY				, mosaicTotalWidth-pipY);
-			memcpy(lineaY + pipY + mosaicTotalWidth		, imageY + pipY + mosaicTotalWidth	, mosaicTotalWidth-pipY);
+			memcpy(lineaY + pipY + mosaicTotalWidth		, imageY + pipY + imgStride	, mosaicTotalWidth-pipY);
 			//Copy U and V lines until the end
 			memcpy(lineaU + pipUV, imageU + pipUV, mosaicTotalWidthUV-pipUV);
 			memcpy(lineaV + pipUV, imageV + pipUV, mosaicTotalWidthUV-pipUV);
 			//Go to next line
 			lineaY += mosaicTotalWidth;
-			imageY += mosaicTotalWidth;
+			imageY += imgStride;
 			lineaY += mosaicTotalWidth;
-			imageY += mosaicTotalWidth;
+			imageY += imgStride;
 			lineaU += mosaicTotalWidthUV;
 			lineaV += mosaicTotalWidthUV;
-			imageU += mosaicTotalWidthUV;
-			imageV += mosaicTotalWidthUV;
+			imageU += imgStride/2;
+			imageV += imgStride/2;
 		}
 		//Copy from the end pip zone
 		for (int j=(pipIni+mosaicHeight)/2; j<mosaicTotalHeight/2; ++j)
@@ -204,13 +200,13 @@ int PIPMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool kee
 			memcpy(lineaY, imageY, mosaicTotalWidth);
 			//Go to next
 			lineaY += mosaicTotalWidth;
-			imageY += mosaicTotalWidth;
+			imageY += imgStride;
 
 			//Copy Y line
 			memcpy(lineaY, imageY, mosaicTotalWidth);
 			//Go to next
 			lineaY += mosaicTotalWidth;
-			imageY += mosaicTotalWidth;
+			imageY += imgStride;
 
 			//Copy U and V lines
 			memcpy(lineaU, imageU, mosaicTotalWidthUV);
@@ -218,8 +214,8 @@ int PIPMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool kee
 			//Go to next
 			lineaU += mosaicTotalWidthUV;
 			lineaV += mosaicTotalWidthUV;
-			imageU += mosaicTotalWidthUV;
-			imageV += mosaicTotalWidthUV;
+			imageU += imgStride/2;
+			imageV += imgStride/2;
 		}
 	} else {
 		//Get offsets
@@ -241,7 +237,7 @@ int PIPMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool kee
 
 				//Go to next
 				lineaY += mosaicTotalWidth;
-				imageY += imgWidth;
+				imageY += imgStride;
 			}
 
 			//Copy U and V planes
@@ -255,19 +251,19 @@ int PIPMosaic::Update(int pos, BYTE *image, int imgWidth, int imgHeight,bool kee
 				lineaU += mosaicTotalWidthUV;
 				lineaV += mosaicTotalWidthUV;
 
-				imageU += mosaicWidthUV;
-				imageV += mosaicWidthUV;
+				imageU += imgStride/2;
+				imageV += imgStride/2;
 			}
 		} else if ((imgWidth > 0) && (imgHeight > 0)) {
 			//Set resize
-			resizer[pos]->SetResize(imgWidth,imgHeight,imgWidth,mosaicWidth,mosaicHeight,mosaicTotalWidth,keepAspectRatio);
+			resizer[pos]->SetResize(imgWidth,imgHeight,imgStride,mosaicWidth,mosaicHeight,mosaicTotalWidth,keepAspectRatio);
 			//Resize and set to slot
 			resizer[pos]->Resize(imageY,imageU,imageV,lineaY,lineaU,lineaV);
 		}
 	}
 
-	//We have changed
-	SetChanged();
+	//Only this slot has changed
+	SetChanged(pos);
 
 	return 1;
 }
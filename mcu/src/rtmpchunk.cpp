@@ -119,6 +119,73 @@ bool RTMPChunkInputStream::IsFirstChunk()
 	return message==NULL;
 }
 
+/***********************************
+ * RTMPChunkOutput
+ * 	Chunks pending to be written
+ ***********************************/
+RTMPChunkOutput::RTMPChunkOutput()
+{
+	//Empty
+	chunks = 0;
+	first = 0;
+	num = 0;
+	length = 0;
+}
+
+RTMPChunkOutput::~RTMPChunkOutput()
+{
+	//Release unsent payloads
+	Clear();
+}
+
+void RTMPChunkOutput::Consume(DWORD len)
+{
+	//Less pending
+	length -= len;
+
+	//While there is written data
+	while (first<num && len)
+	{
+		//If not fully written
+		if (len<iov[first].iov_len)
+		{
+			//Move inside it
+			iov[first].iov_base = (BYTE*)iov[first].iov_base+len;
+			iov[first].iov_len -= len;
+			//Done
+			break;
+		}
+		//Written
+		len -= iov[first].iov_len;
+		//If it was a payload
+		if (payloads[first])
+			//Release it
+			payloads[first]->Release();
+		//Next
+		first++;
+	}
+
+	//If all written
+	if (first==num)
+		//Reuse the arena
+		Clear();
+}
+
+void RTMPChunkOutput::Clear()
+{
+	//Release pending payloads
+	for (int i=first;i<num;++i)
+		//If it was a payload
+		if (payloads[i])
+			//Release it
+			payloads[i]->Release();
+	//Empty
+	chunks = 0;
+	first = 0;
+	num = 0;
+	length = 0;
+}
+
 /***********************************
  * RTMPChunkOutputStream
  * 	Chunk stream sent by the local server
@@ -127,7 +194,9 @@ RTMPChunkOutputStream::RTMPChunkOutputStream(DWORD chunkStreamId) : RTMPChunkStr
 {
 	//Empty message
 	message = NULL;
-	msgBuffer = NULL;
+	msgPayload = NULL;
+	//Nothing queued
+	queued = 0;
 	//Store own id
 	this->chunkStreamId = chunkStreamId;
 	//Init mutex
@@ -142,10 +211,8 @@ RTMPChunkOutputStream::~RTMPChunkOutputStream()
 		delete(*it);
 
 	if (message)
-	{
-		delete(msgBuffer);
-		delete(message);
-	}
+		//Release it
+		ReleaseMessage();
 	//Destroy mutex
 	pthread_mutex_destroy(&mutex);
 }
@@ -156,16 +223,18 @@ void RTMPChunkOutputStream::SendMessage(RTMPMessage *msg)
 	pthread_mutex_lock(&mutex);
 	//Check it is not null
 	if(msg)
+	{
 		//Push back the message
 		messages.push_back(msg);
+		//Add its payload to the pending bytes
+		queued += msg->GetLength();
+	}
 	//Unlock
 	pthread_mutex_unlock(&mutex);
 }
 
-DWORD RTMPChunkOutputStream::GetNextChunk(BYTE *data,DWORD size,DWORD maxChunkSize)
+DWORD RTMPChunkOutputStream::PrepareChunk(BYTE *data,DWORD size,DWORD maxChunkSize,RTMPSerializedPayload** payload,DWORD *offset,DWORD *payloadLen)
 {
-	//lock now
-	pthread_mutex_lock(&mutex);
 	//Message basic header
 	RTMPChunkBasicHeader header;
 	//Set chunk stream id
@@ -182,12 +251,8 @@ DWORD RTMPChunkOutputStream::GetNextChunk(BYTE *data,DWORD size,DWORD maxChunkSi
 	{
 		//Check we hve still data
 		if (messages.empty())
-		{
-			//Unlock
-			pthread_mutex_unlock(&mutex);
 			//No more data to send here
 			return 0;
-		}
 		//Get the next message to send
 		message = messages.front();
 		//Remove from queue
@@ -201,10 +266,20 @@ DWORD RTMPChunkOutputStream::GetNextChunk(BYTE *data,DWORD size,DWORD maxChunkSi
 		//Start sending 
 		pos = 0;
 
-		//Allocate data for serialized message
-		msgBuffer = (BYTE*)malloc(msgLength);
-		//Serialize it
-		message->Serialize(msgBuffer,msgLength);
+		//Check if it is shared with other connections
+		msgPayload = message->GetSerialized();
+
+		//If so
+		if (msgPayload)
+		{
+			//Send it from there, only headers are ours
+			msgPayload->AddRef();
+		} else {
+			//Allocate data for serialized message
+			msgPayload = RTMPSerializedPayload::Create(msgLength);
+			//Serialize it
+			message->Serialize(msgPayload->data,msgLength);
+		}
 
 		//Select wich header
 		if (!msgStreamId || msgStreamId!=streamId || msgTimestamp<timestamp)
@@ -286,40 +361,133 @@ DWORD RTMPChunkOutputStream::GetNextChunk(BYTE *data,DWORD size,DWORD maxChunkSi
 		headersLen += extts.Serialize(data+headersLen,size-headersLen);
 
 	//Size of the msg data of the chunk
-	DWORD payloadLen = maxChunkSize;
+	DWORD len = maxChunkSize;
 	//If we have more than needed
-	if (payloadLen>length-pos)
-		//Just copy until the oend of the object
-		payloadLen = length-pos;
-	
-	//Copy
-	memcpy(data+headersLen,msgBuffer+pos,payloadLen);
+	if (len>length-pos)
+		//Just until the end of the object
+		len = length-pos;
+
+	//Reference the payload slice, it is kept until the chunk is sent
+	msgPayload->AddRef();
+	*payload = msgPayload;
+	*offset = pos;
+	*payloadLen = len;
 
 	//Increase sent data from msg
-	pos += payloadLen;
+	pos += len;
+	//Less pending bytes
+	queued -= len;
 	//Check if we have finished with this message	
 	if (pos==length)
-	{
-		//Delete buffer
-		free(msgBuffer);
-		//Null
-		msgBuffer = NULL;
-		//Delete message
-		delete(message);
-		//Next one
-		message = NULL;
-	}
+		//Release it
+		ReleaseMessage();
 
 	//Check
 	if (chunkHeader)
 		//Delete it
 		delete (chunkHeader);
 
+	//Return headers length
+	return headersLen;
+}
+
+void RTMPChunkOutputStream::ReleaseMessage()
+{
+	//Release payload
+	msgPayload->Release();
+	//Null
+	msgPayload = NULL;
+	//Delete message
+	delete(message);
+	//Next one
+	message = NULL;
+}
+
+DWORD RTMPChunkOutputStream::GetNextChunk(BYTE *data,DWORD size,DWORD maxChunkSize)
+{
+	RTMPSerializedPayload* payload;
+	DWORD offset;
+	DWORD payloadLen;
+
+	//lock now
+	pthread_mutex_lock(&mutex);
+
+	//Get next chunk header
+	DWORD headersLen = PrepareChunk(data,size,maxChunkSize,&payload,&offset,&payloadLen);
+
 	//Unlock
 	pthread_mutex_unlock(&mutex);
 
+	//If no more data
+	if (!headersLen)
+		//Nothing
+		return 0;
+
+	//Copy
+	memcpy(data+headersLen,payload->GetData()+offset,payloadLen);
+	//Done with it
+	payload->Release();
+
 	//Return copied data
-	return headersLen+payloadLen;	
+	return headersLen+payloadLen;
+}
+
+DWORD RTMPChunkOutputStream::GetNextChunk(RTMPChunkOutput &output,DWORD maxChunkSize)
+{
+	RTMPSerializedPayload* payload;
+	DWORD offset;
+	DWORD payloadLen;
+
+	//Check we have room
+	if (output.IsFull())
+		//Nothing
+		return 0;
+
+	//Get header position in the arena
+	BYTE* header = output.headers+output.chunks*RTMPChunkOutput::MaxHeaderSize;
+
+	//lock now
+	pthread_mutex_lock(&mutex);
+
+	//Get next chunk header
+	DWORD headersLen = PrepareChunk(header,RTMPChunkOutput::MaxHeaderSize,maxChunkSize,&payload,&offset,&payloadLen);
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//If no more data
+	if (!headersLen)
+		//Nothing
+		return 0;
+
+	//One more chunk
+	output.chunks++;
+
+	//Add header
+	output.iov[output.num].iov_base = header;
+	output.iov[output.num].iov_len = headersLen;
+	output.payloads[output.num] = NULL;
+	output.num++;
+
+	//If it has payload
+	if (payloadLen)
+	{
+		//Point to the message data, no copy
+		output.iov[output.num].iov_base = (void*)(payload->GetData()+offset);
+		output.iov[output.num].iov_len = payloadLen;
+		//Keep reference until written
+		output.payloads[output.num] = payload;
+		output.num++;
+	} else {
+		//Not needed
+		payload->Release();
+	}
+
+	//Increase length
+	output.length += headersLen+payloadLen;
+
+	//Return chunk length
+	return headersLen+payloadLen;
 }
 
 bool RTMPChunkOutputStream::HasData()
@@ -334,6 +502,18 @@ bool RTMPChunkOutputStream::HasData()
 	return ret;
 }
 
+DWORD RTMPChunkOutputStream::GetQueuedBytes()
+{
+	//lock now
+	pthread_mutex_lock(&mutex);
+	//Get message payload bytes not yet chunked
+	DWORD ret = queued;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	return ret;
+}
+
 bool RTMPChunkOutputStream::ResetStream(DWORD id)
 {
 	Log("-ResetStream %d\n",id);
@@ -351,9 +531,12 @@ bool RTMPChunkOutputStream::ResetStream(DWORD id)
 		RTMPMessage *msg = *it;
 		//Get message
 		if (msg && msg->GetStreamId()==id)
+		{
+			//Not pending anymore
+			queued -= msg->GetLength();
 			//Remove it
 			it = messages.erase(it);
-		else
+		} else
 			//next one;
 			 ++it;
 	}
@@ -361,14 +544,10 @@ bool RTMPChunkOutputStream::ResetStream(DWORD id)
 	//If we have message of this stream
 	if (message && message->GetStreamId()==id)
 	{
-		//Delete buffer
-		free(msgBuffer);
-		//Null
-		msgBuffer = NULL;
-		//Delete message
-		delete(message);
-		//Next one
-		message = NULL;
+		//Remove what was left to be sent
+		queued -= length-pos;
+		//Release it
+		ReleaseMessage();
 		//We have to abort
 		abort = true;
 	}
@@ -1033,15 +1033,20 @@ void RTMPClientConnection::onMediaFrame(DWORD streamId,RTMPMediaFrame *frame)
 		//Calculate timestamp based on current time
 		ts = getDifTime(&startTime)/1000;
 
+	//Get serialized payload shared by all listeners
+	RTMPSerializedPayload* payload = frame->GetSerialized();
+	//Reference it if available instead of cloning the frame
+	RTMPMessage* msg = payload ? new RTMPMessage(streamId,ts,frame->GetType(),payload) : new RTMPMessage(streamId,ts,frame->Clone());
+
 	//Dependign on the streams
 	switch(frame->GetType())
 	{
 		case RTMPMediaFrame::Audio:
 			//Append to the audio trunk
-			chunkOutputStreams[4]->SendMessage(new RTMPMessage(streamId,ts,frame->Clone()));
+			chunkOutputStreams[4]->SendMessage(msg);
 			break;
 		case RTMPMediaFrame::Video:
-			chunkOutputStreams[5]->SendMessage(new RTMPMessage(streamId,ts,frame->Clone()));
+			chunkOutputStreams[5]->SendMessage(msg);
 			break;
 	}
 	//Signal frames
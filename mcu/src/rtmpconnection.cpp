@@ -43,8 +43,12 @@ RTMPConnection::RTMPConnection(Listener *listener)
 	//Not inited
 	inited = false;
 	running = false;
+	reactor = false;
 	socket = FD_INVALID;
 	setZeroThread(&thread);
+	//Not dropping video
+	waitIntra = false;
+	droppedFrames = 0;
 	//Set initial time
 	gettimeofday(&startTime,0);
 	//Init mutex
@@ -63,6 +67,10 @@ RTMPConnection::~RTMPConnection()
 {
 	//End just in case
 	End();
+	//If it was polled by the reactor
+	if (reactor)
+		//Wait until no handler is running for us
+		TCPReactor::getInstance().ReleaseConnection(this);
 	//For each chunk strean
 	for (RTMPChunkInputStreams::iterator it=chunkInputStreams.begin(); it!=chunkInputStreams.end(); ++it)
 		//Delete it
@@ -98,6 +106,34 @@ void RTMPConnection::Start()
 	//We are running
 	running = true;
 
+	//If using the shared reactor
+	if (TCPReactor::getInstance().IsRunning())
+	{
+		//Not waiting for writes yet
+		ufds[0].fd = socket;
+		ufds[0].events = POLLIN | POLLERR | POLLHUP;
+
+		//Set non blocking, reactor handlers read and write until they would block
+		int fsflags = fcntl(socket,F_GETFL,0);
+		fsflags |= O_NONBLOCK;
+		fcntl(socket,F_SETFL,fsflags);
+
+		//Set no delay option
+		int flag = 1;
+		setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(int));
+
+		//Set it before adding, as events may be dispatched right away
+		reactor = true;
+
+		//Add it
+		if (TCPReactor::getInstance().AddConnection(this,socket))
+			//Done
+			return;
+
+		//Use own thread instead
+		reactor = false;
+	}
+
 	//Create thread
 	createPriorityThread(&thread,run,this,0);
 }
@@ -130,16 +166,27 @@ int RTMPConnection::End()
 	//Not inited any more
 	inited = false;
 
-	//Stop just in case
-	Stop();
-
-	//If running
-	if (!isZeroThread(thread))
+	//If polled by the reactor
+	if (reactor)
 	{
-		//Wait for server thread to close
-		pthread_join(thread,NULL);
-		//No thread
-		setZeroThread(&thread);
+		//Not running
+		running = false;
+		//Stop polling it, if the worker has not closed it already do it now
+		if (TCPReactor::getInstance().RemoveConnection(this))
+			//Close socket and launch disconnect event
+			onClosed();
+	} else {
+		//Stop just in case
+		Stop();
+
+		//If running
+		if (!isZeroThread(thread))
+		{
+			//Wait for server thread to close
+			pthread_join(thread,NULL);
+			//No thread
+			setZeroThread(&thread);
+		}
 	}
 
 	//If got application
@@ -222,16 +269,14 @@ int RTMPConnection::Run()
 
 		if (ufds[0].revents & POLLOUT)
 		{
-			//Write data buffer
-			DWORD len = SerializeChunkData(data,size);
-			//Check length
-			if (len)
-			{
-				//Send it
-				WriteData(data,len);
-				//Increase sent bytes
-				outBytes += len;
-			}
+			//If previous chunks have been written
+			if (output.IsEmpty())
+				//Get next ones and increase sent bytes
+				outBytes += SerializeChunkData(output);
+			//If there is something to write
+			if (!output.IsEmpty())
+				//Send it, the rest is kept for next time
+				WriteChunkData();
 		}
 
 		if (ufds[0].revents & POLLIN)
@@ -278,6 +323,131 @@ int RTMPConnection::Run()
 		listener->onDisconnect(this);
 }
 
+/***************************
+ * onReadable
+ * 	Reactor read event, read until it would block
+ ***************************/
+bool RTMPConnection::onReadable()
+{
+	BYTE data[4096];
+
+	//While not ended
+	while(running)
+	{
+		//Read data from connection
+		int len = read(socket,data,sizeof(data));
+		//If nothing read
+		if (len<0)
+		{
+			//If no more data available
+			if (errno==EAGAIN || errno==EWOULDBLOCK)
+				//Wait for next event
+				return true;
+			//If interrupted
+			if (errno==EINTR)
+				//Try again
+				continue;
+			//Error
+			Log("Readed [%d,%d]\n",len,errno);
+			//Close
+			return false;
+		}
+		//If closed
+		if (!len)
+		{
+			//Log
+			Log("-RTMPConnection::onReadable() | connection closed by peer\n");
+			//Close
+			return false;
+		}
+		//Increase in bytes
+		inBytes += len;
+
+		try {
+			//Parse data
+			ParseData(data,len);
+		} catch (std::exception &e) {
+			//Show error
+			Error("Exception parsing data: %s\n",e.what());
+			//Dump it
+			Dump(data,len);
+			//Close on any error
+			return false;
+		}
+	}
+
+	//Ended
+	return false;
+}
+
+/***************************
+ * onWritable
+ * 	Reactor write event, write until it would block or nothing is left
+ ***************************/
+bool RTMPConnection::onWritable()
+{
+	//While not ended
+	while(running)
+	{
+		//If previous chunks have been written
+		if (output.IsEmpty())
+		{
+			//Get next ones
+			DWORD len = SerializeChunkData(output);
+			//If nothing left
+			if (!len)
+				//Wait until signaled
+				return true;
+			//Increase sent bytes
+			outBytes += len;
+		}
+
+		//Send them
+		int len = WriteChunkData();
+		//Check
+		if (len<0)
+		{
+			//If socket buffer is full
+			if (errno==EAGAIN || errno==EWOULDBLOCK)
+				//Wait for next event, rest is kept for then
+				return true;
+			//If interrupted
+			if (errno==EINTR)
+				//Try again
+				continue;
+			//Error
+			Log("-RTMPConnection::onWritable() | error writing [errno:%d]\n",errno);
+			//Close
+			return false;
+		}
+	}
+
+	//Ended
+	return false;
+}
+
+/***************************
+ * onClosed
+ * 	Removed from reactor, close and launch event
+ ***************************/
+void RTMPConnection::onClosed()
+{
+	Log("-RTMPConnection::onClosed() [%p]\n",this);
+
+	//Not running anymore
+	running = false;
+	//Close socket
+	shutdown(socket,SHUT_RDWR);
+	MCU_CLOSE(socket);
+	//No socket
+	socket = FD_INVALID;
+
+	//Check listener
+	if (listener)
+		//launch event
+		listener->onDisconnect(this);
+}
+
 void RTMPConnection::SignalWriteNeeded()
 {
 	//lock now
@@ -298,13 +468,17 @@ void RTMPConnection::SignalWriteNeeded()
 	//Unlock
 	pthread_mutex_unlock(&mutex);
 
+	//If polled by the reactor
+	if (reactor)
+		//Make the worker write it
+		TCPReactor::getInstance().SignalWrite(this);
 	//Check thred
-	if (!isZeroThread(thread))
+	else if (!isZeroThread(thread))
 		//Signal the pthread this will cause the poll call to exit
 		pthread_kill(thread,SIGIO);
 }
 
-DWORD RTMPConnection::SerializeChunkData(BYTE *data,DWORD size)
+DWORD RTMPConnection::SerializeChunkData(RTMPChunkOutput &output)
 {
 	DWORD len = 0;
 
@@ -324,7 +498,7 @@ DWORD RTMPConnection::SerializeChunkData(BYTE *data,DWORD size)
 		while (chunkOutputStream->HasData())
 		{
 			//Check if we do not have enought space left for more
-			if(size-len<maxOutChunkSize+12)
+			if(output.IsFull())
 			{
 				//We have more data to write
 				//ufds[0].events = POLLIN | POLLOUT | POLLERR | POLLHUP;
@@ -332,8 +506,8 @@ DWORD RTMPConnection::SerializeChunkData(BYTE *data,DWORD size)
 				goto end;
 			}
 
-			//Write next chunk from this stream
-			len += chunkOutputStream->GetNextChunk(data+len,size-len,maxOutChunkSize);
+			//Add next chunk from this stream, payload is not copied
+			len += chunkOutputStream->GetNextChunk(output,maxOutChunkSize);
 
 		}
 	}
@@ -761,6 +935,22 @@ void RTMPConnection::ParseData(BYTE *data,const DWORD size)
 	}
 }
 
+/***********************
+ * WriteChunkData
+ *	Write pending chunks to socket
+ ***********************/
+int RTMPConnection::WriteChunkData()
+{
+	//Write all pending chunks at once
+	int len = writev(socket,output.GetIOVec(),output.GetIOVecLength());
+	//If written
+	if (len>0)
+		//Remove them, payloads fully sent are released
+		output.Consume(len);
+	//Return written
+	return len;
+}
+
 /***********************
  * WriteData
  *	Write data to socket
@@ -1190,15 +1380,62 @@ void RTMPConnection::onMediaFrame(DWORD streamId,RTMPMediaFrame *frame)
 		//Calculate timestamp based on current time
 		ts = getDifTime(&startTime)/1000;
 
+	//If it is video
+	if (frame->GetType()==RTMPMediaFrame::Video)
+	{
+		//Get video frame
+		RTMPVideoFrame* video = (RTMPVideoFrame*)frame;
+		//AVC sequence headers are needed to decode anything, never drop them
+		bool header = video->GetVideoCodec()==RTMPVideoFrame::AVC && video->GetAVCType()==RTMPVideoFrame::AVCHEADER;
+		//Only frames that other frames do not need to be decoded from can be dropped
+		bool droppable = !header && (video->GetFrameType()==RTMPVideoFrame::INTER || video->GetFrameType()==RTMPVideoFrame::DISPOSABLE_INTER);
+		//Check if it is a key frame
+		bool intra = video->GetFrameType()==RTMPVideoFrame::INTRA || video->GetFrameType()==RTMPVideoFrame::GENERATED_KEY_FRAME;
+
+		//If we are not draining video fast enought
+		if (droppable && !waitIntra && chunkOutputStreams[5]->GetQueuedBytes()>MaxQueuedVideo)
+		{
+			//Log
+			Log("-RTMPConnection::onMediaFrame() | slow consumer, dropping video until next key frame [queued:%u]\n",chunkOutputStreams[5]->GetQueuedBytes());
+			//Drop until next intra
+			waitIntra = true;
+		}
+
+		//If dropping
+		if (waitIntra)
+		{
+			//Check if we can start again
+			if (intra)
+			{
+				//Log
+				Log("-RTMPConnection::onMediaFrame() | key frame received, resuming video [dropped:%u]\n",droppedFrames);
+				//Not waiting anymore
+				waitIntra = false;
+				//Reset
+				droppedFrames = 0;
+			} else if (droppable) {
+				//One more
+				droppedFrames++;
+				//Skip it
+				return;
+			}
+		}
+	}
+
+	//Get serialized payload shared by all listeners
+	RTMPSerializedPayload* payload = frame->GetSerialized();
+	//Reference it if available instead of cloning the frame
+	RTMPMessage* msg = payload ? new RTMPMessage(streamId,ts,frame->GetType(),payload) : new RTMPMessage(streamId,ts,frame->Clone());
+
 	//Dependign on the streams
 	switch(frame->GetType())
 	{
 		case RTMPMediaFrame::Audio:
 			//Append to the audio trunk
-			chunkOutputStreams[4]->SendMessage(new RTMPMessage(streamId,ts,frame->Clone()));
+			chunkOutputStreams[4]->SendMessage(msg);
 			break;
 		case RTMPMediaFrame::Video:
-			chunkOutputStreams[5]->SendMessage(new RTMPMessage(streamId,ts,frame->Clone()));
+			chunkOutputStreams[5]->SendMessage(msg);
 			break;
 	}
 	//Signal frames
@@ -22,6 +22,7 @@ RTMPMessage::RTMPMessage(DWORD streamId,QWORD timestamp,Type type,DWORD length)
 	ctrl 	= NULL;
 	meta 	= NULL;
 	media 	= NULL;
+	payload = NULL;
 
 	//No skip
 	skip = false;
@@ -112,6 +113,7 @@ RTMPMessage::RTMPMessage(DWORD streamId,QWORD timestamp,Type type,RTMPObject* ct
 	this->cmd = NULL;
 	this->meta = NULL;
 	this->media = NULL;
+	this->payload = NULL;
 }
 
 RTMPMessage::RTMPMessage(DWORD streamId,QWORD timestamp,RTMPCommandMessage* cmd)
@@ -127,6 +129,7 @@ RTMPMessage::RTMPMessage(DWORD streamId,QWORD timestamp,RTMPCommandMessage* cmd)
 	this->cmd = cmd;
 	this->meta = NULL;
 	this->media = NULL;
+	this->payload = NULL;
 }
 
 RTMPMessage::RTMPMessage(DWORD streamId,QWORD timestamp,RTMPMediaFrame* media)
@@ -151,6 +154,7 @@ RTMPMessage::RTMPMessage(DWORD streamId,QWORD timestamp,RTMPMediaFrame* media)
 	this->cmd = NULL;
 	this->meta = NULL;
 	this->media = media;
+	this->payload = NULL;
 }
 
 RTMPMessage::RTMPMessage(DWORD streamId,QWORD timestamp,RTMPMetaData* meta)
@@ -166,6 +170,27 @@ RTMPMessage::RTMPMessage(DWORD streamId,QWORD timestamp,RTMPMetaData* meta)
 	this->cmd = NULL;
 	this->meta = meta;
 	this->media = NULL;
+	this->payload = NULL;
+}
+
+RTMPMessage::RTMPMessage(DWORD streamId,QWORD timestamp,RTMPMediaFrame::Type type,RTMPSerializedPayload* payload)
+{
+	//Store values
+	this->streamId = streamId;
+	this->type = (RTMPMessage::Type)type;
+	this->timestamp = timestamp;
+	//Message size is the serialized one
+	this->length = payload->GetSize();
+	//Store msg
+	this->ctrl = NULL;
+	this->cmd = NULL;
+	this->meta = NULL;
+	this->media = NULL;
+	//Keep a reference
+	this->payload = payload;
+	payload->AddRef();
+	//One more
+	payload->AddUse();
 }
 
 RTMPMessage::~RTMPMessage()
@@ -179,6 +204,8 @@ RTMPMessage::~RTMPMessage()
 		delete(meta);
 	if (media)
 		delete(media);
+	if (payload)
+		payload->Release();
 }
 
 DWORD RTMPMessage::Serialize(BYTE* data,DWORD size)
@@ -191,6 +218,13 @@ DWORD RTMPMessage::Serialize(BYTE* data,DWORD size)
 		return meta->Serialize(data,size);
 	if (media)
 		return media->Serialize(data,size);
+	if (payload && size>=payload->GetSize())
+	{
+		//Copy it
+		memcpy(data,payload->GetData(),payload->GetSize());
+		//Done
+		return payload->GetSize();
+	}
 	return 0;
 }
 
@@ -750,6 +784,8 @@ RTMPMediaFrame::RTMPMediaFrame(Type type,QWORD timestamp,BYTE *data,DWORD size)
 	mediaSize = size;
 	//Set position to the begining
 	this->pos = 0;
+	//Not serialized yet
+	this->serialized = NULL;
 	//Empty padding
 	memset(buffer+bufferSize,0,16);
 }
@@ -763,6 +799,8 @@ RTMPMediaFrame::RTMPMediaFrame(Type type,QWORD timestamp,DWORD size)
 	this->buffer = (BYTE*)malloc(bufferSize+16);
 	this->pos = 0;
 	this->mediaSize = 0;
+	//Not serialized yet
+	this->serialized = NULL;
 	//Empty padding
 	memset(buffer+bufferSize,0,16);
 }
@@ -804,12 +842,74 @@ DWORD RTMPMediaFrame::Serialize(BYTE* data,DWORD size)
 
 RTMPMediaFrame::~RTMPMediaFrame()
 {
+	//Release serialized payload
+	ClearSerialized();
 	//Check buffer alwasy
 	if (buffer)
 		//Delete
 		free(buffer);
 }
 
+bool RTMPMediaFrame::CacheSerialized()
+{
+	//Check if already done, i.e. we are being piped
+	if (serialized)
+		//Not ours
+		return false;
+
+	//Get serialized size
+	DWORD size = GetSize();
+	//Create payload
+	RTMPSerializedPayload* payload = RTMPSerializedPayload::Create(size);
+	//Serialize once
+	Serialize(payload->data,size);
+	//Store it
+	serialized = payload;
+
+	//Created
+	return true;
+}
+
+void RTMPMediaFrame::ClearSerialized()
+{
+	//If we have it
+	if (serialized)
+		//Release our reference, queued messages keep theirs
+		serialized->Release();
+	//No more
+	serialized = NULL;
+}
+
+/************************************
+ * RTMPSerializedPayload
+ *
+ ***********************************/
+RTMPSerializedPayload* RTMPSerializedPayload::Create(DWORD size)
+{
+	//Create new one
+	RTMPSerializedPayload* payload = new RTMPSerializedPayload();
+	//Allocate data
+	payload->data = (BYTE*)malloc(size);
+	payload->size = size;
+	//One reference for the creator
+	payload->refs = 1;
+	payload->uses = 0;
+	//Done
+	return payload;
+}
+
+void RTMPSerializedPayload::Release()
+{
+	//If it was the last one
+	if (!__sync_sub_and_fetch(&refs,1))
+	{
+		//Free data
+		free(data);
+		//Delete
+		delete(this);
+	}
+}
+
 void RTMPMediaFrame::Dump()
 {
 	//Dump
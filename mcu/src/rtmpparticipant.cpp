@@ -1004,14 +1004,18 @@ int RTMPParticipant::RecVideo()
 			videoOutput->SetVideoSize(width,height);
 		}
 
-		//Get frame
-		BYTE *frame = decoder->GetFrame();
+		//Get frame, as decoded
+		VideoBuffer *frame = decoder->GetBuffer();
 
 		//If it is muted
 		if (!videoMuted && frame)
 			//Send
 			videoOutput->NextFrame(frame);
 
+		//Release it
+		if (frame)
+			frame->Release();
+
 		//Delete video frame
 		delete(video);
 	}
@@ -222,11 +222,19 @@ void RTMPServer::CreateConnection(int fd)
  **************************/
 void RTMPServer::CleanZombies()
 {
+	Connections dead;
+
 	//Lock list
 	pthread_mutex_lock(&sessionMutex);
 
+	//Get zombies
+	dead.swap(zombies);
+
+	//Unlock list, deleting may wait for a connection that is disconnecting right now
+	pthread_mutex_unlock(&sessionMutex);
+
 	//Zombie iterator
-	for (Connections::iterator it=zombies.begin();it!=zombies.end();++it)
+	for (Connections::iterator it=dead.begin();it!=dead.end();++it)
 	{
 		//Get connection
 		RTMPConnection *con = *it;
@@ -234,12 +242,6 @@ void RTMPServer::CleanZombies()
 		delete con;
 	}
 
-	//Clear zombies
-	zombies.clear();
-
-	//Unlock list
-	pthread_mutex_unlock(&sessionMutex);
-
 }
 
 /*********************
@@ -250,26 +252,34 @@ void RTMPServer::DeleteAllConnections()
 {
 	Log(">Delete all connections\n");
 
+	Connections ended;
+
 	//Lock list
 	pthread_mutex_lock(&sessionMutex);
 
+	//Get connections
+	ended.swap(connections);
+
+	//Unlock list, ending them fires their disconnect event
+	pthread_mutex_unlock(&sessionMutex);
+
 	//Connection iterator
-	for (Connections::iterator it=connections.begin();it!=connections.end();++it)
+	for (Connections::iterator it=ended.begin();it!=ended.end();++it)
 	{
 		//Get connection
 		RTMPConnection *con = *it;
 		//End connection
 		con->End();
+		//Lock list
+		pthread_mutex_lock(&sessionMutex);
+		//It has been added as zombie on disconnect, we delete it now
+		zombies.remove(con);
+		//Unlock list
+		pthread_mutex_unlock(&sessionMutex);
 		//Delete connection
 		delete con;
 	}
 
-	//Clear connections
-	connections.clear();
-
-	//Unlock list
-	pthread_mutex_unlock(&sessionMutex);
-
 	Log("<Delete all connections\n");
 
 }
@@ -1,17 +1,47 @@
 #include <sys/poll.h>
 
 #include "log.h"
+#include "tools.h"
+#include "eventstreaminghandler.h"
 #include "rtmpstream.h"
 
+//Process wide serialization sharing stats
+static RTMPMediaStream::Stats stats = {0};
+
+static EvenSource& GetEventSource()
+{
+	//Created on first use
+	static EvenSource source("rtmp");
+	return source;
+}
+
+RTMPMediaStream::Stats RTMPMediaStream::GetStats()
+{
+	Stats copy;
+	//Get them, updated without lock
+	copy.frames		= __atomic_load_n(&stats.frames,__ATOMIC_RELAXED);
+	copy.messages		= __atomic_load_n(&stats.messages,__ATOMIC_RELAXED);
+	copy.serializedBytes	= __atomic_load_n(&stats.serializedBytes,__ATOMIC_RELAXED);
+	copy.savedBytes		= __atomic_load_n(&stats.savedBytes,__ATOMIC_RELAXED);
+	//Return them
+	return copy;
+}
+
 RTMPMediaStream::RTMPMediaStream()
 {
 	this->id = 0;
 	this->data = 0;
+	//Start stats period
+	this->savedBytes = 0;
+	getUpdDifTime(&lastStats);
 }
 RTMPMediaStream::RTMPMediaStream(DWORD id)
 {
 	this->id = id;
 	this->data = 0;
+	//Start stats period
+	this->savedBytes = 0;
+	getUpdDifTime(&lastStats);
 }
 
 RTMPMediaStream::~RTMPMediaStream()
@@ -76,12 +106,50 @@ void RTMPMediaStream::SendMediaFrame(RTMPMediaFrame* frame)
 {
 	//Lock mutexk
 	lock.IncUse();
+	//Serialize it only once for all the connections, unless we are piped and it is already
+	bool cached = !listeners.empty() && frame->CacheSerialized();
 	//Iterate
 	for (Listeners::iterator it = listeners.begin(); it!=listeners.end(); ++it)
 		//Send it
 		(*it)->onMediaFrame(id,frame);
+	//If we have serialized it
+	if (cached)
+	{
+		//Get payload
+		RTMPSerializedPayload* payload = frame->GetSerialized();
+		//Update process wide stats
+		__sync_add_and_fetch(&stats.frames,1);
+		__sync_add_and_fetch(&stats.messages,payload->GetUses());
+		__sync_add_and_fetch(&stats.serializedBytes,payload->GetSize());
+		//Each message after the first one would have serialized it again
+		if (payload->GetUses()>1)
+		{
+			//Get saved bytes
+			QWORD saved = (QWORD)(payload->GetUses()-1)*payload->GetSize();
+			//Increase them
+			__sync_add_and_fetch(&savedBytes,saved);
+			__sync_add_and_fetch(&stats.savedBytes,saved);
+		}
+		//Frame may be modified after this, so drop it
+		frame->ClearSerialized();
+	}
 	//Unlock
 	lock.DecUse();
+
+	//Get elapsed time
+	QWORD elapsed = getDifTime(&lastStats);
+	//Report each second
+	if (cached && elapsed>1000000)
+	{
+		//Get saved bytes and reset them
+		QWORD saved = __sync_fetch_and_and(&savedBytes,0);
+		//Start next period
+		getUpdDifTime(&lastStats);
+		//Log it
+		Debug("-RTMPMediaStream serialization saved [id:%d,listeners:%d,bytes/s:%llu]\n",id,GetNumListeners(),saved*1000000/elapsed);
+		//Send event, so it can be checked in production
+		GetEventSource().SendEvent("serializationStats","{id:%d,listeners:%d,saved:%llu}",id,GetNumListeners(),saved*1000000/elapsed);
+	}
 }
 
 void RTMPMediaStream::SendCommand(const wchar_t *name,AMFData* obj)
@@ -1454,7 +1454,7 @@ RTPRedundantPacket::RTPRedundantPacket(MediaFrame::Type media,BYTE *data,DWORD s
 RTPTimedPacket* RTPRedundantPacket::CreatePrimaryPacket()
 {
 	//Create new pacekt
-	RTPTimedPacket* packet = new RTPTimedPacket(GetMedia(),primaryCodec,primaryType);
+	RTPTimedPacket* packet = new(GetMedia()) RTPTimedPacket(GetMedia(),primaryCodec,primaryType);
 	//Set attributes
 	packet->SetClockRate(GetClockRate());
 	packet->SetMark(GetMark());
@@ -0,0 +1,337 @@
+/*
+ * File:   rtppacketpool.cpp
+ * Author: Sergio
+ *
+ * Created on 16 de octubre de 2026, 17:40
+ */
+
+#include <stdlib.h>
+#include <new>
+#include "log.h"
+#include "rtp.h"
+#include "rtppacketpool.h"
+
+//Block header, the object is placed just after it
+struct PoolBlock
+{
+	struct PacketPool*	pool;
+	PoolBlock*		next;
+};
+
+struct PacketPool
+{
+	pthread_mutex_t	mutex;
+	PoolBlock*		free;
+	DWORD		cached;
+	DWORD		resident;
+	QWORD		allocs;
+	QWORD		hits;
+};
+
+struct PoolCache
+{
+	PoolBlock*	free[3];
+	DWORD	num[3];
+};
+
+//Biggest packet object, larger ones are not pooled
+static const size_t BlockSize = sizeof(RTPRedundantPacket);
+//Number of pools, one per media type
+static const int NumPools = 3;
+
+//The pools
+static PacketPool pools[NumPools] = {
+	{PTHREAD_MUTEX_INITIALIZER,NULL,0,0,0,0},
+	{PTHREAD_MUTEX_INITIALIZER,NULL,0,0,0,0},
+	{PTHREAD_MUTEX_INITIALIZER,NULL,0,0,0,0}
+};
+//Max free blocks on each global list
+static DWORD maxCached = 2048;
+
+//Thread caches
+static __thread PoolCache* threadCache = NULL;
+static pthread_key_t key;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static void ReleaseToGlobal(PacketPool* pool,PoolBlock* first,PoolBlock* last,DWORD num)
+{
+	//Lock
+	pthread_mutex_lock(&pool->mutex);
+
+	//Check if they fit in the global list
+	if (pool->cached+num<=maxCached)
+	{
+		//Append them
+		last->next = pool->free;
+		pool->free = first;
+		//Increase count
+		pool->cached += num;
+		//Unlock
+		pthread_mutex_unlock(&pool->mutex);
+		//Done
+		return;
+	}
+
+	//They will be freed, it is increased without the lock
+	__sync_sub_and_fetch(&pool->resident,num);
+
+	//Unlock
+	pthread_mutex_unlock(&pool->mutex);
+
+	//Free them all
+	while (first)
+	{
+		//Get next
+		PoolBlock* next = first->next;
+		//Free it
+		free(first);
+		//Move
+		first = next;
+	}
+}
+
+static void FlushCache(void* par)
+{
+	//Get cache
+	PoolCache* cache = (PoolCache*)par;
+
+	//For each pool
+	for (int i=0;i<NumPools;++i)
+	{
+		//Get first
+		PoolBlock* first = cache->free[i];
+		//If empty
+		if (!first)
+			//Next
+			continue;
+		//Find last
+		PoolBlock* last = first;
+		while (last->next)
+			last = last->next;
+		//Give them back
+		ReleaseToGlobal(&pools[i],first,last,cache->num[i]);
+	}
+
+	//If it is the one of this thread
+	if (threadCache==cache)
+		//Not anymore
+		threadCache = NULL;
+
+	//Free it
+	free(cache);
+}
+
+static void CreateKey()
+{
+	//Flush caches on thread exit
+	pthread_key_create(&key,FlushCache);
+}
+
+static PacketPool* GetPool(MediaFrame::Type media)
+{
+	//Check media
+	if (media<0 || media>=NumPools)
+		//Not pooled
+		return NULL;
+	//Return it
+	return &pools[media];
+}
+
+static PoolCache* GetCache()
+{
+	//If already created for this thread
+	if (threadCache)
+		//Return it
+		return threadCache;
+
+	//Create key only once
+	pthread_once(&once,CreateKey);
+
+	//Create new empty cache
+	PoolCache* cache = (PoolCache*)calloc(1,sizeof(PoolCache));
+
+	//Check
+	if (!cache)
+		//Not cached
+		return NULL;
+
+	//Register it so it is flushed when the thread ends
+	pthread_setspecific(key,cache);
+
+	//Store it
+	threadCache = cache;
+
+	//Return it
+	return cache;
+}
+
+void* RTPPacketPool::Allocate(size_t size,MediaFrame::Type media)
+{
+	//Get pool for media
+	PacketPool* pool = GetPool(media);
+
+	//If there is no pool for it or it is bigger than our blocks
+	if (!pool || size>BlockSize)
+	{
+		//Not pooled
+		PoolBlock* block = (PoolBlock*)malloc(sizeof(PoolBlock)+size);
+		//Check
+		if (!block)
+			throw std::bad_alloc();
+		//Not from a pool
+		block->pool = NULL;
+		//Return object memory
+		return block+1;
+	}
+
+	//Get pool index
+	int i = pool-pools;
+
+	//One more allocation
+	__sync_add_and_fetch(&pool->allocs,1);
+
+	//Get thread cache
+	PoolCache* cache = GetCache();
+
+	//If we don't have any free block on the thread cache
+	if (cache && !cache->free[i])
+	{
+		//Lock
+		pthread_mutex_lock(&pool->mutex);
+		//Move a batch from the global list
+		while (pool->free && cache->num[i]<BatchSize)
+		{
+			//Get first
+			PoolBlock* block = pool->free;
+			//Remove from global list
+			pool->free = block->next;
+			pool->cached--;
+			//Add to thread one
+			block->next = cache->free[i];
+			cache->free[i] = block;
+			cache->num[i]++;
+		}
+		//Unlock
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	//If we have a free block
+	if (cache && cache->free[i])
+	{
+		//Get it
+		PoolBlock* block = cache->free[i];
+		//Remove from list
+		cache->free[i] = block->next;
+		cache->num[i]--;
+		//One more hit
+		__sync_add_and_fetch(&pool->hits,1);
+		//Return object memory
+		return block+1;
+	}
+
+	//Allocate new block
+	PoolBlock* block = (PoolBlock*)malloc(sizeof(PoolBlock)+BlockSize);
+	//Check
+	if (!block)
+		throw std::bad_alloc();
+	//Set pool
+	block->pool = pool;
+	//One more resident
+	__sync_add_and_fetch(&pool->resident,1);
+	//Return object memory
+	return block+1;
+}
+
+void RTPPacketPool::Release(void* ptr)
+{
+	//Check
+	if (!ptr)
+		return;
+
+	//Get block
+	PoolBlock* block = ((PoolBlock*)ptr)-1;
+	//Get pool
+	PacketPool* pool = block->pool;
+
+	//If not pooled
+	if (!pool)
+	{
+		//Free it
+		free(block);
+		//Done
+		return;
+	}
+
+	//Get pool index
+	int i = pool-pools;
+
+	//Get thread cache
+	PoolCache* cache = GetCache();
+
+	//If no cache
+	if (!cache)
+	{
+		//Give it to the global list
+		block->next = NULL;
+		ReleaseToGlobal(pool,block,block,1);
+		//Done
+		return;
+	}
+
+	//Add to thread list
+	block->next = cache->free[i];
+	cache->free[i] = block;
+	cache->num[i]++;
+
+	//If we have too many
+	if (cache->num[i]>MaxThreadCached)
+	{
+		//Get first
+		PoolBlock* first = cache->free[i];
+		PoolBlock* last = first;
+		//Get a batch
+		for (DWORD n=1;n<BatchSize;++n)
+			last = last->next;
+		//Remove them
+		cache->free[i] = last->next;
+		cache->num[i] -= BatchSize;
+		//End list
+		last->next = NULL;
+		//Give them to the global list
+		ReleaseToGlobal(pool,first,last,BatchSize);
+	}
+}
+
+RTPPacketPool::Stats RTPPacketPool::GetStats(MediaFrame::Type media)
+{
+	Stats stats = {0};
+
+	//Get pool
+	PacketPool* pool = GetPool(media);
+
+	//Check
+	if (!pool)
+		//Empty
+		return stats;
+
+	//Lock
+	pthread_mutex_lock(&pool->mutex);
+	//Copy values
+	stats.allocs	= __atomic_load_n(&pool->allocs,__ATOMIC_RELAXED);
+	stats.hits	= __atomic_load_n(&pool->hits,__ATOMIC_RELAXED);
+	stats.resident	= __atomic_load_n(&pool->resident,__ATOMIC_RELAXED);
+	stats.cached	= pool->cached;
+	stats.blockSize	= sizeof(PoolBlock)+BlockSize;
+	//Unlock
+	pthread_mutex_unlock(&pool->mutex);
+
+	//Return them
+	return stats;
+}
+
+void RTPPacketPool::SetMaxCached(DWORD num)
+{
+	Log("-RTPPacketPool::SetMaxCached() | [num:%d]\n",num);
+	//Set it
+	maxCached = num;
+}
@@ -0,0 +1,389 @@
+/*
+ * File:   rtpreactor.cpp
+ * Author: Sergio
+ *
+ * Created on 16 de octubre de 2026, 10:12
+ */
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include "log.h"
+#include "tools.h"
+#include "rtpreactor.h"
+#include "rtpsession.h"
+
+RTPReactor::RTPReactor()
+{
+	//Not running
+	__atomic_store_n(&running,false,__ATOMIC_RELEASE);
+}
+
+RTPReactor::~RTPReactor()
+{
+	//Stop just in case
+	Stop();
+}
+
+bool RTPReactor::Start(int numWorkers)
+{
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Check if already running
+	if (running)
+		//Error
+		return Error("-RTPReactor::Start() | already running\n");
+
+	//If not set
+	if (numWorkers<=0)
+		//One per core
+		numWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+
+	//Check
+	if (numWorkers<=0)
+		//At least one
+		numWorkers = 1;
+
+	Log(">RTPReactor::Start() | [workers:%d]\n",numWorkers);
+
+	//We are running
+	__atomic_store_n(&running,true,__ATOMIC_RELEASE);
+
+	//Create workers
+	for (int i=0;i<numWorkers;++i)
+	{
+		//Create new worker
+		Worker* worker = new Worker();
+		//Init it
+		worker->reactor = this;
+		worker->numSessions = 0;
+		worker->numWakeUps = 0;
+		worker->numEvents = 0;
+		//Create epoll set
+		worker->epfd = epoll_create1(EPOLL_CLOEXEC);
+		//Create event fd for waking up the worker on stop
+		worker->efd = eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+		//Check
+		if (worker->epfd==FD_INVALID || worker->efd==FD_INVALID)
+		{
+			//Error
+			Error("-RTPReactor::Start() | could not create epoll set [errno:%d]\n",errno);
+			//Close
+			if (worker->epfd!=FD_INVALID) close(worker->epfd);
+			if (worker->efd!=FD_INVALID) close(worker->efd);
+			//Delete it
+			delete(worker);
+			//Skip
+			continue;
+		}
+		//Add the event fd to the set, with NULL session
+		epoll_event ev = {0};
+		ev.events = EPOLLIN;
+		ev.data.fd = worker->efd;
+		epoll_ctl(worker->epfd,EPOLL_CTL_ADD,worker->efd,&ev);
+		//Start thread
+		createPriorityThread(&worker->thread,run,worker,0);
+		//Add to workers
+		workers.push_back(worker);
+	}
+
+	//Check we have at least one
+	if (workers.empty())
+	{
+		//Not running
+		__atomic_store_n(&running,false,__ATOMIC_RELEASE);
+		//Error
+		return Error("<RTPReactor::Start() | no workers could be started\n");
+	}
+
+	Log("<RTPReactor::Start()\n");
+
+	//OK
+	return true;
+}
+
+bool RTPReactor::Stop()
+{
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Check if running
+	if (!running)
+		//Nothing to do
+		return false;
+
+	Log(">RTPReactor::Stop()\n");
+
+	//Not running anymore, workers check it when woken up
+	__atomic_store_n(&running,false,__ATOMIC_RELEASE);
+
+	//For each worker
+	for (Workers::iterator it=workers.begin();it!=workers.end();++it)
+	{
+		//Get worker
+		Worker* worker = *it;
+		//Wake it up
+		eventfd_write(worker->efd,1);
+		//Wait for thread to finish
+		pthread_join(worker->thread,NULL);
+		//Close fds, sessions sockets are owned by the sessions
+		close(worker->epfd);
+		close(worker->efd);
+		//Delete it
+		delete(worker);
+	}
+
+	//Clear all
+	workers.clear();
+	sessions.clear();
+
+	Log("<RTPReactor::Stop()\n");
+
+	//OK
+	return true;
+}
+
+bool RTPReactor::AddSession(RTPSession* session,int rtp,int rtcp)
+{
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Check if running
+	if (!running)
+		//Error
+		return false;
+
+	//Check if already registered
+	if (sessions.find(session)!=sessions.end())
+		//Error
+		return Error("-RTPReactor::AddSession() | session already registered [%p]\n",session);
+
+	//Find the least loaded worker
+	Worker* worker = workers.front();
+	//For the rest
+	for (Workers::iterator it=workers.begin();it!=workers.end();++it)
+		//If it has less sessions
+		if ((*it)->numSessions<worker->numSessions)
+			//Use it
+			worker = *it;
+
+	//Lock worker, this waits until no dispatch is in progress
+	ScopedUseLock lock(worker->use);
+
+	//Add sockets to the worker set
+	worker->sockets[rtp] = session;
+	worker->sockets[rtcp] = session;
+
+	//Poll for incoming data and errors
+	epoll_event ev = {0};
+	ev.events = EPOLLIN | EPOLLERR | EPOLLHUP;
+	ev.data.fd = rtp;
+	//Add rtp
+	if (epoll_ctl(worker->epfd,EPOLL_CTL_ADD,rtp,&ev)<0)
+	{
+		//Remove them
+		worker->sockets.erase(rtp);
+		worker->sockets.erase(rtcp);
+		//Error
+		return Error("-RTPReactor::AddSession() | could not add rtp socket [errno:%d]\n",errno);
+	}
+	//Set rtcp
+	ev.data.fd = rtcp;
+	//Add rtcp
+	if (epoll_ctl(worker->epfd,EPOLL_CTL_ADD,rtcp,&ev)<0)
+	{
+		//Remove rtp
+		epoll_ctl(worker->epfd,EPOLL_CTL_DEL,rtp,NULL);
+		//Remove them
+		worker->sockets.erase(rtp);
+		worker->sockets.erase(rtcp);
+		//Error
+		return Error("-RTPReactor::AddSession() | could not add rtcp socket [errno:%d]\n",errno);
+	}
+
+	//One more
+	worker->numSessions++;
+
+	//Store registration
+	Registration reg;
+	reg.worker = worker;
+	reg.rtp = rtp;
+	reg.rtcp = rtcp;
+	sessions[session] = reg;
+
+	//OK
+	return true;
+}
+
+bool RTPReactor::RemoveSession(RTPSession* session)
+{
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Find it
+	Sessions::iterator it = sessions.find(session);
+
+	//If not found
+	if (it==sessions.end())
+		//Nothing to do
+		return false;
+
+	//Get registration
+	Registration& reg = it->second;
+	Worker* worker = reg.worker;
+
+	//Lock worker, after this no event for the session will be dispatched
+	ScopedUseLock lock(worker->use);
+
+	//Remove from epoll set
+	epoll_ctl(worker->epfd,EPOLL_CTL_DEL,reg.rtp,NULL);
+	epoll_ctl(worker->epfd,EPOLL_CTL_DEL,reg.rtcp,NULL);
+
+	//Remove sockets
+	worker->sockets.erase(reg.rtp);
+	worker->sockets.erase(reg.rtcp);
+
+	//One less
+	worker->numSessions--;
+
+	//Remove registration
+	sessions.erase(it);
+
+	//OK
+	return true;
+}
+
+RTPReactor::Stats RTPReactor::GetStats()
+{
+	Stats stats = {0};
+
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Set values
+	stats.numWorkers = workers.size();
+	stats.numSessions = sessions.size();
+
+	//For each worker
+	for (Workers::iterator it=workers.begin();it!=workers.end();++it)
+	{
+		//Sum counters
+		stats.numWakeUps += (*it)->numWakeUps;
+		stats.numEvents += (*it)->numEvents;
+	}
+
+	//Return them
+	return stats;
+}
+
+void* RTPReactor::run(void *par)
+{
+	//Get worker
+	Worker* worker = (Worker*)par;
+
+	Log("-RTPReactor::run() | worker thread [%d,0x%x]\n",getpid(),par);
+
+	//Block signals to avoid exiting on SIGUSR1
+	blocksignals();
+
+	//Run
+	worker->reactor->Run(worker);
+
+	//Exit
+	return NULL;
+}
+
+int RTPReactor::Run(Worker* worker)
+{
+	epoll_event events[MaxEvents];
+
+	Log(">RTPReactor::Run() | [%p]\n",worker);
+
+	//Run until ended
+	while(__atomic_load_n(&running,__ATOMIC_ACQUIRE))
+	{
+		//Wait for events
+		int num = epoll_wait(worker->epfd,events,MaxEvents,-1);
+
+		//Check error
+		if (num<0)
+		{
+			//If interrupted
+			if (errno==EINTR)
+				//Check again
+				continue;
+			//Error
+			Error("-RTPReactor::Run() | epoll_wait error [errno:%d]\n",errno);
+			//Exit
+			break;
+		}
+
+		//One more wake up
+		worker->numWakeUps++;
+
+		//Sessions can't be removed while we are dispatching
+		worker->use.IncUse();
+
+		//For each event
+		for (int i=0;i<num;++i)
+		{
+			//Get fd
+			int fd = events[i].data.fd;
+
+			//If it is the wake up event
+			if (fd==worker->efd)
+			{
+				eventfd_t value;
+				//Clear it
+				eventfd_read(worker->efd,&value);
+				//Next
+				continue;
+			}
+
+			//Find session, as it could have been removed after the events were returned
+			Sockets::iterator it = worker->sockets.find(fd);
+
+			//If not found
+			if (it==worker->sockets.end())
+				//Skip
+				continue;
+
+			//Get session
+			RTPSession* session = it->second;
+
+			//Inc counter
+			worker->numEvents++;
+
+			//If got data
+			if (events[i].events & EPOLLIN)
+			{
+				//Check which socket
+				if (fd==session->simSocket)
+					//Read rtp data
+					session->ReadRTP();
+				else
+					//Read rtcp data
+					session->ReadRTCP();
+			}
+
+			//Check errors
+			if (events[i].events & (EPOLLERR | EPOLLHUP))
+			{
+				//Error
+				Log("-RTPReactor::Run() | Poll error event [fd:%d,events:%d]\n",fd,events[i].events);
+				//Stop polling it, session will be removed on End
+				epoll_ctl(worker->epfd,EPOLL_CTL_DEL,fd,NULL);
+			}
+		}
+
+		//Done
+		worker->use.DecUse();
+	}
+
+	Log("<RTPReactor::Run() | [%p]\n",worker);
+
+	//Exit
+	return 0;
+}
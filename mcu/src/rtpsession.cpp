@@ -21,6 +21,7 @@
 #include "codecs.h"
 #include "rtp.h"
 #include "rtpsession.h"
+#include "rtpreactor.h"
 #include "stunmessage.h"
 #include <libavutil/base64.h>
 #include <openssl/ossl_typ.h>
@@ -120,6 +121,10 @@ RTPSession::RTPSession(MediaFrame::Type media,Listener *listener) : dtls(*this),
 	pendingTMBBitrate = 0;
 	//Don't use PLI by default
 	usePLI = false;
+	//No rtx history until first sent packet
+	rtxs = NULL;
+	rtxSize = DefaultRTXHistorySize;
+	rtxMaxHistory = 0;
 	//Not muxing
 	muxRTCP = false;
 	//Default cname
@@ -157,6 +162,10 @@ RTPSession::RTPSession(MediaFrame::Type media,Listener *listener) : dtls(*this),
 	//No thread
 	setZeroThread(&thread);
 	running = false;
+	//Not handled by the reactor
+	reactor = false;
+	//No batches yet
+	memset(&batch,0,sizeof(batch));
 	//No stimator
 	remoteRateEstimator = NULL;
 
@@ -173,6 +182,10 @@ RTPSession::~RTPSession()
 {
 	//Reset
 	Reset();
+
+	//Free rtx history
+	if (rtxs)
+		free(rtxs);
 	
 	//Check listener
 	if (remoteRateEstimator)
@@ -268,6 +281,8 @@ void RTPSession::Reset()
 	recv.Reset();
 	sendRTX.Reset();
 	recv.Reset();
+	//Reset batch stats
+	memset(&batch,0,sizeof(batch));
 }
 
 void RTPSession::FlushRTXPackets()
@@ -277,17 +292,15 @@ void RTPSession::FlushRTXPackets()
 	
 	Debug("-FlushRTXPackets\n");
 
-	//Delete rtx packets
-	for (RTPOrderedPackets::iterator it = rtxs.begin(); it!=rtxs.end();++it)
-	{
-		//Get pacekt
-		RTPTimedPacket *pkt = it->second;
-		//Delete object
-		delete(pkt);
-	}
+	//Check we have history
+	if (!rtxs)
+		//Nothing to do
+		return;
 
-	//Clear list
-	rtxs.clear();
+	//Invalidate all packets
+	for (DWORD i=0;i<rtxSize;++i)
+		//Empty
+		rtxs[i].len = 0;
 }
 
 void RTPSession::SetSendingRTPMap(RTPMap &map)
@@ -436,6 +449,24 @@ int RTPSession::SetProperties(const Properties& properties)
 		} else if (it->first.compare("rtx.apt")==0) {
 			//Set apt
 			recvRTX.apt = atoi(it->second.c_str());
+		} else if (it->first.compare("rtx.maxHistory")==0) {
+			//Set max time in ms to keep packets for retransmission
+			rtxMaxHistory = atoi(it->second.c_str());
+		} else if (it->first.compare("rtx.maxPackets")==0) {
+			//Get requested size
+			DWORD size = atoi(it->second.c_str());
+			//Round up to power of two, so we can use seq num as index
+			rtxSize = 1;
+			while (rtxSize<size && rtxSize<0x10000)
+				rtxSize <<= 1;
+			//Lock
+			ScopedLock lock(sendMutex);
+			//If already allocated
+			if (rtxs)
+				//Free it, will be allocated with new size on next send
+				free(rtxs);
+			//No history
+			rtxs = NULL;
 		} else if (it->first.compare("urn:ietf:params:rtp-hdrext:ssrc-audio-level")==0) {
 			//Set extension
 			extMap[atoi(it->second.c_str())] = RTPPacket::HeaderExtension::SSRCAudioLevel;
@@ -910,6 +941,135 @@ int RTPSession::SendPacket(RTPPacket &packet,DWORD timestamp)
 {
 	int ret = 0;
 
+	//Check remote address and pending reports
+	if (!PrepareSending())
+		//Exit
+		return 0;
+
+	//Block
+	sendMutex.Lock();
+
+	//Serialize, store for retransmission and protect it
+	int len = PrepareRTPPacket(packet,timestamp,sendPacket);
+
+	//If got packet to send
+	if (len)
+	{
+		//Send packet
+		ret = !sendto(simSocket,sendPacket,len,0,(sockaddr *)&sendAddr,sizeof(struct sockaddr_in));
+		//Inc stats
+		send.numPackets++;
+		send.totalBytes += packet.GetMediaLength();
+	}
+
+	//Unlock
+	sendMutex.Unlock();
+
+	//Exit
+	return ret;
+}
+
+int RTPSession::SendPackets(RTPPacket* packets[],DWORD num)
+{
+	mmsghdr msgs[MaxBatchSize];
+	iovec	iovs[MaxBatchSize];
+	DWORD	media[MaxBatchSize];
+	DWORD	sent = 0;
+
+	//Check remote address and pending reports
+	if (!PrepareSending())
+		//Exit
+		return 0;
+
+	//Block
+	sendMutex.Lock();
+
+	//Process in batches
+	for (DWORD i=0;i<num;)
+	{
+		DWORD count = 0;
+
+		//Fill batch
+		while (i<num && count<MaxBatchSize)
+		{
+			//Get packet
+			RTPPacket* packet = packets[i++];
+			//Serialize, store for retransmission and protect it
+			int len = PrepareRTPPacket(*packet,packet->GetTimestamp(),sendBatch[count]);
+			//If failed
+			if (!len)
+				//Skip it
+				continue;
+			//Set buffer
+			iovs[count].iov_base = sendBatch[count];
+			iovs[count].iov_len = len;
+			//Set message
+			memset(&msgs[count],0,sizeof(mmsghdr));
+			msgs[count].msg_hdr.msg_name = &sendAddr;
+			msgs[count].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			msgs[count].msg_hdr.msg_iov = &iovs[count];
+			msgs[count].msg_hdr.msg_iovlen = 1;
+			//Store payload bytes
+			media[count] = packet->GetMediaLength();
+			//One more
+			count++;
+		}
+
+		//Check we have something
+		if (!count)
+			//Next
+			continue;
+
+		DWORD done = 0;
+
+		//Send all them, kernel may take only part of the batch
+		while (done<count)
+		{
+			//Send pending ones at once
+			int ret = sendmmsg(simSocket,msgs+done,count-done,0);
+
+			//If interrupted
+			if (ret<0 && errno==EINTR)
+				//Try again
+				continue;
+
+			//Check error
+			if (ret<=0)
+			{
+				//Error
+				Error("-RTPSession::SendPackets() | Error sending batch [num:%d,sent:%d,errno:%d]\n",count,done,errno);
+				//Drop the rest
+				break;
+			}
+
+			//Inc stats only with the ones sent
+			for (int j=0;j<ret;++j)
+				send.totalBytes += media[done+j];
+			send.numPackets += ret;
+			//Update batch stats
+			batch.sendBatches++;
+			batch.sendBatchedPackets += ret;
+			//Check max
+			if (ret>batch.maxSendBatch)
+				//Update max
+				batch.maxSendBatch = ret;
+			//Inc sent
+			done += ret;
+		}
+
+		//Inc sent
+		sent += done;
+	}
+
+	//Unlock
+	sendMutex.Unlock();
+
+	//Exit
+	return sent;
+}
+
+bool RTPSession::PrepareSending()
+{
 	//Check if we have sendinf ip address
 	if (sendAddr.sin_addr.s_addr == INADDR_ANY)
 	{
@@ -954,7 +1114,7 @@ int RTPSession::SendPacket(RTPPacket &packet,DWORD timestamp)
 			//Exit
 			Debug("-RTPSession::SendPacket() | No remote address for [%s]\n",MediaFrame::TypeToString(media));
 			//Exit
-			return 0;
+			return false;
 		}
 	}
 
@@ -963,8 +1123,19 @@ int RTPSession::SendPacket(RTPPacket &packet,DWORD timestamp)
 		//Send it
 		SendSenderReport();
 
+	//OK
+	return true;
+}
+
+int RTPSession::PrepareRTPPacket(RTPPacket &packet,DWORD timestamp,BYTE* data)
+{
 	//Modificamos las cabeceras del packete
-	rtp_hdr_t *headers = (rtp_hdr_t *)sendPacket;
+	rtp_hdr_t *headers = (rtp_hdr_t *)data;
+
+	//If it is not the default buffer
+	if (data!=sendPacket)
+		//Copy header template with sending type and extension flag
+		memcpy(data,sendPacket,sizeof(rtp_hdr_t));
 
 	//Init send packet
 	headers->version = RTP_VERSION;
@@ -994,7 +1165,7 @@ int RTPSession::SendPacket(RTPPacket &packet,DWORD timestamp)
 	if (useAbsTime)
 	{
 		//Get header
-		rtp_hdr_ext_t* ext = (rtp_hdr_ext_t*)(sendPacket + ini);
+		rtp_hdr_ext_t* ext = (rtp_hdr_ext_t*)(data + ini);
 		//Set extension header
 		headers->x = 1;
 		//Set magic cookie
@@ -1007,9 +1178,9 @@ int RTPSession::SendPacket(RTPPacket &packet,DWORD timestamp)
 		// Encoding: Timestamp is in seconds, 24 bit 6.18 fixed point, yielding 64s wraparound and 3.8us resolution (one increment for each 477 bytes going out on a 1Gbps interface).
 		DWORD abs = ((getTimeMS() << 18) / 1000) & 0x00ffffff;
 		//Set header
-		sendPacket[ini] = extMap.GetTypeForCodec(RTPPacket::HeaderExtension::AbsoluteSendTime) << 4 | 0x02;
+		data[ini] = extMap.GetTypeForCodec(RTPPacket::HeaderExtension::AbsoluteSendTime) << 4 | 0x02;
 		//Set data
-		set3(sendPacket,ini+1,abs);
+		set3(data,ini+1,abs);
 		//Increase ini
 		ini+=4;
 	}
@@ -1019,86 +1190,73 @@ int RTPSession::SendPacket(RTPPacket &packet,DWORD timestamp)
 		return Error("-RTPSession::SendPacket() | Overflow [size:%d,max:%d]\n",ini+packet.GetMediaLength(),MTU);
 
 	//Copiamos los datos
-        memcpy(sendPacket+ini,packet.GetMediaData(),packet.GetMediaLength());
+        memcpy(data+ini,packet.GetMediaData(),packet.GetMediaLength());
 
 	//Set pateckt length
 	int len = packet.GetMediaLength()+ini;
 
-	//Block
-	sendMutex.Lock();
-
 	//Add it rtx queue before encripting
 	if (useNACK)
-	{
-		//Create new pacekt
-		RTPTimedPacket *rtx = new RTPTimedPacket(media,sendPacket,len);
-		//Set cycles
-		rtx->SetSeqCycles(send.cycles);
-		//Add it to que
-		rtxs[rtx->GetExtSeqNum()] = rtx;
-	}
-
-	//No error yet, send packet
-	int err = 0;
+		//Store it
+		StoreRTXPacket(data,ini,len);
 
 	//Check if we ar encripted
 	if (encript)
 	{
 		//Check  session
-		if (sendSRTPSession)
+		if (!sendSRTPSession)
 		{
-			//Encript
-			srtp_err_status_t srtp_err_status = srtp_protect(sendSRTPSession,sendPacket,&len);
-			//Check error
-			if (srtp_err_status!=srtp_err_status_ok)
-			{
-				//Error
-				Error("-RTPSession::SendPacket() | Error protecting RTP packet [%d]\n",err);
-				//Don't send
-				err = 1;
-			}
-		} else {
 			//Log
 			Debug("-RTPSession::SendPacket() | no sendSRTPSession\n");
 			//Don't send
-			err = 1;
+			return 0;
 		}
+		//Encript
+		srtp_err_status_t srtp_err_status = srtp_protect(sendSRTPSession,data,&len);
+		//Check error
+		if (srtp_err_status!=srtp_err_status_ok)
+			//Error
+			return Error("-RTPSession::SendPacket() | Error protecting RTP packet [%d]\n",srtp_err_status);
 	}
 
-	//If got packet to send
-	if (len && !err)
-	{
-		//Send packet
-		ret = !sendto(simSocket,sendPacket,len,0,(sockaddr *)&sendAddr,sizeof(struct sockaddr_in));
-		//Inc stats
-		send.numPackets++;
-		send.totalBytes += packet.GetMediaLength();
-	}
+	//Protected length
+	return len;
+}
 
-	//Get time for packets to discard, always have at least 200ms, max 500ms
-	QWORD until = getTime()/1000 - (200+fmin(rtt*2,300));
-	//Delete old packets
-	RTPOrderedPackets::iterator it = rtxs.begin();
-	//Until the end
-	while(it!=rtxs.end())
+void RTPSession::StoreRTXPacket(BYTE* data,DWORD headerLen,DWORD len)
+{
+	//If not allocated yet
+	if (!rtxs)
 	{
-		//Get pacekt
-		RTPTimedPacket *pkt = it->second;
-		//Check time
-		if (pkt->GetTime()>until)
-			//Keep the rest
-			break;
-		//DElete from queue and move next
-		rtxs.erase(it++);
-		//Delete object
-		delete(pkt);
+		//Allocate the whole history at once
+		rtxs = (RTXPacket*)malloc32(rtxSize*sizeof(RTXPacket));
+		//Check
+		if (!rtxs)
+		{
+			//Error
+			Error("-RTPSession::StoreRTXPacket() | could not allocate rtx history [size:%d]\n",rtxSize);
+			//Exit
+			return;
+		}
+		//Empty all
+		for (DWORD i=0;i<rtxSize;++i)
+			//Empty
+			rtxs[i].len = 0;
 	}
 
-	//Unlock
-	sendMutex.Unlock();
+	//Get seq num counter of the packet, it has been already incremented
+	DWORD extSeq = send.extSeq-1;
 
-	//Exit
-	return ret;
+	//Get slot from the lower bits of the seq num, it will overwrite the older packet with same index
+	RTXPacket* rtx = &rtxs[extSeq & (rtxSize-1)];
+
+	//Store it
+	rtx->extSeq = extSeq;
+	rtx->time = getTime()/1000;
+	rtx->headerLen = headerLen;
+	rtx->len = len;
+	//Copy data
+	memcpy(rtx->data,data,len);
 }
 
 int RTPSession::ReadRTCP()
@@ -1219,27 +1377,65 @@ int RTPSession::ReadRTCP()
 }
 
 /*********************************
-* GetTextPacket
-*	Lee el siguiente paquete de video
+* ReadRTP
+*	Drain up to MaxBatchSize datagrams from the rtp socket
 *********************************/
 int RTPSession::ReadRTP()
 {
-	BYTE data[MTU+SRTP_MAX_TRAILER_LEN] ZEROALIGNEDTO32;
-	BYTE *buffer = data;
-	sockaddr_in from_addr;
-	bool isRTX = false;
-	DWORD from_len = sizeof(from_addr);
+	mmsghdr		msgs[MaxBatchSize];
+	iovec		iovs[MaxBatchSize];
+	sockaddr_in	from[MaxBatchSize];
 
-	//Receive from everywhere
-	memset(&from_addr, 0, from_len);
+	//Prepare batch
+	for (DWORD i=0;i<MaxBatchSize;++i)
+	{
+		//Receive from everywhere
+		memset(&from[i],0,sizeof(sockaddr_in));
+		//Set buffer
+		iovs[i].iov_base = recvBatch[i];
+		iovs[i].iov_len = MTU;
+		//Set message
+		memset(&msgs[i],0,sizeof(mmsghdr));
+		msgs[i].msg_hdr.msg_name = &from[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
 
-	//Leemos del socket
-	int size = recvfrom(simSocket,buffer,MTU,MSG_DONTWAIT,(sockaddr*)&from_addr, &from_len);
+	//Leemos del socket todo lo que haya
+	int num = recvmmsg(simSocket,msgs,MaxBatchSize,MSG_DONTWAIT,NULL);
 
-	// Ignore empty datagrams and errors
-	if (size <= 0)
+	// Ignore errors
+	if (num <= 0)
 		return 0;
 
+	//Update batch stats
+	batch.recvBatches++;
+	batch.recvBatchedPackets += num;
+	//Check max
+	if (num>batch.maxRecvBatch)
+		//Update max
+		batch.maxRecvBatch = num;
+
+	//Process each one
+	for (int i=0;i<num;++i)
+		//Ignore empty datagrams
+		if (msgs[i].msg_len>0)
+			//Process it
+			ProcessRTP(recvBatch[i],msgs[i].msg_len,from[i]);
+
+	//Return number of datagrams read
+	return num;
+}
+
+/*********************************
+* ProcessRTP
+*	Procesa un datagrama recibido en el socket rtp
+*********************************/
+int RTPSession::ProcessRTP(BYTE* buffer,int size,sockaddr_in& from_addr)
+{
+	bool isRTX = false;
+
 	//Check if it looks like a STUN message
 	if (STUNMessage::IsSTUN(buffer,size))
 	{
@@ -1582,7 +1778,7 @@ int RTPSession::ReadRTP()
 	if (codec==TextCodec::T140RED || codec==VideoCodec::RED)
 	{
 		//Create redundant type
-		RTPRedundantPacket *red = new RTPRedundantPacket(media,buffer,size);
+		RTPRedundantPacket *red = new(media) RTPRedundantPacket(media,buffer,size);
 		//Get primary type
 		BYTE t = red->GetPrimaryType();
 		//Map primary data codec
@@ -1622,7 +1818,7 @@ int RTPSession::ReadRTP()
 		packet = red;
 	} else {
 		//Create normal packet
-		packet = new RTPTimedPacket(media,buffer,size);
+		packet = new(media) RTPTimedPacket(media,buffer,size);
 		if (media==MediaFrame::Video && !isRTX) UltraDebug("RTX: Got  %d:%s packet #%d ts:%u\n",type,VideoCodec::GetNameFor((VideoCodec::Type)codec),packet->GetSeqNum(),packet->GetTimestamp());
 	}
 
@@ -1793,15 +1989,44 @@ int RTPSession::ReadRTP()
 
 void RTPSession::Start()
 {
+	//Set non blocking so we can get an error when we are closed by end
+	int fsflags = fcntl(simSocket,F_GETFL,0);
+	fsflags |= O_NONBLOCK;
+	fcntl(simSocket,F_SETFL,fsflags);
+
+	fsflags = fcntl(simRtcpSocket,F_GETFL,0);
+	fsflags |= O_NONBLOCK;
+	fcntl(simRtcpSocket,F_SETFL,fsflags);
+
 	//We are running
 	running = true;
 
+	//If the shared reactor is enabled, let it poll our sockets
+	if (RTPReactor::getInstance().IsRunning() && RTPReactor::getInstance().AddSession(this,simSocket,simRtcpSocket))
+	{
+		//Handled by reactor
+		reactor = true;
+		//Done
+		return;
+	}
+
 	//Create thread
 	createPriorityThread(&thread,run,this,0);
 }
 
 void RTPSession::Stop()
 {
+	//If we are handled by the reactor
+	if (reactor)
+	{
+		//Not running
+		running = false;
+		//Remove from reactor, after this no more reads will be dispatched
+		RTPReactor::getInstance().RemoveSession(this);
+		//Not in reactor anymore
+		reactor = false;
+	}
+
 	//Check thred
 	if (!isZeroThread(thread))
 	{
@@ -1851,15 +2076,6 @@ int RTPSession::Run()
 	ufds[1].fd = simRtcpSocket;
 	ufds[1].events = POLLIN | POLLERR | POLLHUP;
 
-	//Set non blocking so we can get an error when we are closed by end
-	int fsflags = fcntl(simSocket,F_GETFL,0);
-	fsflags |= O_NONBLOCK;
-	fcntl(simSocket,F_SETFL,fsflags);
-
-	fsflags = fcntl(simRtcpSocket,F_GETFL,0);
-	fsflags |= O_NONBLOCK;
-	fcntl(simRtcpSocket,F_SETFL,fsflags);
-
 	//Catch all IO errors
 	signal(SIGIO,EmptyCatch);
 
@@ -2348,22 +2564,23 @@ int RTPSession::ReSendPacket(int seq)
 	//Lock send lock inside the method
 	ScopedLock method(sendMutex);
 
-	//Calculate ext seq number
-	DWORD ext = ((DWORD)send.cycles)<<16 | seq;
-
-	//Find packet to retransmit
-	RTPOrderedPackets::iterator it = rtxs.find(ext);
+	//Get packet slot for seq num
+	RTXPacket* rtx = rtxs ? &rtxs[seq & (rtxSize-1)] : NULL;
 
-	//If we still have it
-	if (it!=rtxs.end())
+	//Get time for packets to discard, always have at least 200ms, max 500ms
+	DWORD history = 200+fmin(rtt*2,300);
+	//If capped
+	if (rtxMaxHistory && rtxMaxHistory<history)
+		//Use it
+		history = rtxMaxHistory;
+
+	//If we still have it and it is not too old
+	if (rtx && rtx->len && (WORD)rtx->extSeq==(WORD)seq && rtx->time+history>=getTime()/1000)
 	{
-		//Get packet
-		RTPTimedPacket* packet = it->second;
-
 		//Data
 		BYTE data[MTU+SRTP_MAX_TRAILER_LEN] ZEROALIGNEDTO32;
 		DWORD size = MTU;
-		int len = packet->GetSize();
+		int len = rtx->len;
 		
 		//Check size + osn in case of RTX
 		if (len+2>size)
@@ -2371,10 +2588,10 @@ int RTPSession::ReSendPacket(int seq)
 			return Error("-RTPSession::ReSendPacket() | not enougth size for copying packet [len:%d]\n",len);
 		
 		//Copy RTP headers
-		memcpy(data,packet->GetData(),packet->GetRTPHeaderLen());
+		memcpy(data,rtx->data,rtx->headerLen);
 		
 		//Get payload ini
-		BYTE *payload = data+packet->GetRTPHeaderLen();
+		BYTE *payload = data+rtx->headerLen;
 		
 		//If using abs-time
 		if (useAbsTime)
@@ -2408,11 +2625,11 @@ int RTPSession::ReSendPacket(int seq)
 			len += 2;
 			//Increase counters
 			sendRTX.numPackets++;
-			sendRTX.totalBytes += packet->GetMediaLength()+2;
+			sendRTX.totalBytes += rtx->len-rtx->headerLen+2;
 		}
 		
 		//Copy payload
-		memcpy(payload,packet->GetMediaData(),packet->GetMediaLength());
+		memcpy(payload,rtx->data+rtx->headerLen,rtx->len-rtx->headerLen);
 		
 		//Check if we ar encripted
 		if (encript)
@@ -2438,12 +2655,12 @@ int RTPSession::ReSendPacket(int seq)
 		//Check len
 		if (len)
 		{
-			Debug("-RTPSession::ReSendPacket() | %d %d\n",seq,ext);
+			Debug("-RTPSession::ReSendPacket() | %d %u\n",seq,rtx->extSeq);
 			//Send packet
 			sendto(simSocket,data,len,0,(sockaddr *)&sendAddr,sizeof(struct sockaddr_in));
 		}
 	} else {
-		Debug("-RTPSession::ReSendPacket() | %d:%d %d not found first %d sending intra instead\n",send.cycles,seq,ext,rtxs.size() ?  rtxs.begin()->first : 0);
+		Debug("-RTPSession::ReSendPacket() | %d not found [slot:%u,history:%dms] sending intra instead\n",seq,rtx ? rtx->extSeq : 0,history);
 		//Check if got listener
 		if (listener)
 			//Request a I frame
@@ -0,0 +1,138 @@
+/*
+ * File:   screencontent.cpp
+ * Author: Sergio
+ *
+ * Created on 18 de octubre de 2026, 10:15
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "log.h"
+#include "screencontent.h"
+
+ScreenContent::ScreenContent()
+{
+	//Nothing yet
+	prev = NULL;
+	map = NULL;
+	width = 0;
+	height = 0;
+	cols = 0;
+	rows = 0;
+	changed = 0;
+	bursting = 0;
+	valid = false;
+}
+
+ScreenContent::~ScreenContent()
+{
+	//Free memory
+	if (prev)
+		free(prev);
+	if (map)
+		free(map);
+}
+
+void ScreenContent::Reset()
+{
+	//Previous picture is not usable anymore
+	valid = false;
+	bursting = 0;
+}
+
+bool ScreenContent::HasChanged(const BYTE* a,const BYTE* b,DWORD stride,DWORD width,DWORD height)
+{
+	//Compare each line of the block
+	for (DWORD j=0;j<height;++j)
+		if (memcmp(a+j*stride,b+j*stride,width))
+			//Changed
+			return true;
+	//Same
+	return false;
+}
+
+DWORD ScreenContent::Update(const BYTE* pic,DWORD width,DWORD height)
+{
+	//Get picture size
+	DWORD numPixels = width*height;
+	DWORD size = numPixels*3/2;
+
+	//If size has changed
+	if (width!=this->width || height!=this->height)
+	{
+		//Free previous
+		if (prev)
+			free(prev);
+		if (map)
+			free(map);
+		//Store new size
+		this->width = width;
+		this->height = height;
+		//Get number of macroblocks
+		cols = (width+15)/16;
+		rows = (height+15)/16;
+		//Allocate
+		prev = (BYTE*)malloc32(size);
+		map = (BYTE*)malloc32(cols*rows);
+		//Nothing to compare with
+		valid = false;
+	}
+
+	//If we can't compare
+	if (!valid)
+	{
+		//All changed
+		memset(map,1,cols*rows);
+		changed = cols*rows;
+	} else {
+		//Get planes
+		const BYTE* y = pic;
+		const BYTE* u = pic+numPixels;
+		const BYTE* v = pic+numPixels*5/4;
+		const BYTE* py = prev;
+		const BYTE* pu = prev+numPixels;
+		const BYTE* pv = prev+numPixels*5/4;
+		//None yet
+		changed = 0;
+		//For each macroblock row
+		for (DWORD j=0;j<rows;++j)
+		{
+			//Get block height, last one may be smaller
+			DWORD h = j*16+16<=height ? 16 : height-j*16;
+			//For each macroblock
+			for (DWORD i=0;i<cols;++i)
+			{
+				//Get block width
+				DWORD w = i*16+16<=width ? 16 : width-i*16;
+				//Get luma and chroma offsets
+				DWORD lo = j*16*width+i*16;
+				DWORD co = j*8*width/2+i*8;
+				//Check luma first as it is the most likely to change
+				bool diff = HasChanged(y+lo,py+lo,width,w,h)
+					|| HasChanged(u+co,pu+co,width/2,w/2,h/2)
+					|| HasChanged(v+co,pv+co,width/2,w/2,h/2);
+				//Set it
+				map[j*cols+i] = diff;
+				//Count
+				if (diff)
+					changed++;
+			}
+		}
+	}
+
+	//If more than half the picture has changed
+	if (valid && changed*2>cols*rows)
+		//Scrolling or window moving
+		bursting++;
+	else
+		//Not anymore
+		bursting = 0;
+
+	//Keep it for next one
+	memcpy(prev,pic,size);
+	//Can compare now
+	valid = true;
+
+	//Return number of changed
+	return changed;
+}
@@ -12,11 +12,15 @@ Sidebar::Sidebar()
 {
 	//Alloc alligned
 	mixer_buffer = (SWORD*) malloc32(MIXER_BUFFER_SIZE*sizeof(SWORD));
+	mixer_acu = (int*) malloc32(MIXER_BUFFER_SIZE*sizeof(int));
+	//Empty
+	Reset();
 }
 
 Sidebar::~Sidebar()
 {
 	free(mixer_buffer);
+	free(mixer_acu);
 }
 
 int Sidebar::Update(int id,SWORD *samples,DWORD len)
@@ -27,26 +31,61 @@ int Sidebar::Update(int id,SWORD *samples,DWORD len)
 		return Error("-Sidebar error updating particionat, len bigger than mixer max buffer size [len:%d,size:%d]\n",len,MIXER_BUFFER_SIZE);
 
 	//Get pointers to buffer
-	__m128i* d = (__m128i*) mixer_buffer;
+	__m128i* d = (__m128i*) mixer_acu;
 	__m128i* s = (__m128i*) samples;
 
 	//Sum 8 ech time
-	for(DWORD n = (len + 7) >> 3; n != 0; --n,++d,++s)
+	for(DWORD n = (len + 7) >> 3; n != 0; --n,d+=2,++s)
 	{
 		//Load data in SSE registers
-		__m128i xmm1 = _mm_load_si128(d);
-		__m128i xmm2 = _mm_load_si128(s);
+		__m128i xmm = _mm_load_si128(s);
+		//Sign extend to 32 bits
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(xmm,xmm),16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(xmm,xmm),16);
 		//SSE2 sum
-		_mm_store_si128(d, _mm_add_epi16(xmm1,xmm2));
+		_mm_store_si128(d,   _mm_add_epi32(_mm_load_si128(d),lo));
+		_mm_store_si128(d+1, _mm_add_epi32(_mm_load_si128(d+1),hi));
 	}
 
 	//OK
 	return len;
 }
 
+void Sidebar::Mix(DWORD len)
+{
+	//Get pointers to buffer
+	__m128i* d = (__m128i*) mixer_buffer;
+	__m128i* s = (__m128i*) mixer_acu;
+
+	//Pack 8 each time, saturating to 16 bits
+	for(DWORD n = (len + 7) >> 3; n != 0; --n,++d,s+=2)
+		_mm_store_si128(d, _mm_packs_epi32(_mm_load_si128(s),_mm_load_si128(s+1)));
+}
+
+void Sidebar::MixMinus(SWORD *samples,SWORD *out,DWORD len)
+{
+	//Get pointers to buffer
+	__m128i* a = (__m128i*) mixer_acu;
+	__m128i* s = (__m128i*) samples;
+	__m128i* d = (__m128i*) out;
+
+	//Substract 8 each time
+	for(DWORD n = (len + 7) >> 3; n != 0; --n,a+=2,++s,++d)
+	{
+		//Load data in SSE registers
+		__m128i xmm = _mm_load_si128(s);
+		//Sign extend to 32 bits
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(xmm,xmm),16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(xmm,xmm),16);
+		//Remove own samples from sum and saturate
+		_mm_store_si128(d, _mm_packs_epi32(_mm_sub_epi32(_mm_load_si128(a),lo),_mm_sub_epi32(_mm_load_si128(a+1),hi)));
+	}
+}
+
 void Sidebar::Reset()
 {
-	//zero the mixer buffer
+	//zero the mixer buffers
+	memset((BYTE*)mixer_acu, 0, MIXER_BUFFER_SIZE*sizeof(int));
 	memset((BYTE*)mixer_buffer, 0, MIXER_BUFFER_SIZE*sizeof(SWORD));
 }
 
@@ -70,6 +70,16 @@ DWORD SpeexEncoder::GetRate()
 	return rate;
 }
 
+bool SpeexEncoder::Reset()
+{
+	//Drop prediction state but keep settings
+	speex_encoder_ctl(encoder, SPEEX_RESET_STATE, NULL);
+	//Drop pending bits
+	speex_bits_reset(&encbits);
+	//Done
+	return true;
+}
+
 int SpeexEncoder::Encode (SWORD *in,int inLen,BYTE* out,int outLen)
 {
 	if (!inLen)
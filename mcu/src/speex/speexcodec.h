@@ -13,6 +13,7 @@ public:
 	virtual DWORD TrySetRate(DWORD rate);
 	virtual DWORD GetRate();
 	virtual DWORD GetClockRate()	{ return 16000;}
+	virtual bool  Reset();
 private:
 	void *encoder;
 	SpeexBits encbits;
@@ -0,0 +1,510 @@
+/*
+ * File:   tcpreactor.cpp
+ * Author: Sergio
+ *
+ * Created on 17 de octubre de 2026, 11:40
+ */
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include "log.h"
+#include "tools.h"
+#include "tcpreactor.h"
+
+TCPReactor::TCPReactor()
+{
+	//Not running
+	__atomic_store_n(&running,false,__ATOMIC_RELEASE);
+	//No signals yet
+	numSignals = 0;
+}
+
+TCPReactor::~TCPReactor()
+{
+	//Stop just in case
+	Stop();
+}
+
+bool TCPReactor::Start(int numWorkers)
+{
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Check if already running
+	if (__atomic_load_n(&running,__ATOMIC_ACQUIRE))
+		//Error
+		return Error("-TCPReactor::Start() | already running\n");
+
+	//If not set
+	if (numWorkers<=0)
+		//One per core
+		numWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+
+	//Check
+	if (numWorkers<=0)
+		//At least one
+		numWorkers = 1;
+
+	Log(">TCPReactor::Start() | [workers:%d]\n",numWorkers);
+
+	//We are running
+	__atomic_store_n(&running,true,__ATOMIC_RELEASE);
+
+	//Create workers
+	for (int i=0;i<numWorkers;++i)
+	{
+		//Create new worker
+		Worker* worker = new Worker();
+		//Init it
+		worker->reactor = this;
+		worker->numConnections = 0;
+		worker->numWakeUps = 0;
+		worker->numEvents = 0;
+		//Create epoll set
+		worker->epfd = epoll_create1(EPOLL_CLOEXEC);
+		//Create event fd for waking up the worker on stop
+		worker->efd = eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+		//Check
+		if (worker->epfd==FD_INVALID || worker->efd==FD_INVALID)
+		{
+			//Error
+			Error("-TCPReactor::Start() | could not create epoll set [errno:%d]\n",errno);
+			//Close
+			if (worker->epfd!=FD_INVALID) close(worker->epfd);
+			if (worker->efd!=FD_INVALID) close(worker->efd);
+			//Delete it
+			delete(worker);
+			//Skip
+			continue;
+		}
+		//Add the event fd to the set
+		epoll_event ev = {0};
+		ev.events = EPOLLIN;
+		ev.data.fd = worker->efd;
+		epoll_ctl(worker->epfd,EPOLL_CTL_ADD,worker->efd,&ev);
+		//Start thread
+		createPriorityThread(&worker->thread,run,worker,0);
+		//Add to workers
+		workers.push_back(worker);
+	}
+
+	//Check we have at least one
+	if (workers.empty())
+	{
+		//Not running
+		__atomic_store_n(&running,false,__ATOMIC_RELEASE);
+		//Error
+		return Error("<TCPReactor::Start() | no workers could be started\n");
+	}
+
+	Log("<TCPReactor::Start()\n");
+
+	//OK
+	return true;
+}
+
+bool TCPReactor::Stop()
+{
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Check if running
+	if (!__atomic_load_n(&running,__ATOMIC_ACQUIRE))
+		//Nothing to do
+		return false;
+
+	Log(">TCPReactor::Stop()\n");
+
+	//Not running anymore, workers check it when woken up
+	__atomic_store_n(&running,false,__ATOMIC_RELEASE);
+
+	//For each worker
+	for (Workers::iterator it=workers.begin();it!=workers.end();++it)
+	{
+		//Get worker
+		Worker* worker = *it;
+		//Wake it up
+		eventfd_write(worker->efd,1);
+		//Wait for thread to finish
+		pthread_join(worker->thread,NULL);
+		//Close fds, connection sockets are owned by the connections
+		close(worker->epfd);
+		close(worker->efd);
+		//Delete it
+		delete(worker);
+	}
+
+	//Clear all
+	workers.clear();
+	connections.clear();
+
+	Log("<TCPReactor::Stop()\n");
+
+	//OK
+	return true;
+}
+
+bool TCPReactor::AddConnection(Connection* connection,int fd)
+{
+	Worker* worker = NULL;
+
+	//Lock
+	mutex.Lock();
+
+	//Check if running and not already registered
+	if (__atomic_load_n(&running,__ATOMIC_ACQUIRE) && connections.find(connection)==connections.end())
+	{
+		//Find the least loaded worker
+		worker = workers.front();
+		//For the rest
+		for (Workers::iterator it=workers.begin();it!=workers.end();++it)
+			//If it has less connections
+			if ((*it)->numConnections<worker->numConnections)
+				//Use it
+				worker = *it;
+		//Store registration
+		connections[connection] = worker;
+	}
+
+	//Unlock, workers may call us while dispatching
+	mutex.Unlock();
+
+	//Check
+	if (!worker)
+		//Error
+		return Error("-TCPReactor::AddConnection() | not running or already registered [%p]\n",connection);
+
+	//Lock worker, this waits until no dispatch is in progress
+	ScopedUseLock lock(worker->use);
+
+	//Set connection data before it can be signaled
+	connection->epfd = worker->epfd;
+	connection->fd = fd;
+
+	//Add socket to the worker set
+	worker->sockets[fd] = connection;
+
+	//Edge triggered, so handlers must read and write until they would block
+	epoll_event ev = {0};
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLERR | EPOLLHUP | EPOLLET;
+	ev.data.fd = fd;
+	//Add it
+	if (epoll_ctl(worker->epfd,EPOLL_CTL_ADD,fd,&ev)<0)
+	{
+		//Error
+		Error("-TCPReactor::AddConnection() | could not add socket [errno:%d]\n",errno);
+		//Remove it
+		worker->sockets.erase(fd);
+		//Reset connection data
+		connection->epfd = FD_INVALID;
+		connection->fd = FD_INVALID;
+		//Lock
+		ScopedLock scope(mutex);
+		//Remove registration
+		connections.erase(connection);
+		//Error
+		return false;
+	}
+
+	//One more
+	__sync_add_and_fetch(&worker->numConnections,1);
+
+	//OK
+	return true;
+}
+
+bool TCPReactor::RemoveConnection(Connection* connection)
+{
+	Worker* worker = NULL;
+
+	//Lock
+	mutex.Lock();
+	//Find it
+	Connections::iterator it = connections.find(connection);
+	//If found
+	if (it!=connections.end())
+		//Get worker
+		worker = it->second;
+	//Unlock, we must not wait for the worker with it held
+	mutex.Unlock();
+
+	//If not found
+	if (!worker)
+		//Nothing to do
+		return false;
+
+	//If we are called from a handler of the worker itself
+	if (pthread_equal(pthread_self(),worker->thread))
+		//Already in use by us, remove it
+		return Remove(worker,connection);
+
+	//Lock worker, after this no event for the connection will be dispatched
+	ScopedUseLock lock(worker->use);
+
+	//Remove it
+	return Remove(worker,connection);
+}
+
+void TCPReactor::ReleaseConnection(Connection* connection)
+{
+	Worker* worker = NULL;
+
+	//Lock
+	mutex.Lock();
+	//Find it
+	Connections::iterator it = connections.find(connection);
+	//If found
+	if (it!=connections.end())
+	{
+		//Get worker
+		worker = it->second;
+		//Forget it
+		connections.erase(it);
+	}
+	//Unlock, we must not wait for the worker with it held
+	mutex.Unlock();
+
+	//If not found
+	if (!worker)
+		//Nothing to do
+		return;
+
+	//If we are called from a handler of the worker itself
+	if (pthread_equal(pthread_self(),worker->thread))
+	{
+		//Remove it if it was still registered
+		Remove(worker,connection);
+		//Done
+		return;
+	}
+
+	//Wait until the worker is not dispatching, it may be inside a handler of the connection
+	ScopedUseLock lock(worker->use);
+
+	//Remove it if it was still registered
+	Remove(worker,connection);
+}
+
+bool TCPReactor::Remove(Worker* worker,Connection* connection)
+{
+	//Get socket
+	int fd = connection->fd;
+
+	//Check it is still registered for it
+	Sockets::iterator it = worker->sockets.find(fd);
+
+	//If not found or reused by other connection
+	if (fd==FD_INVALID || it==worker->sockets.end() || it->second!=connection)
+		//Already removed
+		return false;
+
+	//Remove from epoll set
+	epoll_ctl(worker->epfd,EPOLL_CTL_DEL,fd,NULL);
+
+	//Remove socket
+	worker->sockets.erase(it);
+
+	//Reset connection data, so no more signals are sent
+	connection->epfd = FD_INVALID;
+	connection->fd = FD_INVALID;
+
+	//One less
+	__sync_sub_and_fetch(&worker->numConnections,1);
+
+	//Removed
+	return true;
+}
+
+bool TCPReactor::SignalWrite(Connection* connection)
+{
+	//Get data
+	int epfd = connection->epfd;
+	int fd = connection->fd;
+
+	//Check it is registered
+	if (epfd==FD_INVALID || fd==FD_INVALID)
+		//Nothing to do
+		return false;
+
+	//Re arm it, so if it is writable a new edge is triggered
+	epoll_event ev = {0};
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLERR | EPOLLHUP | EPOLLET;
+	ev.data.fd = fd;
+
+	//Modify it, it is fine to fail if it has just been removed
+	if (epoll_ctl(epfd,EPOLL_CTL_MOD,fd,&ev)<0)
+		//Not signaled
+		return false;
+
+	//One more
+	__sync_add_and_fetch(&numSignals,1);
+
+	//Signaled
+	return true;
+}
+
+TCPReactor::Stats TCPReactor::GetStats()
+{
+	Stats stats = {0};
+
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Set values
+	stats.numWorkers = workers.size();
+	stats.numSignals = numSignals;
+
+	//For each worker
+	for (Workers::iterator it=workers.begin();it!=workers.end();++it)
+	{
+		//Sum counters
+		stats.numConnections += (*it)->numConnections;
+		stats.numWakeUps += (*it)->numWakeUps;
+		stats.numEvents += (*it)->numEvents;
+	}
+
+	//Return them
+	return stats;
+}
+
+void* TCPReactor::run(void *par)
+{
+	//Get worker
+	Worker* worker = (Worker*)par;
+
+	Log("-TCPReactor::run() | worker thread [%d,0x%x]\n",getpid(),par);
+
+	//Block signals to avoid exiting on SIGUSR1
+	blocksignals();
+
+	//Run
+	worker->reactor->Run(worker);
+
+	//Exit
+	return NULL;
+}
+
+int TCPReactor::Run(Worker* worker)
+{
+	epoll_event events[MaxEvents];
+	std::vector<Connection*> ticked;
+
+	Log(">TCPReactor::Run() | [%p]\n",worker);
+
+	//Get last tick time
+	QWORD last = getTime();
+
+	//Run until ended
+	while(__atomic_load_n(&running,__ATOMIC_ACQUIRE))
+	{
+		//Wait for events, timeout so connections get their tick
+		int num = epoll_wait(worker->epfd,events,MaxEvents,1000);
+
+		//Check error
+		if (num<0)
+		{
+			//If interrupted
+			if (errno==EINTR)
+				//Check again
+				continue;
+			//Error
+			Error("-TCPReactor::Run() | epoll_wait error [errno:%d]\n",errno);
+			//Exit
+			break;
+		}
+
+		//One more wake up
+		worker->numWakeUps++;
+
+		//Connections can't be removed or deleted while we are dispatching
+		worker->use.IncUse();
+
+		//For each event
+		for (int i=0;i<num;++i)
+		{
+			//Get fd
+			int fd = events[i].data.fd;
+
+			//If it is the wake up event
+			if (fd==worker->efd)
+			{
+				eventfd_t value;
+				//Clear it
+				eventfd_read(worker->efd,&value);
+				//Next
+				continue;
+			}
+
+			//Find connection, as it could have been removed after the events were returned
+			Sockets::iterator it = worker->sockets.find(fd);
+
+			//If not found
+			if (it==worker->sockets.end())
+				//Skip
+				continue;
+
+			//Get connection
+			Connection* connection = it->second;
+
+			//Inc counter
+			worker->numEvents++;
+
+			//Keep on while ok
+			bool ok = true;
+
+			//If got data or the peer has closed its side, read until end
+			if (events[i].events & (EPOLLIN | EPOLLRDHUP))
+				//Read
+				ok = connection->onReadable();
+
+			//If we can write and it has not been removed by the read handler
+			if (ok && (events[i].events & EPOLLOUT) && connection->fd==fd)
+				//Write pending data
+				ok = connection->onWritable();
+
+			//Check errors
+			if (events[i].events & (EPOLLERR | EPOLLHUP))
+			{
+				//Error
+				Log("-TCPReactor::Run() | Poll error event [fd:%d,events:%d]\n",fd,events[i].events);
+				//Close it
+				ok = false;
+			}
+
+			//If it has to be closed and it is still ours
+			if (!ok && Remove(worker,connection))
+				//Closed, it may be deleted by its owner from now on
+				connection->onClosed();
+		}
+
+		//Get now
+		QWORD now = getTime();
+
+		//Each second
+		if (now-last>=1000000)
+		{
+			//Copy them, as connections can be removed on tick
+			ticked.clear();
+			for (Sockets::iterator it=worker->sockets.begin();it!=worker->sockets.end();++it)
+				ticked.push_back(it->second);
+			//For each one
+			for (std::vector<Connection*>::iterator it=ticked.begin();it!=ticked.end();++it)
+				//If still registered
+				if ((*it)->fd!=FD_INVALID)
+					//Tick it
+					(*it)->onTick();
+			//Update tick time
+			last = now;
+		}
+
+		//Done
+		worker->use.DecUse();
+	}
+
+	Log("<TCPReactor::Run() | [%p]\n",worker);
+
+	//Exit
+	return 0;
+}
@@ -647,6 +647,18 @@ MediaStatistics TextStream::GetStatistics()
 	stats.numSendPackets	= rtp.GetNumSendPackets();
 	stats.totalRecvBytes	= rtp.GetTotalRecvBytes();
 	stats.totalSendBytes	= rtp.GetTotalSendBytes();
+	//Fill batching stats
+	const RTPSession::BatchStats& batch = rtp.GetBatchStats();
+	stats.recvBatches	= batch.recvBatches;
+	stats.recvBatchedPackets= batch.recvBatchedPackets;
+	stats.maxRecvBatch	= batch.maxRecvBatch;
+	stats.sendBatches	= batch.sendBatches;
+	stats.sendBatchedPackets= batch.sendBatchedPackets;
+	stats.maxSendBatch	= batch.maxSendBatch;
+	//Fill packet pool stats
+	RTPPacketPool::Stats pool = RTPPacketPool::GetStats(MediaFrame::Text);
+	stats.poolHitRate	= pool.allocs ? pool.hits*100/pool.allocs : 0;
+	stats.poolResidentBytes	= pool.resident*pool.blockSize;
 
 	//Return it
 	return stats;
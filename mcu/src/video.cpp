@@ -1,3 +1,4 @@
+#include <string.h>
 #include "log.h"
 #include "video.h"
 #include "flv1/flv1codec.h"
@@ -69,4 +70,43 @@ VideoEncoder* VideoCodecFactory::CreateEncoder(VideoCodec::Type codec,const Prop
 			Error("Video Encoder not found\n");
 	}
 	return NULL;
-}
\ No newline at end of file
+}
+
+int VideoOutput::NextFrame(VideoBuffer* frame)
+{
+	//If it is already packed
+	if (frame->IsPacked())
+		//Send it directly
+		return NextFrame(frame->GetData(),frame->GetTime());
+
+	//Get a packed one from the pool
+	VideoBuffer* packed = VideoBuffer::Create(frame->GetWidth(),frame->GetHeight());
+	//Copy picture
+	frame->CopyTo(packed->GetData());
+	//Send it
+	int ret = NextFrame(packed->GetData(),frame->GetTime());
+	//Give it back
+	packed->Release();
+
+	return ret;
+}
+
+VideoBuffer* VideoDecoder::GetBuffer()
+{
+	//Get packed picture
+	BYTE* frame = GetFrame();
+	DWORD width = GetWidth();
+	DWORD height = GetHeight();
+
+	//Check
+	if (!frame || !width || !height)
+		//Nothing
+		return NULL;
+
+	//Get a buffer from the pool
+	VideoBuffer* buffer = VideoBuffer::Create(width,height);
+	//Copy it
+	memcpy(buffer->GetData(),frame,buffer->GetSize());
+
+	return buffer;
+}
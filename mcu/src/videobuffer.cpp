@@ -0,0 +1,245 @@
+/*
+ * File:   videobuffer.cpp
+ * Author: Sergio
+ *
+ * Created on 17 de octubre de 2026, 12:05
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <map>
+#include <new>
+#include "log.h"
+#include "videobuffer.h"
+
+//Free lists by buffer size
+typedef std::map<DWORD,VideoBuffer*> FreeBuffers;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static FreeBuffers buffers;
+static VideoBuffer::Stats stats = {0};
+//Max bytes kept on the free lists
+static DWORD maxCached = 32*1024*1024;
+//Extra bytes after the picture, so decoders and simd code can read past the last line
+static const DWORD Padding = 64;
+
+VideoBuffer::VideoBuffer(DWORD size)
+{
+	//Store size
+	this->size = size;
+	//Not referenced
+	refs = 0;
+	next = NULL;
+	//Allocate aligned memory
+	data = (BYTE*)malloc32(size+Padding);
+}
+
+VideoBuffer::~VideoBuffer()
+{
+	//Free memory
+	if (data)
+		free(data);
+}
+
+VideoBuffer* VideoBuffer::Create(DWORD width,DWORD height)
+{
+	//Packed
+	return Create(width,height,width,height);
+}
+
+VideoBuffer* VideoBuffer::Create(DWORD width,DWORD height,DWORD stride,DWORD lines)
+{
+	VideoBuffer* buffer = NULL;
+
+	//Get size
+	DWORD size = (stride*lines*3)/2;
+
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//One more
+	stats.allocs++;
+
+	//Find free buffers of the same size
+	FreeBuffers::iterator it = buffers.find(size);
+
+	//If found
+	if (it!=buffers.end())
+	{
+		//Get first one
+		buffer = it->second;
+		//Remove it from the list
+		if (buffer->next)
+			it->second = buffer->next;
+		else
+			buffers.erase(it);
+		//Not cached anymore
+		stats.cached -= size;
+		//Hit
+		stats.hits++;
+	} else {
+		//It will be allocated
+		stats.resident += size;
+	}
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//If got one from the pool
+	if (buffer)
+	{
+		//Not on the list anymore
+		buffer->next = NULL;
+	} else {
+		//Create new one
+		buffer = new VideoBuffer(size);
+		//Check
+		if (!buffer->data)
+		{
+			//Lock
+			pthread_mutex_lock(&mutex);
+			//Not resident
+			stats.resident -= size;
+			//Unlock
+			pthread_mutex_unlock(&mutex);
+			//Free it
+			delete(buffer);
+			//Error
+			throw std::bad_alloc();
+		}
+	}
+
+	//Same size but may have different dimensions
+	buffer->stride = stride;
+	buffer->lines = lines;
+	//Picture at the begining
+	buffer->Crop(0,0,width,height);
+	//Origin unknown
+	buffer->time = 0;
+	//One for the caller
+	buffer->refs = 1;
+
+	//Return it
+	return buffer;
+}
+
+void VideoBuffer::Release()
+{
+	//Decrease references and recycle it if it was the last one
+	if (!__sync_sub_and_fetch(&refs,1))
+		Recycle(this);
+}
+
+void VideoBuffer::Clear()
+{
+	//If it is packed
+	if (IsPacked())
+	{
+		//Get number of pixels
+		DWORD num = width*height;
+
+		//Paint the background in black for YUV
+		memset(data	, 0		, num);
+		memset(data+num	, (BYTE) -128	, num/2);
+		//Done
+		return;
+	}
+
+	//Paint each line of luma
+	for (DWORD j=0;j<height;++j)
+		memset(planes[0]+j*stride,0,width);
+	//And chroma
+	for (DWORD j=0;j<height/2;++j)
+	{
+		memset(planes[1]+j*stride/2,(BYTE)-128,width/2);
+		memset(planes[2]+j*stride/2,(BYTE)-128,width/2);
+	}
+}
+
+void VideoBuffer::Crop(DWORD left,DWORD top,DWORD width,DWORD height)
+{
+	//Store visible size
+	this->width = width;
+	this->height = height;
+	//Get plane pointers from the allocated ones, so it can be called again
+	planes[0] = data+top*stride+left;
+	planes[1] = data+stride*lines+top/2*stride/2+left/2;
+	planes[2] = data+stride*lines*5/4+top/2*stride/2+left/2;
+}
+
+void VideoBuffer::CopyTo(BYTE* dst) const
+{
+	//If it is packed
+	if (IsPacked())
+	{
+		//Copy all at once
+		memcpy(dst,data,(width*height*3)/2);
+		//Done
+		return;
+	}
+
+	//Get packed planes
+	BYTE* u = dst+width*height;
+	BYTE* v = dst+width*height*5/4;
+
+	//Copy luma
+	for (DWORD j=0;j<height;++j)
+		memcpy(dst+j*width,planes[0]+j*stride,width);
+	//And chroma
+	for (DWORD j=0;j<height/2;++j)
+	{
+		memcpy(u+j*width/2,planes[1]+j*stride/2,width/2);
+		memcpy(v+j*width/2,planes[2]+j*stride/2,width/2);
+	}
+}
+
+void VideoBuffer::Recycle(VideoBuffer* buffer)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Check if it fits on the free lists
+	if (stats.cached+buffer->size<=maxCached)
+	{
+		//Get list for its size
+		VideoBuffer*& first = buffers[buffer->size];
+		//Add it in front
+		buffer->next = first;
+		first = buffer;
+		//Cached
+		stats.cached += buffer->size;
+		//Not deleted
+		buffer = NULL;
+	} else {
+		//Not resident anymore
+		stats.resident -= buffer->size;
+	}
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//If it was not cached
+	if (buffer)
+		//Free it
+		delete(buffer);
+}
+
+VideoBuffer::Stats VideoBuffer::GetStats()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Copy them
+	Stats copy = stats;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+	//Return them
+	return copy;
+}
+
+void VideoBuffer::SetMaxCached(DWORD bytes)
+{
+	Log("-VideoBuffer::SetMaxCached() | [bytes:%d]\n",bytes);
+	//Set it
+	maxCached = bytes;
+}
@@ -0,0 +1,349 @@
+/*
+ * File:   videoencodergroup.cpp
+ * Author: Sergio
+ *
+ * Created on 19 de octubre de 2026, 11:40
+ */
+
+#include <string.h>
+#include <sys/time.h>
+#include "log.h"
+#include "tools.h"
+#include "videoencodergroup.h"
+
+//Bitrate tiers in kbps
+static const DWORD Tiers[] = {64,128,256,384,512,768,1024,1536,2048,3072,4096};
+static const DWORD NumTiers = sizeof(Tiers)/sizeof(Tiers[0]);
+
+bool VideoEncoderGroup::Key::operator<(const Key& other) const
+{
+	//Compare each field
+	if (mosaic!=other.mosaic)	return mosaic<other.mosaic;
+	if (codec!=other.codec)		return codec<other.codec;
+	if (width!=other.width)		return width<other.width;
+	if (height!=other.height)	return height<other.height;
+	if (fps!=other.fps)		return fps<other.fps;
+	return tier<other.tier;
+}
+
+DWORD VideoEncoderGroup::GetTier(DWORD bitrate)
+{
+	//Lowest one if below all
+	DWORD tier = Tiers[0];
+
+	//Find highest one not over it
+	for (DWORD i=1;i<NumTiers && Tiers[i]<=bitrate;++i)
+		//This one
+		tier = Tiers[i];
+
+	return tier;
+}
+
+DWORD VideoEncoderGroup::SelectTier(DWORD current,DWORD bitrate,DWORD estimation)
+{
+	//Never go over the configured bitrate
+	DWORD limit = estimation && estimation<bitrate ? estimation : bitrate;
+
+	//Get tier for it
+	DWORD tier = GetTier(limit);
+
+	//If going down and still allowed to, wait until 10% below current to avoid flapping
+	if (current && tier<current && current<=bitrate && limit*10>=current*9)
+		//Keep current
+		return current;
+
+	return tier;
+}
+
+VideoEncoderGroup::VideoEncoderGroup(const Key& key,int intraPeriod,const Properties& properties) :
+	key(key),
+	properties(properties)
+{
+	//Store values
+	this->intraPeriod = intraPeriod;
+	//Not encoding
+	encoding = false;
+	sendFPU = false;
+	//No stats
+	memset(&stats,0,sizeof(stats));
+	//Create objects
+	pthread_mutex_init(&mutex,NULL);
+	pthread_cond_init(&cond,NULL);
+}
+
+VideoEncoderGroup::~VideoEncoderGroup()
+{
+	//Stop if still running
+	Stop();
+	//Clean object
+	pthread_mutex_destroy(&mutex);
+	pthread_cond_destroy(&cond);
+}
+
+void* VideoEncoderGroup::startEncoding(void *par)
+{
+	Log("VideoEncoderGroupThread [%p]\n",pthread_self());
+
+	//Get group
+	VideoEncoderGroup *group = (VideoEncoderGroup *)par;
+
+	//Block signals
+	blocksignals();
+
+	//Run
+	group->Encode();
+	//Exit
+	return NULL;
+}
+
+int VideoEncoderGroup::Start()
+{
+	Log("-VideoEncoderGroup::Start() [%s,%dx%d,%dfps,%dkbps]\n",VideoCodec::GetNameFor(key.codec),key.width,key.height,key.fps,key.tier);
+
+	//Check
+	if (encoding)
+		return 0;
+
+	//Init input
+	input.Init();
+
+	//Encoding
+	encoding = true;
+
+	//Start thread
+	createPriorityThread(&thread,startEncoding,this,0);
+
+	return 1;
+}
+
+int VideoEncoderGroup::Stop()
+{
+	//Check
+	if (!encoding)
+		return 0;
+
+	Log(">VideoEncoderGroup::Stop()\n");
+
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Stop
+	encoding = false;
+	//Cancel waiting
+	pthread_cond_signal(&cond);
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//Cancel grabbing
+	input.CancelGrabFrame();
+	input.End();
+
+	//Wait
+	pthread_join(thread,NULL);
+
+	Log("<VideoEncoderGroup::Stop()\n");
+
+	return 1;
+}
+
+void VideoEncoderGroup::AddMember(Listener* listener)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Add it
+	listeners.insert(listener);
+	//New member needs an intra to start decoding
+	sendFPU = true;
+	stats.fpuRequested++;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
+
+DWORD VideoEncoderGroup::RemoveMember(Listener* listener)
+{
+	//Lock, waits for the frame being delivered
+	pthread_mutex_lock(&mutex);
+	//Remove it
+	listeners.erase(listener);
+	//Get remaining
+	DWORD num = listeners.size();
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	return num;
+}
+
+DWORD VideoEncoderGroup::GetNumMembers()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Get num
+	DWORD num = listeners.size();
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	return num;
+}
+
+void VideoEncoderGroup::SendFPU()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Next one allowed shall be an intra
+	sendFPU = true;
+	stats.fpuRequested++;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
+
+VideoEncoderGroup::Stats VideoEncoderGroup::GetStats()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Copy
+	Stats copy = stats;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	return copy;
+}
+
+int VideoEncoderGroup::Encode()
+{
+	timeval prev;
+	timeval lastFPU;
+
+	Log(">VideoEncoderGroup::Encode() [%dx%d,%dkbps,%dfps,intra:%d]\n",key.width,key.height,key.tier,key.fps,intraPeriod);
+
+	//Create encoder
+	VideoEncoder* videoEncoder = VideoCodecFactory::CreateEncoder(key.codec,properties);
+
+	//Check
+	if (!videoEncoder)
+		//error
+		return Error("-VideoEncoderGroup::Encode() | Can't create video encoder\n");
+
+	//Start capturing from the mosaic
+	if (!input.StartVideoCapture(key.width,key.height,key.fps))
+	{
+		//Delete encoder
+		delete(videoEncoder);
+		//Error
+		return Error("-VideoEncoderGroup::Encode() | Couldn't set video capture\n");
+	}
+
+	//Bitrate is fixed for the tier
+	DWORD bitrate = key.tier;
+
+	//Send at higher bitrate first frame, but skip frames after that so sending bitrate is kept
+	videoEncoder->SetFrameRate(key.fps,bitrate*5,intraPeriod);
+
+	//Set size
+	videoEncoder->SetSize(key.width,key.height);
+
+	//No wait for first
+	QWORD frameTime = 0;
+
+	//Start times
+	gettimeofday(&prev,NULL);
+	setZeroTime(&lastFPU);
+
+	//While we are encoding
+	while(encoding)
+	{
+		//Get picture
+		BYTE *pic = input.GrabFrame(frameTime/1000);
+
+		//Check picture
+		if (!pic)
+			//Next
+			continue;
+
+		//Lock
+		pthread_mutex_lock(&mutex);
+
+		//If requested and enough time since last one, keep pending if not so it is not lost
+		if (sendFPU && getDifTime(&lastFPU)/1000>MinFPUPeriod)
+		{
+			//Serve all pending requests
+			sendFPU = false;
+			stats.fpuSent++;
+			//Set it
+			videoEncoder->FastPictureUpdate();
+			//Update last FPU
+			getUpdDifTime(&lastFPU);
+		}
+
+		//Unlock
+		pthread_mutex_unlock(&mutex);
+
+		//Encode once for all
+		VideoFrame *videoFrame = videoEncoder->EncodeFrame(pic,input.GetBufferSize());
+
+		//If was failed
+		if (!videoFrame)
+			//Next
+			continue;
+
+		//Check
+		if (frameTime)
+		{
+			timespec ts;
+			//Lock
+			pthread_mutex_lock(&mutex);
+			//Calculate timeout
+			calcAbsTimeoutNS(&ts,&prev,frameTime);
+			//Wait next or stopped
+			int canceled  = !pthread_cond_timedwait(&cond,&mutex,&ts);
+			//Unlock
+			pthread_mutex_unlock(&mutex);
+			//Check if we have been canceled
+			if (canceled)
+				//Exit
+				break;
+		}
+
+		//If first
+		if (!frameTime)
+		{
+			//Set frame time, slower
+			frameTime = 5*1000000/key.fps;
+			//Restore bitrate
+			videoEncoder->SetFrameRate(key.fps,bitrate,intraPeriod);
+		} else {
+			//Set frame time
+			frameTime = 1000000/key.fps;
+		}
+
+		//Set sending time of previous frame
+		getUpdDifTime(&prev);
+
+		//Wall clock timestamp, so members switching groups keep a continous rtp timestamp
+		videoFrame->SetTimestamp(getTime()/1000);
+
+		//Calculate sending times based on bitrate, capped to the frame time
+		DWORD sendingTime = videoFrame->GetLength()*8/bitrate;
+		if (sendingTime>frameTime/1000)
+			sendingTime = frameTime/1000;
+
+		//Lock
+		pthread_mutex_lock(&mutex);
+		//Increase frame counter
+		stats.frames++;
+		//Deliver to each member
+		for (Listeners::iterator it=listeners.begin();it!=listeners.end();++it)
+			//Packetize it on its session
+			(*it)->onEncodedFrame(this,videoFrame,sendingTime);
+		//Unlock
+		pthread_mutex_unlock(&mutex);
+	}
+
+	//Stop capturing
+	input.StopVideoCapture();
+
+	//Delete encoder
+	delete(videoEncoder);
+
+	Log("<VideoEncoderGroup::Encode()\n");
+
+	return 1;
+}
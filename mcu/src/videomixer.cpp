@@ -46,9 +46,26 @@ VideoMixer::VideoMixer(const std::wstring &tag) : eventSource(tag)
 	//Don't show display names by default
 	displayNames = false;
 
+	//No refresh yet
+	refreshTick = false;
+	//Not waiting for frames
+	mixVideoWaiting = false;
+
+	//Start stats period
+	getUpdDifTime(&lastStats);
+	//Start scaler stats period
+	lastScalerStats = FrameScaler::GetStats();
+	//Start label cache stats period
+	lastLabelStats = LabelCache::getInstance().GetStats();
+	//Start clock stats period
+	lastClockStats = MediaClock::getInstance().GetStats();
+	lastEncoderStats = EncoderThreads::getInstance().GetStats();
+
 	//Inciamos lso mutex y la condicion
 	pthread_mutex_init(&mixVideoMutex,0);
 	pthread_cond_init(&mixVideoCond,0);
+	pthread_mutex_init(&tickMutex,0);
+	pthread_mutex_init(&encoderGroupsMutex,0);
 }
 
 /***********************
@@ -60,6 +77,8 @@ VideoMixer::~VideoMixer()
 	//Liberamos los mutex
 	pthread_mutex_destroy(&mixVideoMutex);
 	pthread_cond_destroy(&mixVideoCond);
+	pthread_mutex_destroy(&tickMutex);
+	pthread_mutex_destroy(&encoderGroupsMutex);
 }
 
 /***********************
@@ -88,9 +107,8 @@ void * VideoMixer::startMixingVideo(void *par)
 *************************/
 int VideoMixer::MixVideo()
 {
-	struct timespec   ts;
-	struct timeval    tp;
 	int forceUpdate = 0;
+	bool newFrames = false;
 	DWORD version = 0;
 
 	//Video Iterator
@@ -99,50 +117,106 @@ int VideoMixer::MixVideo()
 
 	Log(">MixVideo\n");
 
+	//Get a tick each 1/10 of second for refreshing the mosaics
+	MediaClock::getInstance().AddListener(this,100);
+
 	//Mientras estemos mezclando
 	while(mixingVideo)
 	{
 		//Protegemos la lista
 		lstVideosUse.WaitUnusedAndLock();
 
+		//No new frames yet
+		newFrames = false;
+
+		//Groups left empty after switching tiers
+		EncoderGroupList stopped;
+
+		//Lock encoder groups so members are not moved while feeding them
+		pthread_mutex_lock(&encoderGroupsMutex);
+
 		//For each video
 		for (Videos::iterator it=lstVideos.begin();it!=lstVideos.end();++it)
 		{
 			//Get Source
 			VideoSource *source = it->second;
+
+			//Leave the old group if it has switched tier, as the group threads can't do it
+			FinishEncoderGroupSwitch(source->shared,stopped);
 			//Get input
 			PipeVideoInput *input = source->input;
 
 			//Get mosaic
 			Mosaic *mosaic = source->mosaic;
 
-			//Si no ha cambiado el frame volvemos al principio
-			if (input && mosaic && (source->refresh || mosaic->HasChanged() || forceUpdate))
+			//Si no ha cambiado el frame volvemos al principio, the shared encoder feeds grouped ones
+			if (input && mosaic && !source->shared->group && (source->refresh || mosaic->HasChanged() || forceUpdate))
+			{
+				//Only new content has a meaningful origin, not refreshes
+				QWORD time = mosaic->HasChanged() ? mosaic->GetFrameTime() : 0;
 				//Colocamos el frame
-				input->SetFrame(mosaic->GetFrame(),mosaic->GetWidth(),mosaic->GetHeight());
+				input->SetFrame(mosaic->GetFrame(),mosaic->GetWidth(),mosaic->GetHeight(),time);
+				//If measuring latency for this participant
+				if (source->latency)
+					//Time since the newest frame on it was received
+					source->latency->RecordSince(LatencyStats::Mixed,time);
+			}
 			//Reset refresh 
 			source->refresh = true;
 		}
 
+		//For each encoder group
+		for (EncoderGroups::iterator it=encoderGroups.begin();it!=encoderGroups.end();++it)
+		{
+			//Get mosaic
+			Mosaic *mosaic = it->first.mosaic;
+			//If it has changed or time to refresh
+			if (mosaic->HasChanged() || forceUpdate)
+				//Resize it once for all the members
+				it->second->GetInput()->SetFrame(mosaic->GetFrame(),mosaic->GetWidth(),mosaic->GetHeight(),mosaic->HasChanged() ? mosaic->GetFrameTime() : 0);
+		}
+
+		//Unlock groups
+		pthread_mutex_unlock(&encoderGroupsMutex);
+
 		//Desprotege la lista
 		lstVideosUse.Unlock();
 
+		//Stop the empty groups without any lock held
+		DeleteEncoderGroups(stopped);
+
 		//LOck the mixing
 		pthread_mutex_lock(&mixVideoMutex);
 
 		//Everything is updated
 		forceUpdate = 0;
 
-		//Get now
-		gettimeofday(&tp, NULL);
+		//Let decoders know before checking, so they signal us under the mutex if they publish after it
+		__atomic_store_n(&mixVideoWaiting,true,__ATOMIC_SEQ_CST);
 
-		//Calculate timeout
-		calcAbsTimeout(&ts,&tp,100);
+		//Protegemos la lista
+		lstVideosUse.WaitUnusedAndLock();
 
-		//Wait for new images or timeout and adquire mutex on exit
-		if (pthread_cond_timedwait(&mixVideoCond,&mixVideoMutex,&ts)==ETIMEDOUT)
-		{
+		//Check if a frame has been published while we were composing
+		for (Videos::iterator it=lstVideos.begin();it!=lstVideos.end() && !newFrames;++it)
+			//If it has one
+			if (it->second->output && it->second->output->HasPendingFrame())
+				//Don't wait
+				newFrames = true;
 
+		//Desprotege la lista
+		lstVideosUse.Unlock();
+
+		//Wait for new images or refresh tick and adquire mutex on exit
+		if (!newFrames && !IsRefreshTick(false))
+			pthread_cond_wait(&mixVideoCond,&mixVideoMutex);
+
+		//Not waiting anymore
+		__atomic_store_n(&mixVideoWaiting,false,__ATOMIC_RELAXED);
+
+		//If it is time to refresh
+		if (IsRefreshTick(true))
+		{
 			//Force an update each 1/10 of second
 			forceUpdate = 1;
 			//Desbloqueamos
@@ -157,155 +231,364 @@ int VideoMixer::MixVideo()
 		//New version
 		version++;
 
+		//Get the frames of all participants first, as checking and getting them is not reentrant
+		Frames frames;
+		//For each video
+		for (Videos::iterator it=lstVideos.begin();it!=lstVideos.end();++it)
+		{
+			//Get output
+			PipeVideoOutput *output = it->second->output;
+			//If no output
+			if (!output)
+				//Skip
+				continue;
+			//Get frame info
+			SourceFrame& frame = frames[it->first];
+			//Check if it has changed for this version
+			frame.changed = output->IsChanged(version);
+			//Get a reference to the frame, no copy
+			frame.buffer = output->GetBuffer();
+		}
+
+		//Create a composition task per mosaic
+		std::vector<CompositionTask> tasks(mosaics.size());
+		std::vector<WorkerPool::Task*> pending(mosaics.size());
+		int num = 0;
+
 		//For each mosaic
-		for (itMosaic=mosaics.begin();itMosaic!=mosaics.end();++itMosaic)
+		for (itMosaic=mosaics.begin();itMosaic!=mosaics.end();++itMosaic,++num)
+		{
+			//Set task data
+			tasks[num].mixer = this;
+			tasks[num].id = itMosaic->first;
+			tasks[num].mosaic = itMosaic->second;
+			tasks[num].frames = &frames;
+			tasks[num].elapsed = 0;
+			tasks[num].pixels = 0;
+			//Add it
+			pending[num] = &tasks[num];
+		}
+
+		//Compose all mosaics in parallel and wait for them
+		if (num)
+			WorkerPool::getInstance().Run(&pending[0],num);
+
+		//Release frames
+		for (Frames::iterator it=frames.begin();it!=frames.end();++it)
+			//If got any
+			if (it->second.buffer)
+				//Release it
+				it->second.buffer->Release();
+
+		//Update composition stats
+		for (int i=0;i<num;++i)
+		{
+			//Get mosaic stats
+			CompositionStats& stats = compositionStats[tasks[i].id];
+			//Update
+			stats.num++;
+			stats.acu += tasks[i].elapsed;
+			stats.pixels += tasks[i].pixels;
+			if (tasks[i].elapsed>stats.max)
+				stats.max = tasks[i].elapsed;
+		}
+
+		//Desbloqueamos, stats are reported without it as other locks are taken
+		pthread_mutex_unlock(&mixVideoMutex);
+
+		//Check if it is time to report them
+		if (getDifTime(&lastStats)>=CompositionStatsPeriod*1000)
 		{
+			//For each mosaic
+			for (CompositionStatsMap::iterator it=compositionStats.begin();it!=compositionStats.end();++it)
+				//Send event, times in us and average pixels written per frame
+				eventSource.SendEvent("mosaicStats","{id:%d,frames:%d,avg:%llu,max:%llu,pixels:%llu}",it->first,it->second.num,it->second.num ? it->second.acu/it->second.num : 0,it->second.max,it->second.num ? it->second.pixels/it->second.num : 0);
+			//Get scaler cache stats
+			FrameScaler::Stats scaler = FrameScaler::GetStats();
+			//Get elapsed seconds
+			double secs = getDifTime(&lastStats)/1E6;
+			//Send event, context creations and reuses per second
+			eventSource.SendEvent("scalerStats","{creations:%.2f,reused:%.2f,cached:%d}",(scaler.created-lastScalerStats.created)/secs,(scaler.reused-lastScalerStats.reused)/secs,scaler.cached);
+			//Store them for next period
+			lastScalerStats = scaler;
+			//Get label cache stats
+			LabelCache::Stats label = LabelCache::getInstance().GetStats();
+			//Send event, labels rasterized and reused per second
+			eventSource.SendEvent("labelStats","{rendered:%.2f,reused:%.2f,cached:%d}",(label.rendered-lastLabelStats.rendered)/secs,(label.reused-lastLabelStats.reused)/secs,label.cached);
+			//Store them for next period
+			lastLabelStats = label;
+			//Get media clock stats
+			MediaClock::Stats clock = MediaClock::getInstance().GetStats();
+			//Send event, lateness histogram for the period
+			eventSource.SendEvent("clockStats","{wakeups:%llu,ticks:%llu,missed:%llu,maxLateness:%d,lateness:[%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu]}",
+				clock.wakeups-lastClockStats.wakeups,clock.ticks-lastClockStats.ticks,clock.missed-lastClockStats.missed,clock.maxLateness,
+				clock.lateness[0]-lastClockStats.lateness[0],clock.lateness[1]-lastClockStats.lateness[1],clock.lateness[2]-lastClockStats.lateness[2],clock.lateness[3]-lastClockStats.lateness[3],
+				clock.lateness[4]-lastClockStats.lateness[4],clock.lateness[5]-lastClockStats.lateness[5],clock.lateness[6]-lastClockStats.lateness[6],clock.lateness[7]-lastClockStats.lateness[7]);
+			//Store them for next period
+			lastClockStats = clock;
+			//Get encoder threads stats
+			EncoderThreads::Stats encoder = EncoderThreads::getInstance().GetStats();
+			//Frames encoded on the period
+			QWORD encoded = encoder.frames-lastEncoderStats.frames;
+			//Send event, threads in use and average encoding time per frame in ms
+			eventSource.SendEvent("encoderStats","{cores:%d,used:%d,encoders:%d,limited:%llu,fps:%.2f,encodeTime:%.2f}",encoder.cores,encoder.used,encoder.encoders,encoder.limited-lastEncoderStats.limited,encoded/secs,encoded ? (encoder.encodeTime-lastEncoderStats.encodeTime)/1000.0/encoded : 0.0);
+			//Store them for next period
+			lastEncoderStats = encoder;
+			//For each participant
+			for (Videos::iterator it=lstVideos.begin();it!=lstVideos.end();++it)
+				//If measuring its latency
+				if (it->second->latency)
+					//Send them
+					SendLatencyStats(it->first,it->second);
+			//Lock groups
+			pthread_mutex_lock(&encoderGroupsMutex);
+			//For each encoder group
+			for (EncoderGroups::iterator it=encoderGroups.begin();it!=encoderGroups.end();++it)
+			{
+				//Get key and stats since created
+				const VideoEncoderGroup::Key& key = it->first;
+				VideoEncoderGroup::Stats stats = it->second->GetStats();
+				//Send event
+				eventSource.SendEvent("encoderGroupStats","{mosaic:%d,codec:\"%s\",width:%d,height:%d,fps:%d,tier:%d,members:%d,frames:%d,fpuRequested:%d,fpuSent:%d}",
+					GetMosaicId(key.mosaic),VideoCodec::GetNameFor(key.codec),key.width,key.height,key.fps,key.tier,it->second->GetNumMembers(),stats.frames,stats.fpuRequested,stats.fpuSent);
+			}
+			//Unlock groups
+			pthread_mutex_unlock(&encoderGroupsMutex);
+			//Reset them
+			compositionStats.clear();
+			//Update report time
+			getUpdDifTime(&lastStats);
+		}
+
+		//Desprotege la lista
+		lstVideosUse.Unlock();
+	}
+
+	//No more ticks
+	MediaClock::getInstance().RemoveListener(this);
+
+	Log("<MixVideo\n");
+}
+
+/*******************************
+ * onTick
+ *	Called from the media clock thread
+ **************************************/
+void VideoMixer::onTick(QWORD deadline,DWORD ticks)
+{
+	//Lock
+	pthread_mutex_lock(&tickMutex);
+	//Refresh mosaics
+	refreshTick = true;
+	//Unlock
+	pthread_mutex_unlock(&tickMutex);
 
-			//Get Mosaic
-			Mosaic *mosaic = itMosaic->second;
+	//Make sure the flag is visible before checking if the mixing thread is waiting
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	//If it is about to wait, lock so the signal is not lost, it does not hold the mutex while waiting
+	if (__atomic_load_n(&mixVideoWaiting,__ATOMIC_SEQ_CST))
+	{
+		//Lock
+		pthread_mutex_lock(&mixVideoMutex);
+		//Wake up mixing thread
+		pthread_cond_signal(&mixVideoCond);
+		//Unlock
+		pthread_mutex_unlock(&mixVideoMutex);
+	} else {
+		//Busy, it will see the flag before waiting again
+		pthread_cond_signal(&mixVideoCond);
+	}
+}
+
+bool VideoMixer::IsRefreshTick(bool clear)
+{
+	//Lock
+	pthread_mutex_lock(&tickMutex);
+	//Get flag
+	bool tick = refreshTick;
+	//Clear it if asked
+	if (clear)
+		refreshTick = false;
+	//Unlock
+	pthread_mutex_unlock(&tickMutex);
+
+	return tick;
+}
+
+/*******************************
+ * CompositionTask
+ *	Compose a mosaic from a pool worker
+ **************************************/
+void VideoMixer::CompositionTask::Execute()
+{
+	//Get start time
+	QWORD ini = getTime();
+	//Compose it
+	mixer->ComposeMosaic(mosaic,*frames);
+	//Store time in us
+	elapsed = getTime()-ini;
+	//Get pixels written for previous frame, including overlay blending
+	pixels = mosaic->GetPixelsTouched();
+}
 
-			if (displayNames) 
-				//FIX: Reset text overlay
-				mosaic->SetOverlayText();
+/*******************************
+ * ComposeMosaic
+ *	Update mosaic slots with the latest frames, may be called in parallel for different mosaics
+ **************************************/
+int VideoMixer::ComposeMosaic(Mosaic* mosaic,const Frames& frames)
+{
+	//Name labels of the slots
+	Mosaic::Labels labels;
 
-			//Get number of slots
-			int numSlots = mosaic->GetNumSlots();
+	//Get number of slots
+	int numSlots = mosaic->GetNumSlots();
 
-			//Max vad value
-			DWORD maxVAD = 0;
+	//Max vad value
+	DWORD maxVAD = 0;
 
-			//Get old speaker participant
-			int oldVad = mosaic->GetVADParticipant();
+	//Get old speaker participant
+	int oldVad = mosaic->GetVADParticipant();
 
-			//Keep latest speaker if no one is talking
-			int vadId = oldVad;
+	//Keep latest speaker if no one is talking
+	int vadId = oldVad;
 
-			//If VAD is set and we have the VAD proxy enabled do the "VAD thing"!
-			//If there was no previous speaker or the vad slot is not blocked
-			//If vad is not shown do nothing
-			if (vadMode!=NoVAD && proxy && mosaic->IsVADShown() && (oldVad==0 || mosaic->GetVADBlockingTime()<=getTime()))
+	//If VAD is set and we have the VAD proxy enabled do the "VAD thing"!
+	//If there was no previous speaker or the vad slot is not blocked
+	//If vad is not shown do nothing
+	if (vadMode!=NoVAD && proxy && mosaic->IsVADShown() && (oldVad==0 || mosaic->GetVADBlockingTime()<=getTime()))
+	{
+		//Update VAD info for each participant
+		for (Videos::iterator it=lstVideos.begin();it!=lstVideos.end();++it)
+		{
+			//Get Id of participant
+			int id = it->first;
+			//If it is in the mosaic
+			if (mosaic->HasParticipant(id))
 			{
-				//Update VAD info for each participant
-				for (Videos::iterator it=lstVideos.begin();it!=lstVideos.end();++it)
+				//Get vad value for participant
+				DWORD vad = proxy->GetVAD(id);
+				//Found the highest VAD participant but select at least one.
+				if (vad>maxVAD || vadId==0)
 				{
-					//Get Id of participant
-					int id = it->first;
-					//If it is in the mosaic
-					if (mosaic->HasParticipant(id))
-					{
-						//Get vad value for participant
-						DWORD vad = proxy->GetVAD(id);
-						//Found the highest VAD participant but select at least one.
-						if (vad>maxVAD || vadId==0)
-						{
-							//Store max vad value
-							maxVAD = vad;
-							//Store speaker participant
-							vadId = id;
-						}
-					}
-				}
-				//Check if there is a different active speaker
-				if (oldVad!=vadId)
-				{
-					//Do we need to hide it?
-					bool hide = (vadMode==FullVAD);
-					// set the VAD participant
-					mosaic->SetVADParticipant(vadId,hide,getTime() + vadDefaultChangePeriod*1000);
-					//If there was a previous active spearkc and wein FULL vad
-					if (oldVad && hide)
-						//Set score of old particippant to last time on VAD slot
-						mosaic->SetScore(oldVad,getTime());
-					//Calculate participants again
-					mosaic->CalculatePositions();
+					//Store max vad value
+					maxVAD = vad;
+					//Store speaker participant
+					vadId = id;
 				}
 			}
+		}
+		//Check if there is a different active speaker
+		if (oldVad!=vadId)
+		{
+			//Do we need to hide it?
+			bool hide = (vadMode==FullVAD);
+			// set the VAD participant
+			mosaic->SetVADParticipant(vadId,hide,getTime() + vadDefaultChangePeriod*1000);
+			//If there was a previous active spearkc and wein FULL vad
+			if (oldVad && hide)
+				//Set score of old particippant to last time on VAD slot
+				mosaic->SetScore(oldVad,getTime());
+			//Calculate participants again
+			mosaic->CalculatePositions();
+		}
+	}
 
-			//Old and new positions
-			int* newPos = (int*) malloc(numSlots*sizeof(int));
-			int* oldPos = (int*) malloc(numSlots*sizeof(int));
+	//Old and new positions
+	int* newPos = (int*) malloc(numSlots*sizeof(int));
+	int* oldPos = (int*) malloc(numSlots*sizeof(int));
 
-			//Get info from mosaic
-			memcpy(oldPos,mosaic->GetOldPositions(),numSlots*sizeof(int));
-			memcpy(newPos,mosaic->GetPositions(),numSlots*sizeof(int));
+	//Get info from mosaic
+	memcpy(oldPos,mosaic->GetOldPositions(),numSlots*sizeof(int));
+	memcpy(newPos,mosaic->GetPositions(),numSlots*sizeof(int));
 
-			//Reset the change status in the mosaic
-			mosaic->Reset();
+	//Reset the change status in the mosaic
+	mosaic->Reset();
 
-			//For each slot
-			for (int i=0;i<numSlots;i++)
+	//For each slot
+	for (int i=0;i<numSlots;i++)
+	{
+		//Get participant for slot
+		int partId = newPos[i];
+
+		//Check if it has changed
+		bool changed = (oldPos[i]!=partId);
+		
+		//If there is a participant in the slot
+		if (partId)
+		{
+			//Find  it
+			Videos::iterator it = lstVideos.find(partId);
+
+			//Double check
+			if (it==lstVideos.end())
 			{
-				//Get participant for slot
-				int partId = newPos[i];
-
-				//Check if it has changed
-				bool changed = (oldPos[i]!=partId);
-				
-				//If there is a participant in the slot
-				if (partId)
-				{
-					//Find  it
-					Videos::iterator it = lstVideos.find(partId);
-
-					//Double check
-					if (it==lstVideos.end())
-					{
-						//Error
-						Error("-participant not found %d for slot %d,cleaning it\n",partId,i);
-						//If it was not there previously
-						if (changed)
-							//Clean position
-							mosaic->Clean(i,logo);
-						//Next slot
-						continue;
-					}
-					
-					//If we are displaying names
-					if (displayNames && !it->second->name.empty())
-					{
-						//Get
-						int height = overlay.GetProperty("height",30);
-						//Set name
-						mosaic->RenderOverlayText(it->second->name,mosaic->GetLeft(i),mosaic->GetTop(i)+mosaic->GetHeight(i)-height,mosaic->GetWidth(i),height,overlay);
-					}
-
-					//Get output
-					PipeVideoOutput *output = it->second->output;
-
-					//If we've got a new frame or the participant image was not in slot yet
-					if ((output && output->IsChanged(version)) || changed)
-					{
-						//Change mosaic
-						mosaic->Update(i,output->GetFrame(),output->GetWidth(),output->GetHeight(),keepAspectRatio);
-
-						//Check if debug is enabled
-						if (vadMode!=NoVAD && proxy && Logger::IsDebugEnabled())
-						{
-							//Get vad
-							DWORD vad = proxy->GetVAD(partId);
-							//Set VU meter
-							mosaic->DrawVUMeter(i,vad,48000);
-						}
-					}
-				} else if (changed) {
+				//Error
+				Error("-participant not found %d for slot %d,cleaning it\n",partId,i);
+				//If it was not there previously
+				if (changed)
 					//Clean position
 					mosaic->Clean(i,logo);
+				//Next slot
+				continue;
+			}
+			
+			//If we are displaying names
+			if (displayNames && !it->second->name.empty())
+			{
+				//Get
+				int height = overlay.GetProperty("height",30);
+				//Add name label at the bottom of the slot
+				Mosaic::Label label;
+				label.text = it->second->name;
+				label.left = mosaic->GetLeft(i);
+				label.top = mosaic->GetTop(i)+mosaic->GetHeight(i)-height;
+				label.width = mosaic->GetWidth(i);
+				label.height = height;
+				labels.push_back(label);
+			}
+
+			//Get participant frame
+			Frames::const_iterator frame = frames.find(partId);
+
+			//If we've got a new frame or the participant image was not in slot yet
+			if (frame!=frames.end() && frame->second.buffer && (frame->second.changed || changed))
+			{
+				//Get picture
+				VideoBuffer* buffer = frame->second.buffer;
+				//Change mosaic, planes are used as decoded
+				mosaic->Update(i,buffer,keepAspectRatio);
+				//Keep origin of the newest one
+				mosaic->UpdateFrameTime(buffer->GetTime());
+
+				//Check if debug is enabled
+				if (vadMode!=NoVAD && proxy && Logger::IsDebugEnabled())
+				{
+					//Get vad
+					DWORD vad = proxy->GetVAD(partId);
+					//Set VU meter
+					mosaic->DrawVUMeter(i,vad,48000);
 				}
 			}
-			//Free mem
-			free(oldPos);
-			free(newPos);
+		} else if (changed) {
+			//Clean position
+			mosaic->Clean(i,logo);
 		}
+	}
 
-		//Desprotege la lista
-		lstVideosUse.Unlock();
+	//If we are displaying names
+	if (displayNames)
+		//Only the labels that have changed are drawn again
+		mosaic->SetOverlayLabels(labels,overlay);
 
-		//Desbloqueamos
-		pthread_mutex_unlock(&mixVideoMutex);
-	}
+	//Free mem
+	free(oldPos);
+	free(newPos);
 
-	Log("<MixVideo\n");
+	//Done
+	return 1;
 }
+
 /*******************************
  * CreateMosaic
  *	Create new mosaic in the conference
@@ -506,6 +789,25 @@ int VideoMixer::End()
 	//Protegemos la lista
 	lstVideosUse.WaitUnusedAndLock();
 
+	EncoderGroupList stopped;
+
+	//Lock groups
+	pthread_mutex_lock(&encoderGroupsMutex);
+
+	//Get all encoder groups
+	for (EncoderGroups::iterator it=encoderGroups.begin();it!=encoderGroups.end();++it)
+		//Stop it later
+		stopped.push_back(it->second);
+
+	//Clean them
+	encoderGroups.clear();
+
+	//Unlock groups
+	pthread_mutex_unlock(&encoderGroupsMutex);
+
+	//Stop and delete them without the lock held
+	DeleteEncoderGroups(stopped);
+
 	//Recorremos la lista
 	for (it =lstVideos.begin();it!=lstVideos.end();++it)
 	{
@@ -514,6 +816,7 @@ int VideoMixer::End()
 		//Delete video stream
 		delete video->input;
 		delete video->output;
+		delete video->shared;
 		delete video;
 	}
 
@@ -568,7 +871,8 @@ int VideoMixer::CreateMixer(int id,const std::wstring &name)
 
 	//POnemos el input y el output
 	video->input  = new PipeVideoInput();
-	video->output = new PipeVideoOutput(&mixVideoMutex,&mixVideoCond);
+	video->output = new PipeVideoOutput(&mixVideoMutex,&mixVideoCond,&mixVideoWaiting);
+	video->shared = new SharedEncoder(this);
 	//No mosaic yet
 	video->mosaic = NULL;
 
@@ -625,6 +929,9 @@ int VideoMixer::InitMixer(int id,int mosaicId)
 		//Send only participant
 		Log("-No mosaic for participant found, will be send only.\n");
 
+	//Move shared encoder to its group
+	SetSharedEncoderMosaic(video,video->mosaic);
+
 	//Desprotegemos
 	lstVideosUse.DecUse();
 	
@@ -683,6 +990,9 @@ int VideoMixer::SetMixerMosaic(int id,int mosaicId)
 	//Refresh it
 	video->refresh = true;
 
+	//Move shared encoder to the group of the new mosaic
+	SetSharedEncoderMosaic(video,mosaic);
+
 	//Desprotegemos
 	lstVideosUse.DecUse();
 	
@@ -694,6 +1004,96 @@ int VideoMixer::SetMixerMosaic(int id,int mosaicId)
 	//Si esta devolvemos el input
 	return true;
 }
+/***********************************
+ * SetLatencyStats
+ *	Set where the latency of the participant stream is recorded, NULL to stop
+ ************************************/
+int VideoMixer::SetLatencyStats(int id,LatencyStats* latency)
+{
+	//Protegemos la lista
+	lstVideosUse.WaitUnusedAndLock();
+
+	//Buscamos el video source
+	Videos::iterator it = lstVideos.find(id);
+
+	//Si no esta
+	if (it == lstVideos.end())
+	{
+		//Desprotegemos
+		lstVideosUse.Unlock();
+		//Salimos
+		return Error("Mixer not found\n");
+	}
+
+	//Obtenemos el video source
+	VideoSource *video = (*it).second;
+
+	//Set it
+	video->latency = latency;
+
+	//Reset last reported ones
+	if (video->lastLatency)
+		delete(video->lastLatency);
+	video->lastLatency = NULL;
+
+	//If got new ones
+	if (latency)
+	{
+		//Report from now on
+		video->lastLatency = new LatencyStats::Snapshot();
+		latency->GetSnapshot(*video->lastLatency);
+	}
+
+	//Desprotegemos
+	lstVideosUse.Unlock();
+
+	return true;
+}
+
+/*******************************
+ * SendLatencyStats
+ *	Send latency of each stage for a participant since last report
+ **************************************/
+void VideoMixer::SendLatencyStats(int id,VideoSource* source)
+{
+	char stages[LatencyStats::NumStages*96];
+	DWORD len = 0;
+
+	//Get current ones
+	LatencyStats::Snapshot* current = new LatencyStats::Snapshot();
+	source->latency->GetSnapshot(*current);
+
+	//Get them for the period
+	LatencyStats::Snapshot period = *current;
+	period -= *source->lastLatency;
+
+	//Store for next time
+	delete(source->lastLatency);
+	source->lastLatency = current;
+
+	//For each stage
+	for (DWORD i=0;i<LatencyStats::NumStages;++i)
+	{
+		//Get histogram
+		const LatencyHistogram& histogram = period.stages[i];
+		//Append count, avg and percentiles in us
+		len += snprintf(stages+len,sizeof(stages)-len,",%s:[%llu,%llu,%llu,%llu,%llu,%llu]",
+			LatencyStats::GetNameFor((LatencyStats::Stage)i),
+			histogram.GetCount(),histogram.GetMean(),histogram.GetPercentile(50),histogram.GetPercentile(90),histogram.GetPercentile(99),histogram.GetMax());
+		//Check
+		if (len>=sizeof(stages))
+			//Truncated
+			return;
+	}
+
+	//Get period length
+	double secs = period.time ? period.time/1E6 : 1;
+
+	//Send event, cpu in % of one core
+	eventSource.SendEvent("latencyStats","{id:%d,cpu:{receiving:%.1f,sending:%.1f}%s}",id,
+		period.cpu[LatencyStats::Receiving]/secs/1E4,period.cpu[LatencyStats::Sending]/secs/1E4,stages);
+}
+
 /***********************************
  * AddMosaicParticipant
  *	Add a participant to be shown in a mosaic
@@ -811,6 +1211,9 @@ int VideoMixer::EndMixer(int id)
 	//Unset mosaic
 	video->mosaic = NULL;
 
+	//Remove shared encoder from its group
+	SetSharedEncoderMosaic(video,NULL);
+
 	//Dec usage
 	lstVideosUse.DecUse();
 
@@ -882,9 +1285,13 @@ int VideoMixer::DeleteMixer(int id)
 	//Desprotegemos la lista
 	lstVideosUse.Unlock();
 
+	//Stop getting frames from shared encoder
+	video->shared->Leave();
+
 	//SI esta borramos los objetos
 	delete video->input;
 	delete video->output;
+	delete video->shared;
 	delete video;
 
 	Log("<DeleteMixer video [%d]\n",id);
@@ -944,6 +1351,398 @@ VideoOutput* VideoMixer::GetOutput(int id)
 	return output;
 }
 
+/***********************
+* GetSharedEncoder
+*	Get the encoder shared with the rest of participants of the same mosaic
+************************/
+SharedVideoEncoder* VideoMixer::GetSharedEncoder(int id)
+{
+	//Protegemos la lista
+	lstVideosUse.IncUse();
+
+	//Buscamos el video source
+	Videos::iterator it = lstVideos.find(id);
+
+	//Obtenemos el shared encoder
+	SharedVideoEncoder *shared = NULL;
+
+	//Si esta
+	if (it != lstVideos.end())
+		shared = it->second->shared;
+
+	//Desprotegemos
+	lstVideosUse.DecUse();
+
+	//Return it
+	return shared;
+}
+
+/***********************
+* SetSharedEncoderMosaic
+*	Move the shared encoder of a source to the group of its new mosaic
+************************/
+void VideoMixer::SetSharedEncoderMosaic(VideoSource* source,Mosaic* mosaic)
+{
+	EncoderGroupList stopped;
+	//Lock groups
+	pthread_mutex_lock(&encoderGroupsMutex);
+	//Set new mosaic
+	source->shared->key.mosaic = mosaic;
+	//Update group, other content so no need to wait for an intra
+	UpdateEncoderGroup(source->shared,false,stopped);
+	//Unlock groups
+	pthread_mutex_unlock(&encoderGroupsMutex);
+	//Stop the empty ones without the lock held
+	DeleteEncoderGroups(stopped);
+}
+
+/***********************
+* UpdateEncoderGroup
+*	Move a shared encoder to the group for its key, must be called with the groups locked
+*	If switching, it is kept on its current group until the new one sends an intra
+*	Groups left empty are removed and returned in stopped to be deleted after unlocking
+************************/
+void VideoMixer::UpdateEncoderGroup(SharedEncoder* shared,bool switching,EncoderGroupList& stopped)
+{
+	VideoEncoderGroup* group = NULL;
+
+	//Take the switch state, so it can't be completed by the group threads while we decide
+	pthread_mutex_lock(&shared->mutex);
+	VideoEncoderGroup* current = shared->group;
+	VideoEncoderGroup* target = shared->target;
+	VideoEncoderGroup* previous = shared->previous;
+	shared->target = NULL;
+	shared->previous = NULL;
+	pthread_mutex_unlock(&shared->mutex);
+
+	//Leave the group of a completed switch
+	if (previous)
+		LeaveEncoderGroup(shared,previous,stopped);
+
+	//If joined and watching a mosaic
+	if (shared->joined && shared->key.mosaic)
+	{
+		//Find group for it
+		EncoderGroups::iterator it = encoderGroups.find(shared->key);
+
+		//If found
+		if (it!=encoderGroups.end())
+		{
+			//Use it
+			group = it->second;
+		} else {
+			//Create new one with the member settings
+			group = new VideoEncoderGroup(shared->key,shared->intraPeriod,shared->properties);
+			//Add it
+			encoderGroups[shared->key] = group;
+			//Start encoding
+			group->Start();
+		}
+	}
+
+	//If not moved
+	if (group==current)
+	{
+		//Cancel pending switch
+		if (target)
+			LeaveEncoderGroup(shared,target,stopped);
+		//Done
+		return;
+	}
+
+	//If we can keep the current group until the new one has an intra
+	if (switching && current && group)
+	{
+		//Set it before joining so the first intra is not lost
+		pthread_mutex_lock(&shared->mutex);
+		shared->target = group;
+		pthread_mutex_unlock(&shared->mutex);
+		//Join new group, which will send an intra, even if already waiting for it as it may have been missed
+		group->AddMember(shared);
+		//If there was another pending switch
+		if (target && target!=group)
+			//Cancel it
+			LeaveEncoderGroup(shared,target,stopped);
+		Log("-VideoMixer::UpdateEncoderGroup() switching on next intra [tier:%d,groups:%d]\n",shared->key.tier,encoderGroups.size());
+		//Done
+		return;
+	}
+
+	//Move now
+	pthread_mutex_lock(&shared->mutex);
+	shared->group = group;
+	pthread_mutex_unlock(&shared->mutex);
+
+	//Join new group, which will send an intra
+	if (group)
+		group->AddMember(shared);
+
+	//Leave the previous ones
+	if (target && target!=group)
+		LeaveEncoderGroup(shared,target,stopped);
+	if (current)
+		LeaveEncoderGroup(shared,current,stopped);
+
+	Log("-VideoMixer::UpdateEncoderGroup() [tier:%d,groups:%d]\n",shared->key.tier,encoderGroups.size());
+}
+
+/***********************
+* FinishEncoderGroupSwitch
+*	Leave the group a shared encoder has switched from, must be called with the groups locked
+************************/
+void VideoMixer::FinishEncoderGroupSwitch(SharedEncoder* shared,EncoderGroupList& stopped)
+{
+	//Get the group switched from
+	pthread_mutex_lock(&shared->mutex);
+	VideoEncoderGroup* previous = shared->previous;
+	shared->previous = NULL;
+	pthread_mutex_unlock(&shared->mutex);
+
+	//If any
+	if (previous)
+		//Leave it
+		LeaveEncoderGroup(shared,previous,stopped);
+}
+
+/***********************
+* LeaveEncoderGroup
+*	Remove a shared encoder from a group and remove the group if it was the last member,
+*	must be called with the groups locked
+************************/
+void VideoMixer::LeaveEncoderGroup(SharedEncoder* shared,VideoEncoderGroup* group,EncoderGroupList& stopped)
+{
+	//If it was not the last one
+	if (group->RemoveMember(shared))
+		//Done
+		return;
+	//Remove group
+	encoderGroups.erase(group->GetKey());
+	//It will be stopped later, as it waits for the encoding thread
+	stopped.push_back(group);
+}
+
+/***********************
+* DeleteEncoderGroups
+*	Stop and delete removed encoder groups, must be called without the groups locked
+************************/
+void VideoMixer::DeleteEncoderGroups(EncoderGroupList& stopped)
+{
+	//For each one
+	for (EncoderGroupList::iterator it=stopped.begin();it!=stopped.end();++it)
+		//Stop and delete it
+		delete(*it);
+	//Clean
+	stopped.clear();
+}
+
+/***********************
+* GetMosaicId
+*	Get id of a mosaic, 0 if not found
+************************/
+int VideoMixer::GetMosaicId(Mosaic* mosaic)
+{
+	//For each mosaic
+	for (Mosaics::iterator it=mosaics.begin();it!=mosaics.end();++it)
+		//If found
+		if (it->second==mosaic)
+			//Return id
+			return it->first;
+	//Not found
+	return 0;
+}
+
+VideoMixer::SharedEncoder::SharedEncoder(VideoMixer* mixer)
+{
+	//Store mixer
+	this->mixer = mixer;
+	//Not joined
+	listener = NULL;
+	group = NULL;
+	target = NULL;
+	previous = NULL;
+	joined = false;
+	//Create mutex
+	pthread_mutex_init(&mutex,NULL);
+	//No key yet
+	key.mosaic = NULL;
+	key.codec = VideoCodec::H264;
+	key.width = 0;
+	key.height = 0;
+	key.fps = 0;
+	key.tier = 0;
+	bitrate = 0;
+	estimation = 0;
+	intraPeriod = 0;
+}
+
+VideoMixer::SharedEncoder::~SharedEncoder()
+{
+	//Destroy mutex
+	pthread_mutex_destroy(&mutex);
+}
+
+void VideoMixer::SharedEncoder::onEncodedFrame(VideoEncoderGroup* from,VideoFrame* frame,DWORD sendingTime)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//If it is the first intra of the group we are switching to
+	if (from==target && frame->IsIntra())
+	{
+		//Old group will be left by the mixer, we can't lock it from here
+		previous = group;
+		//Switch
+		group = target;
+		target = NULL;
+	}
+
+	//Only deliver the frames of the current group
+	if (from==group && listener)
+		//Packetize it
+		listener->onEncodedFrame(from,frame,sendingTime);
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
+
+int VideoMixer::SharedEncoder::Join(VideoEncoderGroup::Listener* listener,VideoCodec::Type codec,int width,int height,int fps,int bitrate,int intraPeriod,const Properties& properties)
+{
+	Log("-VideoMixer::SharedEncoder::Join() [%s,%dx%d,%dfps,%dkbps]\n",VideoCodec::GetNameFor(codec),width,height,fps,bitrate);
+
+	//Check
+	if (!listener || !width || !height || !fps || bitrate<=0)
+		//Error
+		return Error("-VideoMixer::SharedEncoder::Join() | Wrong parameters\n");
+
+	EncoderGroupList stopped;
+
+	//Lock groups
+	pthread_mutex_lock(&mixer->encoderGroupsMutex);
+
+	//If it was already joined
+	if (joined)
+	{
+		//Leave first
+		joined = false;
+		//Remove from group
+		mixer->UpdateEncoderGroup(this,false,stopped);
+	}
+
+	//Store settings
+	pthread_mutex_lock(&mutex);
+	this->listener = listener;
+	pthread_mutex_unlock(&mutex);
+	this->bitrate = bitrate;
+	this->intraPeriod = intraPeriod;
+	this->properties = properties;
+	key.codec = codec;
+	key.width = width;
+	key.height = height;
+	key.fps = fps;
+	//No estimation yet
+	estimation = 0;
+	//Start on the tier of its bitrate
+	key.tier = VideoEncoderGroup::SelectTier(0,bitrate,0);
+	//Joined
+	joined = true;
+
+	//Add to group for its mosaic
+	mixer->UpdateEncoderGroup(this,false,stopped);
+
+	//Unlock groups
+	pthread_mutex_unlock(&mixer->encoderGroupsMutex);
+
+	//Stop the empty ones without the lock held
+	DeleteEncoderGroups(stopped);
+
+	return 1;
+}
+
+int VideoMixer::SharedEncoder::SetTargetBitrate(int bitrate)
+{
+	EncoderGroupList stopped;
+
+	//Lock groups
+	pthread_mutex_lock(&mixer->encoderGroupsMutex);
+
+	//Store estimation
+	estimation = bitrate>0 ? bitrate : 0;
+
+	//If joined
+	if (joined)
+	{
+		//Get tier for new estimation
+		DWORD tier = VideoEncoderGroup::SelectTier(key.tier,this->bitrate,estimation);
+		//If changed
+		if (tier!=key.tier)
+		{
+			Debug("-VideoMixer::SharedEncoder::SetTargetBitrate() | Changing tier [estimation:%d,from:%d,to:%d]\n",estimation,key.tier,tier);
+			//Set it
+			key.tier = tier;
+			//Move to the group of the new tier on its next intra, so the decoder can switch without artifacts
+			mixer->UpdateEncoderGroup(this,true,stopped);
+		}
+	}
+
+	//Unlock groups
+	pthread_mutex_unlock(&mixer->encoderGroupsMutex);
+
+	//Stop the empty ones without the lock held, it waits for their encoding threads
+	DeleteEncoderGroups(stopped);
+
+	return 1;
+}
+
+int VideoMixer::SharedEncoder::SendFPU()
+{
+	//Lock groups
+	pthread_mutex_lock(&mixer->encoderGroupsMutex);
+
+	//Get group being delivered, it is not deleted while we hold the groups lock
+	pthread_mutex_lock(&mutex);
+	VideoEncoderGroup* current = group;
+	pthread_mutex_unlock(&mutex);
+
+	//Check if in a group
+	int ret = current!=NULL;
+
+	//Request it to the group, coalesced with the other members requests
+	if (current)
+		current->SendFPU();
+
+	//Unlock groups
+	pthread_mutex_unlock(&mixer->encoderGroupsMutex);
+
+	return ret;
+}
+
+int VideoMixer::SharedEncoder::Leave()
+{
+	EncoderGroupList stopped;
+
+	//Lock groups
+	pthread_mutex_lock(&mixer->encoderGroupsMutex);
+
+	//Not joined anymore
+	joined = false;
+
+	//Remove from group
+	mixer->UpdateEncoderGroup(this,false,stopped);
+
+	//No listener
+	pthread_mutex_lock(&mutex);
+	listener = NULL;
+	pthread_mutex_unlock(&mutex);
+
+	//Unlock groups
+	pthread_mutex_unlock(&mixer->encoderGroupsMutex);
+
+	//Stop the empty ones without the lock held
+	DeleteEncoderGroups(stopped);
+
+	return 1;
+}
+
 /**************************
 * SetCompositionType
 *    Pone el modo de mosaico
@@ -1101,8 +1900,12 @@ int VideoMixer::DeleteMosaic(int mosaicId)
 	{
 		//Check it it has dis mosaic
 		if (itv->second->mosaic == mosaic)
+		{
 			//Set to null
 			itv->second->mosaic = NULL;
+			//Remove shared encoder from the mosaic group
+			SetSharedEncoderMosaic(itv->second,NULL);
+		}
 	}
 
 	//Remove mosaic
@@ -20,13 +20,15 @@ VideoPipe::VideoPipe()
 	//No estamos iniciados
 	//inited = false;
 	capturing = false;
-	grabPic = 0;
-	imgBuffer[0] = NULL;
-	imgBuffer[1] = NULL;
+	canceled = false;
+	grabbed = NULL;
 }
 
 VideoPipe::~VideoPipe()
 {
+	//Release last grabbed picture
+	if (grabbed)
+		grabbed->Release();
 	//Liberamos los mutex
 	pthread_mutex_destroy(&newPicMutex);
 	pthread_cond_destroy(&newPicCond);
@@ -78,14 +80,8 @@ int VideoPipe::StartVideoCapture(int width,int height,int fps)
 	videoSize = (videoWidth*videoHeight*3)/2;
 	videoFPS = fps;
 
-	//Creamos el buffer
-	imgBuffer[0] = (BYTE *)malloc(videoSize);
-	imgBuffer[1] = (BYTE *)malloc(videoSize);
-
-	//El inicio
-	imgPos = false;
-	imgNew = false;
-	grabPic = 0;
+	//El inicio, pictures will be taken from the pool
+	canceled = false;
 
 	//Estamos capturando
 	capturing = true;
@@ -103,17 +99,18 @@ int VideoPipe::StopVideoCapture()
 	//Protegemos
 	pthread_mutex_lock(&newPicMutex);
 
-	//LIberamos los buffers
-	if (imgBuffer[0])
-		free(imgBuffer[0]);
-	if (imgBuffer[1])
-		free(imgBuffer[1]);
-
 	//Y no estamos capturando
 	capturing = false;
 
-	//Clear flags
-	grabPic = NULL;
+	//Drop pending picture
+	pending.Clear();
+
+	//Release last grabbed one
+	if (grabbed)
+		grabbed->Release();
+
+	//Clear it
+	grabbed = NULL;
 
 	//Desprotegemos
 	pthread_mutex_unlock(&newPicMutex);
@@ -140,7 +137,7 @@ BYTE* VideoPipe::GrabFrame(DWORD timeout)
 	}
 
 	//Miramos a ver si hay un nuevo pict
-	if(imgNew==0)
+	if (!pending.IsPending() && !canceled)
 	{
 		//If timeout has been specified
 		if (timeout)
@@ -156,11 +153,31 @@ BYTE* VideoPipe::GrabFrame(DWORD timeout)
 		}
 	}
 
-	//Lo vamos a consumir
-	imgNew=0;
+	//If we have been canceled
+	if (canceled)
+	{
+		//Not anymore
+		canceled = false;
+		//No picture
+		if (grabbed)
+			grabbed->Release();
+		grabbed = NULL;
+	} else {
+		//Take new picture if any
+		VideoBuffer* frame = pending.Take();
+		//If got it
+		if (frame)
+		{
+			//Release previous one, the encoder is done with it
+			if (grabbed)
+				grabbed->Release();
+			//Keep it until next grab
+			grabbed = frame;
+		}
+	}
 
-	//Nos quedamos con el puntero antes de que lo cambien
-	pic=grabPic;
+	//Nos quedamos con el puntero, nobody will write on it
+	pic = grabbed ? grabbed->GetData() : NULL;
 
 	//Y liberamos el mutex
 	pthread_mutex_unlock(&newPicMutex);
@@ -174,8 +191,8 @@ void  VideoPipe::CancelGrabFrame()
 	pthread_mutex_lock(&newPicMutex);
 
 	//No image
-	imgNew = false;
-	grabPic = NULL;
+	canceled = true;
+	pending.Clear();
 
 	//Se�alamos
 	pthread_cond_signal(&newPicCond);
@@ -202,54 +219,136 @@ int VideoPipe::NextFrame(BYTE * buffer)
 	//Protegemos
 	pthread_mutex_lock(&newPicMutex);
 
-	//Si estamos capturamos
-	if (capturing)
-	{
-		//Actualizamos el grabPic
-		grabPic = imgBuffer[imgPos];
+	//Get capture values
+	int capture = capturing;
+	int width = videoWidth;
+	int height = videoHeight;
+
+	//Y desbloqueamos
+	pthread_mutex_unlock(&newPicMutex);
+
+	//Si no estamos capturamos
+	if (!capture)
+		//Nothing to do
+		return 1;
 
-		//Pasamos al siguiente
-		imgPos = !imgPos;
+	//Get a free picture from the pool
+	VideoBuffer* frame = VideoBuffer::Create(width,height);
 
-		//Copy & Resize
-		resizer.Resize(buffer,inputWidth,inputHeight,grabPic,videoWidth,videoHeight,true);
+	//Copy & Resize, outside the lock
+	resizer.Resize(buffer,inputWidth,inputHeight,frame->GetData(),width,height,true);
 
+	//Hay imagen
+	return Publish(frame);
+}
+
+int VideoPipe::NextFrame(VideoBuffer* buffer)
+{
+	int width;
+	int height;
+
+	//Si no estamos capturamos
+	if (!GetCaptureSize(width,height))
+		//Nothing to do
+		return 1;
+
+	//If it is packed and has already the capture size
+	if (buffer->IsPacked() && buffer->GetWidth()==width && buffer->GetHeight()==height)
+	{
+		//Share it
+		buffer->AddRef();
 		//Hay imagen
-		imgNew = true;
-		//Se�alamos
-		pthread_cond_signal(&newPicCond);
+		return Publish(buffer);
+	}
+
+	//Get a free picture from the pool
+	VideoBuffer* frame = VideoBuffer::Create(width,height);
+
+	//Scale from the decoded planes, outside the lock
+	resizer.Resize(buffer->GetPlane(0),buffer->GetPlane(1),buffer->GetPlane(2),buffer->GetStride(),buffer->GetWidth(),buffer->GetHeight(),frame->GetData(),width,height,true);
+
+	//Keep origin time along with it
+	frame->SetTime(buffer->GetTime());
+
+	//Hay imagen
+	return Publish(frame);
+}
+
+int VideoPipe::NextScaledFrame(VideoBuffer* frame)
+{
+	int width;
+	int height;
+
+	//If not capturing or the size has changed meanwhile
+	if (!GetCaptureSize(width,height) || frame->GetWidth()!=width || frame->GetHeight()!=height)
+	{
+		//Drop it
+		frame->Release();
+		//Nothing to do
+		return 1;
 	}
 
+	//Hay imagen
+	return Publish(frame);
+}
+
+bool VideoPipe::GetCaptureSize(int &width,int &height)
+{
+	//Protegemos
+	pthread_mutex_lock(&newPicMutex);
+
+	//Get capture values
+	bool capture = capturing;
+	width = videoWidth;
+	height = videoHeight;
+
 	//Y desbloqueamos
 	pthread_mutex_unlock(&newPicMutex);
 
-	return 1;
+	return capture;
 }
 
 void VideoPipe::ClearFrame()
 {
 	//Protegemos
 	pthread_mutex_lock(&newPicMutex);
-	
-	//Actualizamos el grabPic
-	grabPic = imgBuffer[imgPos];
 
-	//Pasamos al siguiente
-	imgPos = !imgPos;
+	//Get capture values
+	int capture = capturing;
+	int width = videoWidth;
+	int height = videoHeight;
 
-	//Get number of pixels
-	DWORD num = videoWidth*videoHeight;
+	//Y desbloqueamos
+	pthread_mutex_unlock(&newPicMutex);
+
+	//Si no estamos capturamos
+	if (!capture)
+		//Nothing to do
+		return;
+
+	//Get a free picture from the pool
+	VideoBuffer* frame = VideoBuffer::Create(width,height);
 
-	// paint the background in black for YUV
-	memset(grabPic		, 0		, num);
-	memset(grabPic+num	, (BYTE) -128	, num/2);
+	//Paint it in black
+	frame->Clear();
 
 	//Ponemos el cambio
-	imgNew = true;
+	Publish(frame);
+}
+
+int VideoPipe::Publish(VideoBuffer* frame)
+{
+	//Swap it with the pending one, if it was not grabbed it is dropped
+	pending.Publish(frame);
 
-	//Se�alizamos
+	//Protegemos
+	pthread_mutex_lock(&newPicMutex);
+
+	//Señalamos
 	pthread_cond_signal(&newPicCond);
 
 	//Y desbloqueamos
 	pthread_mutex_unlock(&newPicMutex);
-}
\ No newline at end of file
+
+	return 1;
+}
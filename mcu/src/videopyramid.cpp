@@ -0,0 +1,296 @@
+/*
+ * File:   videopyramid.cpp
+ * Author: Sergio
+ *
+ * Created on 22 de octubre de 2026, 16:50
+ */
+
+#include <string.h>
+#include "log.h"
+#include "videopyramid.h"
+
+VideoPyramid::VideoPyramid()
+{
+	//No input yet
+	inputWidth = 0;
+	inputHeight = 0;
+	//No stats
+	memset(&stats,0,sizeof(stats));
+	//Create mutex
+	pthread_mutex_init(&mutex,NULL);
+}
+
+VideoPyramid::~VideoPyramid()
+{
+	//Delete all levels
+	for (Levels::iterator it=levels.begin();it!=levels.end();++it)
+	{
+		delete(it->pipe);
+		delete(it->scaler);
+	}
+	//Destroy mutex
+	pthread_mutex_destroy(&mutex);
+}
+
+int VideoPyramid::Init(DWORD num)
+{
+	Log("-VideoPyramid::Init() [levels:%d]\n",num);
+
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Remove the ones not needed anymore
+	while (levels.size()>num)
+	{
+		//Delete last one
+		delete(levels.back().pipe);
+		delete(levels.back().scaler);
+		levels.pop_back();
+	}
+
+	//Create new ones
+	while (levels.size()<num)
+	{
+		Level level;
+		//Create pipe and its scaler
+		level.pipe = new VideoPipe();
+		level.scaler = new FrameScaler();
+		//Init pipe
+		level.pipe->Init();
+		//Add it
+		levels.push_back(level);
+	}
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	return 1;
+}
+
+int VideoPyramid::End()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//End all pipes, so anyone waiting for a picture is released
+	for (Levels::iterator it=levels.begin();it!=levels.end();++it)
+		it->pipe->End();
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	Log("-VideoPyramid::End() [frames:%llu,scaled:%llu,fromLevel:%llu,shared:%llu]\n",stats.frames,stats.scaled,stats.fromLevel,stats.shared);
+
+	return 1;
+}
+
+DWORD VideoPyramid::GetNumLevels()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Get number
+	DWORD num = levels.size();
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	return num;
+}
+
+VideoPipe* VideoPyramid::GetLevel(DWORD num)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Get it
+	VideoPipe* pipe = num<levels.size() ? levels[num].pipe : NULL;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	return pipe;
+}
+
+VideoPyramid::Stats VideoPyramid::GetStats()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Copy
+	Stats copy = stats;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	return copy;
+}
+
+int VideoPyramid::SetVideoSize(int width,int height)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+	//Store input size
+	inputWidth = width;
+	inputHeight = height;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	return 1;
+}
+
+int VideoPyramid::NextFrame(BYTE *pic)
+{
+	//Packed picture of the input size
+	return NextPicture(NULL,pic);
+}
+
+int VideoPyramid::NextFrame(VideoBuffer* frame)
+{
+	//Scale from the decoded planes
+	return NextPicture(frame,NULL);
+}
+
+int VideoPyramid::NextPicture(VideoBuffer* input,BYTE* pic)
+{
+	//Lock, so levels are not changed meanwhile
+	pthread_mutex_lock(&mutex);
+
+	//Get input planes
+	DWORD inputPixels = inputWidth*inputHeight;
+	BYTE* inputY = input ? input->GetPlane(0) : pic;
+	BYTE* inputU = input ? input->GetPlane(1) : pic+inputPixels;
+	BYTE* inputV = input ? input->GetPlane(2) : pic+inputPixels*5/4;
+	DWORD inputStride = input ? input->GetStride() : inputWidth;
+	int srcInputWidth = input ? input->GetWidth() : inputWidth;
+	int srcInputHeight = input ? input->GetHeight() : inputHeight;
+
+	//Get number of levels
+	DWORD num = levels.size();
+
+	//Capture size of each level, 0 if not capturing
+	std::vector<int> widths(num,0);
+	std::vector<int> heights(num,0);
+	//Picture done for each level
+	std::vector<VideoBuffer*> done(num,(VideoBuffer*)NULL);
+
+	//Get capture sizes
+	for (DWORD i=0;i<num;++i)
+		//If not capturing
+		if (!levels[i].pipe->GetCaptureSize(widths[i],heights[i]))
+			//Skip it
+			widths[i] = heights[i] = 0;
+
+	//One more
+	stats.frames++;
+
+	//Do biggest levels first
+	for (DWORD n=0;n<num;++n)
+	{
+		int next = -1;
+
+		//Find biggest one not done yet
+		for (DWORD i=0;i<num;++i)
+			//If capturing, not done and bigger
+			if (widths[i] && !done[i] && (next==-1 || widths[i]*heights[i]>widths[next]*heights[next]))
+				//This one
+				next = i;
+
+		//If nothing more to do
+		if (next==-1)
+			//Done
+			break;
+
+		int width = widths[next];
+		int height = heights[next];
+
+		//Scale from input by default
+		BYTE* srcY = inputY;
+		BYTE* srcU = inputU;
+		BYTE* srcV = inputV;
+		DWORD srcStride = inputStride;
+		int srcWidth = srcInputWidth;
+		int srcHeight = srcInputHeight;
+		VideoBuffer* parent = NULL;
+
+		//Find smallest level done that is at least as big and has the same aspect
+		for (DWORD i=0;i<num;++i)
+		{
+			//Get it
+			VideoBuffer* level = done[i];
+			//Check
+			if (!level || (int)level->GetWidth()<width || (int)level->GetHeight()<height || level->GetWidth()*height!=level->GetHeight()*width)
+				//Not valid
+				continue;
+			//If it is smaller than current one
+			if (!parent || level->GetWidth()<parent->GetWidth())
+				//Use it
+				parent = level;
+		}
+
+		VideoBuffer* frame = NULL;
+
+		//If we have one with the same size
+		if (parent && (int)parent->GetWidth()==width && (int)parent->GetHeight()==height)
+		{
+			//Share it
+			frame = parent;
+			frame->AddRef();
+			//Shared
+			stats.shared++;
+		} else if (!parent && input && input->IsPacked() && srcInputWidth==width && srcInputHeight==height) {
+			//Share the decoded picture
+			frame = input;
+			frame->AddRef();
+			//Shared
+			stats.shared++;
+		} else {
+			//If got a bigger level
+			if (parent)
+			{
+				//Scale from it
+				srcY = parent->GetPlane(0);
+				srcU = parent->GetPlane(1);
+				srcV = parent->GetPlane(2);
+				srcStride = parent->GetStride();
+				srcWidth = parent->GetWidth();
+				srcHeight = parent->GetHeight();
+				//From level
+				stats.fromLevel++;
+			} else {
+				//From input
+				stats.scaled++;
+			}
+			//Get a free picture from the pool
+			frame = VideoBuffer::Create(width,height);
+			//Scale it
+			levels[next].scaler->Resize(srcY,srcU,srcV,srcStride,srcWidth,srcHeight,frame->GetData(),width,height,true);
+		}
+
+		//Keep a reference for the smaller ones
+		frame->AddRef();
+		done[next] = frame;
+
+		//Publish it, reference goes to the pipe
+		levels[next].pipe->NextScaledFrame(frame);
+	}
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//Release our references
+	for (DWORD i=0;i<num;++i)
+		//If done
+		if (done[i])
+			//Release it
+			done[i]->Release();
+
+	return 1;
+}
+
+void VideoPyramid::ClearFrame()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Clear all levels
+	for (Levels::iterator it=levels.begin();it!=levels.end();++it)
+		it->pipe->ClearFrame();
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+}
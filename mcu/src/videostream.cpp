@@ -26,9 +26,11 @@ VideoStream::VideoStream(Listener* listener) : rtp(MediaFrame::Video,listener)
 {
 	//Inicializamos a cero todo
 	sendingVideo=0;
+	sendingShared=false;
 	receivingVideo=0;
 	videoInput=NULL;
 	videoOutput=NULL;
+	sharedEncoder=NULL;
 	videoCodec=VideoCodec::H263_1996;
 	videoCaptureMode=0;
 	videoGrabWidth=0;
@@ -99,6 +101,10 @@ int VideoStream::SetVideoCodec(VideoCodec::Type codec,int mode,int fps,int bitra
 
 int VideoStream::SetTemporalBitrateLimit(int estimation)
 {
+	//If using the shared encoder
+	if (sendingShared)
+		//Pick the tier for it
+		return sharedEncoder->SetTargetBitrate(estimation/1000);
 	//Set bitrate limit
 	videoBitrateLimit = estimation/1000;
 	//Set limit of bitrate to 1 second;
@@ -113,6 +119,12 @@ void VideoStream::SetRemoteRateEstimator(RemoteRateEstimator* estimator)
 	rtp.SetRemoteRateEstimator(estimator);
 }
 
+void VideoStream::SetSharedEncoder(SharedVideoEncoder* encoder)
+{
+	//Store it, used if enabled on codec properties
+	sharedEncoder = encoder;
+}
+
 /***************************************
 * Init
 *	Inicializa los devices 
@@ -241,8 +253,15 @@ int VideoStream::StartSending(char *sendVideoIp,int sendVideoPort,RTPMap& rtpMap
 	//Estamos mandando
 	sendingVideo=1;
 
-	//Arrancamos los procesos
-	createPriorityThread(&sendVideoThread,startSendingVideo,this,0);
+	//If we can get the frames from the encoder shared with the rest of the mosaic participants
+	if (sharedEncoder && videoProperties.GetProperty("encoder.shared",false))
+		//Join its group
+		sendingShared = sharedEncoder->Join(this,videoCodec,videoGrabWidth,videoGrabHeight,videoFPS,videoBitrate,videoIntraPeriod,videoProperties);
+
+	//If not shared
+	if (!sendingShared)
+		//Arrancamos los procesos
+		createPriorityThread(&sendVideoThread,startSendingVideo,this,0);
 
 	//LOgeamos
 	Log("<StartSending video [%d]\n",sendingVideo);
@@ -313,6 +332,16 @@ int VideoStream::StopSending()
 {
 	Log(">StopSending [%d]\n",sendingVideo);
 
+	//If using the shared encoder
+	if (sendingShared)
+	{
+		//Stop getting frames
+		sharedEncoder->Leave();
+		//Not sending
+		sendingShared = false;
+		sendingVideo = 0;
+	}
+
 	//Esperamos a que se cierren las threads de envio
 	if (sendingVideo)
 	{
@@ -375,9 +404,13 @@ int VideoStream::SendVideo()
 	
 	DWORD num = 0;
 	QWORD overslept = 0;
+	QWORD lastOrigin = 0;
 
 	Acumulator bitrateAcu(1000);
 	Acumulator fpsAcu(1000);
+
+	//Start measuring cpu of this thread
+	latency.StartCPU(LatencyStats::Sending);
 	
 	Log(">SendVideo [width:%d,size:%d,bitrate:%d,fps:%d,intra:%d]\n",videoGrabWidth,videoGrabHeight,videoBitrate,videoFPS,videoIntraPeriod);
 
@@ -432,6 +465,20 @@ int VideoStream::SendVideo()
 			//Exit
 			continue;
 
+		//Get when the newest frame on it was received
+		QWORD origin = videoInput->GetFrameTime();
+
+		//Measure each new content only once, not when the same picture is encoded again
+		if (origin==lastOrigin)
+			//Unknown
+			origin = 0;
+		else
+			//Store it
+			lastOrigin = origin;
+
+		//Time since received until the encoder got it
+		latency.RecordSince(LatencyStats::Grabbed,origin);
+
 		//Check if we need to send intra
 		if (sendFPU)
 		{
@@ -484,14 +531,23 @@ int VideoStream::SendVideo()
 			current = target;
 		}
 		
+		//Get encoding start
+		QWORD ini = getTime();
+
 		//Procesamos el frame
 		VideoFrame *videoFrame = videoEncoder->EncodeFrame(pic,videoInput->GetBufferSize());
 
+		//Time spent encoding
+		latency.Record(LatencyStats::Encode,getTime()-ini);
+
 		//If was failed
 		if (!videoFrame)
 			//Next
 			continue;
 
+		//Time since received until encoded
+		latency.RecordSince(LatencyStats::Encoded,origin);
+
 		//Increase frame counter
 		fpsAcu.Update(getTime()/1000,1);
 		
@@ -570,9 +626,19 @@ int VideoStream::SendVideo()
 			//Clean rtp rtx buffer
 			rtp.FlushRTXPackets();
 
+		//Get packetization start
+		ini = getTime();
+
 		//Send it smoothly
 		smoother.SendFrame(videoFrame,sendingTime);
 
+		//Time spent packetizing
+		latency.Record(LatencyStats::Packetize,getTime()-ini);
+		//Time since received until queued for sending, after waiting for the frame time
+		latency.RecordSince(LatencyStats::Sent,origin);
+		//Update cpu used
+		latency.UpdateCPU(LatencyStats::Sending);
+
 		//Dump statistics
 		if (num && ((num%videoFPS*10)==0))
 		{
@@ -613,8 +679,14 @@ int VideoStream::RecVideo()
 	DWORD		frameTime = (DWORD)-1;
 	DWORD		lastSeq = RTPPacket::MaxExtSeqNum;
 	bool		waitIntra = false;
+	QWORD		origin = 0;
+	QWORD		decoding = 0;
+	QWORD		ini;
 	
 	Log(">RecVideo\n");
+
+	//Start measuring cpu of this thread
+	latency.StartCPU(LatencyStats::Receiving);
 	
 	//Get now
 	gettimeofday(&before,NULL);
@@ -633,6 +705,12 @@ int VideoStream::RecVideo()
 			//Next
 			continue;
 
+		//Get reception time in us, all packets from the jitter buffer are timed
+		QWORD received = ((RTPTimedPacket*)packet)->GetTime()*1000;
+
+		//Time waiting on the jitter buffer
+		latency.RecordSince(LatencyStats::Jitter,received);
+
 		//Get extended sequence number and timestamp
 		DWORD seq = packet->GetExtSeqNum();
 		DWORD ts = packet->GetTimestamp();
@@ -725,12 +803,16 @@ int VideoStream::RecVideo()
 		if (ts>frameTime)
 		{
 			Debug("-lost mark packet ts:%u frameTime:%u\n",ts,frameTime);
+			//Get decoding start
+			ini = getTime();
 			//Try to decode what is in the buffer
 			videoDecoder->DecodePacket(NULL,0,1,1);
-			//Get picture
-			BYTE *frame = videoDecoder->GetFrame();
+			//Get picture, as decoded
+			VideoBuffer *frame = videoDecoder->GetBuffer();
 			DWORD width = videoDecoder->GetWidth();
 			DWORD height = videoDecoder->GetHeight();
+			//Time spent decoding the frame
+			latency.Record(LatencyStats::Decode,decoding+getTime()-ini);
 			//Check values
 			if (frame && width && height)
 			{
@@ -739,16 +821,42 @@ int VideoStream::RecVideo()
 
 				//Check if muted
 				if (!muted)
+				{
+					//Keep origin time along with it
+					frame->SetTime(origin);
 					//Send it
 					videoOutput->NextFrame(frame);
+					//Time since received until handed to the mixer
+					latency.RecordSince(LatencyStats::Decoded,origin);
+				}
 			}
+			//Release it
+			if (frame)
+				frame->Release();
+			//Next frame
+			origin = 0;
+			decoding = 0;
 		}
+
+		//If it is the first packet of the frame
+		if (!origin)
+			//Frame is received since then
+			origin = received;
 		
 		//Update frame time
 		frameTime = ts;
 		
+		//Get decoding start
+		ini = getTime();
+
 		//Decode packet
-		if(!videoDecoder->DecodePacket(buffer,size,lost,packet->GetMark()))
+		int decoded = videoDecoder->DecodePacket(buffer,size,lost,packet->GetMark());
+
+		//Time spent depacketizing and decoding
+		decoding += getTime()-ini;
+
+		//Check result
+		if(!decoded)
 		{
 			//Check if we got listener and more than 1/2 seconds have elapsed from last request
 			if (listener && getDifTime(&lastFPURequest)>500000)
@@ -777,10 +885,12 @@ int VideoStream::RecVideo()
 			//No frame time yet for next frame
 			frameTime = (DWORD)-1;
 
-			//Get picture
-			BYTE *frame = videoDecoder->GetFrame();
+			//Get picture, as decoded
+			VideoBuffer *frame = videoDecoder->GetBuffer();
 			DWORD width = videoDecoder->GetWidth();
 			DWORD height = videoDecoder->GetHeight();
+			//Time spent decoding the frame
+			latency.Record(LatencyStats::Decode,decoding);
 			//Check values
 			if (frame && width && height)
 			{
@@ -789,9 +899,23 @@ int VideoStream::RecVideo()
 				
 				//Check if muted
 				if (!muted)
+				{
+					//Keep origin time along with it
+					frame->SetTime(origin);
 					//Send it
 					videoOutput->NextFrame(frame);
+					//Time since received until handed to the mixer
+					latency.RecordSince(LatencyStats::Decoded,origin);
+				}
 			}
+			//Release it
+			if (frame)
+				frame->Release();
+			//Next frame
+			origin = 0;
+			decoding = 0;
+			//Update cpu used
+			latency.UpdateCPU(LatencyStats::Receiving);
 			//Check if we got the waiting refresh
 			if (waitIntra && videoDecoder->IsKeyFrame())
 				//Do not wait anymore
@@ -815,12 +939,39 @@ int VideoStream::SetMediaListener(MediaFrame::Listener *listener)
 
 int VideoStream::SendFPU()
 {
+	//If using the shared encoder
+	if (sendingShared)
+		//Request it to the group
+		return sharedEncoder->SendFPU();
+
 	//Next shall be an intra
 	sendFPU = true;
 	
 	return 1;
 }
 
+void VideoStream::onEncodedFrame(VideoEncoderGroup* group,VideoFrame* frame,DWORD sendingTime)
+{
+	//If it was a I frame
+	if (frame->IsIntra())
+		//Clean rtp rtx buffer
+		rtp.FlushRTXPackets();
+
+	//Check if we have mediaListener
+	if (mediaListener)
+		//Call it
+		mediaListener->onMediaFrame(*frame);
+
+	//Get packetization start
+	QWORD ini = getTime();
+
+	//Send it smoothly on our session
+	smoother.SendFrame(frame,sendingTime);
+
+	//Time spent packetizing
+	latency.Record(LatencyStats::Packetize,getTime()-ini);
+}
+
 MediaStatistics VideoStream::GetStatistics()
 {
 	MediaStatistics stats;
@@ -833,6 +984,18 @@ MediaStatistics VideoStream::GetStatistics()
 	stats.numSendPackets	= rtp.GetNumSendPackets();
 	stats.totalRecvBytes	= rtp.GetTotalRecvBytes();
 	stats.totalSendBytes	= rtp.GetTotalSendBytes();
+	//Fill batching stats
+	const RTPSession::BatchStats& batch = rtp.GetBatchStats();
+	stats.recvBatches	= batch.recvBatches;
+	stats.recvBatchedPackets= batch.recvBatchedPackets;
+	stats.maxRecvBatch	= batch.maxRecvBatch;
+	stats.sendBatches	= batch.sendBatches;
+	stats.sendBatchedPackets= batch.sendBatchedPackets;
+	stats.maxSendBatch	= batch.maxSendBatch;
+	//Fill packet pool stats
+	RTPPacketPool::Stats pool = RTPPacketPool::GetStats(MediaFrame::Video);
+	stats.poolHitRate	= pool.allocs ? pool.hits*100/pool.allocs : 0;
+	stats.poolResidentBytes	= pool.resident*pool.blockSize;
 
 	//Return it
 	return stats;
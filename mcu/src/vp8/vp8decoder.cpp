@@ -28,8 +28,7 @@ VP8Decoder::VP8Decoder()
 	//Alocamos el buffer
 	bufSize = 1024*756*3/2;
 	buffer = (BYTE *)malloc(bufSize);
-	frame = NULL;
-	frameSize = 0;
+	current = NULL;
 	src = 0;
 	width = 0;
 	height = 0;
@@ -77,8 +76,8 @@ VP8Decoder::~VP8Decoder()
 	vpx_codec_destroy(&decoder);
 	if (buffer)
 		free(buffer);
-	if (frame)
-		free(frame);
+	if (current)
+		current->Release();
 }
 
 /***********************
@@ -221,34 +220,30 @@ int VP8Decoder::DecodePacket(BYTE *in,DWORD inLen,int lost,int last)
 			//Do nothing
 			return Error("-No image\n");
 		
+		//Check size
+		if (width!=img->d_w || height!=img->d_h)
+			Log("-Frame size %dx%d\n",img->d_w,img->d_h);
+
 		//Get dimensions
 		width = img->d_w;
 		height = img->d_h;
-		int u = width*height;
-		int v = width*height*5/4;
-		int size = width*height*3/2;
 
-		//Check size
-		if (size>frameSize)
-		{
-			Log("-Frame size %dx%d\n",width,height);
-			//Liberamos si habia
-			if(frame!=NULL)
-				free(frame);
-			//Y allocamos de nuevo
-			frame = (BYTE*) malloc(size);
-			frameSize = size;
-		}
+		//Release previous picture
+		if (current)
+			current->Release();
+
+		//Get one from the pool, libvpx reuses its pictures and has no external buffers for vp8, so copy it once here
+		current = VideoBuffer::Create(width,height);
 
 		//Copaamos  el Cy
 		for(int i=0;i<height;i++)
-			memcpy(&frame[i*width],&img->planes[0][i*img->stride[0]],width);
+			memcpy(current->GetPlane(0)+i*width,&img->planes[0][i*img->stride[0]],width);
 
 		//Y el Cr y Cb
 		for(int i=0;i<height/2;i++)
 		{
-			memcpy(&frame[i*width/2+u],&img->planes[1][i*img->stride[1]],width/2);
-			memcpy(&frame[i*width/2+v],&img->planes[2][i*img->stride[2]],width/2);
+			memcpy(current->GetPlane(1)+i*width/2,&img->planes[1][i*img->stride[1]],width/2);
+			memcpy(current->GetPlane(2)+i*width/2,&img->planes[2][i*img->stride[2]],width/2);
 		}
 	}
 
@@ -265,3 +260,14 @@ bool VP8Decoder::IsKeyFrame()
 {
 	return isKeyFrame;
 }
+
+VideoBuffer* VP8Decoder::GetBuffer()
+{
+	//Check we have a picture
+	if (!current)
+		return NULL;
+	//One reference more for the caller
+	current->AddRef();
+	//Return it
+	return current;
+}
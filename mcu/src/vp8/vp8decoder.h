@@ -22,15 +22,15 @@ public:
 	virtual int Decode(BYTE *in,DWORD len);
 	virtual int GetWidth()	{return width;};
 	virtual int GetHeight()	{return height;};
-	virtual BYTE* GetFrame(){return (BYTE *)frame;};
+	virtual BYTE* GetFrame(){return current ? current->GetData() : NULL;};
+	virtual VideoBuffer* GetBuffer();
 	virtual bool  IsKeyFrame();
 private:
 	vpx_codec_ctx_t  decoder;
 	BYTE*		buffer;
 	DWORD		bufLen;
 	DWORD 		bufSize;
-	BYTE*		frame;
-	DWORD		frameSize;
+	VideoBuffer*	current;
 	BYTE		src;
 	DWORD		width;
 	DWORD		height;
@@ -10,6 +10,8 @@
 #include "log.h"
 #include "vp8encoder.h"
 #include "vp8.h"
+#include "encoderthreads.h"
+#include "tools.h"
 
 
 #define interface (vpx_codec_vp8_cx())
@@ -33,6 +35,12 @@ VP8Encoder::VP8Encoder(const Properties& properties)
 	pts	= 0;
 	num	= 0;
 	pic	= NULL;
+	segments = NULL;
+	numSegments = 0;
+	//Check if encoding screen content, segments are used for the region of interest
+	screen = properties.GetProperty("screen",false);
+	//Not failed yet
+	roiFailed = false;
 	//not force
 	forceKeyFrame = false;
 	
@@ -43,6 +51,16 @@ VP8Encoder::VP8Encoder(const Properties& properties)
 	bitrate = 0;
 	fps = 0;
 	intraPeriod = 0;
+
+	//Fixed number of threads, 0 for automatic depending on size and core budget
+	wantedThreads = properties.GetProperty("vp8.threads",0);
+	//Not got yet
+	threads = 0;
+
+	//No frames encoded
+	frames = 0;
+	encodeTime = 0;
+	maxEncodeTime = 0;
 }
 
 VP8Encoder::~VP8Encoder()
@@ -52,6 +70,15 @@ VP8Encoder::~VP8Encoder()
 		vpx_img_free(pic);
 	if (frame)
 		delete frame;
+	if (segments)
+		free(segments);
+	//If we had threads
+	if (threads)
+	{
+		Log("-~VP8Encoder [%dx%d,threads:%d,frames:%llu,avg:%llums,max:%llums]\n",width,height,threads,frames,frames ? encodeTime/frames/1000 : 0,maxEncodeTime/1000);
+		//Give them back
+		EncoderThreads::getInstance().Release(threads);
+	}
 }
 
 /**********************
@@ -136,7 +163,9 @@ int VP8Encoder::OpenCodec()
 	config.rc_target_bitrate = bitrate;
 	config.g_timebase.num = 1;
 	config.g_timebase.den = 1000;
-	config.g_error_resilient = VPX_ERROR_RESILIENT_PARTITIONS;  /**< The frame partitions are
+	//On screen content the cyclic background refresh enabled by error resilience owns the segmentation map,
+	//	so it has to be disabled for the region of interest map to be accepted and kept
+	config.g_error_resilient = screen ? 0 : VPX_ERROR_RESILIENT_PARTITIONS;  /**< The frame partitions are
 									 independently decodable by the
 									 bool decoder, meaning that
 									 partitions can be decoded even
@@ -145,7 +174,9 @@ int VP8Encoder::OpenCodec()
 									 predicition is still done over
 									 the partition boundary. */
 	config.g_lag_in_frames = 0; // 0- no frame lagging
-	config.g_threads = 1;
+	//Get threads from the core budget
+	threads = EncoderThreads::getInstance().Acquire(width,height,wantedThreads);
+	config.g_threads = threads;
 	// rate control settings
 	config.rc_dropframe_thresh = 0;
 	config.rc_end_usage = VPX_CBR;
@@ -196,15 +227,27 @@ int VP8Encoder::OpenCodec()
 	
 	//Check result
 	if (vpx_codec_enc_init(&encoder, interface, &config, VPX_CODEC_USE_OUTPUT_PARTITION)!=VPX_CODEC_OK)
+	{
+		//Give threads back
+		EncoderThreads::getInstance().Release(threads);
+		threads = 0;
 		//Error
 		return Error("WEBRTC_VIDEO_CODEC_UNINITIALIZED [error %d:%s]\n",encoder.err,encoder.err_detail);
+	}
 
 	//The static threshold imposes a change threshold on blocks below which they will be skipped by the encoder.
 	vpx_codec_control(&encoder, VP8E_SET_STATIC_THRESHOLD, 100);
 	//Set cpu usage, a bit lower than normal (-6) but higher than android (-12)
 	vpx_codec_control(&encoder, VP8E_SET_CPUUSED, -8);
-	//Only one partition
-	vpx_codec_control(&encoder, VP8E_SET_TOKEN_PARTITIONS,VP8_ONE_TOKENPARTITION);
+	//One token partition per thread, so they can be packed in parallel
+	if (threads>=8)
+		vpx_codec_control(&encoder, VP8E_SET_TOKEN_PARTITIONS,VP8_EIGHT_TOKENPARTITION);
+	else if (threads>=4)
+		vpx_codec_control(&encoder, VP8E_SET_TOKEN_PARTITIONS,VP8_FOUR_TOKENPARTITION);
+	else if (threads>=2)
+		vpx_codec_control(&encoder, VP8E_SET_TOKEN_PARTITIONS,VP8_TWO_TOKENPARTITION);
+	else
+		vpx_codec_control(&encoder, VP8E_SET_TOKEN_PARTITIONS,VP8_ONE_TOKENPARTITION);
 	//Enable noise reduction
 	vpx_codec_control(&encoder, VP8E_SET_NOISE_SENSITIVITY,0);
 	//Set max data rate for Intra frames.
@@ -227,6 +270,69 @@ int VP8Encoder::FastPictureUpdate()
 	 forceKeyFrame = true;
 }
 
+int VP8Encoder::SetRegionOfInterest(const BYTE* map,DWORD cols,DWORD rows,int changedQP,int staticQP)
+{
+	vpx_roi_map_t roi;
+
+	//Check
+	if (!opened || roiFailed)
+		return 0;
+
+	//Check it matches the encoding size
+	if (cols!=(width+15)/16 || rows!=(height+15)/16)
+		return Error("-SetRegionOfInterest wrong size [%dx%d]\n",cols,rows);
+
+	//Check if we need to allocate the segment map
+	if (numSegments!=cols*rows)
+	{
+		//Free previous
+		if (segments)
+			free(segments);
+		//Allocate new one
+		segments = (BYTE*)malloc(cols*rows);
+		numSegments = cols*rows;
+	}
+
+	//Segment 1 for changed macroblocks, 0 for static ones
+	for (DWORD i=0;i<numSegments;++i)
+		segments[i] = map[i] ? 1 : 0;
+
+	//Set map, it is copied by the encoder and used until changed
+	memset(&roi,0,sizeof(roi));
+	roi.roi_map = segments;
+	roi.cols = cols;
+	roi.rows = rows;
+	//Quantizer deltas for each segment, converted from x264 QP offsets
+	roi.delta_q[0] = GetSegmentDelta(staticQP);
+	roi.delta_q[1] = GetSegmentDelta(changedQP);
+	//Let the encoder skip static blocks, changed ones are always coded
+	roi.static_threshold[0] = 1000;
+	roi.static_threshold[1] = 0;
+
+	//Set it
+	if (vpx_codec_control(&encoder, VP8E_SET_ROI_MAP, &roi)!=VPX_CODEC_OK)
+	{
+		//Don't try again on each frame
+		roiFailed = true;
+		//Error
+		return Error("-SetRegionOfInterest error, disabling it [error %d:%s]\n",encoder.err,encoder.err_detail);
+	}
+
+	return 1;
+}
+
+int VP8Encoder::GetSegmentDelta(int qp)
+{
+	//x264 QP goes from 0 to 51 while segment deltas are applied on the internal VP8 quantizer index, from 0 to 127
+	int delta = qp>=0 ? (qp*127+25)/51 : -((-qp*127+25)/51);
+	//Clamp to the range accepted by the roi map, bigger deltas make it fail
+	if (delta>63)
+		return 63;
+	if (delta<-63)
+		return -63;
+	return delta;
+}
+
 VideoFrame* VP8Encoder::EncodeFrame(BYTE *buffer,DWORD bufferSize)
 {
 	if(!opened)
@@ -260,7 +366,23 @@ VideoFrame* VP8Encoder::EncodeFrame(BYTE *buffer,DWORD bufferSize)
 		
 	uint32_t duration = 1000 / fps;
 
-	if (vpx_codec_encode(&encoder, pic, pts, duration, flags, VPX_DL_REALTIME)!=VPX_CODEC_OK)
+	//Get encoding start time
+	QWORD ini = getTime();
+
+	//Encode it
+	vpx_codec_err_t err = vpx_codec_encode(&encoder, pic, pts, duration, flags, VPX_DL_REALTIME);
+
+	//Get encoding time
+	QWORD time = getTime()-ini;
+	//Update stats
+	frames++;
+	encodeTime += time;
+	if (time>maxEncodeTime)
+		maxEncodeTime = time;
+	EncoderThreads::getInstance().OnEncoded(time);
+
+	//Check result
+	if (err!=VPX_CODEC_OK)
 	{
 		//Error
 		Error("WEBRTC_VIDEO_CODEC_ERROR [error %d:%s]\n",encoder.err,encoder.err_detail);
@@ -21,13 +21,19 @@ public:
 	virtual int FastPictureUpdate();
 	virtual int SetSize(int width,int height);
 	virtual int SetFrameRate(int fps,int kbits,int intraPeriod);
+	virtual int SetRegionOfInterest(const BYTE* map,DWORD cols,DWORD rows,int changedQP,int staticQP);
 private:
 	int OpenCodec();
+	static int GetSegmentDelta(int qp);
 private:
 	vpx_codec_ctx_t		encoder;
 	vpx_codec_enc_cfg_t	config;
 	vpx_image_t*		pic;
 	VideoFrame*		frame;
+	BYTE*			segments;
+	DWORD			numSegments;
+	bool			screen;
+	bool			roiFailed;
 	bool forceKeyFrame;
 	int width;
 	int height;
@@ -39,6 +45,11 @@ private:
 	int intraPeriod;
 	int pts;
 	int num;
+	int wantedThreads;
+	DWORD threads;
+	QWORD frames;
+	QWORD encodeTime;
+	QWORD maxEncodeTime;
 };
 
 #endif	/* VP8ENCODER_H */
@@ -28,8 +28,13 @@ WebSocketConnection::WebSocketConnection(Listener *listener)
 	//Not inited
 	inited = false;
 	running = false;
+	reactor = false;
 	socket = FD_INVALID;
 	setZeroThread(&thread);
+	//Nothing being written
+	outUpgrade = false;
+	outFrame = NULL;
+	outPos = 0;
 	//No pong
 	pong = NULL;
 	//Not uypgraded yet
@@ -57,6 +62,12 @@ WebSocketConnection::~WebSocketConnection()
 {
 	//End just in case
 	End();
+	//If it was polled by the reactor
+	if (reactor)
+		//Wait until no handler is running for us
+		TCPReactor::getInstance().ReleaseConnection(this);
+	//Check partially written frame
+	if (outFrame) delete(outFrame);
 	//Remove pending frames
 	while (!frames.empty())
 	{
@@ -101,6 +112,37 @@ void WebSocketConnection::Start()
 	//We are running
 	running = true;
 
+	//If using the shared reactor
+	if (TCPReactor::getInstance().IsRunning())
+	{
+		//Not waiting for writes yet
+		ufds[0].fd = socket;
+		ufds[0].events = POLLIN | POLLERR | POLLHUP;
+
+		//Set non blocking, reactor handlers read and write until they would block
+		int fsflags = fcntl(socket,F_GETFL,0);
+		fsflags |= O_NONBLOCK;
+		fcntl(socket,F_SETFL,fsflags);
+
+		//Set no delay option
+		int flag = 1;
+		setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(int));
+
+		//Get first activity time
+		getUpdDifTime(&lastActivity);
+
+		//Set it before adding, as events may be dispatched right away
+		reactor = true;
+
+		//Add it
+		if (TCPReactor::getInstance().AddConnection(this,socket))
+			//Done
+			return;
+
+		//Use own thread instead
+		reactor = false;
+	}
+
 	//Create thread
 	createPriorityThread(&thread,run,this,0);
 }
@@ -116,6 +158,21 @@ void WebSocketConnection::Stop()
 
 	//Not running;
 	running = false;
+
+	//If polled by the reactor
+	if (reactor)
+	{
+		//Lock mutex, socket is closed by the worker
+		pthread_mutex_lock(&mutex);
+		//Will cause the worker to get a hang up and close it
+		if (socket!=FD_INVALID)
+			shutdown(socket,SHUT_RDWR);
+		//Un Lock mutex
+		pthread_mutex_unlock(&mutex);
+		//Done
+		return;
+	}
+
 	//Close socket
 	shutdown(socket,SHUT_RDWR);
 	//Will cause poll to return
@@ -219,11 +276,18 @@ int WebSocketConnection::End()
 	inited = false;
 
 	//Stop just in case
-	Stop();
+	if (running)
+		Stop();
 
-	//If running
-	if (!isZeroThread(thread))
+	//If polled by the reactor
+	if (reactor)
 	{
+		//Stop polling it, if the worker has not closed it already do it now
+		if (TCPReactor::getInstance().RemoveConnection(this))
+			//Close socket and launch events
+			onClosed();
+	//If running
+	} else if (!isZeroThread(thread)) {
 		//Wait for server thread to close
 		pthread_join(thread,NULL);
 		//No thread
@@ -410,6 +474,229 @@ int WebSocketConnection::Run()
 	Log("<Run WebSocket connection [ws:%p]\n", this);
 }
 
+/***************************
+ * onReadable
+ * 	Reactor read event, read until it would block
+ ***************************/
+bool WebSocketConnection::onReadable()
+{
+	BYTE data[MTU] ZEROALIGNEDTO32;
+
+	//While not ended
+	while(running)
+	{
+		//Read data from connection
+		int len = read(socket,data,MTU);
+		//If nothing read
+		if (len<0)
+		{
+			//If no more data available
+			if (errno==EAGAIN || errno==EWOULDBLOCK)
+				//Wait for next event
+				return true;
+			//If interrupted
+			if (errno==EINTR)
+				//Try again
+				continue;
+			//Error
+			Log("Readed [%d,%d]\n",len,errno);
+			//Close
+			return false;
+		}
+		//If closed
+		if (!len)
+		{
+			//Log
+			Log("-WebSocketConnection::onReadable() | connection closed by peer [ws:%p]\n",this);
+			//Close
+			return false;
+		}
+		//Increase in bytes
+		inBytes += len;
+		//Update last received time
+		getUpdDifTime(&lastActivity);
+
+		try {
+			//Parse data
+			ProcessData(data,len);
+		} catch (std::exception &e) {
+			//Show error
+			Error("Exception parsing data: %s\n",e.what());
+			//Dump it
+			Dump(data,len);
+			//Close on any error
+			return false;
+		}
+	}
+
+	//Ended
+	return false;
+}
+
+/***************************
+ * onWritable
+ * 	Reactor write event, write until it would block or nothing is left
+ ***************************/
+bool WebSocketConnection::onWritable()
+{
+	//While not ended
+	while(running)
+	{
+		//If nothing is being written
+		if (outResponse.empty() && !outFrame)
+		{
+			//Check if we have http response
+			if (response)
+			{
+				//Serialize
+				outResponse = response->Serialize();
+				Debug("WS RESPONSE:%s\n",outResponse.c_str());
+				//Check if it is upgrade
+				outUpgrade = response->GetCode()==101;
+				//Delete it
+				delete(response);
+				//Nullify
+				response = NULL;
+			} else {
+				//Get next frame to send
+				outFrame = GetNextFrame();
+				//If nothing left
+				if (!outFrame)
+					//Wait until signaled
+					return true;
+			}
+			//From the begining
+			outPos = 0;
+		}
+
+		//Get what we are writing
+		const BYTE* data = outFrame ? outFrame->GetData() : (const BYTE*)outResponse.data();
+		DWORD size = outFrame ? outFrame->GetSize() : outResponse.length();
+
+		//Send it
+		int len = write(socket,data+outPos,size-outPos);
+		//Check
+		if (len<0)
+		{
+			//If socket buffer is full
+			if (errno==EAGAIN || errno==EWOULDBLOCK)
+				//Wait for next event, rest is kept for then
+				return true;
+			//If interrupted
+			if (errno==EINTR)
+				//Try again
+				continue;
+			//Error
+			Log("-WebSocketConnection::onWritable() | error writing [ws:%p,errno:%d]\n",this,errno);
+			//Close
+			return false;
+		}
+		//Increase out bytes
+		outBytes += len;
+		//Move
+		outPos += len;
+
+		//If not fully written yet
+		if (outPos<size)
+			//Keep on
+			continue;
+
+		//If it was a frame
+		if (outFrame)
+		{
+			//Check if it is a close frame
+			bool close = outFrame->GetOpCode()==WebSocketFrameHeader::Close;
+			//Delete it
+			delete(outFrame);
+			//Done with it
+			outFrame = NULL;
+			//If it was a close one
+			if (close)
+			{
+				//Close web socket now
+				Stop();
+				//Done
+				return false;
+			}
+		} else {
+			//Done with it
+			outResponse.clear();
+			//Check if it is not upgrade
+			if (!outUpgrade)
+			{
+				//End connection
+				End();
+				//Done
+				return false;
+			}
+		}
+	}
+
+	//Ended
+	return false;
+}
+
+/***************************
+ * onTick
+ * 	Reactor timer, check inactivity
+ ***************************/
+void WebSocketConnection::onTick()
+{
+	//Check last read activity
+	if (getDifTime(&lastActivity)/1000>KEEP_ALIVE)
+	{
+		//Debug
+		Debug("-Inactivity timer on ws:%p\n",this);
+		//Update last received time
+		getUpdDifTime(&lastActivity);
+		//Check if it has been already upgraded or not
+		if (upgraded)
+			//Send ping
+			Ping();
+		else
+			//Stop
+			Stop();
+	}
+}
+
+/***************************
+ * onClosed
+ * 	Removed from reactor, close and launch events
+ ***************************/
+void WebSocketConnection::onClosed()
+{
+	Log("-WebSocketConnection::onClosed() [ws:%p]\n",this);
+
+	//Lock mutex
+	pthread_mutex_lock(&mutex);
+	//Not running anymore
+	running = false;
+	//Close socket
+	shutdown(socket,SHUT_RDWR);
+	MCU_CLOSE(socket);
+	//No socket
+	socket = FD_INVALID;
+	//Un Lock mutex
+	pthread_mutex_unlock(&mutex);
+
+	//lock now
+	pthread_mutex_lock(&mutexListener);
+	//If we were opened
+	if (upgraded && wsl)
+		//Send close
+		wsl->onClose(this);
+	//unlock now
+	pthread_mutex_unlock(&mutexListener);
+
+	//If got listener
+	if (listener)
+		//Send end
+		listener->onDisconnected(this);
+
+	//Don't send more events
+	listener = NULL;
+}
+
 void WebSocketConnection::SignalWriteNeeded()
 {
 	//lock now
@@ -430,8 +717,12 @@ void WebSocketConnection::SignalWriteNeeded()
 	//Unlock
 	pthread_mutex_unlock(&mutex);
 
+	//If polled by the reactor
+	if (reactor)
+		//Make the worker write it
+		TCPReactor::getInstance().SignalWrite(this);
 	//Check thred
-	if (!isZeroThread(thread))
+	else if (!isZeroThread(thread))
 		//Signal the pthread this will cause the poll call to exit
 		pthread_kill(thread,SIGIO);
 }
@@ -221,11 +221,19 @@ void WebSocketServer::CreateConnection(int fd)
  **************************/
 void WebSocketServer::CleanZombies()
 {
+	Connections dead;
+
 	//Lock list
 	pthread_mutex_lock(&sessionMutex);
 
+	//Get zombies
+	dead.swap(zombies);
+
+	//Unlock list, deleting may wait for a connection that is disconnecting right now
+	pthread_mutex_unlock(&sessionMutex);
+
 	//Zombie iterator
-	for (Connections::iterator it=zombies.begin();it!=zombies.end();++it)
+	for (Connections::iterator it=dead.begin();it!=dead.end();++it)
 	{
 		//Get connection
 		WebSocketConnection *con = *it;
@@ -233,12 +241,6 @@ void WebSocketServer::CleanZombies()
 		delete con;
 	}
 
-	//Clear zombies
-	zombies.clear();
-
-	//Unlock list
-	pthread_mutex_unlock(&sessionMutex);
-
 }
 
 /***********************
@@ -0,0 +1,259 @@
+/*
+ * File:   workerpool.cpp
+ * Author: Sergio
+ *
+ * Created on 17 de octubre de 2026, 9:20
+ */
+
+#include <unistd.h>
+#include "log.h"
+#include "tools.h"
+#include "workerpool.h"
+
+WorkerPool::WorkerPool()
+{
+	//Not running
+	running = false;
+	//Create objects
+	pthread_mutex_init(&mutex,NULL);
+	pthread_cond_init(&cond,NULL);
+}
+
+WorkerPool::~WorkerPool()
+{
+	//Stop just in case
+	Stop();
+	//Clean object
+	pthread_mutex_destroy(&mutex);
+	pthread_cond_destroy(&cond);
+}
+
+bool WorkerPool::Start(int numWorkers)
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Check if already running
+	if (running)
+	{
+		//Unlock
+		pthread_mutex_unlock(&mutex);
+		//Error
+		return Error("-WorkerPool::Start() | already running\n");
+	}
+
+	//If not set
+	if (numWorkers<=0)
+		//One per core, calling thread will work too
+		numWorkers = sysconf(_SC_NPROCESSORS_ONLN)-1;
+
+	//Check
+	if (numWorkers<=0)
+		//At least one
+		numWorkers = 1;
+
+	Log("-WorkerPool::Start() | [workers:%d]\n",numWorkers);
+
+	//We are running
+	running = true;
+
+	//Create workers
+	for (int i=0;i<numWorkers;++i)
+	{
+		pthread_t thread;
+		//Start thread
+		createPriorityThread(&thread,run,this,0);
+		//Add it
+		threads.push_back(thread);
+	}
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//OK
+	return true;
+}
+
+bool WorkerPool::Stop()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Check if running
+	if (!running)
+	{
+		//Unlock
+		pthread_mutex_unlock(&mutex);
+		//Nothing to do
+		return false;
+	}
+
+	Log(">WorkerPool::Stop()\n");
+
+	//Not running anymore
+	running = false;
+
+	//Wake up all workers
+	pthread_cond_broadcast(&cond);
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//Wait for all of them
+	for (Threads::iterator it=threads.begin();it!=threads.end();++it)
+		//Join
+		pthread_join(*it,NULL);
+
+	//Clean
+	threads.clear();
+
+	Log("<WorkerPool::Stop()\n");
+
+	//OK
+	return true;
+}
+
+void WorkerPool::Run(Task* tasks[],DWORD num)
+{
+	//Check
+	if (!num)
+		//Nothing to do
+		return;
+
+	//If we are not running or there is only one task
+	if (!running || num==1)
+	{
+		//Execute them here
+		for (DWORD i=0;i<num;++i)
+			//Execute
+			tasks[i]->Execute();
+		//Done
+		return;
+	}
+
+	//Create batch, the first one will be run by us
+	Batch batch;
+	batch.pending = num-1;
+	pthread_cond_init(&batch.cond,NULL);
+
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Enqueue the rest
+	for (DWORD i=1;i<num;++i)
+	{
+		Job job;
+		//Set it
+		job.task = tasks[i];
+		job.batch = &batch;
+		//Add it
+		jobs.push_back(job);
+	}
+
+	//Wake up workers
+	pthread_cond_broadcast(&cond);
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//Run first one
+	tasks[0]->Execute();
+
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Until all are done
+	while (batch.pending)
+	{
+		//If there are no more queued jobs
+		if (jobs.empty())
+		{
+			//Wait for the workers to finish ours
+			pthread_cond_wait(&batch.cond,&mutex);
+			//Check again
+			continue;
+		}
+		//Help executing the queued ones
+		Job job = jobs.front();
+		//Remove it
+		jobs.pop_front();
+		//Unlock while executing
+		pthread_mutex_unlock(&mutex);
+		//Execute it
+		job.task->Execute();
+		//Lock again
+		pthread_mutex_lock(&mutex);
+		//Done
+		Done(job.batch);
+	}
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//Clean object
+	pthread_cond_destroy(&batch.cond);
+}
+
+void WorkerPool::Done(Batch* batch)
+{
+	//One less, mutex must be locked
+	if (!--batch->pending)
+		//Signal the caller
+		pthread_cond_signal(&batch->cond);
+}
+
+void* WorkerPool::run(void *par)
+{
+	Log("-WorkerPool::run() | worker thread [%d,0x%x]\n",getpid(),par);
+
+	//Block signals to avoid exiting on SIGUSR1
+	blocksignals();
+
+	//Run
+	((WorkerPool*)par)->Run();
+
+	//Exit
+	return NULL;
+}
+
+int WorkerPool::Run()
+{
+	//Lock
+	pthread_mutex_lock(&mutex);
+
+	//Run until ended, but don't leave anything queued
+	while (running || !jobs.empty())
+	{
+		//If there is nothing to do
+		if (jobs.empty())
+		{
+			//Wait for new jobs
+			pthread_cond_wait(&cond,&mutex);
+			//Check again
+			continue;
+		}
+
+		//Get first job
+		Job job = jobs.front();
+		//Remove it
+		jobs.pop_front();
+
+		//Unlock while executing
+		pthread_mutex_unlock(&mutex);
+
+		//Execute it
+		job.task->Execute();
+
+		//Lock again
+		pthread_mutex_lock(&mutex);
+
+		//Done
+		Done(job.batch);
+	}
+
+	//Unlock
+	pthread_mutex_unlock(&mutex);
+
+	//Exit
+	return 0;
+}
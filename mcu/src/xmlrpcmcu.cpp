@@ -1721,7 +1721,9 @@ xmlrpc_value* GetParticipantStatistics(xmlrpc_env *env, xmlrpc_value *param_arra
 		//Get stats
 		MediaStatistics stats = it->second;
 		//Create array
-		xmlrpc_value* val = xmlrpc_build_value(env,"(siiiiiii)",media.c_str(),stats.isReceiving,stats.isSending,stats.lostRecvPackets,stats.numRecvPackets,stats.numSendPackets,stats.totalRecvBytes,stats.totalSendBytes);
+		xmlrpc_value* val = xmlrpc_build_value(env,"(siiiiiiiiiiiiiii)",media.c_str(),stats.isReceiving,stats.isSending,stats.lostRecvPackets,stats.numRecvPackets,stats.numSendPackets,stats.totalRecvBytes,stats.totalSendBytes,
+			stats.recvBatches,stats.recvBatchedPackets,stats.maxRecvBatch,stats.sendBatches,stats.sendBatchedPackets,stats.maxSendBatch,
+			stats.poolHitRate,stats.poolResidentBytes);
 		//Add it
 		xmlrpc_array_append_item(env,arr,val);
 		//Release
@@ -1734,6 +1736,69 @@ xmlrpc_value* GetParticipantStatistics(xmlrpc_env *env, xmlrpc_value *param_arra
 	return xmlok(env,arr);
 }
 
+xmlrpc_value* GetParticipantLatencyStatistics(xmlrpc_env *env, xmlrpc_value *param_array, void *user_data)
+{
+	MCU *mcu = (MCU *)user_data;
+	MultiConf *conf = NULL;
+
+	 //Parseamos
+	int confId;
+	int partId;
+	xmlrpc_parse_value(env, param_array, "(ii)", &confId, &partId);
+
+	//Comprobamos si ha habido error
+	if(env->fault_occurred)
+		return xmlerror(env,"Fault occurred");
+
+	//Get conference reference
+	if(!mcu->GetConferenceRef(confId,&conf))
+		return xmlerror(env,"Conference does not exist");
+
+	//Get latency since participant started
+	LatencyStats::Snapshot *snapshot = conf->GetParticipantLatencyStatistics(partId);
+
+	//Free conference reference
+	mcu->ReleaseConferenceRef(confId);
+
+	//Salimos
+	if(!snapshot)
+		return xmlerror(env,"Participant not found or without latency statistics");
+
+	//Create array
+	xmlrpc_value* arr = xmlrpc_array_new(env);
+
+	//For each stage
+	for (int i=0;i<LatencyStats::NumStages;++i)
+	{
+		//Get histogram
+		const LatencyHistogram& stage = snapshot->stages[i];
+		//Create array with count, mean and percentiles in us
+		xmlrpc_value* val = xmlrpc_build_value(env,"(siiiiii)",LatencyStats::GetNameFor((LatencyStats::Stage)i),(int)stage.GetCount(),(int)stage.GetMean(),
+			(int)stage.GetPercentile(50),(int)stage.GetPercentile(90),(int)stage.GetPercentile(99),(int)stage.GetMax());
+		//Add it
+		xmlrpc_array_append_item(env,arr,val);
+		//Release
+		xmlrpc_DECREF(val);
+	}
+
+	//For each thread
+	for (int i=0;i<LatencyStats::NumThreads;++i)
+	{
+		//Create array with cpu time in ms
+		xmlrpc_value* val = xmlrpc_build_value(env,"(si)",LatencyStats::GetNameFor((LatencyStats::Thread)i),(int)(snapshot->cpu[i]/1000));
+		//Add it
+		xmlrpc_array_append_item(env,arr,val);
+		//Release
+		xmlrpc_DECREF(val);
+	}
+
+	//Free stats
+	delete(snapshot);
+
+	//return
+	return xmlok(env,arr);
+}
+
 xmlrpc_value* GetMosaicPositions(xmlrpc_env *env, xmlrpc_value *param_array, void *user_data)
 {
 	MCU *mcu = (MCU *)user_data;
@@ -2312,6 +2377,7 @@ XmlHandlerCmd mcuCmdList[] =
 	{"SetChair",SetChair},
 	{"SetAppMixerViewer",SetAppMixerViewer},
 	{"GetParticipantStatistics",GetParticipantStatistics},
+	{"GetParticipantLatencyStatistics",GetParticipantLatencyStatistics},
 	{"AddParticipantInputToken",AddParticipantInputToken},
 	{"AddParticipantOutputToken",AddParticipantOutputToken},
 	{"SetParticipantMosaic",SetParticipantMosaic},
@@ -0,0 +1,101 @@
+#include "test.h"
+#include "encoderthreads.h"
+
+class EncoderThreadsTestPlan: public TestPlan
+{
+public:
+	EncoderThreadsTestPlan() : TestPlan("Encoder threads test plan")
+	{
+
+	}
+
+	int policy()
+	{
+		int ok = true;
+
+		//Small ones use only one
+		if (EncoderThreads::GetWanted(320,240)!=1 || EncoderThreads::GetWanted(640,480)!=1)
+			ok = Error("-EncoderThreadsTestPlan::policy() | small encoder with several threads\n");
+		//Bigger ones get more
+		if (EncoderThreads::GetWanted(1280,720)!=2 || EncoderThreads::GetWanted(1920,1080)!=4 || EncoderThreads::GetWanted(3840,2160)!=8)
+			ok = Error("-EncoderThreadsTestPlan::policy() | wrong threads for big encoder\n");
+
+		Log("-EncoderThreadsTestPlan::policy() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int budget()
+	{
+		EncoderThreads threads(6);
+		int ok = true;
+
+		//1080p gets all wanted
+		DWORD first = threads.Acquire(1920,1080);
+		//Second one only the free ones
+		DWORD second = threads.Acquire(1920,1080);
+		//No more free, but still one
+		DWORD small = threads.Acquire(320,240);
+		DWORD third = threads.Acquire(1920,1080);
+
+		if (first!=4 || second!=2 || small!=1 || third!=1)
+			ok = Error("-EncoderThreadsTestPlan::budget() | wrong threads [first:%d,second:%d,small:%d,third:%d]\n",first,second,small,third);
+
+		EncoderThreads::Stats stats = threads.GetStats();
+		if (stats.used!=8 || stats.encoders!=4 || stats.limited!=2)
+			ok = Error("-EncoderThreadsTestPlan::budget() | wrong stats [used:%d,encoders:%d,limited:%llu]\n",stats.used,stats.encoders,stats.limited);
+
+		//Give back the first ones
+		threads.Release(first);
+		threads.Release(small);
+		threads.Release(third);
+
+		//Fixed number is also limited
+		DWORD fixed = threads.Acquire(320,240,8);
+		if (fixed!=4)
+			ok = Error("-EncoderThreadsTestPlan::budget() | wrong fixed threads [fixed:%d]\n",fixed);
+
+		//Encoding times
+		threads.OnEncoded(1000);
+		threads.OnEncoded(3000);
+		stats = threads.GetStats();
+		if (stats.frames!=2 || stats.encodeTime!=4000)
+			ok = Error("-EncoderThreadsTestPlan::budget() | wrong encode stats [frames:%llu,time:%llu]\n",stats.frames,stats.encodeTime);
+
+		Log("-EncoderThreadsTestPlan::budget() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int cores()
+	{
+		EncoderThreads threads(8);
+		int ok = true;
+
+		//Lower the budget, as done on start for the composition workers
+		threads.SetCores(2);
+		DWORD first = threads.Acquire(1920,1080);
+		if (first!=2 || threads.GetStats().cores!=2)
+			ok = Error("-EncoderThreadsTestPlan::cores() | budget not lowered [first:%d]\n",first);
+		threads.Release(first);
+
+		//Never less than one
+		threads.SetCores(0);
+		if (threads.GetStats().cores!=1 || threads.Acquire(1920,1080)!=1)
+			ok = Error("-EncoderThreadsTestPlan::cores() | empty budget\n");
+
+		Log("-EncoderThreadsTestPlan::cores() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	virtual void Execute()
+	{
+		policy();
+		budget();
+		cores();
+	}
+
+};
+
+EncoderThreadsTestPlan encoderthreads;
@@ -0,0 +1,206 @@
+#include "test.h"
+#include "framescaler.h"
+#include "tools.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+class FrameScalerTestPlan: public TestPlan
+{
+public:
+	FrameScalerTestPlan() : TestPlan("FrameScaler test plan")
+	{
+		
+	}
+
+	static void Fill(BYTE* frame,DWORD width,DWORD height)
+	{
+		//Get number of pixels
+		DWORD num = width*height;
+		//Smooth gradients, like camera content
+		for (DWORD j=0; j<height; ++j)
+			for (DWORD i=0; i<width; ++i)
+				frame[j*width+i] = 128+64*sin(i/23.0)*cos(j/17.0)+32*sin((i+j)/41.0);
+		//Chroma
+		for (DWORD j=0; j<height/2; ++j)
+		{
+			for (DWORD i=0; i<width/2; ++i)
+			{
+				frame[num+j*width/2+i] = 128+48*sin(i/13.0+j/29.0);
+				frame[num*5/4+j*width/2+i] = 128+48*cos(i/31.0-j/11.0);
+			}
+		}
+	}
+
+	static double PSNR(const BYTE* a,const BYTE* b,DWORD size)
+	{
+		double mse = 0;
+		//Get squared error
+		for (DWORD i=0; i<size; ++i)
+			mse += (a[i]-b[i])*(a[i]-b[i]);
+		//Average
+		mse /= size;
+		//Same
+		if (!mse)
+			return 100;
+		//Get psnr
+		return 10*log10(255.0*255.0/mse);
+	}
+
+	int quality()
+	{
+		DWORD width = 1440;
+		DWORD height = 720;
+		BYTE* src = (BYTE*)malloc32(width*height*3/2);
+		BYTE* box = (BYTE*)malloc32(width*height*3/2);
+		BYTE* bicubic = (BYTE*)malloc32(width*height*3/2);
+		int ok = true;
+
+		//Create source
+		Fill(src,width,height);
+
+		//For each factor
+		for (DWORD n=2; n<=4; ++n)
+		{
+			FrameScaler fast;
+			FrameScaler slow;
+			//Get output size
+			DWORD w = width/n;
+			DWORD h = height/n;
+			//Disable box on the reference one
+			slow.SetBoxFilter(false);
+			//Scale both
+			QWORD ini = getTime();
+			fast.Resize(src,width,height,box,w,h);
+			QWORD boxTime = getTime()-ini;
+			ini = getTime();
+			slow.Resize(src,width,height,bicubic,w,h);
+			QWORD bicubicTime = getTime()-ini;
+			//Compare
+			double psnr = PSNR(box,bicubic,w*h*3/2);
+			Log("-FrameScalerTestPlan::quality() | [factor:%d,box:%d,psnr:%.2fdB,boxTime:%lluus,bicubicTime:%lluus]\n",n,fast.GetBoxFactor(),psnr,boxTime,bicubicTime);
+			//Check it was used
+			if (fast.GetBoxFactor()!=n || slow.GetBoxFactor())
+				ok = Error("-FrameScalerTestPlan::quality() | box filter not selected [factor:%d]\n",n);
+			//Must be close
+			if (psnr<30)
+				ok = Error("-FrameScalerTestPlan::quality() | box filter too far from bicubic [factor:%d,psnr:%.2f]\n",n,psnr);
+		}
+
+		//Non exact downscale must not use it
+		FrameScaler scaler;
+		scaler.Resize(src,width,height,box,width*2/5,height*2/5);
+		if (scaler.GetBoxFactor())
+			ok = Error("-FrameScalerTestPlan::quality() | box filter selected for non exact downscale\n");
+
+		free(src);
+		free(box);
+		free(bicubic);
+
+		return ok;
+	}
+
+	int cache()
+	{
+		DWORD width = 640;
+		DWORD height = 480;
+		BYTE* src = (BYTE*)malloc32(width*height*3/2);
+		BYTE* dst = (BYTE*)malloc32(width*height*3/2);
+		int ok = true;
+
+		//Create source
+		Fill(src,width,height);
+
+		//Get initial stats
+		FrameScaler::Stats ini = FrameScaler::GetStats();
+
+		//Switch between two sizes like a participant moving between slots
+		FrameScaler scaler;
+		scaler.SetBoxFilter(false);
+		for (DWORD i=0; i<100; ++i)
+		{
+			if (i%2)
+				scaler.Resize(src,width,height,dst,352,288);
+			else
+				scaler.Resize(src,width,height,dst,176,144);
+		}
+
+		//Get stats
+		FrameScaler::Stats end = FrameScaler::GetStats();
+
+		Log("-FrameScalerTestPlan::cache() | [created:%llu,reused:%llu,cached:%d]\n",end.created-ini.created,end.reused-ini.reused,end.cached);
+
+		//Only the first ones must have been created
+		if (end.created-ini.created>2)
+			ok = Error("-FrameScalerTestPlan::cache() | contexts not reused [created:%llu]\n",end.created-ini.created);
+
+		free(src);
+		free(dst);
+
+		return ok;
+	}
+
+	int stride()
+	{
+		DWORD width = 640;
+		DWORD height = 480;
+		DWORD stride = width+64;
+		BYTE* src = (BYTE*)malloc32(width*height*3/2);
+		BYTE* padded = (BYTE*)malloc32(stride*height*3/2);
+		BYTE* packed = (BYTE*)malloc32(352*288*3/2);
+		BYTE* strided = (BYTE*)malloc32(352*288*3/2);
+		int ok = true;
+
+		//Create source
+		Fill(src,width,height);
+
+		//Garbage on the padding
+		memset(padded,0xFF,stride*height*3/2);
+		//Copy it with the decoder layout
+		BYTE* y = padded;
+		BYTE* u = padded+stride*height;
+		BYTE* v = padded+stride*height*5/4;
+		for (DWORD j=0; j<height; ++j)
+			memcpy(y+j*stride,src+j*width,width);
+		for (DWORD j=0; j<height/2; ++j)
+		{
+			memcpy(u+j*stride/2,src+width*height+j*width/2,width/2);
+			memcpy(v+j*stride/2,src+width*height*5/4+j*width/2,width/2);
+		}
+
+		//Scale both
+		FrameScaler scaler;
+		scaler.Resize(src,width,height,packed,352,288);
+		scaler.Resize(y,u,v,stride,width,height,strided,352,288);
+
+		//Must be the same
+		if (memcmp(packed,strided,352*288*3/2))
+			ok = Error("-FrameScalerTestPlan::stride() | strided scaling differs [psnr:%.2f]\n",PSNR(packed,strided,352*288*3/2));
+
+		//Same size must just repack it
+		BYTE* copy = (BYTE*)malloc32(width*height*3/2);
+		scaler.Resize(y,u,v,stride,width,height,copy,width,height);
+		if (memcmp(src,copy,width*height*3/2))
+			ok = Error("-FrameScalerTestPlan::stride() | wrong repacking\n");
+
+		Log("-FrameScalerTestPlan::stride() | [ok:%d]\n",ok);
+
+		free(src);
+		free(padded);
+		free(packed);
+		free(strided);
+		free(copy);
+
+		return ok;
+	}
+
+	virtual void Execute()
+	{
+		quality();
+		cache();
+		stride();
+	}
+	
+};
+
+FrameScalerTestPlan framescaler;
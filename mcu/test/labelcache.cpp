@@ -0,0 +1,174 @@
+#include "test.h"
+#include "labelcache.h"
+#include <string.h>
+#include <stdlib.h>
+
+//Fills tiles with the number of renders instead of rasterizing them
+class TestLabelCache : public LabelCache
+{
+public:
+	TestLabelCache(DWORD maxCached) : LabelCache(maxCached)
+	{
+		renders = 0;
+		reenter = false;
+	}
+
+	DWORD renders;
+	//Draw the same label from inside next render, as another mixer would do meanwhile
+	bool  reenter;
+
+protected:
+	virtual int Render(const std::wstring& text,DWORD width,DWORD height,const Properties& properties,BYTE* tile)
+	{
+		//One more
+		renders++;
+		//If drawing it while rendering
+		if (reenter)
+		{
+			//Only once
+			reenter = false;
+			//Draw on its own canvas, would deadlock if rendering with the cache locked
+			BYTE* canvas = (BYTE*)malloc(width*height*5/2);
+			Draw(text,width,height,properties,canvas,width,height,0,0);
+			free(canvas);
+		}
+		//Fill it
+		memset(tile,renders,GetTileSize(width,height));
+		//Done
+		return 1;
+	}
+};
+
+class LabelCacheTestPlan: public TestPlan
+{
+public:
+	LabelCacheTestPlan() : TestPlan("Label cache test plan")
+	{
+
+	}
+
+	int reuse()
+	{
+		static const DWORD Width = 64;
+		static const DWORD Height = 32;
+		BYTE* canvas = (BYTE*)calloc(Width*Height*5/2,1);
+		TestLabelCache cache(2);
+		Properties style;
+		int ok = true;
+
+		//Render first one
+		cache.Draw(L"alice",32,16,style,canvas,Width,Height,0,0);
+		//Same one again must not be rendered
+		cache.Draw(L"alice",32,16,style,canvas,Width,Height,16,8);
+		if (cache.renders!=1)
+			ok = Error("-LabelCacheTestPlan::reuse() | label rendered again [renders:%d]\n",cache.renders);
+
+		//Different size, text or style are new ones
+		cache.Draw(L"alice",32,18,style,canvas,Width,Height,0,0);
+		cache.Draw(L"bob",32,16,style,canvas,Width,Height,0,0);
+		style.SetProperty("color","black");
+		cache.Draw(L"bob",32,16,style,canvas,Width,Height,0,0);
+		if (cache.renders!=4)
+			ok = Error("-LabelCacheTestPlan::reuse() | wrong renders [renders:%d]\n",cache.renders);
+
+		//Only last two are kept
+		LabelCache::Stats stats = cache.GetStats();
+		if (stats.cached!=2 || stats.rendered!=4 || stats.reused!=1)
+			ok = Error("-LabelCacheTestPlan::reuse() | wrong stats [rendered:%llu,reused:%llu,cached:%d]\n",stats.rendered,stats.reused,stats.cached);
+
+		//First one was evicted
+		cache.Draw(L"alice",32,16,Properties(),canvas,Width,Height,0,0);
+		if (cache.renders!=5)
+			ok = Error("-LabelCacheTestPlan::reuse() | evicted label not rendered [renders:%d]\n",cache.renders);
+
+		free(canvas);
+
+		Log("-LabelCacheTestPlan::reuse() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int clip()
+	{
+		static const DWORD Width = 64;
+		static const DWORD Height = 32;
+		static const DWORD NumPixels = Width*Height;
+		BYTE* canvas = (BYTE*)calloc(NumPixels*5/2,1);
+		TestLabelCache cache(4);
+		int ok = true;
+
+		//Out of canvas
+		if (cache.Draw(L"out",16,16,Properties(),canvas,Width,Height,Width,0))
+			ok = Error("-LabelCacheTestPlan::clip() | label out of canvas drawn\n");
+
+		//Partially out on the bottom right corner
+		if (!cache.Draw(L"corner",32,16,Properties(),canvas,Width,Height,48,24))
+			ok = Error("-LabelCacheTestPlan::clip() | clipped label not drawn\n");
+
+		//Check luma, alpha and chroma only written inside
+		for (DWORD j=0;j<Height;++j)
+		{
+			for (DWORD i=0;i<Width;++i)
+			{
+				BYTE expected = i>=48 && j>=24 ? 1 : 0;
+				if (canvas[j*Width+i]!=expected || canvas[NumPixels*3/2+j*Width+i]!=expected)
+					ok = Error("-LabelCacheTestPlan::clip() | wrong luma or alpha at [%d,%d]\n",i,j);
+			}
+		}
+		for (DWORD j=0;j<Height/2;++j)
+		{
+			for (DWORD i=0;i<Width/2;++i)
+			{
+				BYTE expected = i>=24 && j>=12 ? 1 : 0;
+				if (canvas[NumPixels+j*Width/2+i]!=expected || canvas[NumPixels*5/4+j*Width/2+i]!=expected)
+					ok = Error("-LabelCacheTestPlan::clip() | wrong chroma at [%d,%d]\n",i,j);
+			}
+		}
+
+		free(canvas);
+
+		Log("-LabelCacheTestPlan::clip() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int unlocked()
+	{
+		static const DWORD Width = 64;
+		static const DWORD Height = 32;
+		BYTE* canvas = (BYTE*)calloc(Width*Height*5/2,1);
+		TestLabelCache cache(4);
+		int ok = true;
+
+		//Same label is drawn while rendering it
+		cache.reenter = true;
+		if (!cache.Draw(L"alice",32,16,Properties(),canvas,Width,Height,0,0))
+			ok = Error("-LabelCacheTestPlan::unlocked() | label not drawn\n");
+
+		//Both rendered but only the first one inserted is kept and used
+		LabelCache::Stats stats = cache.GetStats();
+		if (cache.renders!=2 || stats.rendered!=2 || stats.cached!=1 || canvas[0]!=2)
+			ok = Error("-LabelCacheTestPlan::unlocked() | wrong double check [renders:%d,cached:%d,pixel:%d]\n",cache.renders,stats.cached,canvas[0]);
+
+		//And it is reused after that
+		cache.Draw(L"alice",32,16,Properties(),canvas,Width,Height,0,0);
+		if (cache.renders!=2 || cache.GetStats().reused!=1)
+			ok = Error("-LabelCacheTestPlan::unlocked() | label not reused [renders:%d]\n",cache.renders);
+
+		free(canvas);
+
+		Log("-LabelCacheTestPlan::unlocked() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	virtual void Execute()
+	{
+		reuse();
+		clip();
+		unlocked();
+	}
+
+};
+
+LabelCacheTestPlan labelcache;
@@ -0,0 +1,143 @@
+#include "test.h"
+#include "latencystats.h"
+
+class LatencyStatsTestPlan: public TestPlan
+{
+public:
+	LatencyStatsTestPlan() : TestPlan("Latency stats test plan")
+	{
+
+	}
+
+	int buckets()
+	{
+		int ok = true;
+		DWORD last = 0;
+
+		//Check values on all the range
+		for (QWORD value=0;value<0xFFFFFFFF;value=value*9/8+1)
+		{
+			//Get bucket
+			DWORD bucket = LatencyHistogram::GetBucket(value);
+			//Get its bound
+			QWORD bound = LatencyHistogram::GetBucketValue(bucket);
+			//Check it is in range and increasing
+			if (bucket>=LatencyHistogram::NumBuckets || bucket<last)
+				ok = Error("-LatencyStatsTestPlan::buckets() | wrong bucket [value:%llu,bucket:%d]\n",value,bucket);
+			//Bound must not be below and be within 3%
+			if (bound<value || (bound-value)*100>value*3+1)
+				ok = Error("-LatencyStatsTestPlan::buckets() | wrong bound [value:%llu,bound:%llu]\n",value,bound);
+			//Store
+			last = bucket;
+		}
+
+		//Small values are exact
+		for (QWORD value=0;value<64;++value)
+			if (LatencyHistogram::GetBucketValue(LatencyHistogram::GetBucket(value))!=value)
+				ok = Error("-LatencyStatsTestPlan::buckets() | not exact [value:%llu]\n",value);
+
+		//Max is clamped to last bucket
+		if (LatencyHistogram::GetBucket((QWORD)-1)!=LatencyHistogram::NumBuckets-1)
+			ok = Error("-LatencyStatsTestPlan::buckets() | max not on last bucket\n");
+
+		Log("-LatencyStatsTestPlan::buckets() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int percentiles()
+	{
+		LatencyHistogram histogram;
+		int ok = true;
+
+		//Empty
+		if (histogram.GetCount() || histogram.GetMean() || histogram.GetPercentile(50) || histogram.GetMax())
+			ok = Error("-LatencyStatsTestPlan::percentiles() | not empty\n");
+
+		//Record 1..1000ms
+		for (QWORD i=1;i<=1000;++i)
+			histogram.Record(i*1000);
+
+		//Check
+		if (histogram.GetCount()!=1000 || histogram.GetMean()!=500500)
+			ok = Error("-LatencyStatsTestPlan::percentiles() | wrong count or mean [count:%llu,mean:%llu]\n",histogram.GetCount(),histogram.GetMean());
+		if (!Near(histogram.GetPercentile(50),500000) || !Near(histogram.GetPercentile(90),900000) || !Near(histogram.GetPercentile(99),990000) || !Near(histogram.GetMax(),1000000))
+			ok = Error("-LatencyStatsTestPlan::percentiles() | wrong percentiles [p50:%llu,p90:%llu,p99:%llu,max:%llu]\n",histogram.GetPercentile(50),histogram.GetPercentile(90),histogram.GetPercentile(99),histogram.GetMax());
+
+		//Keep a copy
+		LatencyHistogram previous = histogram;
+
+		//Record some small ones
+		for (QWORD i=0;i<100;++i)
+			histogram.Record(10);
+
+		//Get only the new ones
+		histogram -= previous;
+
+		//Check
+		if (histogram.GetCount()!=100 || histogram.GetMean()!=10 || histogram.GetPercentile(1)!=10 || histogram.GetMax()!=10)
+			ok = Error("-LatencyStatsTestPlan::percentiles() | wrong interval [count:%llu,mean:%llu,max:%llu]\n",histogram.GetCount(),histogram.GetMean(),histogram.GetMax());
+
+		Log("-LatencyStatsTestPlan::percentiles() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int snapshots()
+	{
+		LatencyStats latency;
+		LatencyStats::Snapshot first;
+		LatencyStats::Snapshot second;
+		int ok = true;
+
+		//Start
+		latency.StartCPU(LatencyStats::Sending);
+		latency.Record(LatencyStats::Encode,1000);
+		latency.GetSnapshot(first);
+
+		//Unknown and future origins are not recorded
+		latency.RecordSince(LatencyStats::Sent,0);
+		latency.RecordSince(LatencyStats::Sent,getTime()+1000000);
+		//Known one
+		latency.RecordSince(LatencyStats::Sent,getTime()-5000);
+		latency.Record(LatencyStats::Encode,2000);
+
+		//Spend some cpu
+		volatile DWORD acu = 0;
+		for (DWORD i=0;i<20000000;++i)
+			acu += i;
+		latency.UpdateCPU(LatencyStats::Sending);
+
+		//Get interval
+		latency.GetSnapshot(second);
+		second -= first;
+
+		//Check
+		if (second.stages[LatencyStats::Encode].GetCount()!=1 || second.stages[LatencyStats::Encode].GetMean()!=2000)
+			ok = Error("-LatencyStatsTestPlan::snapshots() | wrong encode interval\n");
+		if (second.stages[LatencyStats::Sent].GetCount()!=1 || second.stages[LatencyStats::Sent].GetMean()<5000)
+			ok = Error("-LatencyStatsTestPlan::snapshots() | wrong sent interval [count:%llu]\n",second.stages[LatencyStats::Sent].GetCount());
+		if (!second.cpu[LatencyStats::Sending] || second.cpu[LatencyStats::Receiving])
+			ok = Error("-LatencyStatsTestPlan::snapshots() | wrong cpu [sending:%llu,receiving:%llu]\n",second.cpu[LatencyStats::Sending],second.cpu[LatencyStats::Receiving]);
+
+		Log("-LatencyStatsTestPlan::snapshots() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	virtual void Execute()
+	{
+		buckets();
+		percentiles();
+		snapshots();
+	}
+
+private:
+	static bool Near(QWORD value,QWORD expected)
+	{
+		//Within 3% above
+		return value>=expected && (value-expected)*100<=expected*3;
+	}
+};
+
+LatencyStatsTestPlan latencystats;
@@ -1,5 +1,8 @@
 #include "test.h"
 #include "overlay.h"
+#include "tools.h"
+#include <stdlib.h>
+#include <string.h>
 
 
 
@@ -23,10 +26,106 @@ public:
 		return true;
 	}
 
-	
+	int blend()
+	{
+		const DWORD width = 1280;
+		const DWORD height = 720;
+		const DWORD num = 500;
+		DWORD size = width*height*3/2;
+		Canvas canvas(width,height);
+		//Store selected blend
+		Canvas::Blend best = Canvas::GetBlend();
+
+		//Create random frame
+		BYTE* frame = (BYTE*)malloc32(size);
+		for (DWORD i=0;i<size;++i)
+			frame[i] = rand();
+
+		//Get overlay planes
+		BYTE* overlay = canvas.GetCanvas();
+		BYTE* alpha = overlay+width*height*3/2;
+		//Random overlay picture
+		for (DWORD i=0;i<size;++i)
+			overlay[i] = rand();
+		//Top banner with antialiased borders, a semitransparent box and the rest transparent
+		for (DWORD j=0;j<height;++j)
+			for (DWORD i=0;i<width;++i)
+				alpha[j*width+i] = j<60 ? (i<8 || i>=width-8 || j<4 ? rand() : 255) : (j>=600 && i>=100 && i<700 ? 128 : 0);
+		//We have written on it
+		canvas.Invalidate();
+
+		//Check banner against a fully random alpha one
+		for (int mixed=0;mixed<2;++mixed)
+		{
+			//Make all alpha random
+			if (mixed)
+			{
+				for (DWORD i=0;i<width*height;++i)
+					alpha[i] = rand();
+				//We have written on it
+				canvas.Invalidate();
+			}
+
+			//Get reference output
+			BYTE* reference = (BYTE*)malloc32(size);
+			Canvas::SetBlend(Canvas::BlendScalar);
+			canvas.Draw(reference,frame);
+
+			//For each implementation
+			for (int b=Canvas::BlendScalar;b<=Canvas::BlendAVX2;++b)
+			{
+				//Check if supported on this cpu
+				if (!Canvas::IsBlendSupported((Canvas::Blend)b))
+					continue;
+
+				BYTE* image = (BYTE*)malloc32(size);
+				//Use it
+				Canvas::SetBlend((Canvas::Blend)b);
+
+				QWORD ini = getTime();
+				//Draw
+				for (DWORD i=0;i<num;++i)
+					canvas.Draw(image,frame);
+				QWORD elapsed = getTime()-ini;
+
+				Log("-OverlayTestPlan::blend() | [blend:%s,alpha:%s,elapsed:%lluus,perFrame:%.1fus]\n",Canvas::GetBlendName((Canvas::Blend)b),mixed ? "random" : "banner",elapsed,(double)elapsed/num);
+
+				//Must be bit exact
+				if (memcmp(image,reference,size))
+					Error("-OverlayTestPlan::blend() | %s differs from scalar\n",Canvas::GetBlendName((Canvas::Blend)b));
+
+				//Draw in place too
+				memcpy(image,frame,size);
+				canvas.Draw(image,image);
+				if (memcmp(image,reference,size))
+					Error("-OverlayTestPlan::blend() | %s in place differs from scalar\n",Canvas::GetBlendName((Canvas::Blend)b));
+
+				//Draw it by regions not aligned to blocks
+				memset(image,0,size);
+				for (DWORD y=0;y<height;y+=90)
+					for (DWORD x=0;x<width;x+=200)
+						canvas.Draw(image,frame,x,y,200,90);
+				if (memcmp(image,reference,size))
+					Error("-OverlayTestPlan::blend() | %s by regions differs from scalar\n",Canvas::GetBlendName((Canvas::Blend)b));
+
+				free(image);
+			}
+			free(reference);
+		}
+
+		free(frame);
+
+		//Restore it
+		Canvas::SetBlend(best);
+
+		//OK
+		return true;
+	}
+
 	virtual void Execute()
 	{
 		canvas();
+		blend();
 	}
 	
 };
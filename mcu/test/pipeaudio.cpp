@@ -0,0 +1,601 @@
+#include "test.h"
+#include "fifo.h"
+#include "spscring.h"
+#include "pipeaudiooutput.h"
+#include "pipeaudioinput.h"
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <vector>
+
+class PipeAudioTestPlan: public TestPlan
+{
+public:
+	PipeAudioTestPlan() : TestPlan("Pipe audio test plan")
+	{
+
+	}
+
+	virtual void Execute()
+	{
+		stress();
+		shared();
+		splice();
+		overrun();
+		wait();
+		benchmark<LockedPipe>("mutex");
+		benchmark<LockFreePipe>("spscring");
+	}
+
+	int stress()
+	{
+		Stress stress;
+
+		Log(">PipeAudioTestPlan::stress() | [samples:%u]\n",Stress::NumSamples);
+
+		//Start both sides
+		pthread_t producer;
+		pthread_t consumer;
+		createPriorityThread(&producer,Stress::Produce,&stress,0);
+		createPriorityThread(&consumer,Stress::Consume,&stress,0);
+		pthread_join(producer,NULL);
+		pthread_join(consumer,NULL);
+
+		Log("<PipeAudioTestPlan::stress() | [ok:%d,full:%u,empty:%u]\n",stress.ok,stress.full,stress.empty);
+
+		return stress.ok;
+	}
+
+	int shared()
+	{
+		PipeAudioInput input;
+		Properties properties;
+		AudioCodec::Type codec;
+		DWORD rate;
+		DWORD numFrameSamples;
+		Properties got;
+		SWORD samples[160];
+		BYTE frame[MTU];
+		DWORD len = 0;
+		int ok = true;
+
+		Log(">PipeAudioTestPlan::shared()\n");
+
+		//Start recording at mixer rate
+		input.Init(8000);
+		input.StartRecording(8000);
+
+		//Queue some samples before sharing
+		memset(samples,0,sizeof(samples));
+		input.PutSamples(samples,160);
+
+		//Ask for shared frames
+		DWORD version = input.GetSharedVersion();
+		properties.SetProperty("test","1");
+		input.StartSharedEncoding(AudioCodec::PCMU,8000,160,properties);
+
+		//Mixer must see the request
+		if (input.GetSharedVersion()==version || !input.GetSharedEncoding(codec,rate,numFrameSamples,got) || codec!=AudioCodec::PCMU || rate!=8000 || numFrameSamples!=160 || !(got==properties))
+			ok = Error("-PipeAudioTestPlan::shared() | wrong shared encoding request\n");
+
+		//Mixer sends more frames than the queue holds
+		for (BYTE i=0;i<6;++i)
+		{
+			memset(frame,i,i+1);
+			input.PutFrame(frame,i+1);
+		}
+
+		//Samples queued before them are encoded privately first
+		if (input.RecFrame(samples,160,frame,sizeof(frame),len)!=160 || len)
+			ok = Error("-PipeAudioTestPlan::shared() | queued samples not delivered before frames [len:%d]\n",len);
+
+		//Oldest ones are dropped
+		for (BYTE i=2;i<6;++i)
+		{
+			//Get it
+			int num = input.RecFrame(samples,160,frame,sizeof(frame),len);
+			//Check it is the encoded one
+			if (num!=160 || len!=i+1 || frame[0]!=i)
+				ok = Error("-PipeAudioTestPlan::shared() | wrong shared frame [num:%d,len:%d,expected:%d]\n",num,len,i+1);
+		}
+
+		//Stop sharing
+		input.StopSharedEncoding();
+
+		//Frames are ignored now and samples go through
+		input.PutFrame(frame,1);
+		for (DWORD i=0;i<160;++i)
+			samples[i] = i;
+		input.PutSamples(samples,160);
+
+		//Get them
+		memset(samples,0,sizeof(samples));
+		int num = input.RecFrame(samples,160,frame,sizeof(frame),len);
+
+		//Must be the raw samples for the private encoder
+		if (num!=160 || len || samples[159]!=159 || input.GetSharedEncoding(codec,rate,numFrameSamples,got))
+			ok = Error("-PipeAudioTestPlan::shared() | wrong samples after sharing [num:%d,len:%d]\n",num,len);
+
+		//Stop
+		input.StopRecording();
+		input.End();
+
+		Log("<PipeAudioTestPlan::shared() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int splice()
+	{
+		PipeAudioInput input;
+		Properties properties;
+		SWORD samples[200];
+		BYTE frame[MTU];
+		DWORD len = 0;
+		int ok = true;
+
+		Log(">PipeAudioTestPlan::splice()\n");
+
+		//Start recording at mixer rate and ask for shared frames
+		input.Init(8000);
+		input.StartRecording(8000);
+		input.StartSharedEncoding(AudioCodec::PCMU,8000,160,properties);
+
+		//Mixer sends a frame and a half of private samples
+		for (DWORD i=0;i<200;++i)
+			samples[i] = i;
+		input.PutSamples(samples,200);
+
+		//Switch to shared frames, first one starts on the last partial private frame
+		memset(frame,1,1);
+		input.PutFrame(frame,1);
+
+		//Whole private frame goes first
+		memset(samples,0,sizeof(samples));
+		int num = input.RecFrame(samples,160,frame,sizeof(frame),len);
+		if (num!=160 || len || samples[0]!=0 || samples[159]!=159)
+			ok = Error("-PipeAudioTestPlan::splice() | private frame not delivered [num:%d,len:%d]\n",num,len);
+
+		//Then the shared one, the partial private frame is dropped
+		num = input.RecFrame(samples,160,frame,sizeof(frame),len);
+		if (num!=160 || len!=1 || frame[0]!=1)
+			ok = Error("-PipeAudioTestPlan::splice() | shared frame not delivered [num:%d,len:%d]\n",num,len);
+
+		//Another shared frame and back to private, mixer carries what the shared encoder had not encoded yet
+		memset(frame,2,1);
+		input.PutFrame(frame,1);
+		for (DWORD i=0;i<200;++i)
+			samples[i] = 1000+i;
+		input.PutRecordedSamples(samples,40);
+		input.PutSamples(samples+40,120);
+
+		//Queued frame goes first
+		num = input.RecFrame(samples,160,frame,sizeof(frame),len);
+		if (num!=160 || len!=1 || frame[0]!=2)
+			ok = Error("-PipeAudioTestPlan::splice() | queued frame not delivered first [num:%d,len:%d]\n",num,len);
+
+		//Then the carried samples followed by the private ones
+		memset(samples,0,sizeof(samples));
+		num = input.RecFrame(samples,160,frame,sizeof(frame),len);
+		if (num!=160 || len || samples[0]!=1000 || samples[40]!=1040 || samples[159]!=1159)
+			ok = Error("-PipeAudioTestPlan::splice() | carried samples lost [num:%d,len:%d,first:%d]\n",num,len,samples[0]);
+
+		//Stop
+		input.StopRecording();
+		input.End();
+
+		Log("<PipeAudioTestPlan::splice() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int overrun()
+	{
+		PipeAudioOutput output(false);
+		SWORD samples[160];
+		DWORD played = 0;
+		int ok = true;
+
+		Log(">PipeAudioTestPlan::overrun()\n");
+
+		//Same rate, no transrating
+		output.Init(8000);
+		output.StartPlaying(8000);
+
+		//Fill it until it does not fit
+		memset(samples,1,sizeof(samples));
+		while (output.PlayBuffer(samples,160,0))
+			played += 160;
+
+		//While the mixer does not run nothing else fits
+		if (output.PlayBuffer(samples,160,0))
+			ok = Error("-PipeAudioTestPlan::overrun() | chunk queued on full ring\n");
+
+		//Mixer drops everything queued before the overflow, so latency does not grow
+		DWORD len = output.GetSamples(samples,160);
+		if (!played || len)
+			ok = Error("-PipeAudioTestPlan::overrun() | stale samples not dropped [played:%d,len:%d]\n",played,len);
+
+		//Newest audio goes through after it
+		for (DWORD i=0;i<160;++i)
+			samples[i] = i;
+		output.PlayBuffer(samples,160,0);
+		memset(samples,0,sizeof(samples));
+		len = output.GetSamples(samples,160);
+		if (len!=160 || samples[0]!=0 || samples[159]!=159)
+			ok = Error("-PipeAudioTestPlan::overrun() | wrong samples after overrun [len:%d]\n",len);
+
+		//Same on the input side
+		PipeAudioInput input;
+		input.Init(8000);
+		input.StartRecording(8000);
+
+		//Overfill it
+		memset(samples,1,sizeof(samples));
+		for (DWORD i=0;i<4096/160+2;++i)
+			input.PutSamples(samples,160);
+
+		//Mixer sends new ones when the encoder is waiting
+		Waiter waiter(&input);
+		createPriorityThread(&waiter.thread,Waiter::Wait,&waiter,0);
+		//Give it time to drop the old ones and wait
+		usleep(50000);
+		//Send new ones
+		for (DWORD i=0;i<160;++i)
+			samples[i] = i;
+		input.PutSamples(samples,160);
+		pthread_join(waiter.thread,NULL);
+
+		//Only new ones must be there
+		if (waiter.len!=160 || waiter.samples[0]!=0 || waiter.samples[159]!=159)
+			ok = Error("-PipeAudioTestPlan::overrun() | wrong input samples after overrun [len:%d]\n",waiter.len);
+
+		input.StopRecording();
+		input.End();
+
+		Log("<PipeAudioTestPlan::overrun() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int wait()
+	{
+		PipeAudioInput input;
+		SWORD samples[160];
+		int ok = true;
+
+		Log(">PipeAudioTestPlan::wait()\n");
+
+		//Start recording at mixer rate
+		input.Init(8000);
+		input.StartRecording(8000);
+
+		//Encoder waits for a frame
+		Waiter waiter(&input);
+		QWORD ini = getTime();
+		createPriorityThread(&waiter.thread,Waiter::Wait,&waiter,0);
+
+		//Send half a frame, not enought for waking it up for good
+		for (DWORD i=0;i<160;++i)
+			samples[i] = i;
+		usleep(20000);
+		input.PutSamples(samples,80);
+		usleep(20000);
+		input.PutSamples(samples+80,80);
+
+		//Wait for it
+		pthread_join(waiter.thread,NULL);
+		QWORD elapsed = getTime()-ini;
+
+		//It must have blocked until the whole frame was there
+		if (waiter.len!=160 || waiter.samples[0]!=0 || waiter.samples[159]!=159 || elapsed<40000)
+			ok = Error("-PipeAudioTestPlan::wait() | wrong wait [len:%d,elapsed:%llu]\n",waiter.len,elapsed);
+
+		//Now one blocked when recording stops
+		Waiter stopped(&input);
+		createPriorityThread(&stopped.thread,Waiter::Wait,&stopped,0);
+		usleep(20000);
+		input.StopRecording();
+		pthread_join(stopped.thread,NULL);
+
+		//Must return without samples
+		if (stopped.len)
+			ok = Error("-PipeAudioTestPlan::wait() | got samples after stop [len:%d]\n",stopped.len);
+
+		input.End();
+
+		Log("<PipeAudioTestPlan::wait() | [ok:%d,elapsed:%llu]\n",ok,elapsed);
+
+		return ok;
+	}
+
+	template<typename Pipe>
+	int benchmark(const char* name)
+	{
+		Benchmark<Pipe> bench;
+		rusage before;
+		rusage after;
+
+		Log(">PipeAudioTestPlan::benchmark() | [pipe:%s,participants:%d,decoders:%d,frames:%d]\n",name,NumParticipants,NumDecoders,NumFrames);
+
+		//Create participants
+		for (int i=0;i<NumParticipants;++i)
+			bench.pipes.push_back(new Pipe());
+
+		//Get usage before
+		getrusage(RUSAGE_SELF,&before);
+		QWORD ini = getTime();
+
+		//Start decoders, each one owns a slice of the participants
+		pthread_t decoders[NumDecoders];
+		for (int i=0;i<NumDecoders;++i)
+		{
+			bench.decoders[i].bench = &bench;
+			bench.decoders[i].first = i*NumParticipants/NumDecoders;
+			bench.decoders[i].last = (i+1)*NumParticipants/NumDecoders;
+			bench.decoders[i].decoded = 0;
+			createPriorityThread(&decoders[i],Benchmark<Pipe>::Decode,&bench.decoders[i],0);
+		}
+		//Start mixer
+		pthread_t mixer;
+		createPriorityThread(&mixer,Benchmark<Pipe>::Mix,&bench,0);
+
+		//Wait for all
+		for (int i=0;i<NumDecoders;++i)
+			pthread_join(decoders[i],NULL);
+		pthread_join(mixer,NULL);
+
+		//Get usage after
+		QWORD elapsed = getTime()-ini;
+		getrusage(RUSAGE_SELF,&after);
+
+		//Calculate context switches
+		long csw = (after.ru_nvcsw-before.ru_nvcsw) + (after.ru_nivcsw-before.ru_nivcsw);
+
+		//Log results
+		Log("<PipeAudioTestPlan::benchmark() | [pipe:%s,played:%llu,mixed:%llu,elapsed:%llums,ns/frame:%.1f,ctxsw:%ld]\n",
+			name,bench.played,bench.mixed/FrameSamples,elapsed/1000,bench.played ? elapsed*1000.0/bench.played : 0.0,csw);
+
+		//Clean up
+		for (int i=0;i<NumParticipants;++i)
+			delete(bench.pipes[i]);
+
+		//All played frames must have been mixed
+		return bench.played==NumParticipants*NumFrames && bench.mixed==bench.played*FrameSamples;
+	}
+
+private:
+	static const int NumParticipants = 500;
+	static const int NumDecoders = 8;
+	static const int NumFrames = 2000;
+	static const int FrameSamples = 160;
+	//Frames the decoders may be ahead of the mixer
+	static const int MaxDelay = 4;
+
+	struct Waiter
+	{
+		PipeAudioInput* input;
+		pthread_t	thread;
+		SWORD		samples[160];
+		int		len;
+
+		Waiter(PipeAudioInput* input)
+		{
+			this->input = input;
+			len = 0;
+			memset(samples,0,sizeof(samples));
+		}
+
+		static void* Wait(void* arg)
+		{
+			Waiter* waiter = (Waiter*)arg;
+			//Block until there is a whole frame
+			waiter->len = waiter->input->RecBuffer(waiter->samples,160);
+			return NULL;
+		}
+	};
+
+	struct Stress
+	{
+		static const DWORD NumSamples = 4*1024*1024;
+
+		spscring<SWORD,1024> ring;
+		int	ok;
+		DWORD	full;
+		DWORD	empty;
+
+		Stress()
+		{
+			ok = true;
+			full = 0;
+			empty = 0;
+		}
+
+		static void* Produce(void* arg)
+		{
+			Stress* stress = (Stress*)arg;
+			SWORD buffer[512];
+			DWORD num = 0;
+			DWORD chunk = 1;
+
+			while (num<NumSamples)
+			{
+				//Vary chunk size so we wrap at every position
+				DWORD len = chunk%511+1;
+				if (len>NumSamples-num)
+					len = NumSamples-num;
+				//Fill with the sequence
+				for (DWORD i=0;i<len;++i)
+					buffer[i] = (SWORD)(num+i);
+				//Push until it fits
+				if (stress->ring.push(buffer,len))
+				{
+					num += len;
+					chunk = chunk*7+3;
+				} else {
+					stress->full++;
+					//Let the consumer run
+					sched_yield();
+				}
+			}
+			return NULL;
+		}
+
+		static void* Consume(void* arg)
+		{
+			Stress* stress = (Stress*)arg;
+			SWORD buffer[512];
+			DWORD num = 0;
+			DWORD chunk = 5;
+
+			while (num<NumSamples)
+			{
+				//Vary chunk size too
+				DWORD len = chunk%509+1;
+				if (len>NumSamples-num)
+					len = NumSamples-num;
+				//Pop until there are enought
+				if (!stress->ring.pop(buffer,len))
+				{
+					stress->empty++;
+					//Let the producer run
+					sched_yield();
+					continue;
+				}
+				//Check sequence
+				for (DWORD i=0;i<len;++i)
+					if (buffer[i]!=(SWORD)(num+i))
+					{
+						//Only first one
+						if (stress->ok)
+							Error("-PipeAudioTestPlan::stress() | wrong sample [num:%u,sample:%d]\n",num+i,buffer[i]);
+						stress->ok = false;
+					}
+				num += len;
+				chunk = chunk*13+1;
+			}
+			return NULL;
+		}
+	};
+
+	//Previous PipeAudioOutput fifo handling, for comparison
+	class LockedPipe
+	{
+	public:
+		LockedPipe()		{ pthread_mutex_init(&mutex,NULL);	}
+		~LockedPipe()		{ pthread_mutex_destroy(&mutex);	}
+
+		int PlayBuffer(SWORD *buffer,DWORD size)
+		{
+			pthread_mutex_lock(&mutex);
+			int left = fifoBuffer.size()-fifoBuffer.length();
+			if (size>left)
+				fifoBuffer.remove(size-left);
+			fifoBuffer.push(buffer,size);
+			pthread_mutex_unlock(&mutex);
+			return size;
+		}
+
+		int GetSamples(SWORD *buffer,DWORD num)
+		{
+			pthread_mutex_lock(&mutex);
+			int len = fifoBuffer.length();
+			if (len > num)
+				len = num;
+			fifoBuffer.pop(buffer,len);
+			pthread_mutex_unlock(&mutex);
+			return len;
+		}
+	private:
+		pthread_mutex_t mutex;
+		fifo<SWORD,8192> fifoBuffer;
+	};
+
+	class LockFreePipe
+	{
+	public:
+		LockFreePipe() : output(false)
+		{
+			output.Init(8000);
+			output.StartPlaying(8000);
+		}
+
+		int PlayBuffer(SWORD *buffer,DWORD size)	{ return output.PlayBuffer(buffer,size,0);	}
+		int GetSamples(SWORD *buffer,DWORD num)		{ return output.GetSamples(buffer,num);		}
+	private:
+		PipeAudioOutput output;
+	};
+
+	template<typename Pipe>
+	struct Benchmark
+	{
+		struct Decoder
+		{
+			Benchmark* bench;
+			int first;
+			int last;
+			DWORD decoded;
+		};
+
+		std::vector<Pipe*> pipes;
+		Decoder	decoders[NumDecoders];
+		DWORD	round;
+		QWORD	played;
+		QWORD	mixed;
+
+		Benchmark()
+		{
+			round = 0;
+			played = 0;
+			mixed = 0;
+		}
+
+		static void* Decode(void* arg)
+		{
+			Decoder* decoder = (Decoder*)arg;
+			SWORD buffer[FrameSamples];
+			QWORD num = 0;
+
+			memset(buffer,0,sizeof(buffer));
+
+			for (int j=0;j<NumFrames;++j)
+			{
+				//Don't get too far ahead of the mixer
+				while ((int)__atomic_load_n(&decoder->bench->round,__ATOMIC_ACQUIRE)+MaxDelay<j)
+					sched_yield();
+				//Play a frame on each participant
+				for (int i=decoder->first;i<decoder->last;++i)
+					if (decoder->bench->pipes[i]->PlayBuffer(buffer,FrameSamples))
+						num++;
+				//Done with this one
+				__atomic_store_n(&decoder->decoded,j+1,__ATOMIC_RELEASE);
+			}
+
+			__atomic_add_fetch(&decoder->bench->played,num,__ATOMIC_RELAXED);
+			return NULL;
+		}
+
+		static void* Mix(void* arg)
+		{
+			Benchmark* bench = (Benchmark*)arg;
+			SWORD buffer[FrameSamples];
+
+			for (int j=0;j<NumFrames;++j)
+			{
+				//Wait until all decoders have played this frame
+				for (int i=0;i<NumDecoders;++i)
+					while (__atomic_load_n(&bench->decoders[i].decoded,__ATOMIC_ACQUIRE)<(DWORD)j+1)
+						sched_yield();
+				//Get a frame from each participant
+				for (int i=0;i<NumParticipants;++i)
+					bench->mixed += bench->pipes[i]->GetSamples(buffer,FrameSamples);
+				//Next round
+				__atomic_store_n(&bench->round,j+1,__ATOMIC_RELEASE);
+			}
+			return NULL;
+		}
+	};
+};
+
+PipeAudioTestPlan pipeaudio;
@@ -0,0 +1,270 @@
+#include "test.h"
+#include "rtmpchunk.h"
+#include "rtmpmessage.h"
+#include "rtmpstream.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+class RTMPTestPlan: public TestPlan
+{
+public:
+	RTMPTestPlan() : TestPlan("RTMP test plan")
+	{
+
+	}
+
+	int sharedPayload()
+	{
+		BYTE media[1000];
+		BYTE cloned[2048];
+		BYTE shared[2048];
+		int ok = true;
+
+		//Create video frame
+		RTMPVideoFrame frame(0,sizeof(media));
+		for (DWORD i=0;i<sizeof(media);++i)
+			media[i] = i;
+		frame.SetVideoCodec(RTMPVideoFrame::FLV1);
+		frame.SetFrameType(RTMPVideoFrame::INTRA);
+		frame.SetVideoFrame(media,sizeof(media));
+
+		//Serialize it once
+		if (!frame.CacheSerialized())
+			ok = Error("-RTMPTestPlan::sharedPayload() | could not cache\n");
+		//Second time is a no op, as if piped
+		if (frame.CacheSerialized())
+			ok = Error("-RTMPTestPlan::sharedPayload() | cached twice\n");
+
+		//One connection gets a copy and other the shared one
+		RTMPChunkOutputStream a(5);
+		RTMPChunkOutputStream b(5);
+		a.SendMessage(new RTMPMessage(1,40,frame.Clone()));
+		b.SendMessage(new RTMPMessage(1,40,frame.GetType(),frame.GetSerialized()));
+
+		//Check uses
+		if (frame.GetSerialized()->GetUses()!=1)
+			ok = Error("-RTMPTestPlan::sharedPayload() | wrong uses [%d]\n",frame.GetSerialized()->GetUses());
+
+		//Frame may be reused now, messages keep their reference
+		frame.ClearSerialized();
+
+		//Get all chunks
+		DWORD clonedLen = 0;
+		DWORD sharedLen = 0;
+		while (a.HasData())
+			clonedLen += a.GetNextChunk(cloned+clonedLen,sizeof(cloned)-clonedLen,128);
+		while (b.HasData())
+			sharedLen += b.GetNextChunk(shared+sharedLen,sizeof(shared)-sharedLen,128);
+
+		//Must be the same
+		if (clonedLen!=sharedLen || memcmp(cloned,shared,clonedLen))
+			ok = Error("-RTMPTestPlan::sharedPayload() | chunks differ [cloned:%d,shared:%d]\n",clonedLen,sharedLen);
+
+		Log("-RTMPTestPlan::sharedPayload() | [ok:%d,len:%d]\n",ok,sharedLen);
+
+		return ok;
+	}
+
+	int chunkOutput()
+	{
+		BYTE media[3000];
+		BYTE copied[8192];
+		BYTE gathered[8192];
+		int ok = true;
+
+		//Create video frame bigger than several chunks
+		RTMPVideoFrame frame(0,sizeof(media));
+		for (DWORD i=0;i<sizeof(media);++i)
+			media[i] = i;
+		frame.SetVideoCodec(RTMPVideoFrame::FLV1);
+		frame.SetFrameType(RTMPVideoFrame::INTRA);
+		frame.SetVideoFrame(media,sizeof(media));
+
+		//Same messages on both
+		RTMPChunkOutputStream a(5);
+		RTMPChunkOutputStream b(5);
+		for (int i=0;i<2;++i)
+		{
+			a.SendMessage(new RTMPMessage(1,40*i,frame.Clone()));
+			b.SendMessage(new RTMPMessage(1,40*i,frame.Clone()));
+		}
+
+		//Copy them
+		DWORD copiedLen = 0;
+		while (a.HasData())
+			copiedLen += a.GetNextChunk(copied+copiedLen,sizeof(copied)-copiedLen,512);
+
+		//Gather them
+		RTMPChunkOutput output;
+		while (b.HasData())
+			b.GetNextChunk(output,512);
+
+		//Consume in odd sizes as if partially written
+		DWORD gatheredLen = 0;
+		while (!output.IsEmpty())
+		{
+			//Get first slice
+			iovec* iov = output.GetIOVec();
+			//Take only part of it
+			DWORD len = iov->iov_len>7 ? 7 : iov->iov_len;
+			//Copy
+			memcpy(gathered+gatheredLen,iov->iov_base,len);
+			gatheredLen += len;
+			//Written
+			output.Consume(len);
+		}
+
+		//Must be the same
+		if (copiedLen!=gatheredLen || memcmp(copied,gathered,copiedLen))
+			ok = Error("-RTMPTestPlan::chunkOutput() | chunks differ [copied:%d,gathered:%d]\n",copiedLen,gatheredLen);
+
+		Log("-RTMPTestPlan::chunkOutput() | [ok:%d,len:%d]\n",ok,gatheredLen);
+
+		return ok;
+	}
+
+	int benchmarkChunkOutput()
+	{
+		static const DWORD FrameSize = 200*1024;
+		static const DWORD NumFrames = 500;
+		static const DWORD ChunkSize = 512;
+		BYTE buffer[16384];
+		BYTE* media = (BYTE*)calloc(FrameSize,1);
+
+		//Sink
+		int fd = open("/dev/null",O_WRONLY);
+
+		//Create key frame
+		RTMPVideoFrame frame(0,FrameSize);
+		frame.SetVideoCodec(RTMPVideoFrame::AVC);
+		frame.SetFrameType(RTMPVideoFrame::INTRA);
+		frame.SetVideoFrame(media,FrameSize);
+		//Shared by all listeners
+		frame.CacheSerialized();
+
+		//Copy into one buffer and write
+		RTMPChunkOutputStream a(5);
+		QWORD copied = 0;
+		QWORD ini = getTime();
+		for (DWORD i=0;i<NumFrames;++i)
+		{
+			a.SendMessage(new RTMPMessage(1,40*i,frame.GetType(),frame.GetSerialized()));
+			while (a.HasData())
+			{
+				DWORD len = 0;
+				while (a.HasData() && sizeof(buffer)-len>=ChunkSize+12)
+				{
+					DWORD l = a.GetNextChunk(buffer+len,sizeof(buffer)-len,ChunkSize);
+					//Payload is copied, header is serialized
+					copied += l;
+					len += l;
+				}
+				write(fd,buffer,len);
+			}
+		}
+		QWORD copyElapsed = getTime()-ini;
+
+		//Gather and writev
+		RTMPChunkOutputStream b(5);
+		RTMPChunkOutput output;
+		QWORD serialized = 0;
+		ini = getTime();
+		for (DWORD i=0;i<NumFrames;++i)
+		{
+			b.SendMessage(new RTMPMessage(1,40*i,frame.GetType(),frame.GetSerialized()));
+			while (b.HasData())
+			{
+				while (b.HasData() && !output.IsFull())
+					b.GetNextChunk(output,ChunkSize);
+				//Only headers are serialized
+				serialized += output.GetIOVecLength()/2*RTMPChunkOutput::MaxHeaderSize;
+				int len = writev(fd,output.GetIOVec(),output.GetIOVecLength());
+				output.Consume(len);
+			}
+		}
+		QWORD gatherElapsed = getTime()-ini;
+
+		close(fd);
+		frame.ClearSerialized();
+		free(media);
+
+		Log("-RTMPTestPlan::benchmarkChunkOutput() | copy [elapsed:%llums,copied:%lluMB/s]\n",copyElapsed/1000,copyElapsed ? copied/copyElapsed : 0);
+		Log("-RTMPTestPlan::benchmarkChunkOutput() | writev [elapsed:%llums,copied:%lluMB/s]\n",gatherElapsed/1000,gatherElapsed ? serialized/gatherElapsed : 0);
+
+		return true;
+	}
+
+	int sharedStats()
+	{
+		BYTE media[1000];
+		int ok = true;
+
+		//Watchers using the shared payload
+		Watcher watchers[3];
+		RTMPMediaStream stream(1);
+		for (DWORD i=0;i<3;++i)
+			stream.AddMediaListener(&watchers[i]);
+
+		//Create video frame
+		RTMPVideoFrame frame(0,sizeof(media));
+		memset(media,0,sizeof(media));
+		frame.SetVideoCodec(RTMPVideoFrame::FLV1);
+		frame.SetFrameType(RTMPVideoFrame::INTRA);
+		frame.SetVideoFrame(media,sizeof(media));
+
+		//Get stats before
+		RTMPMediaStream::Stats ini = RTMPMediaStream::GetStats();
+
+		//Send it to all
+		stream.SendMediaFrame(&frame);
+
+		//Get them after
+		RTMPMediaStream::Stats end = RTMPMediaStream::GetStats();
+
+		//Serialized once, sent three times
+		QWORD size = end.serializedBytes-ini.serializedBytes;
+		if (end.frames-ini.frames!=1 || end.messages-ini.messages!=3 || !size || end.savedBytes-ini.savedBytes!=2*size)
+			ok = Error("-RTMPTestPlan::sharedStats() | wrong stats [frames:%llu,messages:%llu,serialized:%llu,saved:%llu]\n",end.frames-ini.frames,end.messages-ini.messages,size,end.savedBytes-ini.savedBytes);
+
+		//Payload is not kept after sending it
+		if (frame.GetSerialized())
+			ok = Error("-RTMPTestPlan::sharedStats() | payload still cached\n");
+
+		stream.RemoveAllMediaListeners();
+
+		Log("-RTMPTestPlan::sharedStats() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	virtual void Execute()
+	{
+		sharedPayload();
+		sharedStats();
+		chunkOutput();
+		benchmarkChunkOutput();
+	}
+
+private:
+	class Watcher : public RTMPMediaStream::Listener
+	{
+	public:
+		virtual void onAttached(RTMPMediaStream *stream)	{}
+		virtual void onMediaFrame(DWORD id,RTMPMediaFrame *frame)
+		{
+			//Use the shared payload as connections do
+			if (frame->GetSerialized())
+				frame->GetSerialized()->AddUse();
+		}
+		virtual void onMetaData(DWORD id,RTMPMetaData *meta)	{}
+		virtual void onCommand(DWORD id,const wchar_t *name,AMFData* obj)	{}
+		virtual void onStreamBegin(DWORD id)	{}
+		virtual void onStreamEnd(DWORD id)	{}
+		virtual void onStreamReset(DWORD id)	{}
+		virtual void onDetached(RTMPMediaStream *stream)	{}
+	};
+
+};
+
+RTMPTestPlan rtmp;
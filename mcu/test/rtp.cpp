@@ -1,5 +1,9 @@
 #include "test.h"
 #include "rtp.h"
+#include "codecs.h"
+#include "rtpsession.h"
+#include "rtpreactor.h"
+#include <sys/resource.h>
 
 class RTPTestPlan: public TestPlan
 {
@@ -26,6 +30,8 @@ public:
 	{
 		init();
 		testExtension();
+		benchmarkReactor(false);
+		benchmarkReactor(true);
 		end();
 	}
 	
@@ -88,6 +94,133 @@ public:
 		return true;
 	}
 	
+	int getNumThreads()
+	{
+		char line[256];
+		int num = 0;
+		//Open process status
+		FILE* f = fopen("/proc/self/status","r");
+		//Check
+		if (!f)
+			return 0;
+		//Read lines
+		while (fgets(line,sizeof(line),f))
+			//Check threads line
+			if (sscanf(line,"Threads: %d",&num)==1)
+				break;
+		//Close
+		fclose(f);
+		//Done
+		return num;
+	}
+	
+	int benchmarkReactor(bool useReactor)
+	{
+		const int numSessions = 100;
+		const int numPackets = 200;
+		RTPMap rtpMap;
+		rusage before;
+		rusage after;
+		
+		Log(">RTPTestPlan::benchmarkReactor() | [reactor:%d,sessions:%d,packets:%d]\n",useReactor,numSessions,numPackets);
+		
+		//Set receiving codec
+		rtpMap[AudioCodec::PCMU] = AudioCodec::PCMU;
+		
+		//Start shared reactor
+		if (useReactor)
+			RTPReactor::getInstance().Start();
+		
+		//Get threads before sessions
+		int threads = getNumThreads();
+		
+		//Create sessions
+		std::vector<RTPSession*> sessions;
+		for (int i=0;i<numSessions;++i)
+		{
+			RTPSession* session = new RTPSession(MediaFrame::Audio,NULL);
+			//Don't send reports
+			Properties properties;
+			properties.SetProperty("useRTCP","0");
+			session->SetProperties(properties);
+			session->SetReceivingRTPMap(rtpMap);
+			session->Init();
+			sessions.push_back(session);
+		}
+		
+		//Get thread delta
+		threads = getNumThreads()-threads;
+		
+		//Create sender socket
+		int fd = socket(PF_INET,SOCK_DGRAM,0);
+		sockaddr_in addr;
+		memset(&addr,0,sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		
+		//Get usage before
+		getrusage(RUSAGE_SELF,&before);
+		QWORD ini = getTime();
+		
+		//Send packets in rounds
+		for (int j=0;j<numPackets;++j)
+		{
+			//Create packet
+			RTPPacket packet(MediaFrame::Audio,AudioCodec::PCMU);
+			BYTE payload[160];
+			memset(payload,0,sizeof(payload));
+			packet.SetSSRC(0x1234);
+			packet.SetSeqNum(j);
+			packet.SetTimestamp(j*160);
+			packet.SetPayload(payload,sizeof(payload));
+			//Send to all sessions
+			for (int i=0;i<numSessions;++i)
+			{
+				addr.sin_port = htons(sessions[i]->GetLocalPort());
+				sendto(fd,packet.GetData(),packet.GetSize(),0,(sockaddr*)&addr,sizeof(addr));
+			}
+			//Simulate 20ms packetization in compressed time
+			msleep(1000);
+		}
+		
+		//Wait until all received or timeout
+		DWORD received = 0;
+		for (int k=0;k<100;++k)
+		{
+			received = 0;
+			for (int i=0;i<numSessions;++i)
+				received += sessions[i]->GetNumRecvPackets();
+			if (received>=numSessions*numPackets)
+				break;
+			msleep(10000);
+		}
+		
+		//Get usage after
+		QWORD elapsed = getTime()-ini;
+		getrusage(RUSAGE_SELF,&after);
+		
+		//Calculate context switches
+		long csw = (after.ru_nvcsw-before.ru_nvcsw) + (after.ru_nivcsw-before.ru_nivcsw);
+		
+		//Log results
+		Log("<RTPTestPlan::benchmarkReactor() | [reactor:%d,threads:%d,received:%u,elapsed:%llums,ctxsw:%ld,ctxsw/packet:%.3f]\n",
+			useReactor,threads,received,elapsed/1000,csw,received ? (double)csw/received : 0.0);
+		
+		//Clean up
+		close(fd);
+		for (int i=0;i<numSessions;++i)
+		{
+			sessions[i]->End();
+			delete(sessions[i]);
+		}
+		
+		//Stop reactor
+		if (useReactor)
+			RTPReactor::getInstance().Stop();
+		
+		//OK
+		return received==numSessions*numPackets;
+	}
 };
 
 RTPTestPlan rtp;
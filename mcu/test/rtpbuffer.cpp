@@ -0,0 +1,369 @@
+#include "test.h"
+#include "rtp.h"
+#include "codecs.h"
+#include "rtpbuffer.h"
+#include <map>
+#include <sched.h>
+
+/*
+ * Previous std::map based jitter buffer, kept for comparing against the ring one
+ */
+class MapRTPBuffer
+{
+public:
+	MapRTPBuffer()
+	{
+		maxWaitTime = 0;
+		hurryUp = false;
+		cancel = false;
+		next = (DWORD)-1;
+		pthread_mutex_init(&mutex,NULL);
+		pthread_cond_init(&cond,NULL);
+	}
+
+	~MapRTPBuffer()
+	{
+		for (Packets::iterator it=packets.begin(); it!=packets.end(); ++it)
+			delete(it->second);
+		pthread_mutex_destroy(&mutex);
+		pthread_cond_destroy(&cond);
+	}
+
+	bool Add(RTPTimedPacket *rtp)
+	{
+		DWORD seq = rtp->GetExtSeqNum();
+		pthread_mutex_lock(&mutex);
+		//If already past or duplicated
+		if ((next!=(DWORD)-1 && seq<next) || !packets.insert(std::pair<DWORD,RTPTimedPacket*>(seq,rtp)).second)
+		{
+			pthread_mutex_unlock(&mutex);
+			delete(rtp);
+			return 0;
+		}
+		pthread_mutex_unlock(&mutex);
+		pthread_cond_signal(&cond);
+		return true;
+	}
+
+	void Cancel()
+	{
+		pthread_mutex_lock(&mutex);
+		cancel = true;
+		pthread_mutex_unlock(&mutex);
+		pthread_cond_signal(&cond);
+	}
+
+	RTPPacket* Wait()
+	{
+		RTPTimedPacket* rtp = NULL;
+		pthread_mutex_lock(&mutex);
+		while (!cancel)
+		{
+			if (!packets.empty())
+			{
+				Packets::iterator it = packets.begin();
+				DWORD seq = it->first;
+				RTPTimedPacket* candidate = it->second;
+				QWORD time = candidate->GetTime();
+				if (next==(DWORD)-1 || seq==next || time+maxWaitTime<getTime()/1000 || hurryUp)
+				{
+					rtp = candidate;
+					next = seq+1;
+					packets.erase(it);
+					break;
+				}
+				timespec ts;
+				ts.tv_sec  = (time+maxWaitTime) / 1000;
+				ts.tv_nsec = (time+maxWaitTime - ts.tv_sec*1000)*1000000;
+				pthread_cond_timedwait(&cond,&mutex,&ts);
+			} else {
+				hurryUp = false;
+				pthread_cond_wait(&cond,&mutex);
+			}
+		}
+		pthread_mutex_unlock(&mutex);
+		return rtp;
+	}
+
+	DWORD Length()
+	{
+		return packets.size();
+	}
+
+	void SetMaxWaitTime(DWORD maxWaitTime)
+	{
+		this->maxWaitTime = maxWaitTime;
+	}
+private:
+	typedef std::map<DWORD,RTPTimedPacket*> Packets;
+private:
+	Packets		packets;
+	bool		cancel;
+	bool		hurryUp;
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+	DWORD		next;
+	DWORD		maxWaitTime;
+};
+
+template<typename Buffer>
+class RTPBufferProducer
+{
+public:
+	RTPBufferProducer(Buffer* buffer,DWORD num)
+	{
+		this->buffer = buffer;
+		this->num = num;
+	}
+
+	static void* run(void* par)
+	{
+		RTPBufferProducer* producer = (RTPBufferProducer*)par;
+		producer->Produce(0,producer->num,true);
+		return NULL;
+	}
+
+	void Produce(DWORD from,DWORD to,bool throttle)
+	{
+		//Add packets swapping each 8th pair and duplicating each 1000th
+		for (DWORD i=from;i<to;++i)
+		{
+			//Don't run too far ahead of the consumer, as on the network
+			while (throttle && buffer->Length()>RTPBuffer::Capacity/2)
+				sched_yield();
+			//Get seq to send
+			DWORD seq = i;
+			//Reorder
+			if (i%8==0 && i+1<to)
+				seq = i+1;
+			else if (i%8==1)
+				seq = i-1;
+			//Add it
+			buffer->Add(Create(seq));
+			//Duplicate
+			if (i%1000==999)
+				buffer->Add(Create(seq));
+		}
+	}
+
+	RTPTimedPacket* Create(DWORD seq)
+	{
+		RTPTimedPacket* packet = new(MediaFrame::Video) RTPTimedPacket(MediaFrame::Video,96);
+		packet->SetSeqNum(seq & 0xFFFF);
+		packet->SetSeqCycles(seq >> 16);
+		packet->SetTimestamp(seq*3000);
+		return packet;
+	}
+private:
+	Buffer* buffer;
+	DWORD	num;
+};
+
+struct Consumer
+{
+	Consumer(RTPBuffer* buffer)
+	{
+		this->buffer = buffer;
+		received = 0;
+	}
+
+	static void* run(void* par)
+	{
+		Consumer* consumer = (Consumer*)par;
+		RTPPacket* packet;
+		//Until canceled
+		while ((packet=consumer->buffer->Wait()))
+		{
+			//Delete it
+			delete(packet);
+			//One more
+			consumer->received++;
+		}
+		return NULL;
+	}
+
+	RTPBuffer*	buffer;
+	DWORD		received;
+};
+
+class RTPBufferTestPlan: public TestPlan
+{
+public:
+	RTPBufferTestPlan() : TestPlan("RTPBuffer test plan")
+	{
+
+	}
+
+	virtual void Execute()
+	{
+		benchmark<MapRTPBuffer>("map",false);
+		benchmark<RTPBuffer>("ring",false);
+		benchmark<MapRTPBuffer>("map",true);
+		benchmark<RTPBuffer>("ring",true);
+		jump();
+		concurrent();
+	}
+
+	int concurrent()
+	{
+		RTPBuffer buffer;
+		RTPBufferProducer<RTPBuffer> producer(&buffer,0);
+		Consumer consumer(&buffer);
+		pthread_t thread;
+		int ok = true;
+
+		//Deliver as soon as possible
+		buffer.SetMaxWaitTime(0);
+
+		//Start consuming
+		createPriorityThread(&thread,Consumer::run,&consumer,0);
+
+		//Jump each time and reset often while the consumer is taking them, run with asan to check
+		for (DWORD i=0;i<2000;++i)
+		{
+			//Far from previous ones
+			DWORD seq = i*RTPBuffer::Capacity*2;
+			//Add some
+			producer.Produce(seq,seq+32,false);
+			//Clear them as on ssrc change
+			if (i%10==9)
+				buffer.Reset();
+		}
+
+		//Stop consumer
+		buffer.Cancel();
+		pthread_join(thread,NULL);
+
+		//Check
+		if (!consumer.received || !buffer.GetResyncs())
+			ok = Error("-RTPBufferTestPlan::concurrent() | nothing done [received:%d,resyncs:%d]\n",consumer.received,buffer.GetResyncs());
+
+		Log("-RTPBufferTestPlan::concurrent() | [ok:%d,received:%d,resyncs:%d]\n",ok,consumer.received,buffer.GetResyncs());
+
+		return ok;
+	}
+
+	int jump()
+	{
+		RTPBuffer buffer;
+		RTPBufferProducer<RTPBuffer> producer(&buffer,0);
+		int ok = true;
+
+		//Wait enought for the reordered ones
+		buffer.SetMaxWaitTime(100);
+
+		//Deliver some in order
+		producer.Produce(0,16,false);
+		for (DWORD i=0;i<16;++i)
+			delete(buffer.Wait());
+
+		//Leave some on the buffer and jump further than the ring
+		producer.Produce(16,20,false);
+		DWORD jump = 18+RTPBuffer::Capacity*3;
+		producer.Produce(jump,jump+64,false);
+
+		//Stale ones are removed and new ones delivered in order
+		for (DWORD i=0;i<64;++i)
+		{
+			//Get next
+			RTPPacket* packet = buffer.Wait();
+			//Check
+			if (!packet || packet->GetExtSeqNum()!=jump+i)
+			{
+				ok = Error("-RTPBufferTestPlan::jump() | wrong packet [expected:%d,got:%d]\n",jump+i,packet ? packet->GetExtSeqNum() : -1);
+				delete(packet);
+				break;
+			}
+			delete(packet);
+		}
+
+		//Check nothing else is there
+		if (buffer.Length() || buffer.GetResyncs()!=1)
+			ok = Error("-RTPBufferTestPlan::jump() | wrong state [length:%d,resyncs:%d]\n",buffer.Length(),buffer.GetResyncs());
+
+		//Sender restarts sequence numbers back
+		producer.Produce(100,164,false);
+		for (DWORD i=0;ok && i<64;++i)
+		{
+			//Get next
+			RTPPacket* packet = buffer.Wait();
+			//Check
+			if (!packet || packet->GetExtSeqNum()!=100+i)
+				ok = Error("-RTPBufferTestPlan::jump() | wrong packet after restart [expected:%d,got:%d]\n",100+i,packet ? packet->GetExtSeqNum() : -1);
+			delete(packet);
+		}
+
+		Log("-RTPBufferTestPlan::jump() | [ok:%d,resyncs:%d]\n",ok,buffer.GetResyncs());
+
+		return ok;
+	}
+
+	template<typename Buffer>
+	int benchmark(const char* name,bool threaded)
+	{
+		const DWORD numPackets = 500000;
+		const DWORD burst = 64;
+		Buffer buffer;
+		pthread_t thread;
+
+		Log(">RTPBufferTestPlan::benchmark() | [impl:%s,threaded:%d,packets:%d]\n",name,threaded,numPackets);
+
+		//Wait enought for the reordered ones
+		buffer.SetMaxWaitTime(100);
+
+		//Create producer
+		RTPBufferProducer<Buffer> producer(&buffer,numPackets);
+
+		QWORD ini = getTime();
+
+		//Start producing
+		if (threaded)
+			createPriorityThread(&thread,RTPBufferProducer<Buffer>::run,&producer,0);
+
+		//Consume them all
+		DWORD received = 0;
+		DWORD outOfOrder = 0;
+		DWORD last = (DWORD)-1;
+		while (received<numPackets)
+		{
+			//If not threaded add a burst each time we have consumed previous one, so we never block
+			if (!threaded && received%burst==0)
+				producer.Produce(received,received+burst<numPackets ? received+burst : numPackets,false);
+			//Get next
+			RTPPacket* packet = buffer.Wait();
+			//Check
+			if (!packet)
+				break;
+			//Check order
+			if (last!=(DWORD)-1 && packet->GetExtSeqNum()!=last+1)
+				outOfOrder++;
+			//Store last
+			last = packet->GetExtSeqNum();
+			//Delete it
+			delete(packet);
+			//One more
+			received++;
+		}
+
+		//Get time
+		QWORD elapsed = getTime()-ini;
+
+		//Wait producer
+		if (threaded)
+			pthread_join(thread,NULL);
+		//Stop
+		buffer.Cancel();
+
+		Log("<RTPBufferTestPlan::benchmark() | [impl:%s,threaded:%d,received:%d,outOfOrder:%d,elapsed:%lluus,perPacket:%.3fus]\n",name,threaded,received,outOfOrder,elapsed,(double)elapsed/numPackets);
+
+		//Check all received in order
+		if (received!=numPackets || outOfOrder)
+			return Error("-RTPBufferTestPlan::benchmark() | %s failed\n",name);
+
+		//OK
+		return true;
+	}
+
+};
+
+RTPBufferTestPlan rtpbuffer;
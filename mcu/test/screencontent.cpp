@@ -0,0 +1,130 @@
+#include "test.h"
+#include "screencontent.h"
+#include "vp8/vp8encoder.h"
+#include <string.h>
+#include <stdlib.h>
+
+class ScreenContentTestPlan: public TestPlan
+{
+public:
+	ScreenContentTestPlan() : TestPlan("Screen content test plan")
+	{
+
+	}
+
+	int changes()
+	{
+		//Not multiple of 16 so last macroblocks are partial
+		static const DWORD Width = 200;
+		static const DWORD Height = 120;
+		static const DWORD NumPixels = Width*Height;
+		BYTE* pic = (BYTE*)calloc(NumPixels*3/2,1);
+		ScreenContent content;
+		int ok = true;
+
+		//First one is all changed
+		if (content.Update(pic,Width,Height)!=content.GetNumMacroblocks())
+			ok = Error("-ScreenContentTestPlan::changes() | first not all changed\n");
+		//Check size
+		if (content.GetMacroblocksWidth()!=13 || content.GetMacroblocksHeight()!=8)
+			ok = Error("-ScreenContentTestPlan::changes() | wrong size [%dx%d]\n",content.GetMacroblocksWidth(),content.GetMacroblocksHeight());
+
+		//Same picture
+		if (content.Update(pic,Width,Height))
+			ok = Error("-ScreenContentTestPlan::changes() | static picture changed\n");
+
+		//Change one luma pixel on macroblock (3,2)
+		pic[(2*16+5)*Width+3*16+7] = 1;
+		//Change one chroma pixel on last partial macroblock (12,7)
+		pic[NumPixels+(7*8+3)*Width/2+12*8+1] = 1;
+
+		//Only those
+		DWORD changed = content.Update(pic,Width,Height);
+		if (changed!=2 || !content.GetMap()[2*13+3] || !content.GetMap()[7*13+12])
+			ok = Error("-ScreenContentTestPlan::changes() | wrong changes [%d]\n",changed);
+
+		//Not a burst
+		if (content.IsBurst())
+			ok = Error("-ScreenContentTestPlan::changes() | unexpected burst\n");
+
+		//Scroll several times
+		for (int i=0;i<3;++i)
+		{
+			//Move all lines up
+			memmove(pic,pic+Width,NumPixels-Width);
+			//New line at the bottom
+			for (DWORD j=0;j<NumPixels;++j)
+				pic[j] += j%7+i;
+			content.Update(pic,Width,Height);
+		}
+		//Must be a burst
+		if (!content.IsBurst())
+			ok = Error("-ScreenContentTestPlan::changes() | burst not detected\n");
+
+		//Static again ends it
+		content.Update(pic,Width,Height);
+		if (content.IsBurst())
+			ok = Error("-ScreenContentTestPlan::changes() | burst not ended\n");
+
+		//After reset all is changed
+		content.Reset();
+		if (content.Update(pic,Width,Height)!=content.GetNumMacroblocks())
+			ok = Error("-ScreenContentTestPlan::changes() | reset not all changed\n");
+
+		free(pic);
+
+		Log("-ScreenContentTestPlan::changes() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int vp8()
+	{
+		static const DWORD Width = 320;
+		static const DWORD Height = 240;
+		static const DWORD NumPixels = Width*Height;
+		BYTE* pic = (BYTE*)calloc(NumPixels*3/2,1);
+		ScreenContent content;
+		Properties properties;
+		int ok = true;
+
+		//Encode screen content
+		properties.SetProperty("screen","1");
+		VP8Encoder encoder(properties);
+		encoder.SetFrameRate(5,256,300);
+		if (!encoder.SetSize(Width,Height))
+		{
+			free(pic);
+			return Error("-ScreenContentTestPlan::vp8() | could not open encoder\n");
+		}
+
+		//Several frames with a few changes each
+		for (int i=0;i<4;++i)
+		{
+			//Change some macroblocks
+			memset(pic+(i*16+8)*Width,i*40+20,Width/4);
+			content.Update(pic,Width,Height);
+			//The segmentation map must be accepted on every frame
+			if (encoder.SetRegionOfInterest(content.GetMap(),content.GetMacroblocksWidth(),content.GetMacroblocksHeight(),-2,6)!=1)
+				ok = Error("-ScreenContentTestPlan::vp8() | region of interest not set [frame:%d]\n",i);
+			//Encode
+			if (!encoder.EncodeFrame(pic,NumPixels*3/2))
+				ok = Error("-ScreenContentTestPlan::vp8() | encode failed [frame:%d]\n",i);
+		}
+
+		free(pic);
+
+		Log("-ScreenContentTestPlan::vp8() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	virtual void Execute()
+	{
+		changes();
+		vp8();
+	}
+
+};
+
+ScreenContentTestPlan screencontent;
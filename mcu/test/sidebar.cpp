@@ -0,0 +1,67 @@
+#include "test.h"
+#include "sidebar.h"
+#include <stdlib.h>
+#include <string.h>
+
+class SidebarTestPlan: public TestPlan
+{
+public:
+	SidebarTestPlan() : TestPlan("Sidebar test plan")
+	{
+		
+	}
+
+	int saturation()
+	{
+		Sidebar sidebar;
+		DWORD len = 160;
+		SWORD* a = (SWORD*)malloc32(Sidebar::MIXER_BUFFER_SIZE*sizeof(SWORD));
+		SWORD* b = (SWORD*)malloc32(Sidebar::MIXER_BUFFER_SIZE*sizeof(SWORD));
+		SWORD* out = (SWORD*)malloc32(Sidebar::MIXER_BUFFER_SIZE*sizeof(SWORD));
+		int ok = true;
+
+		//Two loud participants
+		for (DWORD i=0; i<len; ++i)
+		{
+			a[i] = (i%2) ? 30000 : -30000;
+			b[i] = (i%2) ? 20000 : -20000;
+		}
+
+		//Mix them
+		sidebar.Reset();
+		sidebar.Update(0,a,len);
+		sidebar.Update(1,b,len);
+		sidebar.Mix(len);
+
+		//Sum must be clipped, not wrapped
+		SWORD* mixed = sidebar.GetBuffer();
+		for (DWORD i=0; i<len; ++i)
+			if (mixed[i]!=((i%2) ? 32767 : -32768))
+				ok = Error("-SidebarTestPlan::saturation() | wrong mixed sample [i:%d,sample:%d]\n",i,mixed[i]);
+
+		//Each one must get exactly the other one back
+		sidebar.MixMinus(a,out,len);
+		if (memcmp(out,b,len*sizeof(SWORD)))
+			ok = Error("-SidebarTestPlan::saturation() | wrong mix minus\n");
+		//In place
+		sidebar.MixMinus(b,b,len);
+		if (memcmp(a,b,len*sizeof(SWORD)))
+			ok = Error("-SidebarTestPlan::saturation() | wrong in place mix minus\n");
+
+		free(a);
+		free(b);
+		free(out);
+
+		Log("-SidebarTestPlan::saturation() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	virtual void Execute()
+	{
+		saturation();
+	}
+	
+};
+
+SidebarTestPlan sidebar;
@@ -0,0 +1,199 @@
+#include "test.h"
+#include "tcpreactor.h"
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+class TCPReactorTestPlan: public TestPlan
+{
+public:
+	TCPReactorTestPlan() : TestPlan("TCP reactor test plan")
+	{
+
+	}
+
+	int echo()
+	{
+		static const DWORD NumConnections = 64;
+		static const DWORD NumBytes = 256*1024;
+		Echo* echos[NumConnections];
+		int peers[NumConnections];
+		BYTE buffer[4096];
+		int ok = true;
+
+		Log(">TCPReactorTestPlan::echo() | [connections:%d,bytes:%d]\n",NumConnections,NumBytes);
+
+		//Start reactor with few workers
+		TCPReactor::getInstance().Start(2);
+
+		//Create connections
+		for (DWORD i=0;i<NumConnections;++i)
+		{
+			int fds[2];
+			//Create connected pair
+			socketpair(AF_UNIX,SOCK_STREAM,0,fds);
+			//Non blocking
+			fcntl(fds[0],F_SETFL,fcntl(fds[0],F_GETFL,0) | O_NONBLOCK);
+			//Create echo on one side
+			echos[i] = new Echo(fds[0]);
+			//Keep the other
+			peers[i] = fds[1];
+			//Add to reactor
+			if (!TCPReactor::getInstance().AddConnection(echos[i],fds[0]))
+				ok = Error("-TCPReactorTestPlan::echo() | could not add connection\n");
+		}
+
+		QWORD ini = getTime();
+
+		//Write to each one and read back
+		for (DWORD i=0;i<NumConnections;++i)
+		{
+			DWORD sent = 0;
+			DWORD recv = 0;
+			//Until all echoed
+			while (recv<NumBytes)
+			{
+				//Send chunk while there is room, blocking peer
+				if (sent<NumBytes && sent-recv<sizeof(buffer))
+				{
+					//Fill with sequence
+					DWORD len = NumBytes-sent<sizeof(buffer) ? NumBytes-sent : sizeof(buffer);
+					for (DWORD j=0;j<len;++j)
+						buffer[j] = (BYTE)(sent+j);
+					int l = write(peers[i],buffer,len);
+					if (l>0)
+						sent += l;
+					//Spurious write signal, must be harmless
+					TCPReactor::getInstance().SignalWrite(echos[i]);
+				}
+				//Read echo back
+				int l = read(peers[i],buffer,sizeof(buffer));
+				if (l<=0)
+				{
+					ok = Error("-TCPReactorTestPlan::echo() | read error [errno:%d]\n",errno);
+					break;
+				}
+				//Check sequence
+				for (int j=0;j<l;++j)
+					if (buffer[j]!=(BYTE)(recv+j) && ok)
+						ok = Error("-TCPReactorTestPlan::echo() | wrong data [conn:%d,pos:%d]\n",i,recv+j);
+				recv += l;
+			}
+		}
+
+		QWORD elapsed = getTime()-ini;
+
+		//Close peers, workers must close the echo side
+		for (DWORD i=0;i<NumConnections;++i)
+			close(peers[i]);
+
+		//Wait for all to be closed
+		for (DWORD i=0;i<NumConnections;++i)
+		{
+			//Wait a bit
+			for (int j=0;j<100 && !echos[i]->closed;++j)
+				msleep(10000);
+			//Check
+			if (!echos[i]->closed)
+				ok = Error("-TCPReactorTestPlan::echo() | connection not closed [conn:%d]\n",i);
+			//Not registered anymore
+			if (TCPReactor::getInstance().RemoveConnection(echos[i]))
+				ok = Error("-TCPReactorTestPlan::echo() | connection still registered [conn:%d]\n",i);
+			//Forget it
+			TCPReactor::getInstance().ReleaseConnection(echos[i]);
+			//Delete
+			delete(echos[i]);
+		}
+
+		//Get stats
+		TCPReactor::Stats stats = TCPReactor::getInstance().GetStats();
+
+		//Stop it
+		TCPReactor::getInstance().Stop();
+
+		Log("<TCPReactorTestPlan::echo() | [ok:%d,elapsed:%llums,workers:%d,connections:%d,wakeups:%llu,events:%llu,signals:%llu]\n",
+			ok,elapsed/1000,stats.numWorkers,stats.numConnections,stats.numWakeUps,stats.numEvents,stats.numSignals);
+
+		return ok;
+	}
+
+	virtual void Execute()
+	{
+		echo();
+	}
+
+private:
+	//Writes back what it reads, only reading when all has been written
+	class Echo : public TCPReactor::Connection
+	{
+	public:
+		Echo(int socket)
+		{
+			this->socket = socket;
+			len = 0;
+			pos = 0;
+			closed = false;
+		}
+
+		virtual bool onReadable()
+		{
+			//Same for both
+			return Pump();
+		}
+
+		virtual bool onWritable()
+		{
+			//Same for both
+			return Pump();
+		}
+
+		virtual void onClosed()
+		{
+			close(socket);
+			closed = true;
+		}
+
+		bool Pump()
+		{
+			//Until it would block
+			while (true)
+			{
+				//If all echoed
+				if (pos==len)
+				{
+					//Read more
+					int l = read(socket,buffer,sizeof(buffer));
+					//Check
+					if (l<0)
+						return errno==EAGAIN;
+					//Closed
+					if (!l)
+						return false;
+					//Echo it
+					len = l;
+					pos = 0;
+				} else {
+					//Write pending
+					int l = write(socket,buffer+pos,len-pos);
+					//Check
+					if (l<0)
+						return errno==EAGAIN;
+					//Move
+					pos += l;
+				}
+			}
+		}
+
+	public:
+		volatile bool closed;
+	private:
+		int socket;
+		BYTE buffer[2048];
+		int len;
+		int pos;
+	};
+};
+
+TCPReactorTestPlan tcpreactor;
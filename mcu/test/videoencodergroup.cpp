@@ -0,0 +1,241 @@
+#include "test.h"
+#include "videoencodergroup.h"
+#include "tools.h"
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+class VideoEncoderGroupTestPlan: public TestPlan
+{
+public:
+	VideoEncoderGroupTestPlan() : TestPlan("Video encoder group test plan")
+	{
+
+	}
+
+	int tiers()
+	{
+		int ok = true;
+
+		//Below lowest, exact and between tiers
+		if (VideoEncoderGroup::GetTier(10)!=64 || VideoEncoderGroup::GetTier(512)!=512 || VideoEncoderGroup::GetTier(700)!=512 || VideoEncoderGroup::GetTier(100000)!=4096)
+			ok = Error("-VideoEncoderGroupTestPlan::tiers() | wrong tier\n");
+
+		//Start on configured bitrate
+		if (VideoEncoderGroup::SelectTier(0,1000,0)!=768)
+			ok = Error("-VideoEncoderGroupTestPlan::tiers() | wrong initial tier\n");
+		//Never over configured one
+		if (VideoEncoderGroup::SelectTier(768,1000,5000)!=768)
+			ok = Error("-VideoEncoderGroupTestPlan::tiers() | over configured bitrate\n");
+		//Slightly below current keeps it
+		if (VideoEncoderGroup::SelectTier(512,1000,480)!=512)
+			ok = Error("-VideoEncoderGroupTestPlan::tiers() | flapping down\n");
+		//Clearly below goes down
+		if (VideoEncoderGroup::SelectTier(512,1000,400)!=384)
+			ok = Error("-VideoEncoderGroupTestPlan::tiers() | not going down\n");
+		//Going up as soon as reached
+		if (VideoEncoderGroup::SelectTier(384,1000,512)!=512)
+			ok = Error("-VideoEncoderGroupTestPlan::tiers() | not going up\n");
+		//If configured bitrate is lowered, go down even if close
+		if (VideoEncoderGroup::SelectTier(512,500,0)!=384)
+			ok = Error("-VideoEncoderGroupTestPlan::tiers() | over lowered bitrate\n");
+
+		Log("-VideoEncoderGroupTestPlan::tiers() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int keys()
+	{
+		int ok = true;
+		VideoEncoderGroup::Key a = {(Mosaic*)1,VideoCodec::H264,640,480,30,512};
+		VideoEncoderGroup::Key b = a;
+
+		//Same
+		if (a<b || b<a)
+			ok = Error("-VideoEncoderGroupTestPlan::keys() | equal keys differ\n");
+
+		//Different tier
+		b.tier = 768;
+		if (!(a<b) || b<a)
+			ok = Error("-VideoEncoderGroupTestPlan::keys() | tier not compared\n");
+
+		//Mosaic goes first
+		b.mosaic = (Mosaic*)0;
+		if (!(b<a) || a<b)
+			ok = Error("-VideoEncoderGroupTestPlan::keys() | mosaic not compared first\n");
+
+		Log("-VideoEncoderGroupTestPlan::keys() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int membership()
+	{
+		int ok = true;
+		Counter a;
+		Counter b;
+		VideoEncoderGroup::Key key = {NULL,VideoCodec::H264,Width,Height,30,256};
+		VideoEncoderGroup group(key,1000,Properties());
+
+		//Add both, adding again does nothing
+		group.AddMember(&a);
+		group.AddMember(&b);
+		group.AddMember(&a);
+		if (group.GetNumMembers()!=2)
+			ok = Error("-VideoEncoderGroupTestPlan::membership() | wrong members [%d]\n",group.GetNumMembers());
+
+		//Each join needs an intra
+		if (group.GetStats().fpuRequested!=3)
+			ok = Error("-VideoEncoderGroupTestPlan::membership() | join without intra [%d]\n",group.GetStats().fpuRequested);
+
+		//Remove returns the remaining ones
+		if (group.RemoveMember(&a)!=1 || group.RemoveMember(&a)!=1)
+			ok = Error("-VideoEncoderGroupTestPlan::membership() | wrong remaining after remove\n");
+		//Last one
+		if (group.RemoveMember(&b)!=0 || group.GetNumMembers())
+			ok = Error("-VideoEncoderGroupTestPlan::membership() | not empty\n");
+
+		Log("-VideoEncoderGroupTestPlan::membership() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int fpu()
+	{
+		int ok = true;
+		Counter counter;
+		BYTE* pic = (BYTE*)calloc(Width*Height*3/2,1);
+		VideoEncoderGroup::Key key = {NULL,VideoCodec::H264,Width,Height,30,256};
+		VideoEncoderGroup group(key,1000,Properties());
+
+		//Start encoding
+		group.Start();
+		group.AddMember(&counter);
+
+		//Get start time
+		QWORD ini = getTime();
+
+		//Request an intra on each frame for a second
+		for (int i=0;i<100;++i)
+		{
+			//Change picture
+			memset(pic,i,Width*Height);
+			group.GetInput()->SetFrame(pic,Width,Height);
+			//Ask for intra
+			group.SendFPU();
+			//Wait
+			usleep(10000);
+		}
+
+		//Stop it
+		group.Stop();
+
+		//Get elapsed time in ms
+		DWORD elapsed = (getTime()-ini)/1000;
+		VideoEncoderGroup::Stats stats = group.GetStats();
+
+		//Check something was sent
+		if (!counter.frames || !stats.fpuSent)
+			ok = Error("-VideoEncoderGroupTestPlan::fpu() | nothing encoded [frames:%d,fpu:%d]\n",counter.frames,stats.fpuSent);
+		//Requests must be coalesced
+		if (stats.fpuSent>stats.fpuRequested)
+			ok = Error("-VideoEncoderGroupTestPlan::fpu() | more intras than requested [sent:%d,requested:%d]\n",stats.fpuSent,stats.fpuRequested);
+		//At most one each 100ms
+		if (stats.fpuSent>elapsed/100+1)
+			ok = Error("-VideoEncoderGroupTestPlan::fpu() | too many intras [sent:%d,elapsed:%d]\n",stats.fpuSent,elapsed);
+
+		free(pic);
+
+		Log("-VideoEncoderGroupTestPlan::fpu() | [ok:%d,frames:%d,intras:%d,requested:%d,sent:%d,elapsed:%d]\n",ok,counter.frames,counter.intras,stats.fpuRequested,stats.fpuSent,elapsed);
+
+		return ok;
+	}
+
+	int teardown()
+	{
+		int ok = true;
+		Counter counter;
+		BYTE* pic = (BYTE*)calloc(Width*Height*3/2,1);
+		VideoEncoderGroup::Key key = {NULL,VideoCodec::H264,Width,Height,30,256};
+		VideoEncoderGroup* group = new VideoEncoderGroup(key,1000,Properties());
+
+		//Start encoding
+		group->Start();
+		group->AddMember(&counter);
+
+		//Feed it until something is delivered, at most 2s
+		for (int i=0;i<200 && !counter.frames;++i)
+		{
+			group->GetInput()->SetFrame(pic,Width,Height);
+			usleep(10000);
+		}
+
+		//Leave, waits for the frame being delivered
+		if (group->RemoveMember(&counter))
+			ok = Error("-VideoEncoderGroupTestPlan::teardown() | not empty\n");
+
+		//Nothing is delivered after leaving
+		DWORD frames = counter.frames;
+		for (int i=0;i<20;++i)
+		{
+			group->GetInput()->SetFrame(pic,Width,Height);
+			usleep(10000);
+		}
+		if (counter.frames!=frames)
+			ok = Error("-VideoEncoderGroupTestPlan::teardown() | delivered after leaving\n");
+
+		//Stop while waiting for a picture must not block
+		QWORD ini = getTime();
+		if (group->Stop()!=1 || group->Stop()!=0)
+			ok = Error("-VideoEncoderGroupTestPlan::teardown() | wrong stop\n");
+		//Delete it, already stopped
+		delete(group);
+		if (getTime()-ini>1000000)
+			ok = Error("-VideoEncoderGroupTestPlan::teardown() | stop too slow\n");
+
+		//Never started can be deleted too
+		delete(new VideoEncoderGroup(key,1000,Properties()));
+
+		free(pic);
+
+		Log("-VideoEncoderGroupTestPlan::teardown() | [ok:%d,frames:%d]\n",ok,frames);
+
+		return ok;
+	}
+
+	virtual void Execute()
+	{
+		tiers();
+		keys();
+		membership();
+		fpu();
+		teardown();
+	}
+
+private:
+	static const DWORD Width = 176;
+	static const DWORD Height = 144;
+
+	class Counter : public VideoEncoderGroup::Listener
+	{
+	public:
+		Counter()
+		{
+			frames = 0;
+			intras = 0;
+		}
+		virtual void onEncodedFrame(VideoEncoderGroup* group,VideoFrame* frame,DWORD sendingTime)
+		{
+			//Count it
+			frames++;
+			if (frame->IsIntra())
+				intras++;
+		}
+	public:
+		DWORD frames;
+		DWORD intras;
+	};
+};
+
+VideoEncoderGroupTestPlan videoencodergroup;
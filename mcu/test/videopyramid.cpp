@@ -0,0 +1,154 @@
+#include "test.h"
+#include "videopyramid.h"
+#include <string.h>
+#include <stdlib.h>
+
+class VideoPyramidTestPlan: public TestPlan
+{
+public:
+	VideoPyramidTestPlan() : TestPlan("Video pyramid test plan")
+	{
+
+	}
+
+	int levels()
+	{
+		static const DWORD Width = 320;
+		static const DWORD Height = 240;
+		static const DWORD NumPixels = Width*Height;
+		BYTE* pic = (BYTE*)malloc(NumPixels*3/2);
+		VideoPyramid pyramid;
+		int ok = true;
+
+		//Flat grey picture
+		memset(pic,100,NumPixels);
+		memset(pic+NumPixels,128,NumPixels/2);
+
+		//Half, quarter, half again and a not capturing one
+		pyramid.Init(4);
+		pyramid.SetVideoSize(Width,Height);
+		pyramid.GetLevel(0)->StartVideoCapture(Width/2,Height/2,30);
+		pyramid.GetLevel(1)->StartVideoCapture(Width/4,Height/4,30);
+		pyramid.GetLevel(2)->StartVideoCapture(Width/2,Height/2,30);
+
+		//Publish picture
+		pyramid.NextFrame(pic);
+
+		//Half is scaled from input, same size is shared and quarter is done from half
+		VideoPyramid::Stats stats = pyramid.GetStats();
+		if (stats.frames!=1 || stats.scaled!=1 || stats.shared!=1 || stats.fromLevel!=1)
+			ok = Error("-VideoPyramidTestPlan::levels() | wrong stats [frames:%llu,scaled:%llu,shared:%llu,fromLevel:%llu]\n",stats.frames,stats.scaled,stats.shared,stats.fromLevel);
+
+		//Grab them
+		BYTE* half = pyramid.GetLevel(0)->GrabFrame(10);
+		BYTE* quarter = pyramid.GetLevel(1)->GrabFrame(10);
+		BYTE* shared = pyramid.GetLevel(2)->GrabFrame(10);
+
+		//Check
+		if (!half || !quarter || half!=shared)
+			ok = Error("-VideoPyramidTestPlan::levels() | wrong pictures [half:%p,quarter:%p,shared:%p]\n",half,quarter,shared);
+
+		//Check content
+		for (DWORD i=0;quarter && i<NumPixels/16;++i)
+		{
+			if (quarter[i]!=100)
+			{
+				ok = Error("-VideoPyramidTestPlan::levels() | wrong luma [%d:%d]\n",i,quarter[i]);
+				break;
+			}
+		}
+
+		//Not capturing one has nothing
+		if (pyramid.GetLevel(3)->GrabFrame(10))
+			ok = Error("-VideoPyramidTestPlan::levels() | picture on not capturing level\n");
+
+		//Stop them
+		for (DWORD i=0;i<pyramid.GetNumLevels();++i)
+			pyramid.GetLevel(i)->StopVideoCapture();
+		pyramid.End();
+
+		free(pic);
+
+		Log("-VideoPyramidTestPlan::levels() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	int strided()
+	{
+		static const DWORD Width = 320;
+		static const DWORD Height = 240;
+		static const DWORD Stride = Width+64;
+		VideoPyramid pyramid;
+		int ok = true;
+
+		//Decoded picture with padding
+		VideoBuffer* input = VideoBuffer::Create(Width,Height,Stride,Height+32);
+		//Garbage on the padding
+		memset(input->GetData(),0xFF,Stride*(Height+32)*3/2);
+		//Flat grey picture
+		for (DWORD j=0;j<Height;++j)
+			memset(input->GetPlane(0)+j*Stride,100,Width);
+		for (DWORD j=0;j<Height/2;++j)
+		{
+			memset(input->GetPlane(1)+j*Stride/2,128,Width/2);
+			memset(input->GetPlane(2)+j*Stride/2,128,Width/2);
+		}
+
+		//Same size and half
+		pyramid.Init(2);
+		pyramid.SetVideoSize(Width,Height);
+		pyramid.GetLevel(0)->StartVideoCapture(Width,Height,30);
+		pyramid.GetLevel(1)->StartVideoCapture(Width/2,Height/2,30);
+
+		//Publish it
+		pyramid.NextFrame(input);
+
+		//Not packed so it can not be shared, half is done from the repacked one
+		VideoPyramid::Stats stats = pyramid.GetStats();
+		if (stats.frames!=1 || stats.scaled!=1 || stats.shared!=0 || stats.fromLevel!=1)
+			ok = Error("-VideoPyramidTestPlan::strided() | wrong stats [frames:%llu,scaled:%llu,shared:%llu,fromLevel:%llu]\n",stats.frames,stats.scaled,stats.shared,stats.fromLevel);
+
+		//Grab full one
+		BYTE* full = pyramid.GetLevel(0)->GrabFrame(10);
+
+		//Check padding has not been copied
+		for (DWORD i=0;full && i<Width*Height;++i)
+		{
+			if (full[i]!=100)
+			{
+				ok = Error("-VideoPyramidTestPlan::strided() | wrong luma [%d:%d]\n",i,full[i]);
+				break;
+			}
+		}
+		for (DWORD i=Width*Height;full && i<Width*Height*3/2;++i)
+		{
+			if (full[i]!=128)
+			{
+				ok = Error("-VideoPyramidTestPlan::strided() | wrong chroma [%d:%d]\n",i,full[i]);
+				break;
+			}
+		}
+
+		//Stop them
+		for (DWORD i=0;i<pyramid.GetNumLevels();++i)
+			pyramid.GetLevel(i)->StopVideoCapture();
+		pyramid.End();
+
+		//Release ours
+		input->Release();
+
+		Log("-VideoPyramidTestPlan::strided() | [ok:%d]\n",ok);
+
+		return ok;
+	}
+
+	virtual void Execute()
+	{
+		levels();
+		strided();
+	}
+
+};
+
+VideoPyramidTestPlan videopyramid;